@@ -50,6 +50,26 @@ int osmo_pbit2ubit_ext(ubit_t *out, unsigned int out_ofs,
                        const pbit_t *in, unsigned int in_ofs,
                        unsigned int num_bits, int lsb_mode);
 
+void osmo_sbit2ubit(ubit_t *out, const sbit_t *in, unsigned int num_bits);
+
+void osmo_ubit2sbit(sbit_t *out, const ubit_t *in, unsigned int num_bits);
+
+void osmo_ubit_xor(ubit_t *out, const ubit_t *in, const ubit_t *ks,
+		   unsigned int num_bits);
+
+void osmo_sbit_xor(sbit_t *out, const sbit_t *in, const ubit_t *ks,
+		   unsigned int num_bits);
+
+/*! \brief implementations of the bulk bit conversion functions */
+enum osmo_bits_backend {
+	OSMO_BITS_GENERIC,	/*!< \brief portable, 64bit word at a time */
+	OSMO_BITS_SSE2,		/*!< \brief x86 SSE2 */
+	OSMO_BITS_AVX2,		/*!< \brief x86 AVX2 */
+};
+
+int osmo_bits_set_backend(enum osmo_bits_backend backend);
+enum osmo_bits_backend osmo_bits_get_backend(void);
+
 #define OSMO_BIN_SPEC "%d%d%d%d%d%d%d%d"
 #define OSMO_BIN_PRINT(byte)  \
   (byte & 0x80 ? 1 : 0), \
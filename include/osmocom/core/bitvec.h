@@ -62,6 +62,16 @@ struct bitvec {
 	uint8_t *data;		/*!< \brief pointer to data array */
 };
 
+/*! \brief cursor for sequential field access to a \ref bitvec */
+struct bitvec_cursor {
+	struct bitvec *bv;	/*!< \brief bit vector accessed */
+	unsigned int pos;	/*!< \brief bit position of the next field */
+	unsigned int limit;	/*!< \brief size of the bit vector in bits */
+	int err;		/*!< \brief 0 or (sticky) negative error */
+	uint64_t acc;		/*!< \brief written bits not yet stored */
+	unsigned int acc_bits;	/*!< \brief number of bits in \a acc */
+};
+
 enum bit_value bitvec_get_bit_pos(const struct bitvec *bv, unsigned int bitnr);
 enum bit_value bitvec_get_bit_pos_high(const struct bitvec *bv,
 					unsigned int bitnr);
@@ -91,5 +101,11 @@ void bitvec_zero(struct bitvec *bv);
 unsigned bitvec_rl(const struct bitvec *bv, bool b);
 void bitvec_shiftl(struct bitvec *bv, unsigned int n);
 int16_t bitvec_get_int16_msb(const struct bitvec *bv, unsigned int num_bits);
+void bitvec_cursor_init(struct bitvec_cursor *c, struct bitvec *bv,
+			unsigned int pos);
+uint64_t bitvec_cursor_read(struct bitvec_cursor *c, unsigned int len);
+void bitvec_cursor_write(struct bitvec_cursor *c, uint64_t val,
+			 unsigned int len);
+int bitvec_cursor_finish(struct bitvec_cursor *c);
 
 /*! @} */
@@ -103,8 +103,26 @@ int  osmo_conv_encode(const struct osmo_conv_code *code,
 
 /* Decoding */
 
+/*! \brief Viterbi decoder implementations
+ *
+ *  The SIMD backends are used for codes with K=5 or K=7 and N=2..4, any
+ *  other code is decoded by the generic implementation. All of them
+ *  produce identical results.
+ */
+enum osmo_conv_decode_backend {
+	OSMO_CONV_DECODE_GENERIC,	/*!< \brief portable C */
+	OSMO_CONV_DECODE_SSE2,		/*!< \brief x86 SSE2 */
+	OSMO_CONV_DECODE_SSE41,		/*!< \brief x86 SSE4.1 */
+	OSMO_CONV_DECODE_AVX2,		/*!< \brief x86 AVX2 */
+};
+
+int osmo_conv_decode_set_backend(enum osmo_conv_decode_backend backend);
+enum osmo_conv_decode_backend osmo_conv_decode_get_backend(void);
+
 	/* Low level API */
 
+struct osmo_conv_acc;
+
 /*! \brief convolutional decoder state */
 struct osmo_conv_decoder {
 	const struct osmo_conv_code *code; /*!< \brief for which code? */
@@ -119,6 +137,8 @@ struct osmo_conv_decoder {
 	unsigned int *ae;	/*!< \brief accumulated error */
 	unsigned int *ae_next;	/*!< \brief next accumulated error (tmp in scan) */
 	uint8_t *state_history;	/*!< \brief state history [len][n_states] */
+
+	struct osmo_conv_acc *acc; /*!< \brief SIMD trellis tables (private) */
 };
 
 void osmo_conv_decode_init(struct osmo_conv_decoder *decoder,
@@ -140,4 +160,17 @@ int osmo_conv_decode(const struct osmo_conv_code *code,
                      const sbit_t *input, ubit_t *output);
 
 
+/* Compiled codes */
+
+struct osmo_conv_compiled;
+
+struct osmo_conv_compiled *osmo_conv_compile(const struct osmo_conv_code *code);
+void osmo_conv_compiled_free(struct osmo_conv_compiled *cc);
+
+int osmo_conv_encode_compiled(struct osmo_conv_compiled *cc,
+                              const ubit_t *input, ubit_t *output);
+int osmo_conv_decode_compiled(struct osmo_conv_compiled *cc,
+                              const sbit_t *input, ubit_t *output);
+
+
 /*! @} */
@@ -16,18 +16,34 @@
 /*! \brief Maximum number of logging filters */
 #define LOG_MAX_FILTERS	8
 
+/*! \brief Compile-time floor of the log level
+ *
+ * If defined (e.g. CPPFLAGS=-DLOG_MIN_LEVEL=LOGL_INFO for a release
+ * build), call sites of \ref LOGP and \ref DEBUGP with a constant level
+ * below it are removed by the compiler.
+ */
+#ifdef LOG_MIN_LEVEL
+#define LOG_LEVEL_COMPILED(level)	((level) >= LOG_MIN_LEVEL)
+#else
+#define LOG_LEVEL_COMPILED(level)	1
+#endif
+
 #define DEBUG
 
 #ifdef DEBUG
 #define DEBUGP(ss, fmt, args...) \
 	do { \
-		if (log_check_level(ss, LOGL_DEBUG)) \
+		if (LOG_LEVEL_COMPILED(LOGL_DEBUG) && \
+		    log_check_level_cached(ss, LOGL_DEBUG) && \
+		    log_check_level(ss, LOGL_DEBUG)) \
 			logp(ss, __FILE__, __LINE__, 0, fmt, ## args); \
 	} while(0)
 
 #define DEBUGPC(ss, fmt, args...) \
 	do { \
-		if (log_check_level(ss, LOGL_DEBUG)) \
+		if (LOG_LEVEL_COMPILED(LOGL_DEBUG) && \
+		    log_check_level_cached(ss, LOGL_DEBUG) && \
+		    log_check_level(ss, LOGL_DEBUG)) \
 			logp(ss, __FILE__, __LINE__, 1, fmt, ## args); \
 	} while(0)
 
@@ -50,7 +66,9 @@ void logp(int subsys, const char *file, int line, int cont, const char *format,
  */
 #define LOGP(ss, level, fmt, args...) \
 	do { \
-		if (log_check_level(ss, level)) \
+		if (LOG_LEVEL_COMPILED(level) && \
+		    log_check_level_cached(ss, level) && \
+		    log_check_level(ss, level)) \
 			logp2(ss, level, __FILE__, __LINE__, 0, fmt, ##args); \
 	} while(0)
 
@@ -62,7 +80,9 @@ void logp(int subsys, const char *file, int line, int cont, const char *format,
  */
 #define LOGPC(ss, level, fmt, args...) \
 	do { \
-		if (log_check_level(ss, level)) \
+		if (LOG_LEVEL_COMPILED(level) && \
+		    log_check_level_cached(ss, level) && \
+		    log_check_level(ss, level)) \
 			logp2(ss, level, __FILE__, __LINE__, 1, fmt, ##args); \
 	} while(0)
 
@@ -108,6 +128,7 @@ struct log_context {
 };
 
 struct log_target;
+struct log_bin_rec;
 
 /*! \brief Log filter function */
 typedef int log_filter(const struct log_context *ctx,
@@ -149,6 +170,17 @@ enum log_target_type {
 	LOG_TGT_TYPE_FILE,	/*!< \brief text file logging */
 	LOG_TGT_TYPE_STDERR,	/*!< \brief stderr logging */
 	LOG_TGT_TYPE_STRRB,	/*!< \brief osmo_strrb-backed logging */
+	LOG_TGT_TYPE_BIN_RB,	/*!< \brief binary ring buffer, formatted
+				 *   when read */
+};
+
+/*! \brief When the asynchronous writer flushes the output of a target */
+enum log_flush_policy {
+	LOG_FLUSH_ALWAYS,	/*!< \brief after every message */
+	LOG_FLUSH_LEVEL,	/*!< \brief after messages of at least
+				 *   \ref log_target.flush_level, and when
+				 *   the writer runs idle */
+	LOG_FLUSH_IDLE,		/*!< \brief only when the writer runs idle */
 };
 
 /*! \brief structure representing a logging target */
@@ -207,6 +239,31 @@ struct log_target {
 	 */
         void (*output) (struct log_target *target, unsigned int level,
 			const char *string);
+
+	/*! \brief hand messages to the writer thread, see
+	 *	   \ref log_target_set_async */
+	unsigned int async:1;
+	/*! \brief when to flush the output in asynchronous mode */
+	enum log_flush_policy flush_policy;
+	/*! \brief lowest level flushed at once with \ref LOG_FLUSH_LEVEL */
+	uint8_t flush_level;
+	/*! \brief messages dropped since the last one written */
+	unsigned long async_dropped;
+
+	/*! \brief call-back function to be called instead of \ref output
+	 *	   with the unformatted message, if set
+	 *  \param[in] target logging target
+	 *  \param[in] rec the message as binary record
+	 */
+	void (*output_bin) (struct log_target *target,
+			    const struct log_bin_rec *rec);
+};
+
+/*! \brief Counters of the asynchronous logging pipeline */
+struct log_async_stats {
+	unsigned long enqueued;	/*!< \brief messages handed to the writer */
+	unsigned long dequeued;	/*!< \brief messages taken by the writer */
+	unsigned long dropped;	/*!< \brief messages dropped, ring full */
 };
 
 /* use the above macros */
@@ -215,6 +272,29 @@ void logp2(int subsys, unsigned int level, const char *file,
 				__attribute__ ((format (printf, 6, 7)));
 int log_init(const struct log_info *inf, void *talloc_ctx);
 int log_check_level(int subsys, unsigned int level);
+void log_cache_update(void);
+
+/* lowest level enabled in any target per category, indexed by subsys from
+ * -OSMO_NUM_DLIB (library) to osmo_log_num_cat_user - 1 (application) */
+extern uint8_t *osmo_log_min_level;
+extern int osmo_log_num_cat_user;
+
+/*! \brief Check whether a log entry might get generated at all
+ *  \param[in] subsys logging subsystem
+ *  \param[in] level log level
+ *  \returns 0 if no target logs \a level in \a subsys, != 0 otherwise
+ *
+ *  Unlike \ref log_check_level, this doesn't walk the targets or call
+ *  the filters, but only checks the levels cached by
+ *  \ref log_cache_update.  The logging macros use it as a cheap reject
+ *  before \ref log_check_level.
+ */
+static inline int log_check_level_cached(int subsys, unsigned int level)
+{
+	if (subsys >= -OSMO_NUM_DLIB && subsys < osmo_log_num_cat_user)
+		return level >= osmo_log_min_level[subsys];
+	return 1;
+}
 
 /* context management */
 void log_reset_context(void);
@@ -235,6 +315,15 @@ const char *log_level_str(unsigned int lvl);
 int log_parse_category(const char *category);
 void log_set_category_filter(struct log_target *target, int category,
 			       int enable, int level);
+void log_set_flush_policy(struct log_target *target,
+			  enum log_flush_policy policy, int level);
+
+/* asynchronous logging */
+int log_async_start(unsigned int num_msgs);
+void log_async_stop(void);
+void log_async_flush(void);
+void log_async_get_stats(struct log_async_stats *stats);
+int log_target_set_async(struct log_target *target, int async);
 
 /* management of the targets */
 struct log_target *log_target_create(void);
@@ -0,0 +1,61 @@
+#pragma once
+
+/*! \addtogroup logging
+ *  @{
+ */
+
+/*! \file logging_bin.h
+ *  \brief Binary log records, formatted when they are read
+ *
+ * Instead of formatting a message when it is logged, the subsystem,
+ * level, source location, a CLOCK_MONOTONIC timestamp, the format string
+ * pointer and the raw values of the arguments are captured in a compact
+ * record.  The text is only rendered when the record is read, e.g. by
+ * the asynchronous writer thread or from a binary ring buffer target.
+ *
+ * The format string and the file name are referenced, not copied, so
+ * they must be static (string literals, as with \ref LOGP).  Strings
+ * passed for %s are copied into the record.
+ */
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <sys/time.h>
+
+/*! \brief maximum length of a binary log record */
+#define LOG_BIN_MAX_LEN		1024
+
+/*! \brief continuation of the previous message (\ref LOGPC) */
+#define LOG_BIN_F_CONT		0x01
+/*! \brief the arguments couldn't be captured, \ref log_bin_rec.args
+ *	   holds the formatted message instead */
+#define LOG_BIN_F_TEXT		0x02
+
+/*! \brief A binary log record */
+struct log_bin_rec {
+	uint64_t time;		/*!< \brief CLOCK_MONOTONIC in ns */
+	const char *file;	/*!< \brief source file name */
+	const char *fmt;	/*!< \brief printf format string */
+	uint32_t line;		/*!< \brief source line */
+	uint16_t len;		/*!< \brief total length, including args */
+	uint16_t subsys;	/*!< \brief index into \ref log_info.cat */
+	uint8_t level;		/*!< \brief log level */
+	uint8_t flags;		/*!< \brief LOG_BIN_F_* */
+	uint8_t args[0];	/*!< \brief raw (unaligned) arguments */
+};
+
+/*! \brief length of the header of a \ref log_bin_rec */
+#define LOG_BIN_HDR_LEN		offsetof(struct log_bin_rec, args)
+
+int log_bin_encode(struct log_bin_rec *rec, size_t size, unsigned int subsys,
+		   unsigned int level, const char *file, int line, int cont,
+		   const char *format, va_list ap);
+int log_bin_render(char *buf, size_t size, const struct log_bin_rec *rec);
+void log_bin_realtime(const struct log_bin_rec *rec, struct timeval *tv);
+
+struct log_target;
+void log_bin_format(struct log_target *target, char *buf, int size,
+		    const struct log_bin_rec *rec);
+
+/*! @} */
@@ -34,4 +34,14 @@ size_t log_target_rb_avail_size(struct log_target const *target);
 const char *log_target_rb_get(struct log_target const *target, size_t logindex);
 struct log_target *log_target_create_rb(size_t size);
 
+struct log_bin_rec;
+
+struct log_target *log_target_create_rb_bin(size_t size);
+size_t log_target_rb_bin_used_size(struct log_target const *target);
+size_t log_target_rb_bin_avail_size(struct log_target const *target);
+int log_target_rb_bin_foreach(struct log_target const *target,
+			      int (*cb)(const struct log_bin_rec *rec,
+					void *data),
+			      void *data);
+
 /*! @} */
@@ -38,6 +38,8 @@
 
 #define MSGB_DEBUG
 
+struct msgb_shinfo;
+
 /*! \brief Osmocom message buffer */
 struct msgb {
 	struct llist_head list; /*!< \brief linked list header */
@@ -64,9 +66,30 @@ struct msgb {
 	unsigned char *head;	/*!< \brief start of underlying memory buffer */
 	unsigned char *tail;	/*!< \brief end of message in buffer */
 	unsigned char *data;	/*!< \brief start of message in buffer */
+	struct msgb_shinfo *shinfo; /*!< \brief shared buffer state, see \ref msgb_clone */
+	struct msgb *frag;	/*!< \brief next fragment of a msgb chain */
 	unsigned char _data[0]; /*!< \brief optional immediate data array */
 };
 
+/*! \brief maximum number of msgb chain fragments passed to a single
+ *  writev()/sendmsg() by the library */
+#define MSGB_IOV_MAX	16
+
+struct rate_ctr_group;
+struct iovec;
+
+/*! \brief Counters of the msgb pool */
+enum msgb_pool_ctr {
+	MSGB_POOL_CTR_HIT,	/*!< \brief allocation served from the pool */
+	MSGB_POOL_CTR_MISS,	/*!< \brief allocation with empty free list */
+	MSGB_POOL_CTR_RECYCLE,	/*!< \brief buffer put back to the pool */
+	MSGB_POOL_CTR_RELEASE,	/*!< \brief buffer free'd as pool was full */
+};
+
+int msgb_pool_add_class(uint16_t size, unsigned int max_free);
+void msgb_pool_flush(void);
+struct rate_ctr_group *msgb_pool_get_ctrg(void);
+
 extern struct msgb *msgb_alloc(uint16_t size, const char *name);
 extern void msgb_free(struct msgb *m);
 extern void msgb_enqueue(struct llist_head *queue, struct msgb *msg);
@@ -77,6 +100,16 @@ extern const char *msgb_hexdump(const struct msgb *msg);
 extern int msgb_resize_area(struct msgb *msg, uint8_t *area,
 	int old_size, int new_size);
 extern struct msgb *msgb_copy(const struct msgb *msg, const char *name);
+struct msgb *msgb_clone(struct msgb *msg, const char *name);
+int msgb_unshare(struct msgb *msg);
+int msgb_shared(const struct msgb *msg);
+void _msgb_claim(struct msgb *msg, unsigned int headroom,
+		 unsigned int tailroom);
+void msgb_frag_append(struct msgb *msg, struct msgb *frag);
+unsigned int msgb_chain_len(const struct msgb *msg);
+int msgb_linearize(struct msgb *msg);
+int msgb_iovec(const struct msgb *msg, struct iovec *iov, unsigned int iovcnt);
+void msgb_chain_pull(struct msgb *msg, unsigned int len);
 static int msgb_test_invariant(const struct msgb *msg) __attribute__((pure));
 
 #ifdef MSGB_DEBUG
@@ -183,7 +216,10 @@ static inline int msgb_headroom(const struct msgb *msgb)
  */
 static inline unsigned char *msgb_put(struct msgb *msgb, unsigned int len)
 {
-	unsigned char *tmp = msgb->tail;
+	unsigned char *tmp;
+	if (msgb->shinfo)
+		_msgb_claim(msgb, 0, len);
+	tmp = msgb->tail;
 	if (msgb_tailroom(msgb) < (int) len)
 		MSGB_ABORT(msgb, "Not enough tailroom msgb_push (%u < %u)\n",
 			   msgb_tailroom(msgb), len);
@@ -281,6 +317,8 @@ static inline uint32_t msgb_get_u32(struct msgb *msgb)
  */
 static inline unsigned char *msgb_push(struct msgb *msgb, unsigned int len)
 {
+	if (msgb->shinfo)
+		_msgb_claim(msgb, len, 0);
 	if (msgb_headroom(msgb) < (int) len)
 		MSGB_ABORT(msgb, "Not enough headroom msgb_push (%u < %u)\n",
 			   msgb_headroom(msgb), len);
@@ -377,6 +415,8 @@ static inline int msgb_trim(struct msgb *msg, int len)
 		MSGB_ABORT(msg, "Negative length is not allowed\n");
 	if (len > msg->data_len)
 		return -1;
+	if (msg->shinfo && len > msg->len)
+		_msgb_claim(msg, 0, len - msg->len);
 
 	msg->len = len;
 	msg->tail = msg->data + len;
@@ -33,8 +33,22 @@ struct osmo_fd {
 	void *data;
 	/*! private number, extending \a data */
 	unsigned int priv_nr;
+	/*! \brief interest set currently installed in the kernel by the
+	 * epoll backend (internal, 0 if not installed) */
+	unsigned int kernel_when;
 };
 
+/*! \brief Backend used by \ref osmo_select_main to wait for events */
+enum osmo_select_backend {
+	/*! \brief select(2), limited to file descriptors < FD_SETSIZE */
+	OSMO_SELECT_BACKEND_SELECT,
+	/*! \brief epoll(7), only ready file descriptors are dispatched */
+	OSMO_SELECT_BACKEND_EPOLL,
+};
+
+int osmo_select_set_backend(enum osmo_select_backend backend);
+enum osmo_select_backend osmo_select_get_backend(void);
+
 int osmo_fd_register(struct osmo_fd *fd);
 void osmo_fd_unregister(struct osmo_fd *fd);
 int osmo_select_main(int polling);
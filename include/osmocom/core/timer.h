@@ -41,6 +41,10 @@
  *        x seconds and microseconds from now...
  *      - Use osmo_timer_del to remove the timer
  *
+ *  Timeouts are based on the monotonic clock as returned by
+ *  osmo_clock_now_cached(), which osmo_select_main() samples before it
+ *  waits and after the wait returned.
+ *
  *  Internally:
  *      - We hook into select.c to give a timeval of the
  *        nearest timer. On already passed timers we give
@@ -60,6 +64,15 @@ struct osmo_timer_list {
 	void *data;		  /*!< \brief user data for callback */
 };
 
+/*! \brief Data structure used to manage the pending timers */
+enum osmo_timer_backend {
+	/*! \brief red-black tree sorted by expiration (default) */
+	OSMO_TIMER_BACKEND_RBTREE,
+	/*! \brief hierarchical timing wheel with O(1) add and delete,
+	 * expiration is rounded up to the next millisecond */
+	OSMO_TIMER_BACKEND_WHEEL,
+};
+
 /**
  * timer management
  */
@@ -82,5 +95,19 @@ struct timeval *osmo_timers_nearest(void);
 void osmo_timers_prepare(void);
 int osmo_timers_update(void);
 int osmo_timers_check(void);
+int osmo_timers_set_backend(enum osmo_timer_backend backend);
+
+/*
+ * timer clock
+ */
+void osmo_clock_update(void);
+void osmo_clock_now(struct timeval *now);
+void osmo_clock_now_cached(struct timeval *now);
+void osmo_clock_realtime(struct timeval *now);
+void osmo_clock_realtime_cached(struct timeval *now);
+
+void osmo_clock_override_enable(int enable);
+void osmo_clock_override_set(const struct timeval *tv);
+void osmo_clock_override_add(time_t secs, suseconds_t usecs);
 
 /*! @} */
@@ -32,6 +32,21 @@
 #include <osmocom/core/select.h>
 #include <osmocom/core/msgb.h>
 
+/*! \brief behaviour of \ref osmo_wqueue_enqueue on a full queue */
+enum osmo_wqueue_policy {
+	/*! \brief don't enforce max_length (default) */
+	OSMO_WQUEUE_UNLIMITED,
+	/*! \brief drop the oldest msgb not yet (partially) written */
+	OSMO_WQUEUE_DROP_OLDEST,
+	/*! \brief drop the msgb to be enqueued */
+	OSMO_WQUEUE_DROP_NEWEST,
+	/*! \brief return -ENOSPC, the msgb is not consumed */
+	OSMO_WQUEUE_REJECT,
+};
+
+/*! \brief maximum number of iovecs written by one writev() in batch mode */
+#define OSMO_WQUEUE_IOV_MAX	64
+
 /*! write queue instance */
 struct osmo_wqueue {
 	/*! \brief osmocom file descriptor */
@@ -46,10 +61,23 @@ struct osmo_wqueue {
 
 	/*! \brief call-back in case qeueue is readable */
 	int (*read_cb)(struct osmo_fd *fd);
-	/*! \brief call-back in case qeueue is writable */
+	/*! \brief call-back in case qeueue is writable; if NULL, the
+	 *  msgbs (or msgb chains) are written using writev() */
 	int (*write_cb)(struct osmo_fd *fd, struct msgb *msg);
 	/*! \brief call-back in case qeueue has exceptions */
 	int (*except_cb)(struct osmo_fd *fd);
+
+	/*! \brief maximum number of msgbs written per writable event;
+	 *  without write_cb, they are coalesced into a single writev() */
+	unsigned int batch;
+	/*! \brief what to do if max_length is reached */
+	enum osmo_wqueue_policy policy;
+	/*! \brief first msgb in the queue is partially written */
+	int partial;
+	/*! \brief number of msgbs dropped by the policy */
+	unsigned int dropped;
+	/*! \brief number of msgbs rejected by the policy */
+	unsigned int rejected;
 };
 
 void osmo_wqueue_init(struct osmo_wqueue *queue, int max_length);
@@ -76,6 +76,12 @@ struct osmo_auth_impl {
 			    struct osmo_sub_auth_data *aud,
 			    const uint8_t *rand_auts, const uint8_t *auts,
 			    const uint8_t *_rand);
+
+	/*! \brief callback for generating several auth vectors at once
+	 *  (optional, gen_vec is called for each vector if missing) */
+	int (*gen_vec_batch)(struct osmo_auth_vector *vec, unsigned int num,
+			     struct osmo_sub_auth_data *aud,
+			     const uint8_t *_rand);
 };
 
 int osmo_auth_gen_vec(struct osmo_auth_vector *vec,
@@ -86,6 +92,10 @@ int osmo_auth_gen_vec_auts(struct osmo_auth_vector *vec,
 			   const uint8_t *rand_auts, const uint8_t *auts,
 			   const uint8_t *_rand);
 
+int osmo_auth_gen_vec_batch(struct osmo_auth_vector *vec, unsigned int num,
+			    struct osmo_sub_auth_data *aud,
+			    const uint8_t *_rand);
+
 int osmo_auth_register(struct osmo_auth_impl *impl);
 
 int osmo_auth_load(const char *path);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <osmocom/core/linuxlist.h>
+#include <osmocom/gsm/kasumi.h>
 
 #define GSM0464_CIPH_MAX_BLOCK	1523
 
@@ -17,6 +18,21 @@ enum gprs_cipher_direction {
 	GPRS_CIPH_SGSN2MS,
 };
 
+struct gprs_cipher_impl;
+
+/* A Kc prepared once, e.g. per LLME, and used for every frame.  Set up
+ * by gprs_cipher_key_init() and wiped by gprs_cipher_key_clear() */
+struct gprs_cipher_key {
+	enum gprs_ciph_algo algo;
+	uint64_t kc;
+	/* implementation selected when the key was prepared */
+	const struct gprs_cipher_impl *impl;
+	/* implementation specific key state */
+	union {
+		struct kasumi_kgcore_key kasumi;
+	} u;
+};
+
 /* An implementation of a GPRS cipher */
 struct gprs_cipher_impl {
 	struct llist_head list;
@@ -29,6 +45,14 @@ struct gprs_cipher_impl {
 	 * XORed wit the plaintext for encrypt / ciphertext for decrypt */
 	int (*run)(uint8_t *out, uint16_t len, uint64_t kc, uint32_t iv,
 		   enum gprs_cipher_direction direction);
+
+	/* Optional: set up key->u from key->kc once, so that run_key()
+	 * doesn't need to do so for every frame */
+	int (*prepare_key)(struct gprs_cipher_key *key);
+	/* Optional: as run(), with a key set up by prepare_key() */
+	int (*run_key)(uint8_t *out, uint16_t len,
+		       const struct gprs_cipher_key *key, uint32_t iv,
+		       enum gprs_cipher_direction direction);
 };
 
 /* register a cipher with the core (from a plugin) */
@@ -41,6 +65,18 @@ int gprs_cipher_load(const char *path);
 int gprs_cipher_run(uint8_t *out, uint16_t len, enum gprs_ciph_algo algo,
 		    uint64_t kc, uint32_t iv, enum gprs_cipher_direction dir);
 
+/* prepare Kc for repeated use with gprs_cipher_run_key() */
+int gprs_cipher_key_init(struct gprs_cipher_key *key, enum gprs_ciph_algo algo,
+			 uint64_t kc);
+
+/* wipe the key material of a prepared key */
+void gprs_cipher_key_clear(struct gprs_cipher_key *key);
+
+/* as gprs_cipher_run(), with a prepared key */
+int gprs_cipher_run_key(uint8_t *out, uint16_t len,
+			const struct gprs_cipher_key *key, uint32_t iv,
+			enum gprs_cipher_direction dir);
+
 /* Do we have an implementation for this cipher? */
 int gprs_cipher_supported(enum gprs_ciph_algo algo);
 
@@ -62,8 +62,9 @@ struct bssgp_flow_control {
 	uint32_t bucket_size_max;	/*!< maximum size of the bucket (octets) */
 	uint32_t bucket_leak_rate; 	/*!< leak rate of the bucket (octets/sec) */
 
-	uint32_t bucket_counter;	/*!< number of tokens in the bucket */
-	struct timeval time_last_pdu;	/*!< timestamp of last PDU sent */
+	uint32_t bucket_counter;	/*!< number of tokens in the bucket (octets, rounded up) */
+	uint64_t bucket_level;		/*!< exact number of tokens in the bucket (10^-6 octets) */
+	uint64_t time_last_leak;	/*!< monotonic time the bucket was last leaked (us) */
 
 	/* the built-in queue */
 	uint32_t max_queue_depth;	/*!< how many packets to queue (mgs) */
@@ -157,6 +158,12 @@ static inline int bssgp_tlv_parse(struct tlv_parsed *tp, uint8_t *buf, int len)
 	return tlv_parse(tp, &tvlv_att_def, buf, len, 0, 0);
 }
 
+static inline int bssgp_tlv_parse_sparse(struct tlv_parsed_sparse *tp,
+					 uint8_t *buf, int len)
+{
+	return tlv_parse_sparse(tp, &tvlv_att_def, buf, len, 0, 0);
+}
+
 /*! \brief BSSGP Paging mode */
 enum bssgp_paging_mode {
 	BSSGP_PAGING_PS,
@@ -199,6 +206,8 @@ void bssgp_fc_init(struct bssgp_flow_control *fc,
 int bssgp_fc_in(struct bssgp_flow_control *fc, struct msgb *msg,
 		uint32_t llc_pdu_len, void *priv);
 
+void bssgp_fc_flush_queue(struct bssgp_flow_control *fc);
+
 /* Initialize the Flow Control parameters for a new MS according to
  * default values for the BVC specified by BVCI and NSEI */
 int bssgp_fc_ms_init(struct bssgp_flow_control *fc_ms, uint16_t bvci,
@@ -62,6 +62,9 @@ enum gprs_ns_cs {
 };
 
 struct gprs_nsvc;
+struct gprs_nsip_mmsg;
+struct gprs_ns_lookup;
+struct gprs_nse;
 /*! \brief Osmocom GPRS callback function type */
 typedef int gprs_ns_cb_t(enum gprs_ns_evt event, struct gprs_nsvc *nsvc,
 			 struct msgb *msg, uint16_t bvci);
@@ -73,6 +76,8 @@ struct gprs_ns_inst {
 
 	/*! \brief linked lists of all NSVC in this instance */
 	struct llist_head gprs_nsvcs;
+	/*! \brief hash tables indexing gprs_nsvcs (private) */
+	struct gprs_ns_lookup *lookup;
 
 	/*! \brief a NSVC object that's needed to deal with packets for
 	 * 	   unknown NSVC */
@@ -86,6 +91,11 @@ struct gprs_ns_inst {
 		uint32_t local_ip;
 		uint16_t local_port;
 		int dscp;
+		/*! \brief maximum number of datagrams received/sent per
+		 *  recvmmsg()/sendmmsg(); 0 or 1 for single datagram I/O */
+		unsigned int batch;
+		/*! \brief state of the batched I/O (private) */
+		struct gprs_nsip_mmsg *mmsg;
 	} nsip;
 	/*! \brief NS-over-FR-over-GRE-over-IP specific bits */
 	struct {
@@ -113,6 +123,9 @@ struct gprs_nsvc {
 	uint16_t nsei;	/*! \brief end-to-end significance */
 	uint16_t nsvci;	/*! \brief uniquely identifies NS-VC at SGSN */
 
+	/*! \brief NSE_S_* state.  Only changed by the NS code, as it also
+	 *  determines whether the NS-VC is in the list of usable NS-VCs
+	 *  of its NSE */
 	uint32_t state;
 	uint32_t remote_state;
 
@@ -128,6 +141,15 @@ struct gprs_nsvc {
 	struct rate_ctr_group *ctrg;
 	struct osmo_stat_item_group *statg;
 
+	/*! \brief NS Entity this NS-VC is indexed under (private) */
+	struct gprs_nse *nse;
+	/*! \brief hash bucket / NSE list entries (private) */
+	struct llist_head nsvci_entry;
+	struct llist_head addr_entry;
+	struct llist_head nse_entry;
+	/*! \brief position in the NSE's list of usable NS-VCs, or -1 */
+	int active_idx;
+
 	/*! \brief which link-layer are we based on? */
 	enum gprs_ns_ll ll;
 
@@ -175,6 +197,7 @@ struct gprs_nsvc *gprs_nsvc_create(struct gprs_ns_inst *nsi, uint16_t nsvci);
 void gprs_nsvc_delete(struct gprs_nsvc *nsvc);
 struct gprs_nsvc *gprs_nsvc_by_nsei(struct gprs_ns_inst *nsi, uint16_t nsei);
 struct gprs_nsvc *gprs_nsvc_by_nsvci(struct gprs_ns_inst *nsi, uint16_t nsvci);
+void gprs_nsvc_rehash(struct gprs_nsvc *nsvc);
 
 /* Initiate a RESET procedure (including timer start, ...)*/
 int gprs_nsvc_reset(struct gprs_nsvc *nsvc, uint8_t cause);
@@ -25,6 +25,7 @@
 #include <stdint.h>
 
 #include <osmocom/core/bits.h>
+#include <osmocom/gsm/kasumi.h>
 
 /*! \defgroup a5 GSM A5 ciphering algorithm
  *  @{
@@ -56,5 +57,15 @@ osmo_a5_fn_count(uint32_t fn)
 int osmo_a5(int n, const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul);
 void osmo_a5_1(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul);
 void osmo_a5_2(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul);
+int osmo_a5_batch(int n, const uint8_t *keys, const uint32_t *fns,
+		  ubit_t *dl, ubit_t *ul, unsigned int count);
+
+/*! \brief A5/3 or A5/4 key with expanded KASUMI key schedules */
+struct osmo_a5_key {
+	struct kasumi_kgcore_key kg;
+};
+
+int osmo_a5_key_init(struct osmo_a5_key *k, int n, const uint8_t *key);
+void osmo_a5_key_gen(const struct osmo_a5_key *k, uint32_t fn, ubit_t *dl, ubit_t *ul);
 
 /*! @} */
@@ -40,6 +40,9 @@ int ipa_ccm_tlv_to_unitdata(struct ipaccess_unit *ud,
 /* Send an IPA message to the given FD */
 int ipa_send(int fd, const void *msg, size_t msglen);
 
+/* Send an IPA msgb (or msgb chain) to the given FD */
+int ipa_msg_send(int fd, const struct msgb *msg);
+
 /* Send an IPA CCM PONG via the given FD */
 int ipa_ccm_send_pong(int fd);
 
@@ -9,6 +9,21 @@
 
 #include <stdint.h>
 
+/*! \brief Number of blocks processed at the same time by _kasumi_kgcore_multi() */
+#define KASUMI_LANES	4
+
+/*! \brief Expanded KASUMI subkeys, see _kasumi_key_expand() */
+struct kasumi_sched {
+	uint16_t KLi1[8], KLi2[8], KOi1[8], KOi2[8], KOi3[8], KIi1[8], KIi2[8], KIi3[8];
+};
+
+/*! \brief KGCORE key with both of its key schedules expanded, so that it
+ *  can be used for any number of keystreams without expanding it again */
+struct kasumi_kgcore_key {
+	struct kasumi_sched km;	/*!< schedule of the key modified by KM */
+	struct kasumi_sched ck;	/*!< schedule of the key itself */
+};
+
 /*! \brief Single iteration of KASUMI cipher
  *  \param[in] P Block, 64 bits to be processed in this round
  *  \param[in] KLi1 Expanded subkeys
@@ -46,3 +61,32 @@ void _kasumi_kgcore(uint8_t CA, uint8_t cb, uint32_t cc, uint8_t cd, const uint8
  *  \param[out] KIi3 Expanded subkeys
  */
 void _kasumi_key_expand(const uint8_t *key, uint16_t *KLi1, uint16_t *KLi2, uint16_t *KOi1, uint16_t *KOi2, uint16_t *KOi3, uint16_t *KIi1, uint16_t *KIi2, uint16_t *KIi3);
+
+/*! \brief Expand both KASUMI key schedules used by KGCORE
+ *  \param[out] k prepared key
+ *  \param[in] ck 16 byte key
+ */
+void _kasumi_kgcore_key_init(struct kasumi_kgcore_key *k, const uint8_t *ck);
+
+/*! \brief KGCORE with a prepared key
+ *  \param[in] k key prepared by _kasumi_kgcore_key_init()
+ *  \param[in] CA
+ *  \param[in] cb
+ *  \param[in] cc
+ *  \param[in] cd
+ *  \param[out] co (cl + 7) / 8 bytes of keystream
+ *  \param[in] cl keystream length in bits
+ */
+void _kasumi_kgcore_prepared(const struct kasumi_kgcore_key *k, uint8_t CA, uint8_t cb, uint32_t cc, uint8_t cd, uint8_t *co, uint16_t cl);
+
+/*! \brief KGCORE of several independent streams, interleaved
+ *  \param[in] k n keys prepared by _kasumi_kgcore_key_init()
+ *  \param[in] cc n values of cc
+ *  \param[in] n number of streams
+ *  \param[in] CA
+ *  \param[in] cb
+ *  \param[in] cd
+ *  \param[out] co n * ((cl + 7) / 8) bytes of keystream, stream after stream
+ *  \param[in] cl keystream length in bits
+ */
+void _kasumi_kgcore_multi(const struct kasumi_kgcore_key *const *k, const uint32_t *cc, unsigned int n, uint8_t CA, uint8_t cb, uint8_t cd, uint8_t *co, uint16_t cl);
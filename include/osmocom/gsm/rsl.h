@@ -21,6 +21,17 @@ extern const struct tlv_definition rsl_att_tlvdef;
 #define rsl_tlv_parse(dec, buf, len)     \
 			tlv_parse(dec, &rsl_att_tlvdef, buf, len, 0, 0)
 
+/*! \brief Parse RSL TLV structure using \ref tlv_parse_sparse */
+#define rsl_tlv_parse_sparse(dec, buf, len)     \
+			tlv_parse_sparse(dec, &rsl_att_tlvdef, buf, len, 0, 0)
+
+const struct tlv_compiled_def *rsl_att_tlvdef_compiled(void);
+
+/*! \brief Parse and validate RSL IEs of a message using \ref tlv_decode */
+#define rsl_tlv_decode(dec, msg_type, buf, len, err_tag)	\
+			tlv_decode(dec, rsl_att_tlvdef_compiled(), msg_type, \
+				   buf, len, err_tag)
+
 extern const struct tlv_definition rsl_ipac_eie_tlvdef;
 
 /*! \brief Parse RSL IPAC EIE TLV structure using \ref tlv_parse */
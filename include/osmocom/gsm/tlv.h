@@ -412,6 +412,141 @@ void tlv_def_patch(struct tlv_definition *dst, const struct tlv_definition *src)
 #define TLVP_PRES_LEN(tp, tag, min_len) \
 	(TLVP_PRESENT(tp, tag) && TLVP_LEN(tp, tag) >= min_len)
 
+/*! \brief maximum number of distinct IEs in a \ref tlv_parsed_sparse */
+#define TLV_SPARSE_MAX_IE	64
+
+/*! \brief Entry in a \ref tlv_parsed_sparse */
+struct tlv_sparse_entry {
+	uint8_t tag;		/*!< \brief tag of the IE */
+	uint16_t len;		/*!< \brief length */
+	const uint8_t *val;	/*!< \brief pointer to value */
+};
+
+/*! \brief sparse result of the TLV parser
+ *
+ *  Unlike \ref tlv_parsed it needs no clearing of all 256 entries, only
+ *  the presence bitmap is reset before parsing.  \a idx is only valid
+ *  for tags whose presence bit is set.  Use the TLVPS_* accessors. */
+struct tlv_parsed_sparse {
+	uint32_t present[256 / 32];	/*!< \brief one bit per tag */
+	unsigned int num_ie;		/*!< \brief number of entries in \a ie */
+	uint8_t idx[256];		/*!< \brief index into \a ie by tag */
+	/*! \brief IEs in order of their first occurrence */
+	struct tlv_sparse_entry ie[TLV_SPARSE_MAX_IE];
+};
+
+int tlv_parse_sparse(struct tlv_parsed_sparse *dec,
+		     const struct tlv_definition *def,
+		     const uint8_t *buf, int buf_len, uint8_t lv_tag,
+		     uint8_t lv_tag2);
+
+/*! \brief Is the IE \a tag present in a \ref tlv_parsed_sparse */
+static inline int tlvps_present(const struct tlv_parsed_sparse *tp, uint8_t tag)
+{
+	return (tp->present[tag >> 5] >> (tag & 31)) & 1;
+}
+
+/*! \brief Length of the IE \a tag, 0 if not present */
+static inline uint16_t tlvps_len(const struct tlv_parsed_sparse *tp, uint8_t tag)
+{
+	return tlvps_present(tp, tag) ? tp->ie[tp->idx[tag]].len : 0;
+}
+
+/*! \brief Value of the IE \a tag, NULL if not present */
+static inline const uint8_t *tlvps_val(const struct tlv_parsed_sparse *tp,
+				       uint8_t tag)
+{
+	return tlvps_present(tp, tag) ? tp->ie[tp->idx[tag]].val : NULL;
+}
+
+#define TLVPS_PRESENT(x, y)	tlvps_present(x, y)
+#define TLVPS_LEN(x, y)		tlvps_len(x, y)
+#define TLVPS_VAL(x, y)		tlvps_val(x, y)
+
+#define TLVPS_PRES_LEN(tp, tag, min_len) \
+	(TLVPS_PRESENT(tp, tag) && TLVPS_LEN(tp, tag) >= min_len)
+
+/*! \brief IE of a message type, see \ref tlv_msg_def */
+struct tlv_msg_ie {
+	uint8_t tag;		/*!< \brief tag of the IE */
+	uint8_t mandatory;	/*!< \brief message is invalid without it */
+	uint8_t min_len;	/*!< \brief minimum length of the value */
+};
+
+/*! \brief mandatory IE of at least \a min_len octets */
+#define TLV_IE_M(tag, min_len)	{ tag, 1, min_len }
+/*! \brief optional or conditional IE of at least \a min_len octets */
+#define TLV_IE_O(tag, min_len)	{ tag, 0, min_len }
+
+/*! \brief IEs of one message type, for \ref tlv_compile */
+struct tlv_msg_def {
+	uint8_t msg_type;		/*!< \brief message type */
+	const struct tlv_msg_ie *ies;	/*!< \brief IEs of the message */
+	unsigned int num_ies;		/*!< \brief number of \a ies */
+};
+
+/*! \brief describe the IEs of message type \a type */
+#define TLV_MSG_DEF(type, ...) \
+	{ type, (const struct tlv_msg_ie []) { __VA_ARGS__ }, \
+	  sizeof((const struct tlv_msg_ie []) { __VA_ARGS__ }) / \
+		sizeof(struct tlv_msg_ie) }
+
+/*! \brief dispatch entry of one tag in a \ref tlv_compiled_def */
+struct tlv_compiled_ie {
+	uint8_t type;		/*!< \brief \ref tlv_type of the IE */
+	uint8_t tag;		/*!< \brief tag under which the IE is stored */
+	uint8_t fixed_len;	/*!< \brief length for \ref TLV_TYPE_FIXED */
+};
+
+/*! \brief presence and length rules of one message type */
+struct tlv_compiled_msg {
+	uint32_t mandatory[256 / 32];	/*!< \brief one bit per mandatory tag */
+	uint8_t min_len[256];		/*!< \brief minimum length by tag */
+};
+
+/*! \brief \ref tlv_definition and message IE sets compiled by
+ *  \ref tlv_compile for \ref tlv_decode */
+struct tlv_compiled_def {
+	struct tlv_compiled_ie ie[256];	/*!< \brief dispatch table by octet */
+	uint8_t msg_idx[256];		/*!< \brief 1 + index into \a msg */
+	unsigned int num_msgs;		/*!< \brief number of \a msg */
+	struct tlv_compiled_msg msg[0];	/*!< \brief rules by message type */
+};
+
+/*! \brief errors of \ref tlv_decode */
+enum tlv_decode_error {
+	TLV_DEC_ERR_TRUNCATED	= -2,	/*!< \brief IE exceeds the buffer */
+	TLV_DEC_ERR_UNKNOWN_IE	= -3,	/*!< \brief IE of unknown length */
+	TLV_DEC_ERR_TOO_MANY	= -4,	/*!< \brief see \ref TLV_SPARSE_MAX_IE */
+	TLV_DEC_ERR_SHORT_IE	= -5,	/*!< \brief IE shorter than allowed */
+	TLV_DEC_ERR_MISSING_IE	= -6,	/*!< \brief mandatory IE missing */
+};
+
+/*! \brief a \ref tlv_compiled_def built on first use by
+ *  \ref tlv_compiled_get */
+struct tlv_compiled_once {
+	const struct tlv_definition *def;	/*!< \brief TLV definition */
+	const struct tlv_msg_def *msgs;		/*!< \brief message IE sets */
+	unsigned int num_msgs;			/*!< \brief number of \a msgs */
+	struct tlv_compiled_def *cdef;		/*!< \brief compiled, or NULL */
+};
+
+/*! \brief initializer of a \ref tlv_compiled_once for the array \a msgs */
+#define TLV_COMPILED_ONCE(tlv_def, msg_defs) \
+	{ .def = (tlv_def), .msgs = (msg_defs), \
+	  .num_msgs = sizeof(msg_defs) / sizeof((msg_defs)[0]) }
+
+struct tlv_compiled_def *tlv_compile(void *ctx, const struct tlv_definition *def,
+				     const struct tlv_msg_def *msgs,
+				     unsigned int num_msgs);
+const struct tlv_compiled_def *tlv_compiled_get(struct tlv_compiled_once *once);
+int tlv_decode(struct tlv_parsed_sparse *dec,
+	       const struct tlv_compiled_def *cdef, uint8_t msg_type,
+	       const uint8_t *buf, int buf_len, uint8_t *err_tag);
+int tlv_decode_dense(struct tlv_parsed *dec,
+		     const struct tlv_compiled_def *cdef, uint8_t msg_type,
+		     const uint8_t *buf, int buf_len, uint8_t *err_tag);
+
 /*! \brief Align given TLV element with 16 bit value to an even address
  *  \param[in] tp pointer to \ref tlv_parsed
  *  \param[in] pos element to return
@@ -436,4 +571,30 @@ static inline uint32_t tlvp_val32_unal(const struct tlv_parsed *tp, int pos)
 	return res;
 }
 
+/*! \brief Read 16 bit value of a \ref tlv_parsed_sparse element
+ *  \param[in] tp pointer to \ref tlv_parsed_sparse
+ *  \param[in] pos element to return
+ *  \returns aligned 16 bit value
+ */
+static inline uint16_t tlvps_val16_unal(const struct tlv_parsed_sparse *tp,
+					int pos)
+{
+	uint16_t res;
+	memcpy(&res, TLVPS_VAL(tp, pos), sizeof(res));
+	return res;
+}
+
+/*! \brief Read 32 bit value of a \ref tlv_parsed_sparse element
+ *  \param[in] tp pointer to \ref tlv_parsed_sparse
+ *  \param[in] pos element to return
+ *  \returns aligned 32 bit value
+ */
+static inline uint32_t tlvps_val32_unal(const struct tlv_parsed_sparse *tp,
+					int pos)
+{
+	uint32_t res;
+	memcpy(&res, TLVPS_VAL(tp, pos), sizeof(res));
+	return res;
+}
+
 /*! @} */
@@ -20,9 +20,18 @@
  *
  */
 
+#include "config.h"
+
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
 
 #include <osmocom/core/bits.h>
+#include <osmocom/core/endian.h>
 
 /*! \addtogroup bits
  *  @{
@@ -32,6 +41,230 @@
  *  \brief Osmocom bit level support code
  */
 
+/* Eight unpacked bits are handled as one 64bit word: in the native
+ * byte order, the byte holding the first bit has the weight of B0. */
+#define ONES64		0x0101010101010101ULL
+#if OSMO_IS_LITTLE_ENDIAN
+/* gathers bit 0 of each byte into bits 63..56, first bit in bit 63 */
+#define PACK_MUL	0x8040201008040201ULL
+/* keeps bit 7-i of the replicated pbit in byte i */
+#define UNPACK_MASK	0x0102040810204080ULL
+#else
+#define PACK_MUL	0x0102040810204080ULL
+#define UNPACK_MASK	0x8040201008040201ULL
+#endif
+
+static inline uint64_t load64(const void *p)
+{
+	uint64_t x;
+	memcpy(&x, p, sizeof(x));
+	return x;
+}
+
+static inline void store64(void *p, uint64_t x)
+{
+	memcpy(p, &x, sizeof(x));
+}
+
+/* pack 8 ubits into one pbit */
+static inline pbit_t ubit2pbit_8(const ubit_t *in)
+{
+	return ((load64(in) & ONES64) * PACK_MUL) >> 56;
+}
+
+/* unpack one pbit into 8 ubits */
+static inline void pbit2ubit_8(ubit_t *out, pbit_t in)
+{
+	uint64_t x = ((in * ONES64) & UNPACK_MASK) + 0x7f7f7f7f7f7f7f7fULL;
+	store64(out, (x >> 7) & ONES64);
+}
+
+static enum osmo_bits_backend bits_backend = OSMO_BITS_GENERIC;
+static int bits_backend_init = 0;
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static unsigned int ubit2pbit_sse2(pbit_t *out, const ubit_t *in,
+				   unsigned int num_bytes)
+{
+	unsigned int i;
+
+	for (i = 0; i + 8 <= num_bytes; i += 8) {
+		uint64_t m = 0;
+		int j;
+
+		for (j = 3; j >= 0; j--) {
+			__m128i v = _mm_loadu_si128((const __m128i *) &in[16 * j]);
+			m = (m << 16) | _mm_movemask_epi8(_mm_slli_epi16(v, 7));
+		}
+		/* the first bit of each byte is in bit 0, pbits are MSB first */
+		m = (m & 0x5555555555555555ULL) << 1 | (m >> 1 & 0x5555555555555555ULL);
+		m = (m & 0x3333333333333333ULL) << 2 | (m >> 2 & 0x3333333333333333ULL);
+		m = (m & 0x0f0f0f0f0f0f0f0fULL) << 4 | (m >> 4 & 0x0f0f0f0f0f0f0f0fULL);
+		store64(out + i, m);
+		in += 64;
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static unsigned int pbit2ubit_sse2(ubit_t *out, const pbit_t *in,
+				   unsigned int num_bytes)
+{
+	const __m128i mask = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+					  1, 2, 4, 8, 16, 32, 64, -128);
+	const __m128i one = _mm_set1_epi8(1);
+	unsigned int i;
+
+	for (i = 0; i + 2 <= num_bytes; i += 2) {
+		__m128i v = _mm_cvtsi32_si128(in[i] | in[i + 1] << 8);
+
+		/* replicate pbit 0 into bytes 0..7, pbit 1 into 8..15 */
+		v = _mm_unpacklo_epi8(v, v);
+		v = _mm_unpacklo_epi16(v, v);
+		v = _mm_unpacklo_epi32(v, v);
+		v = _mm_cmpeq_epi8(_mm_and_si128(v, mask), mask);
+		_mm_storeu_si128((__m128i *) &out[8 * i], _mm_and_si128(v, one));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+static unsigned int sbit2ubit_sse2(ubit_t *out, const sbit_t *in,
+				   unsigned int num_bits)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	unsigned int i;
+
+	for (i = 0; i + 16 <= num_bits; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) &in[i]);
+		v = _mm_and_si128(_mm_cmplt_epi8(v, zero), one);
+		_mm_storeu_si128((__m128i *) &out[i], v);
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static unsigned int ubit2pbit_avx2(pbit_t *out, const ubit_t *in,
+				   unsigned int num_bytes)
+{
+	/* reverse each group of 8 ubits so movemask yields MSB first */
+	const __m256i rev = _mm256_set_epi8(8, 9, 10, 11, 12, 13, 14, 15,
+					    0, 1, 2, 3, 4, 5, 6, 7,
+					    8, 9, 10, 11, 12, 13, 14, 15,
+					    0, 1, 2, 3, 4, 5, 6, 7);
+	unsigned int i;
+
+	for (i = 0; i + 4 <= num_bytes; i += 4) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) &in[8 * i]);
+		uint32_t m;
+
+		v = _mm256_slli_epi16(_mm256_shuffle_epi8(v, rev), 7);
+		m = _mm256_movemask_epi8(v);
+		memcpy(out + i, &m, sizeof(m));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static unsigned int pbit2ubit_avx2(ubit_t *out, const pbit_t *in,
+				   unsigned int num_bytes)
+{
+	const __m256i mask = _mm256_set_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+					     1, 2, 4, 8, 16, 32, 64, -128,
+					     1, 2, 4, 8, 16, 32, 64, -128,
+					     1, 2, 4, 8, 16, 32, 64, -128);
+	const __m256i spread = _mm256_set_epi8(3, 3, 3, 3, 3, 3, 3, 3,
+					       2, 2, 2, 2, 2, 2, 2, 2,
+					       1, 1, 1, 1, 1, 1, 1, 1,
+					       0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i one = _mm256_set1_epi8(1);
+	unsigned int i;
+
+	for (i = 0; i + 4 <= num_bytes; i += 4) {
+		uint32_t w;
+		__m256i v;
+
+		memcpy(&w, in + i, sizeof(w));
+		v = _mm256_shuffle_epi8(_mm256_set1_epi32(w), spread);
+		v = _mm256_cmpeq_epi8(_mm256_and_si256(v, mask), mask);
+		_mm256_storeu_si256((__m256i *) &out[8 * i],
+				    _mm256_and_si256(v, one));
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static unsigned int sbit2ubit_avx2(ubit_t *out, const sbit_t *in,
+				   unsigned int num_bits)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi8(1);
+	unsigned int i;
+
+	for (i = 0; i + 32 <= num_bits; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) &in[i]);
+		v = _mm256_and_si256(_mm256_cmpgt_epi8(zero, v), one);
+		_mm256_storeu_si256((__m256i *) &out[i], v);
+	}
+
+	return i;
+}
+#endif /* HAVE_X86_SIMD */
+
+static int bits_backend_supported(enum osmo_bits_backend backend)
+{
+	switch (backend) {
+	case OSMO_BITS_GENERIC:
+		return 1;
+#ifdef HAVE_X86_SIMD
+	case OSMO_BITS_SSE2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2");
+	case OSMO_BITS_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return 0;
+	}
+}
+
+/*! \brief Select the implementation of the bulk bit conversion functions
+ *  \param[in] backend implementation to use from now on
+ *  \returns 0 on success; -ENOTSUP if not supported by build or CPU
+ *
+ * By default the fastest implementation supported by the CPU is used,
+ * all of them produce identical results.
+ */
+int osmo_bits_set_backend(enum osmo_bits_backend backend)
+{
+	if (!bits_backend_supported(backend))
+		return -ENOTSUP;
+
+	bits_backend_init = 1;
+	bits_backend = backend;
+	return 0;
+}
+
+/*! \brief Obtain the bulk bit conversion implementation in use */
+enum osmo_bits_backend osmo_bits_get_backend(void)
+{
+	if (!bits_backend_init) {
+		bits_backend_init = 1;
+		if (bits_backend_supported(OSMO_BITS_AVX2))
+			bits_backend = OSMO_BITS_AVX2;
+		else if (bits_backend_supported(OSMO_BITS_SSE2))
+			bits_backend = OSMO_BITS_SSE2;
+	}
+	return bits_backend;
+}
 
 /*! \brief convert unpacked bits to packed bits, return length in bytes
  *  \param[out] out output buffer of packed bits
@@ -40,25 +273,35 @@
  */
 int osmo_ubit2pbit(pbit_t *out, const ubit_t *in, unsigned int num_bits)
 {
-	unsigned int i;
-	uint8_t curbyte = 0;
-	pbit_t *outptr = out;
+	unsigned int i = 0, n = num_bits / 8, r = num_bits % 8;
 
-	for (i = 0; i < num_bits; i++) {
-		uint8_t bitnum = 7 - (i % 8);
+	switch (osmo_bits_get_backend()) {
+#ifdef HAVE_X86_SIMD
+	case OSMO_BITS_AVX2:
+		i = ubit2pbit_avx2(out, in, n);
+		break;
+	case OSMO_BITS_SSE2:
+		i = ubit2pbit_sse2(out, in, n);
+		break;
+#endif
+	default:
+		break;
+	}
 
-		curbyte |= (in[i] << bitnum);
+	for (; i < n; i++)
+		out[i] = ubit2pbit_8(in + 8 * i);
 
-		if(i % 8 == 7){
-			*outptr++ = curbyte;
-			curbyte = 0;
-		}
-	}
 	/* we have a non-modulo-8 bitcount */
-	if (i % 8)
-		*outptr++ = curbyte;
+	if (r) {
+		uint8_t curbyte = 0;
+		unsigned int j;
 
-	return outptr - out;
+		for (j = 0; j < r; j++)
+			curbyte |= in[8 * n + j] << (7 - j);
+		out[n++] = curbyte;
+	}
+
+	return n;
 }
 
 /*! \brief convert packed bits to unpacked bits, return length in bytes
@@ -68,38 +311,32 @@ int osmo_ubit2pbit(pbit_t *out, const ubit_t *in, unsigned int num_bits)
  */
 int osmo_pbit2ubit(ubit_t *out, const pbit_t *in, unsigned int num_bits)
 {
-	unsigned int i;
-	ubit_t *cur = out;
-	ubit_t *limit = out + num_bits;
-
-	for (i = 0; i < (num_bits/8)+1; i++) {
-		pbit_t byte = in[i];
-		*cur++ = (byte >> 7) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 6) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 5) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 4) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 3) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 2) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 1) & 1;
-		if (cur >= limit)
-			break;
-		*cur++ = (byte >> 0) & 1;
-		if (cur >= limit)
-			break;
-	}
-	return cur - out;
+	unsigned int i = 0, n = num_bits / 8, r = num_bits % 8;
+
+	switch (osmo_bits_get_backend()) {
+#ifdef HAVE_X86_SIMD
+	case OSMO_BITS_AVX2:
+		i = pbit2ubit_avx2(out, in, n);
+		break;
+	case OSMO_BITS_SSE2:
+		i = pbit2ubit_sse2(out, in, n);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	for (; i < n; i++)
+		pbit2ubit_8(out + 8 * i, in[i]);
+
+	if (r) {
+		unsigned int j;
+
+		for (j = 0; j < r; j++)
+			out[8 * n + j] = (in[n] >> (7 - j)) & 1;
+	}
+
+	return num_bits;
 }
 
 /*! \brief convert unpacked bits to packed bits (extended options)
@@ -115,15 +352,44 @@ int osmo_ubit2pbit_ext(pbit_t *out, unsigned int out_ofs,
                        const ubit_t *in, unsigned int in_ofs,
                        unsigned int num_bits, int lsb_mode)
 {
-	int i, op, bn;
-	for (i=0; i<num_bits; i++) {
-		op = out_ofs + i;
-		bn = lsb_mode ? (op&7) : (7-(op&7));
-		if (in[in_ofs+i])
-			out[op>>3] |= 1 << bn;
+	pbit_t *op = out + (out_ofs >> 3);
+	unsigned int i = 0, bn = out_ofs & 7;
+
+	in += in_ofs;
+
+	if (!lsb_mode) {
+		/* up to the next byte boundary of the output... */
+		for (; i < num_bits && bn; i++) {
+			if (in[i])
+				*op |= 0x80 >> bn;
+			else
+				*op &= ~(0x80 >> bn);
+			bn = (bn + 1) & 7;
+		}
+		if (i && !bn)
+			op++;
+		/* ...then whole bytes */
+		if (num_bits - i >= 8) {
+			unsigned int n = (num_bits - i) / 8;
+			osmo_ubit2pbit(op, in + i, n * 8);
+			op += n;
+			i += n * 8;
+		}
+	}
+
+	for (; i < num_bits; i++) {
+		uint8_t mask = lsb_mode ? 1 << bn : 0x80 >> bn;
+
+		if (in[i])
+			*op |= mask;
 		else
-			out[op>>3] &= ~(1 << bn);
+			*op &= ~mask;
+		if (++bn == 8) {
+			bn = 0;
+			op++;
+		}
 	}
+
 	return ((out_ofs + num_bits - 1) >> 3) + 1;
 }
 
@@ -140,15 +406,128 @@ int osmo_pbit2ubit_ext(ubit_t *out, unsigned int out_ofs,
                        const pbit_t *in, unsigned int in_ofs,
                        unsigned int num_bits, int lsb_mode)
 {
-	int i, ip, bn;
-	for (i=0; i<num_bits; i++) {
-		ip = in_ofs + i;
-		bn = lsb_mode ? (ip&7) : (7-(ip&7));
-		out[out_ofs+i] = !!(in[ip>>3] & (1<<bn));
+	const pbit_t *ip = in + (in_ofs >> 3);
+	unsigned int i = 0, bn = in_ofs & 7;
+
+	out += out_ofs;
+
+	if (!lsb_mode) {
+		for (; i < num_bits && bn; i++) {
+			out[i] = (*ip >> (7 - bn)) & 1;
+			bn = (bn + 1) & 7;
+		}
+		if (i && !bn)
+			ip++;
+		if (num_bits - i >= 8) {
+			unsigned int n = (num_bits - i) / 8;
+			osmo_pbit2ubit(out + i, ip, n * 8);
+			ip += n;
+			i += n * 8;
+		}
 	}
+
+	for (; i < num_bits; i++) {
+		out[i] = (*ip >> (lsb_mode ? bn : 7 - bn)) & 1;
+		if (++bn == 8) {
+			bn = 0;
+			ip++;
+		}
+	}
+
 	return out_ofs + num_bits;
 }
 
+/*! \brief hard decision of soft bits into unpacked bits
+ *  \param[out] out output buffer of unpacked bits
+ *  \param[in] in input buffer of soft bits
+ *  \param[in] num_bits number of bits
+ *
+ * Negative soft bits become 1, all others 0.
+ */
+void osmo_sbit2ubit(ubit_t *out, const sbit_t *in, unsigned int num_bits)
+{
+	unsigned int i = 0;
+
+	switch (osmo_bits_get_backend()) {
+#ifdef HAVE_X86_SIMD
+	case OSMO_BITS_AVX2:
+		i = sbit2ubit_avx2(out, in, num_bits);
+		break;
+	case OSMO_BITS_SSE2:
+		i = sbit2ubit_sse2(out, in, num_bits);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	for (; i + 8 <= num_bits; i += 8)
+		store64(out + i, (load64(in + i) >> 7) & ONES64);
+	for (; i < num_bits; i++)
+		out[i] = in[i] < 0;
+}
+
+/*! \brief convert unpacked bits into soft bits of full confidence
+ *  \param[out] out output buffer of soft bits
+ *  \param[in] in input buffer of unpacked bits
+ *  \param[in] num_bits number of bits
+ *
+ * 0 becomes 127 and 1 becomes -127.
+ */
+void osmo_ubit2sbit(sbit_t *out, const ubit_t *in, unsigned int num_bits)
+{
+	unsigned int i;
+
+	/* 0x7f + 2 * b: 0x7f (127) or 0x81 (-127), never carries */
+	for (i = 0; i + 8 <= num_bits; i += 8)
+		store64(out + i, 0x7f7f7f7f7f7f7f7fULL +
+				 ((load64(in + i) & ONES64) << 1));
+	for (; i < num_bits; i++)
+		out[i] = in[i] ? -127 : 127;
+}
+
+/*! \brief XOR unpacked bits with a keystream of unpacked bits
+ *  \param[out] out output buffer of unpacked bits (may be \a in)
+ *  \param[in] in input buffer of unpacked bits
+ *  \param[in] ks keystream of unpacked bits
+ *  \param[in] num_bits number of bits
+ */
+void osmo_ubit_xor(ubit_t *out, const ubit_t *in, const ubit_t *ks,
+		   unsigned int num_bits)
+{
+	unsigned int i;
+
+	for (i = 0; i + 8 <= num_bits; i += 8)
+		store64(out + i, load64(in + i) ^ load64(ks + i));
+	for (; i < num_bits; i++)
+		out[i] = in[i] ^ ks[i];
+}
+
+/*! \brief apply a keystream of unpacked bits to soft bits
+ *  \param[out] out output buffer of soft bits (may be \a in)
+ *  \param[in] in input buffer of soft bits
+ *  \param[in] ks keystream of unpacked bits
+ *  \param[in] num_bits number of bits
+ *
+ * The sign of each soft bit is inverted where the keystream bit is 1,
+ * which is the soft decision equivalent of osmo_ubit_xor().
+ */
+void osmo_sbit_xor(sbit_t *out, const sbit_t *in, const ubit_t *ks,
+		   unsigned int num_bits)
+{
+	unsigned int i;
+
+	/* -x == ~x + 1, added per byte without carry between bytes */
+	for (i = 0; i + 8 <= num_bits; i += 8) {
+		uint64_t k = load64(ks + i) & ONES64;
+		uint64_t x = load64(in + i) ^ (k * 0xff);
+		x = ((x & 0x7f7f7f7f7f7f7f7fULL) + k) ^ (x & 0x8080808080808080ULL);
+		store64(out + i, x);
+	}
+	for (; i < num_bits; i++)
+		out[i] = ks[i] & 1 ? -in[i] : in[i];
+}
+
 /*! \brief generalized bit reversal function
  *  \param[in] x the 32bit value to be reversed
  *  \param[in] k the type of reversal requested
@@ -38,6 +38,7 @@
 
 #include <osmocom/core/bits.h>
 #include <osmocom/core/bitvec.h>
+#include <osmocom/core/endian.h>
 
 #define BITNUM_FROM_COMP(byte, bit)	((byte*8)+bit)
 
@@ -425,6 +426,93 @@ int bitvec_unhex(struct bitvec *bv, const char *src)
 	return 0;
 }
 
+/* Fields are accessed through a 64bit big endian window starting at the
+ * byte holding their first bit; a field of up to 57 bits always fits. */
+#define WINDOW_MAX_BITS	57
+
+static inline uint64_t load64be(const uint8_t *p)
+{
+	uint64_t x;
+
+	memcpy(&x, p, sizeof(x));
+#if OSMO_IS_LITTLE_ENDIAN
+	x = __builtin_bswap64(x);
+#endif
+	return x;
+}
+
+static inline void store64be(uint64_t x, uint8_t *p)
+{
+#if OSMO_IS_LITTLE_ENDIAN
+	x = __builtin_bswap64(x);
+#endif
+	memcpy(p, &x, sizeof(x));
+}
+
+static inline uint64_t window_load(const uint8_t *data, unsigned int avail)
+{
+	uint8_t tmp[8] = { 0 };
+
+	if (avail >= 8)
+		return load64be(data);
+
+	memcpy(tmp, data, avail);
+	return load64be(tmp);
+}
+
+static inline void window_store(uint8_t *data, unsigned int avail,
+				uint64_t w)
+{
+	uint8_t tmp[8];
+
+	if (avail >= 8) {
+		store64be(w, data);
+		return;
+	}
+
+	store64be(w, tmp);
+	memcpy(data, tmp, avail);
+}
+
+/* read len (1..64) bits at pos, which must be within the vector */
+static uint64_t bits_read(const uint8_t *data, unsigned int data_len,
+			  unsigned int pos, unsigned int len)
+{
+	unsigned int byte = pos / 8, ofs = pos % 8;
+	uint64_t w;
+
+	if (len > WINDOW_MAX_BITS)
+		return bits_read(data, data_len, pos, len - 32) << 32 |
+		       bits_read(data, data_len, pos + len - 32, 32);
+
+	w = window_load(data + byte, data_len - byte);
+	return (w << ofs) >> (64 - len);
+}
+
+/* write len (1..64) bits at pos, which must be within the vector */
+static void bits_write(uint8_t *data, unsigned int data_len,
+		       unsigned int pos, uint64_t val, unsigned int len)
+{
+	unsigned int byte = pos / 8, ofs = pos % 8;
+	unsigned int avail = data_len - byte;
+	uint64_t w, mask;
+
+	if (len > WINDOW_MAX_BITS) {
+		bits_write(data, data_len, pos, val >> 32, len - 32);
+		bits_write(data, data_len, pos + len - 32, val, 32);
+		return;
+	}
+
+	/* the last byte of the field is always within the vector */
+	if (avail > (ofs + len + 7) / 8)
+		avail = (ofs + len + 7) / 8;
+
+	mask = (~(uint64_t)0 >> (64 - len)) << (64 - ofs - len);
+	w = window_load(data + byte, avail);
+	w = (w & ~mask) | ((val << (64 - ofs - len)) & mask);
+	window_store(data + byte, avail, w);
+}
+
 /*! \brief read part of the vector
  *  \param[in] bv The boolean vector to work on
  *  \param[in,out] read_index Where reading supposed to start in the vector
@@ -437,6 +525,15 @@ uint64_t bitvec_read_field(struct bitvec *bv, unsigned int *read_index, unsigned
 	uint64_t ui = 0;
 	bv->cur_bit = *read_index;
 
+	/* fast path: the whole field is within the vector */
+	if (len <= 64 && *read_index + len <= bv->data_len * 8) {
+		if (len)
+			ui = bits_read(bv->data, bv->data_len, *read_index, len);
+		bv->cur_bit += len;
+		*read_index += len;
+		return ui;
+	}
+
 	for (i = 0; i < len; i++) {
 		int bit = bitvec_get_bit_pos((const struct bitvec *)bv, bv->cur_bit);
 		if (bit < 0)
@@ -460,6 +557,16 @@ int bitvec_write_field(struct bitvec *bv, unsigned int *write_index, uint64_t va
 	unsigned int i;
 	int rc;
 	bv->cur_bit = *write_index;
+
+	/* fast path: the whole field is within the vector */
+	if (len <= 64 && *write_index + len <= bv->data_len * 8) {
+		if (len)
+			bits_write(bv->data, bv->data_len, *write_index, val, len);
+		bv->cur_bit += len;
+		*write_index += len;
+		return 0;
+	}
+
 	for (i = 0; i < len; i++) {
 		int bit = 0;
 		if (val & ((uint64_t)1 << (len - i - 1)))
@@ -472,6 +579,105 @@ int bitvec_write_field(struct bitvec *bv, unsigned int *write_index, uint64_t va
 	return 0;
 }
 
+/*! \brief start sequential field access to a bit vector
+ *  \param[out] c cursor to initialize
+ *  \param[in] bv The boolean vector to work on
+ *  \param[in] pos bit position of the first field
+ *
+ * The cursor reads or writes consecutive fields with a single bounds
+ * check each and without touching \a bv->cur_bit. Errors are sticky, so
+ * that the caller only has to check the result of bitvec_cursor_finish()
+ * after the last field.
+ *
+ * Written fields are collected in a 64bit accumulator and only stored to
+ * \a bv->data once it is full, before a read and in
+ * bitvec_cursor_finish().
+ */
+void bitvec_cursor_init(struct bitvec_cursor *c, struct bitvec *bv,
+			unsigned int pos)
+{
+	c->bv = bv;
+	c->pos = pos;
+	c->limit = bv->data_len * 8;
+	c->err = 0;
+	c->acc = 0;
+	c->acc_bits = 0;
+}
+
+/* store the accumulated bits, which end at the cursor position */
+static void cursor_flush(struct bitvec_cursor *c)
+{
+	if (!c->acc_bits)
+		return;
+
+	bits_write(c->bv->data, c->bv->data_len, c->pos - c->acc_bits,
+		   c->acc, c->acc_bits);
+	c->acc = 0;
+	c->acc_bits = 0;
+}
+
+/*! \brief read the next field
+ *  \param[in] c cursor
+ *  \param[in] len number of bits (0..64)
+ *  \returns read bits, 0 once the cursor is in error state
+ */
+uint64_t bitvec_cursor_read(struct bitvec_cursor *c, unsigned int len)
+{
+	uint64_t ui;
+
+	if (c->err || len == 0)
+		return 0;
+	if (len > 64 || c->pos + len > c->limit) {
+		c->err = -EINVAL;
+		return 0;
+	}
+
+	cursor_flush(c);
+	ui = bits_read(c->bv->data, c->bv->data_len, c->pos, len);
+	c->pos += len;
+	return ui;
+}
+
+/*! \brief write the next field
+ *  \param[in] c cursor
+ *  \param[in] val value whose \a len least significant bits are written
+ *  \param[in] len number of bits (0..64)
+ */
+void bitvec_cursor_write(struct bitvec_cursor *c, uint64_t val,
+			 unsigned int len)
+{
+	if (c->err || len == 0)
+		return;
+	if (len > 64 || c->pos + len > c->limit) {
+		c->err = -EINVAL;
+		return;
+	}
+
+	if (c->acc_bits + len > 64)
+		cursor_flush(c);
+
+	if (len < 64)
+		c->acc = (c->acc << len) | (val & (((uint64_t)1 << len) - 1));
+	else
+		c->acc = val;
+	c->acc_bits += len;
+	c->pos += len;
+}
+
+/*! \brief finish sequential field access
+ *  \param[in] c cursor
+ *  \returns 0 if all fields were within the vector, -EINVAL otherwise
+ *
+ * Like after bitvec_read_field() / bitvec_write_field(), \a bv->cur_bit
+ * is set to the bit following the last field accessed successfully.
+ */
+int bitvec_cursor_finish(struct bitvec_cursor *c)
+{
+	cursor_flush(c);
+	c->bv->cur_bit = c->pos;
+	return c->err;
+}
+
 /*! \brief convert enum to corresponding character */
 char bit_value_to_char(enum bit_value v)
 {
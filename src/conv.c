@@ -36,6 +36,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
 
 #include <osmocom/core/bits.h>
 #include <osmocom/core/conv.h>
@@ -238,6 +243,361 @@ osmo_conv_encode(const struct osmo_conv_code *code,
 
 #define MAX_AE 0x00ffffff
 
+/*
+ * SIMD add-compare-select
+ *
+ * For codes built from a shift register (recursive or not) the two
+ * predecessors of state t are always t/2 and t/2 + n_states/2. This
+ * allows to process 4 (SSE) or 8 (AVX2) target states at once using
+ * 32 bit path metrics, so the results are identical to the generic code.
+ *
+ * The branch metric of a transition is the sum over the N coded bits of
+ * e0[k] (bit is 0) or e1[k] (bit is 1). It is computed per step as
+ * E0 + sum(mask[k] & (e1[k] - e0[k])), mask[k] being all ones for the
+ * transitions whose output has bit k set.
+ */
+
+typedef void (*conv_acs_fn)(const struct osmo_conv_acc *acc,
+			    const unsigned int *ae, unsigned int *ae_next,
+			    uint8_t *hist, int e0, const int *d);
+
+struct osmo_conv_acc {
+	conv_acs_fn acs;
+	int N;
+	int n_states;
+	/*! \brief [2][N][n_states]: per predecessor and coded bit */
+	int32_t *mask;
+	/*! \brief [n_states]: first predecessor t/2 of every state */
+	int32_t *pred;
+};
+
+static enum osmo_conv_decode_backend conv_backend = OSMO_CONV_DECODE_GENERIC;
+static int conv_backend_init = 0;
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static void conv_acs_sse2(const struct osmo_conv_acc *acc,
+			  const unsigned int *ae, unsigned int *ae_next,
+			  uint8_t *hist, int e0, const int *d)
+{
+	const int n = acc->n_states, h = n >> 1, N = acc->N;
+	const int32_t *mask[2] = { acc->mask, acc->mask + N * n };
+	const __m128i vmax = _mm_set1_epi32(MAX_AE);
+	const __m128i vh = _mm_set1_epi32(h);
+	const __m128i ve0 = _mm_set1_epi32(e0);
+	__m128i vd[4];
+	int t, i, j, k;
+
+	for (k = 0; k < N; k++)
+		vd[k] = _mm_set1_epi32(d[k]);
+
+	for (t = 0; t < n; t += 8) {
+		__m128i a[2], pm[2][2], hs[2];
+
+		a[0] = _mm_loadu_si128((const __m128i *) &ae[t >> 1]);
+		a[1] = _mm_loadu_si128((const __m128i *) &ae[(t >> 1) + h]);
+		for (j = 0; j < 2; j++) {
+			pm[j][0] = _mm_unpacklo_epi32(a[j], a[j]);
+			pm[j][1] = _mm_unpackhi_epi32(a[j], a[j]);
+		}
+
+		for (i = 0; i < 2; i++) {
+			const int u = t + 4 * i;
+			__m128i m[2], sel, best, over;
+
+			for (j = 0; j < 2; j++) {
+				m[j] = _mm_add_epi32(pm[j][i], ve0);
+				for (k = 0; k < N; k++)
+					m[j] = _mm_add_epi32(m[j], _mm_and_si128(vd[k],
+						_mm_loadu_si128((const __m128i *) &mask[j][k * n + u])));
+			}
+
+			/* the first predecessor wins ties */
+			sel = _mm_cmpgt_epi32(m[0], m[1]);
+			best = _mm_or_si128(_mm_and_si128(sel, m[1]),
+					    _mm_andnot_si128(sel, m[0]));
+			over = _mm_cmpgt_epi32(best, vmax);
+			best = _mm_or_si128(_mm_and_si128(over, vmax),
+					    _mm_andnot_si128(over, best));
+			_mm_storeu_si128((__m128i *) &ae_next[u], best);
+
+			hs[i] = _mm_add_epi32(_mm_and_si128(sel, vh),
+				_mm_loadu_si128((const __m128i *) &acc->pred[u]));
+		}
+
+		hs[0] = _mm_packs_epi32(hs[0], hs[1]);
+		_mm_storel_epi64((__m128i *) &hist[t], _mm_packus_epi16(hs[0], hs[0]));
+	}
+}
+
+__attribute__((target("sse4.1")))
+static void conv_acs_sse41(const struct osmo_conv_acc *acc,
+			   const unsigned int *ae, unsigned int *ae_next,
+			   uint8_t *hist, int e0, const int *d)
+{
+	const int n = acc->n_states, h = n >> 1, N = acc->N;
+	const int32_t *mask[2] = { acc->mask, acc->mask + N * n };
+	const __m128i vmax = _mm_set1_epi32(MAX_AE);
+	const __m128i vh = _mm_set1_epi32(h);
+	const __m128i ve0 = _mm_set1_epi32(e0);
+	__m128i vd[4];
+	int t, i, j, k;
+
+	for (k = 0; k < N; k++)
+		vd[k] = _mm_set1_epi32(d[k]);
+
+	for (t = 0; t < n; t += 8) {
+		__m128i a[2], pm[2][2], hs[2];
+
+		a[0] = _mm_loadu_si128((const __m128i *) &ae[t >> 1]);
+		a[1] = _mm_loadu_si128((const __m128i *) &ae[(t >> 1) + h]);
+		for (j = 0; j < 2; j++) {
+			pm[j][0] = _mm_unpacklo_epi32(a[j], a[j]);
+			pm[j][1] = _mm_unpackhi_epi32(a[j], a[j]);
+		}
+
+		for (i = 0; i < 2; i++) {
+			const int u = t + 4 * i;
+			__m128i m[2], sel;
+
+			for (j = 0; j < 2; j++) {
+				m[j] = _mm_add_epi32(pm[j][i], ve0);
+				for (k = 0; k < N; k++)
+					m[j] = _mm_add_epi32(m[j], _mm_and_si128(vd[k],
+						_mm_loadu_si128((const __m128i *) &mask[j][k * n + u])));
+			}
+
+			/* the first predecessor wins ties */
+			sel = _mm_cmpgt_epi32(m[0], m[1]);
+			_mm_storeu_si128((__m128i *) &ae_next[u],
+				_mm_min_epi32(_mm_blendv_epi8(m[0], m[1], sel), vmax));
+
+			hs[i] = _mm_add_epi32(_mm_and_si128(sel, vh),
+				_mm_loadu_si128((const __m128i *) &acc->pred[u]));
+		}
+
+		hs[0] = _mm_packs_epi32(hs[0], hs[1]);
+		_mm_storel_epi64((__m128i *) &hist[t], _mm_packus_epi16(hs[0], hs[0]));
+	}
+}
+
+__attribute__((target("avx2")))
+static void conv_acs_avx2(const struct osmo_conv_acc *acc,
+			  const unsigned int *ae, unsigned int *ae_next,
+			  uint8_t *hist, int e0, const int *d)
+{
+	const int n = acc->n_states, h = n >> 1, N = acc->N;
+	const int32_t *mask[2] = { acc->mask, acc->mask + N * n };
+	const __m256i vmax = _mm256_set1_epi32(MAX_AE);
+	const __m256i vh = _mm256_set1_epi32(h);
+	const __m256i ve0 = _mm256_set1_epi32(e0);
+	const __m256i dup = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	__m256i vd[4];
+	int t, j, k;
+
+	for (k = 0; k < N; k++)
+		vd[k] = _mm256_set1_epi32(d[k]);
+
+	for (t = 0; t < n; t += 8) {
+		__m256i m[2], sel, hs;
+		__m128i lo, hi;
+
+		for (j = 0; j < 2; j++) {
+			__m128i a = _mm_loadu_si128((const __m128i *)
+						    &ae[(t >> 1) + j * h]);
+			m[j] = _mm256_permutevar8x32_epi32(
+					_mm256_castsi128_si256(a), dup);
+			m[j] = _mm256_add_epi32(m[j], ve0);
+			for (k = 0; k < N; k++)
+				m[j] = _mm256_add_epi32(m[j], _mm256_and_si256(vd[k],
+					_mm256_loadu_si256((const __m256i *) &mask[j][k * n + t])));
+		}
+
+		/* the first predecessor wins ties */
+		sel = _mm256_cmpgt_epi32(m[0], m[1]);
+		_mm256_storeu_si256((__m256i *) &ae_next[t],
+			_mm256_min_epi32(_mm256_blendv_epi8(m[0], m[1], sel), vmax));
+
+		hs = _mm256_add_epi32(_mm256_and_si256(sel, vh),
+			_mm256_loadu_si256((const __m256i *) &acc->pred[t]));
+		lo = _mm256_castsi256_si128(hs);
+		hi = _mm256_extracti128_si256(hs, 1);
+		lo = _mm_packs_epi32(lo, hi);
+		_mm_storel_epi64((__m128i *) &hist[t], _mm_packus_epi16(lo, lo));
+	}
+}
+#endif /* HAVE_X86_SIMD */
+
+static int conv_backend_supported(enum osmo_conv_decode_backend backend)
+{
+	switch (backend) {
+	case OSMO_CONV_DECODE_GENERIC:
+		return 1;
+#ifdef HAVE_X86_SIMD
+	case OSMO_CONV_DECODE_SSE2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2");
+	case OSMO_CONV_DECODE_SSE41:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse4.1");
+	case OSMO_CONV_DECODE_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return 0;
+	}
+}
+
+/* pick the best supported backend on first use */
+static void conv_backend_select(void)
+{
+	const enum osmo_conv_decode_backend prefer[] = {
+		OSMO_CONV_DECODE_AVX2,
+		OSMO_CONV_DECODE_SSE41,
+		OSMO_CONV_DECODE_SSE2,
+	};
+	int i;
+
+	conv_backend_init = 1;
+	for (i = 0; i < sizeof(prefer) / sizeof(prefer[0]); i++) {
+		if (conv_backend_supported(prefer[i])) {
+			conv_backend = prefer[i];
+			return;
+		}
+	}
+}
+
+/*! \brief Select the Viterbi decoder implementation
+ *  \param[in] backend implementation to use for subsequently initialized
+ *		       decoders
+ *  \returns 0 on success; -ENOTSUP if not supported by build or CPU
+ *
+ * By default the fastest implementation supported by the CPU is used.
+ */
+int osmo_conv_decode_set_backend(enum osmo_conv_decode_backend backend)
+{
+	if (!conv_backend_supported(backend))
+		return -ENOTSUP;
+
+	conv_backend_init = 1;
+	conv_backend = backend;
+	return 0;
+}
+
+/*! \brief Obtain the Viterbi decoder implementation currently in use */
+enum osmo_conv_decode_backend osmo_conv_decode_get_backend(void)
+{
+	if (!conv_backend_init)
+		conv_backend_select();
+	return conv_backend;
+}
+
+static conv_acs_fn conv_acs_get(void)
+{
+	switch (osmo_conv_decode_get_backend()) {
+#ifdef HAVE_X86_SIMD
+	case OSMO_CONV_DECODE_SSE2:
+		return conv_acs_sse2;
+	case OSMO_CONV_DECODE_SSE41:
+		return conv_acs_sse41;
+	case OSMO_CONV_DECODE_AVX2:
+		return conv_acs_avx2;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+/* Build the SIMD tables for a code, NULL if it can't be accelerated */
+static struct osmo_conv_acc *conv_acc_alloc(const struct osmo_conv_code *code)
+{
+	const int N = code->N, n = 1 << (code->K - 1), h = n >> 1;
+	struct osmo_conv_acc *acc;
+	conv_acs_fn acs;
+	int s, t, j, k;
+
+	if ((code->K != 5 && code->K != 7) || N < 2 || N > 4)
+		return NULL;
+
+	acs = conv_acs_get();
+	if (!acs)
+		return NULL;
+
+	/* only shift register codes: s -> { 2s, 2s + 1 } mod n_states */
+	for (s = 0; s < n; s++) {
+		int a = code->next_state[s][0], b = code->next_state[s][1];
+		if ((a & ~1) != ((s << 1) & (n - 1)) || (a ^ b) != 1)
+			return NULL;
+	}
+
+	acc = malloc(sizeof(*acc) + sizeof(int32_t) * (2 * N + 1) * n);
+	if (!acc)
+		return NULL;
+
+	acc->acs = acs;
+	acc->N = N;
+	acc->n_states = n;
+	acc->mask = (int32_t *) (acc + 1);
+	acc->pred = acc->mask + 2 * N * n;
+
+	for (t = 0; t < n; t++) {
+		acc->pred[t] = t >> 1;
+		for (j = 0; j < 2; j++) {
+			int p = (t >> 1) + j * h;
+			int b = code->next_state[p][0] == t ? 0 : 1;
+			uint8_t out = code->next_output[p][b];
+
+			for (k = 0; k < N; k++)
+				acc->mask[(j * N + k) * n + t] =
+					(out & (1 << (N - 1 - k))) ? -1 : 0;
+		}
+	}
+
+	return acc;
+}
+
+/* One trellis step using the SIMD tables */
+static inline void conv_acc_step(const struct osmo_conv_acc *acc,
+				 const sbit_t *in_sym, const unsigned int *ae,
+				 unsigned int *ae_next, uint8_t *hist)
+{
+	int d[4], e0 = 0, j;
+
+	for (j = 0; j < acc->N; j++) {
+		int is = in_sym[j], e_0 = 0, e_1 = 0;
+		if (is) {
+			e_0 = ((is - 127) * (is - 127)) >> 9;
+			e_1 = ((is + 127) * (is + 127)) >> 9;
+		}
+		e0 += e_0;
+		d[j] = e_1 - e_0;
+	}
+
+	acc->acs(acc, ae, ae_next, hist, e0, d);
+}
+
+/* Branch metric of every possible N bit output symbol for one step. The
+ * first input symbol corresponds to the MSB of the output symbol. */
+static inline void conv_bm_table(int *bm, const sbit_t *in_sym, int N)
+{
+	int j, o, size = 1;
+
+	bm[0] = 0;
+	for (j = 0; j < N; j++) {
+		int is = in_sym[j], e_0 = 0, e_1 = 0;
+		if (is) {
+			e_0 = ((is - 127) * (is - 127)) >> 9;
+			e_1 = ((is + 127) * (is + 127)) >> 9;
+		}
+		for (o = size - 1; o >= 0; o--) {
+			bm[2 * o + 1] = bm[o] + e_1;
+			bm[2 * o]     = bm[o] + e_0;
+		}
+		size <<= 1;
+	}
+}
+
 void
 osmo_conv_decode_init(struct osmo_conv_decoder *decoder,
                       const struct osmo_conv_code *code, int len, int start_state)
@@ -262,6 +622,8 @@ osmo_conv_decode_init(struct osmo_conv_decoder *decoder,
 
 	decoder->state_history = malloc(sizeof(uint8_t) * n_states * (len + decoder->code->K - 1));
 
+	decoder->acc = conv_acc_alloc(code);
+
 	/* Classic reset */
 	osmo_conv_decode_reset(decoder, start_state);
 }
@@ -313,6 +675,7 @@ osmo_conv_decode_deinit(struct osmo_conv_decoder *decoder)
 	free(decoder->ae);
 	free(decoder->ae_next);
 	free(decoder->state_history);
+	free(decoder->acc);
 
 	memset(decoder, 0x00, sizeof(struct osmo_conv_decoder));
 }
@@ -329,7 +692,9 @@ osmo_conv_decode_scan(struct osmo_conv_decoder *decoder,
 	unsigned int *ae;
 	unsigned int *ae_next;
 	uint8_t *state_history;
-	sbit_t *in_sym;
+	const sbit_t *in_sym;
+	sbit_t *in_buf = NULL;
+	int bm[256];
 
 	int i_idx, p_idx;
 
@@ -340,7 +705,8 @@ osmo_conv_decode_scan(struct osmo_conv_decoder *decoder,
 	ae_next = decoder->ae_next;
 	state_history = &decoder->state_history[n_states * decoder->o_idx];
 
-	in_sym  = alloca(sizeof(sbit_t) * code->N);
+	if (code->puncture)
+		in_buf = alloca(sizeof(sbit_t) * code->N);
 
 	i_idx = 0;
 	p_idx = decoder->p_idx;
@@ -348,10 +714,7 @@ osmo_conv_decode_scan(struct osmo_conv_decoder *decoder,
 	/* Scan the treillis */
 	for (i=0; i<n; i++)
 	{
-		/* Reset next accumulated error */
-		for (s=0; s<n_states; s++) {
-			ae_next[s] = MAX_AE;
-		}
+		unsigned int *tmp;
 
 		/* Get input */
 		if (code->puncture) {
@@ -359,45 +722,46 @@ osmo_conv_decode_scan(struct osmo_conv_decoder *decoder,
 			for (j=0; j<code->N; j++) {
 				int idx = ((decoder->o_idx + i) * code->N) + j;
 				if (idx == code->puncture[p_idx]) {
-					in_sym[j] = 0;	/* Undefined */
+					in_buf[j] = 0;	/* Undefined */
 					p_idx++;
 				} else {
-					in_sym[j] = input[i_idx];
+					in_buf[j] = input[i_idx];
 					i_idx++;
 				}
 			}
+			in_sym = in_buf;
 		} else {
-			/* Easy, just copy N bits */
-			memcpy(in_sym, &input[i_idx], code->N);
+			/* Easy, just use the next N bits */
+			in_sym = &input[i_idx];
 			i_idx += code->N;
 		}
 
+		if (decoder->acc) {
+			conv_acc_step(decoder->acc, in_sym, ae, ae_next,
+				      &state_history[n_states * i]);
+			goto next;
+		}
+
+		/* Error for each possible output symbol */
+		conv_bm_table(bm, in_sym, code->N);
+
+		/* Reset next accumulated error */
+		for (s=0; s<n_states; s++) {
+			ae_next[s] = MAX_AE;
+		}
+
 		/* Scan all state */
 		for (s=0; s<n_states; s++)
 		{
 			/* Scan possible input bits */
 			for (b=0; b<2; b++)
 			{
-				int nae, ov, e;
-				uint8_t m;
-
 				/* Next output and state */
 				uint8_t out   = code->next_output[s][b];
 				uint8_t state = code->next_state[s][b];
 
 				/* New error for this path */
-				nae = ae[s];			/* start from last error */
-				m = 1 << (code->N - 1);		/* mask for 'out' bit selection */
-
-				for (j=0; j<code->N; j++) {
-					int is = (int)in_sym[j];
-					if (is) {
-						ov = (out & m) ? -127 : 127; /* sbit_t value for it */
-						e = is - ov;                 /* raw error for this bit */
-						nae += (e * e) >> 9;         /* acc the squared/scaled value */
-					}
-					m >>= 1;                     /* next mask bit */
-				}
+				unsigned int nae = ae[s] + bm[out];
 
 				/* Is it survivor ? */
 				if (ae_next[state] > nae) {
@@ -407,11 +771,16 @@ osmo_conv_decode_scan(struct osmo_conv_decoder *decoder,
 			}
 		}
 
-		/* Copy accumulated error */
-		memcpy(ae, ae_next, sizeof(unsigned int) * n_states);
+next:
+		/* Swap accumulated error */
+		tmp = ae;
+		ae = ae_next;
+		ae_next = tmp;
 	}
 
 	/* Update decoder state */
+	decoder->ae = ae;
+	decoder->ae_next = ae_next;
 	decoder->p_idx = p_idx;
 	decoder->o_idx += n;
 
@@ -430,7 +799,9 @@ osmo_conv_decode_flush(struct osmo_conv_decoder *decoder,
 	unsigned int *ae;
 	unsigned int *ae_next;
 	uint8_t *state_history;
-	sbit_t *in_sym;
+	const sbit_t *in_sym;
+	sbit_t *in_buf = NULL;
+	int bm[256];
 
 	int i_idx, p_idx;
 
@@ -441,7 +812,8 @@ osmo_conv_decode_flush(struct osmo_conv_decoder *decoder,
 	ae_next = decoder->ae_next;
 	state_history = &decoder->state_history[n_states * decoder->o_idx];
 
-	in_sym  = alloca(sizeof(sbit_t) * code->N);
+	if (code->puncture)
+		in_buf = alloca(sizeof(sbit_t) * code->N);
 
 	i_idx = 0;
 	p_idx = decoder->p_idx;
@@ -449,10 +821,7 @@ osmo_conv_decode_flush(struct osmo_conv_decoder *decoder,
 	/* Scan the treillis */
 	for (i=0; i<code->K-1; i++)
 	{
-		/* Reset next accumulated error */
-		for (s=0; s<n_states; s++) {
-			ae_next[s] = MAX_AE;
-		}
+		unsigned int *tmp;
 
 		/* Get input */
 		if (code->puncture) {
@@ -460,24 +829,32 @@ osmo_conv_decode_flush(struct osmo_conv_decoder *decoder,
 			for (j=0; j<code->N; j++) {
 				int idx = ((decoder->o_idx + i) * code->N) + j;
 				if (idx == code->puncture[p_idx]) {
-					in_sym[j] = 0;	/* Undefined */
+					in_buf[j] = 0;	/* Undefined */
 					p_idx++;
 				} else {
-					in_sym[j] = input[i_idx];
+					in_buf[j] = input[i_idx];
 					i_idx++;
 				}
 			}
+			in_sym = in_buf;
 		} else {
-			/* Easy, just copy N bits */
-			memcpy(in_sym, &input[i_idx], code->N);
+			/* Easy, just use the next N bits */
+			in_sym = &input[i_idx];
 			i_idx += code->N;
 		}
 
+		/* Error for each possible output symbol */
+		conv_bm_table(bm, in_sym, code->N);
+
+		/* Reset next accumulated error */
+		for (s=0; s<n_states; s++) {
+			ae_next[s] = MAX_AE;
+		}
+
 		/* Scan all state */
 		for (s=0; s<n_states; s++)
 		{
-			int nae, ov, e;
-			uint8_t m;
+			unsigned int nae;
 
 			/* Next output and state */
 			uint8_t out;
@@ -492,18 +869,7 @@ osmo_conv_decode_flush(struct osmo_conv_decoder *decoder,
 			}
 
 			/* New error for this path */
-			nae = ae[s];			/* start from last error */
-			m = 1 << (code->N - 1);		/* mask for 'out' bit selection */
-
-			for (j=0; j<code->N; j++) {
-				int is = (int)in_sym[j];
-				if (is) {
-					ov = (out & m) ? -127 : 127; /* sbit_t value for it */
-					e = is - ov;                 /* raw error for this bit */
-					nae += (e * e) >> 9;         /* acc the squared/scaled value */
-				}
-				m >>= 1;                     /* next mask bit */
-			}
+			nae = ae[s] + bm[out];
 
 			/* Is it survivor ? */
 			if (ae_next[state] > nae) {
@@ -512,11 +878,15 @@ osmo_conv_decode_flush(struct osmo_conv_decoder *decoder,
 			}
 		}
 
-		/* Copy accumulated error */
-		memcpy(ae, ae_next, sizeof(unsigned int) * n_states);
+		/* Swap accumulated error */
+		tmp = ae;
+		ae = ae_next;
+		ae_next = tmp;
 	}
 
 	/* Update decoder state */
+	decoder->ae = ae;
+	decoder->ae_next = ae_next;
 	decoder->p_idx = p_idx;
 	decoder->o_idx += code->K - 1;
 
@@ -589,6 +959,29 @@ osmo_conv_decode_get_output(struct osmo_conv_decoder *decoder,
 	return min_ae;
 }
 
+static int
+_conv_decode_run(struct osmo_conv_decoder *decoder,
+                 const sbit_t *input, ubit_t *output)
+{
+	const struct osmo_conv_code *code = decoder->code;
+	int l;
+
+	if (code->term == CONV_TERM_TAIL_BITING) {
+		osmo_conv_decode_scan(decoder, input, code->len);
+		osmo_conv_decode_rewind(decoder);
+	}
+
+	l = osmo_conv_decode_scan(decoder, input, code->len);
+
+	if (code->term == CONV_TERM_FLUSH)
+		l = osmo_conv_decode_flush(decoder, &input[l]);
+
+	return osmo_conv_decode_get_output(decoder, output,
+		code->term == CONV_TERM_FLUSH,		/* has_flush */
+		code->term == CONV_TERM_FLUSH ? 0 : -1	/* end_state */
+	);
+}
+
 /*! \brief All-in-one convolutional decoding function
  *  \param[in] code description of convolutional code to be used
  *  \param[in] input array of soft bits (coded)
@@ -604,28 +997,161 @@ osmo_conv_decode(const struct osmo_conv_code *code,
                  const sbit_t *input, ubit_t *output)
 {
 	struct osmo_conv_decoder decoder;
-	int rv, l;
+	int rv;
 
 	osmo_conv_decode_init(&decoder, code, 0, 0);
+	rv = _conv_decode_run(&decoder, input, output);
+	osmo_conv_decode_deinit(&decoder);
 
-	if (code->term == CONV_TERM_TAIL_BITING) {
-		osmo_conv_decode_scan(&decoder, input, code->len);
-		osmo_conv_decode_rewind(&decoder);
+	return rv;
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Compiled codes                                                           */
+/* ------------------------------------------------------------------------ */
+
+/*! \brief convolutional code prepared for repeated encoding / decoding */
+struct osmo_conv_compiled {
+	/*! \brief copy of the code without puncturing */
+	struct osmo_conv_code code;
+	/*! \brief # of unpunctured / punctured coded bits */
+	int full_len;
+	int out_len;
+	/*! \brief [out_len] position of each transmitted bit in the
+	 *  unpunctured stream, NULL if the code isn't punctured */
+	int *keep;
+	/*! \brief unpunctured coded bits */
+	ubit_t *ubuf;
+	sbit_t *sbuf;
+	/*! \brief decoder with preallocated metrics and state history */
+	struct osmo_conv_decoder dec;
+};
+
+/*! \brief Prepare a convolutional code for repeated use
+ *  \param[in] code description of convolutional code, len must be set
+ *  \returns compiled code or NULL on error
+ *
+ * Resolves the puncturing into an index map and allocates all the
+ * buffers needed by \ref osmo_conv_encode_compiled and
+ * \ref osmo_conv_decode_compiled once, so those don't allocate or
+ * search the puncturing list on every call. The decoder backend is
+ * chosen at this point. A compiled code holds decoder state and must
+ * not be used by several threads at the same time.
+ */
+struct osmo_conv_compiled *
+osmo_conv_compile(const struct osmo_conv_code *code)
+{
+	struct osmo_conv_compiled *cc;
+	int i, o, p;
+
+	if (code->len <= 0)
+		return NULL;
+
+	cc = calloc(1, sizeof(*cc));
+	if (!cc)
+		return NULL;
+
+	cc->code = *code;
+	cc->code.puncture = NULL;
+	cc->full_len = osmo_conv_get_output_length(&cc->code, 0);
+	cc->out_len = osmo_conv_get_output_length(code, 0);
+
+	cc->ubuf = malloc(sizeof(ubit_t) * cc->full_len);
+	cc->sbuf = malloc(sizeof(sbit_t) * cc->full_len);
+	if (!cc->ubuf || !cc->sbuf)
+		goto err;
+
+	if (code->puncture) {
+		cc->keep = malloc(sizeof(int) * cc->out_len);
+		if (!cc->keep)
+			goto err;
+		for (i = 0, o = 0, p = 0; i < cc->full_len; i++) {
+			if (code->puncture[p] == i)
+				p++;
+			else
+				cc->keep[o++] = i;
+		}
 	}
 
-	l = osmo_conv_decode_scan(&decoder, input, code->len);
+	osmo_conv_decode_init(&cc->dec, &cc->code, 0, 0);
+	if (!cc->dec.ae || !cc->dec.ae_next || !cc->dec.state_history) {
+		osmo_conv_decode_deinit(&cc->dec);
+		goto err;
+	}
 
-	if (code->term == CONV_TERM_FLUSH)
-		l = osmo_conv_decode_flush(&decoder, &input[l]);
+	return cc;
 
-	rv = osmo_conv_decode_get_output(&decoder, output,
-		code->term == CONV_TERM_FLUSH,		/* has_flush */
-		code->term == CONV_TERM_FLUSH ? 0 : -1	/* end_state */
-	);
+err:
+	free(cc->keep);
+	free(cc->sbuf);
+	free(cc->ubuf);
+	free(cc);
+	return NULL;
+}
 
-	osmo_conv_decode_deinit(&decoder);
+/*! \brief Release a code compiled by \ref osmo_conv_compile */
+void
+osmo_conv_compiled_free(struct osmo_conv_compiled *cc)
+{
+	if (!cc)
+		return;
+
+	osmo_conv_decode_deinit(&cc->dec);
+	free(cc->keep);
+	free(cc->sbuf);
+	free(cc->ubuf);
+	free(cc);
+}
 
-	return rv;
+/*! \brief Encode using a compiled code
+ *  \param[in] cc compiled code
+ *  \param[in] input array of unpacked bits (uncoded)
+ *  \param[out] output array of unpacked bits (encoded)
+ *  \return Number of produced output bits
+ *
+ * Same result as \ref osmo_conv_encode for the original code.
+ */
+int
+osmo_conv_encode_compiled(struct osmo_conv_compiled *cc,
+                          const ubit_t *input, ubit_t *output)
+{
+	int i;
+
+	if (!cc->keep)
+		return osmo_conv_encode(&cc->code, input, output);
+
+	osmo_conv_encode(&cc->code, input, cc->ubuf);
+	for (i = 0; i < cc->out_len; i++)
+		output[i] = cc->ubuf[cc->keep[i]];
+
+	return cc->out_len;
+}
+
+/*! \brief Decode using a compiled code
+ *  \param[in] cc compiled code
+ *  \param[in] input array of soft bits (coded)
+ *  \param[out] output array of unpacked bits (decoded)
+ *
+ * Same result as \ref osmo_conv_decode for the original code.
+ */
+int
+osmo_conv_decode_compiled(struct osmo_conv_compiled *cc,
+                          const sbit_t *input, ubit_t *output)
+{
+	int i;
+
+	if (cc->keep) {
+		/* punctured bits are erasures */
+		memset(cc->sbuf, 0, sizeof(sbit_t) * cc->full_len);
+		for (i = 0; i < cc->out_len; i++)
+			cc->sbuf[cc->keep[i]] = input[i];
+		input = cc->sbuf;
+	}
+
+	osmo_conv_decode_reset(&cc->dec, 0);
+
+	return _conv_decode_run(&cc->dec, input, output);
 }
 
 /*! @} */
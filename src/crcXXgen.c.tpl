@@ -35,36 +35,220 @@
 #include <osmocom/core/bits.h>
 #include <osmocom/core/crcXXgen.h>
 
+/* Below this many bits the table lookup isn't worth it */
+#define CRC_MIN_TABLE_BITS	32
+
+/* Bytes consumed per step of the table driven engine (slice-by-4) */
+#define CRC_SLICES		4
+
+/* Number of polynomials tables are kept for, others take the bitwise
+ * path.  Slots are static and claimed on first use of a polynomial. */
+#define CRC_TABLE_SLOTS		8
+
+/* The table driven engine keeps the CRC register aligned to the MSB of
+ * a uintXX_t, so CRCs narrower than XX bits need no masking. */
+#define CRC_TOP			((uintXX_t)1 << (XX - 1))
+
+enum crcXXgen_slot_state {
+	SLOT_FREE,
+	SLOT_BUILDING,
+	SLOT_READY,
+};
+
+/* Lookup tables of one polynomial: t[k][b] is the register after
+ * feeding byte b followed by k zero bytes into an all-zero register */
+struct crcXXgen_tables {
+	int state;
+	int bits;
+	uintXX_t poly;
+	uintXX_t t[CRC_SLICES][256];
+};
+
+static struct crcXXgen_tables crcXXgen_slots[CRC_TABLE_SLOTS];
+
+static void
+crcXXgen_tables_build(struct crcXXgen_tables *tbl, uintXX_t poly)
+{
+	int i, j, k;
+
+	for (i = 0; i < 256; i++) {
+		uintXX_t crc = (uintXX_t)i << (XX - 8);
+
+		for (j = 0; j < 8; j++)
+			crc = crc & CRC_TOP ? (uintXX_t)(crc << 1) ^ poly :
+					      (uintXX_t)(crc << 1);
+		tbl->t[0][i] = crc;
+	}
+
+	for (k = 1; k < CRC_SLICES; k++) {
+		for (i = 0; i < 256; i++) {
+			uintXX_t crc = tbl->t[k - 1][i];
+			tbl->t[k][i] = (uintXX_t)(crc << 8) ^
+				       tbl->t[0][crc >> (XX - 8)];
+		}
+	}
+}
+
+/* Find the tables of a polynomial, building them in a free slot on first
+ * use.  This is safe to call from multiple threads: a slot is claimed
+ * with a compare-and-swap and only published once it is complete.
+ * Returns NULL (bitwise fallback) while another thread is still building
+ * the tables, or if all slots are taken. */
+static const struct crcXXgen_tables *
+crcXXgen_tables_get(const struct osmo_crcXXgen_code *code)
+{
+	struct crcXXgen_tables *tbl;
+	int i, state;
+
+	for (i = 0; i < CRC_TABLE_SLOTS; i++) {
+		tbl = &crcXXgen_slots[i];
+		state = __atomic_load_n(&tbl->state, __ATOMIC_ACQUIRE);
+
+		if (state == SLOT_FREE &&
+		    __atomic_compare_exchange_n(&tbl->state, &state,
+				SLOT_BUILDING, 0, __ATOMIC_ACQUIRE,
+				__ATOMIC_ACQUIRE)) {
+			tbl->bits = code->bits;
+			tbl->poly = code->poly;
+			crcXXgen_tables_build(tbl,
+					      code->poly << (XX - code->bits));
+			__atomic_store_n(&tbl->state, SLOT_READY,
+					 __ATOMIC_RELEASE);
+			return tbl;
+		}
+
+		/* a failed compare-and-swap updated state */
+		if (state != SLOT_READY)
+			return NULL;
+		if (tbl->bits == code->bits && tbl->poly == code->poly)
+			return tbl;
+	}
+
+	return NULL;
+}
+
+/* feed whole packed bytes into the MSB aligned register */
+static uintXX_t
+crcXXgen_feed_bytes(const struct crcXXgen_tables *tbl, uintXX_t crc,
+                    const pbit_t *in, unsigned int n)
+{
+	for (; n >= CRC_SLICES; n -= CRC_SLICES, in += CRC_SLICES) {
+		uint8_t x[CRC_SLICES];
+		int k;
+
+		/* the register overlaps the first XX/8 bytes */
+		for (k = 0; k < CRC_SLICES; k++)
+			x[k] = in[k] ^ (k < XX / 8 ?
+					(uint8_t)(crc >> (XX - 8 - 8 * k)) : 0);
+
+#if XX > 8 * CRC_SLICES
+		crc <<= 8 * CRC_SLICES;
+#else
+		crc = 0;
+#endif
+		crc ^= tbl->t[3][x[0]] ^ tbl->t[2][x[1]] ^
+		       tbl->t[1][x[2]] ^ tbl->t[0][x[3]];
+	}
+
+	for (; n; n--, in++)
+		crc = (uintXX_t)(crc << 8) ^ tbl->t[0][(crc >> (XX - 8)) ^ *in];
+
+	return crc;
+}
+
+/* feed single bits (MSB of each value) into the MSB aligned register */
+static uintXX_t
+crcXXgen_feed_bits(uintXX_t poly, uintXX_t crc, const ubit_t *in, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		crc ^= (uintXX_t)(in[i] & 1) << (XX - 1);
+		crc = crc & CRC_TOP ? (uintXX_t)(crc << 1) ^ poly :
+				      (uintXX_t)(crc << 1);
+	}
+
+	return crc;
+}
+
 
 /*! \brief Compute the CRC value of a given array of hard-bits
  *  \param[in] code The CRC code description to apply
  *  \param[in] in Array of hard bits
  *  \param[in] len Length of the array of hard bits
  *  \returns The CRC value
+ *
+ * The bits are packed 8 at a time and run through per-polynomial lookup
+ * tables, which are built on first use of a polynomial.
  */
 uintXX_t
 osmo_crcXXgen_compute_bits(const struct osmo_crcXXgen_code *code,
                            const ubit_t *in, int len)
 {
-	const uintXX_t poly = code->poly;
-	uintXX_t crc = code->init;
-	int i, n = code->bits-1;
-
-	for (i=0; i<len; i++) {
-		uintXX_t bit = in[i] & 1;
-		crc ^= (bit << n);
-		if (crc & ((uintXX_t)1 << n)) {
-			crc <<= 1;
-			crc ^= poly;
-		} else {
-			crc <<= 1;
+	const int shift = XX - code->bits;
+	const uintXX_t poly = code->poly << shift;
+	const struct crcXXgen_tables *tbl = NULL;
+	uintXX_t crc = code->init << shift;
+
+	if (len >= CRC_MIN_TABLE_BITS)
+		tbl = crcXXgen_tables_get(code);
+
+	if (tbl) {
+		pbit_t buf[64];
+
+		while (len >= 8) {
+			int n = len / 8;
+
+			if (n > (int) sizeof(buf))
+				n = sizeof(buf);
+
+			osmo_ubit2pbit(buf, in, n * 8);
+			crc = crcXXgen_feed_bytes(tbl, crc, buf, n);
+			in += n * 8;
+			len -= n * 8;
 		}
-		crc &= ((uintXX_t)1 << code->bits) - 1;
 	}
 
-	crc ^= code->remainder;
+	crc = crcXXgen_feed_bits(poly, crc, in, len);
 
-	return crc;
+	return (crc >> shift) ^ code->remainder;
+}
+
+/*! \brief Compute the CRC value of a given array of packed bits
+ *  \param[in] code The CRC code description to apply
+ *  \param[in] in Array of packed bits (MSB first)
+ *  \param[in] len Number of bits in \a in
+ *  \returns The CRC value, identical to osmo_crcXXgen_compute_bits() of
+ *	     the unpacked bits
+ */
+uintXX_t
+osmo_crcXXgen_compute_pbits(const struct osmo_crcXXgen_code *code,
+                            const pbit_t *in, int len)
+{
+	const int shift = XX - code->bits;
+	const uintXX_t poly = code->poly << shift;
+	const struct crcXXgen_tables *tbl = NULL;
+	uintXX_t crc = code->init << shift;
+	ubit_t tail[8];
+
+	if (len >= CRC_MIN_TABLE_BITS)
+		tbl = crcXXgen_tables_get(code);
+
+	if (tbl) {
+		crc = crcXXgen_feed_bytes(tbl, crc, in, len / 8);
+		in += len / 8;
+		len %= 8;
+	}
+
+	while (len > 0) {
+		int n = len < 8 ? len : 8;
+
+		osmo_pbit2ubit(tail, in++, n);
+		crc = crcXXgen_feed_bits(poly, crc, tail, n);
+		len -= n;
+	}
+
+	return (crc >> shift) ^ code->remainder;
 }
 
 
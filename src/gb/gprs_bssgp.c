@@ -378,14 +378,6 @@ static int bssgp_rx_ul_ud(struct msgb *msg, struct tlv_parsed *tp,
 
 	DEBUGP(DBSSGP, "BSSGP TLLI=0x%08x Rx UPLINK-UNITDATA\n", msgb_tlli(msg));
 
-	/* Cell ID and LLC_PDU are the only mandatory IE */
-	if (!TLVP_PRESENT(tp, BSSGP_IE_CELL_ID) ||
-	    !TLVP_PRESENT(tp, BSSGP_IE_LLC_PDU)) {
-		LOGP(DBSSGP, LOGL_ERROR, "BSSGP TLLI=0x%08x Rx UL-UD "
-			"missing mandatory IE\n", msgb_tlli(msg));
-		return bssgp_tx_status(BSSGP_CAUSE_MISSING_MAND_IE, NULL, msg);
-	}
-
 	/* store pointer to LLC header and CELL ID in msgb->cb */
 	msgb_llch(msg) = (uint8_t *) TLVP_VAL(tp, BSSGP_IE_LLC_PDU);
 	msgb_bcid(msg) = (uint8_t *) TLVP_VAL(tp, BSSGP_IE_CELL_ID);
@@ -409,13 +401,6 @@ static int bssgp_rx_suspend(struct msgb *msg, struct tlv_parsed *tp)
 	uint16_t ns_bvci = msgb_bvci(msg);
 	int rc;
 
-	if (!TLVP_PRESENT(tp, BSSGP_IE_TLLI) ||
-	    !TLVP_PRESENT(tp, BSSGP_IE_ROUTEING_AREA)) {
-		LOGP(DBSSGP, LOGL_ERROR, "BSSGP BVCI=%u Rx SUSPEND "
-			"missing mandatory IE\n", ns_bvci);
-		return bssgp_tx_status(BSSGP_CAUSE_MISSING_MAND_IE, NULL, msg);
-	}
-
 	tlli = ntohl(*(uint32_t *)TLVP_VAL(tp, BSSGP_IE_TLLI));
 
 	DEBUGP(DBSSGP, "BSSGP BVCI=%u TLLI=0x%08x Rx SUSPEND\n",
@@ -450,14 +435,6 @@ static int bssgp_rx_resume(struct msgb *msg, struct tlv_parsed *tp)
 	uint16_t ns_bvci = msgb_bvci(msg);
 	int rc;
 
-	if (!TLVP_PRESENT(tp, BSSGP_IE_TLLI) ||
-	    !TLVP_PRESENT(tp, BSSGP_IE_ROUTEING_AREA) ||
-	    !TLVP_PRESENT(tp, BSSGP_IE_SUSPEND_REF_NR)) {
-		LOGP(DBSSGP, LOGL_ERROR, "BSSGP BVCI=%u Rx RESUME "
-			"missing mandatory IE\n", ns_bvci);
-		return bssgp_tx_status(BSSGP_CAUSE_MISSING_MAND_IE, NULL, msg);
-	}
-
 	tlli = ntohl(*(uint32_t *)TLVP_VAL(tp, BSSGP_IE_TLLI));
 	suspend_ref = *TLVP_VAL(tp, BSSGP_IE_SUSPEND_REF_NR);
 
@@ -489,18 +466,9 @@ static int bssgp_rx_llc_disc(struct msgb *msg, struct tlv_parsed *tp,
 			     struct bssgp_bvc_ctx *ctx)
 {
 	struct osmo_bssgp_prim nmp;
-	uint32_t tlli = 0;
-
-	if (!TLVP_PRESENT(tp, BSSGP_IE_TLLI) ||
-	    !TLVP_PRESENT(tp, BSSGP_IE_LLC_FRAMES_DISCARDED) ||
-	    !TLVP_PRESENT(tp, BSSGP_IE_BVCI) ||
-	    !TLVP_PRESENT(tp, BSSGP_IE_NUM_OCT_AFF)) {
-		LOGP(DBSSGP, LOGL_ERROR, "BSSGP BVCI=%u Rx LLC DISCARDED "
-			"missing mandatory IE\n", ctx->bvci);
-	}
+	uint32_t tlli;
 
-	if (TLVP_PRESENT(tp, BSSGP_IE_TLLI))
-		tlli = ntohl(*(uint32_t *)TLVP_VAL(tp, BSSGP_IE_TLLI));
+	tlli = ntohl(*(uint32_t *)TLVP_VAL(tp, BSSGP_IE_TLLI));
 
 	DEBUGP(DBSSGP, "BSSGP BVCI=%u TLLI=%08x Rx LLC DISCARDED\n",
 		ctx->bvci, tlli);
@@ -571,52 +539,86 @@ struct bssgp_fc_queue_element {
 	void *priv;
 };
 
-static int fc_queue_timer_cfg(struct bssgp_flow_control *fc);
-static int bssgp_fc_needs_queueing(struct bssgp_flow_control *fc, uint32_t pdu_len);
+/* Queue elements are allocated in slabs and never returned to talloc,
+ * so that queueing a PDU doesn't cost an allocation in steady state */
+#define FC_QE_SLAB_SIZE		64
+static LLIST_HEAD(fc_qe_pool);
 
-static void fc_timer_cb(void *data)
+/* the bucket level is kept in 10^-6 octets, so that leaking R octets/s
+ * for a number of microseconds doesn't need any rounding */
+#define FC_UNIT			1000000ULL
+
+static struct bssgp_fc_queue_element *fc_qe_alloc(void)
 {
-	struct bssgp_flow_control *fc = data;
 	struct bssgp_fc_queue_element *fcqe;
-	struct timeval time_now;
-
-	/* if the queue is empty, we return without sending something
-	 * and without re-starting the timer */
-	if (llist_empty(&fc->queue))
-		return;
+	int i;
+
+	if (llist_empty(&fc_qe_pool)) {
+		fcqe = talloc_array(bssgp_tall_ctx,
+				    struct bssgp_fc_queue_element,
+				    FC_QE_SLAB_SIZE);
+		if (!fcqe)
+			return NULL;
+		for (i = 0; i < FC_QE_SLAB_SIZE; i++)
+			llist_add_tail(&fcqe[i].list, &fc_qe_pool);
+	}
 
-	/* get the first entry from the queue */
-	fcqe = llist_entry(fc->queue.next, struct bssgp_fc_queue_element,
+	fcqe = llist_entry(fc_qe_pool.next, struct bssgp_fc_queue_element,
 			   list);
+	llist_del(&fcqe->list);
+	return fcqe;
+}
 
-	if (bssgp_fc_needs_queueing(fc, fcqe->llc_pdu_len)) {
-		LOGP(DBSSGP, LOGL_NOTICE, "BSSGP-FC: fc_timer_cb() but still "
-			"not able to send PDU of %u bytes\n", fcqe->llc_pdu_len);
-		/* make sure we re-start the timer */
-		fc_queue_timer_cfg(fc);
-		return;
-	}
+static void fc_qe_free(struct bssgp_fc_queue_element *fcqe)
+{
+	/* LIFO, the most recently used element is still in the cache */
+	llist_add(&fcqe->list, &fc_qe_pool);
+}
 
-	/* remove from the queue */
-	llist_del(&fcqe->list);
+/* monotonic time in microseconds as sampled by the select loop, the
+ * time base of the FC timer */
+static uint64_t fc_now(void)
+{
+	struct timeval tv;
 
-	fc->queue_depth--;
+	osmo_clock_now_cached(&tv);
+	return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
 
-	/* record the time we transmitted this PDU */
-	gettimeofday(&time_now, NULL);
-	fc->time_last_pdu = time_now;
+/* leak the bucket for the time elapsed since the last leak, (Tc - Tp)*R
+ * of Section 8.2 */
+static void fc_leak(struct bssgp_flow_control *fc, uint64_t now)
+{
+	uint64_t elapsed;
 
-	/* call the output callback for this FC instance */
-	fc->out_cb(fcqe->priv, fcqe->msg, fcqe->llc_pdu_len, NULL);
+	if (now <= fc->time_last_leak)
+		return;
+	elapsed = now - fc->time_last_leak;
+	fc->time_last_leak = now;
 
-	/* we expect that out_cb will in the end free the msgb once
-	 * it is no longer needed */
+	if (fc->bucket_leak_rate == 0)
+		return;
 
-	/* but we have to free the queue element ourselves */
-	talloc_free(fcqe);
+	/* elapsed * R would overflow long before the bucket is empty */
+	if (elapsed > fc->bucket_level / fc->bucket_leak_rate)
+		fc->bucket_level = 0;
+	else
+		fc->bucket_level -= elapsed * fc->bucket_leak_rate;
 
-	/* re-configure the timer for the next PDU */
-	fc_queue_timer_cfg(fc);
+	fc->bucket_counter = (fc->bucket_level + FC_UNIT - 1) / FC_UNIT;
+}
+
+/* B' = B + L(p) <= Bmax, with B already leaked up to now */
+static int fc_pdu_fits(const struct bssgp_flow_control *fc, uint32_t pdu_len)
+{
+	return fc->bucket_level + pdu_len * FC_UNIT <=
+		fc->bucket_size_max * FC_UNIT;
+}
+
+static void fc_pdu_pass(struct bssgp_flow_control *fc, uint32_t pdu_len)
+{
+	fc->bucket_level += pdu_len * FC_UNIT;
+	fc->bucket_counter = (fc->bucket_level + FC_UNIT - 1) / FC_UNIT;
 }
 
 /* configure/schedule the flow control timer to expire once the bucket
@@ -625,32 +627,81 @@ static void fc_timer_cb(void *data)
 static int fc_queue_timer_cfg(struct bssgp_flow_control *fc)
 {
 	struct bssgp_fc_queue_element *fcqe;
-	uint32_t msecs;
+	uint64_t excess, usecs;
 
-	if (llist_empty(&fc->queue))
+	if (llist_empty(&fc->queue) || fc->bucket_leak_rate == 0) {
+		/* If the PCU is telling us to not send any more data at
+		 * all, there's no point starting a timer. */
+		osmo_timer_del(&fc->timer);
 		return 0;
+	}
 
 	fcqe = llist_entry(fc->queue.next, struct bssgp_fc_queue_element,
 			   list);
 
-	if (fc->bucket_leak_rate != 0) {
-		/* Calculate the point in time at which we will have leaked
-		 * a sufficient number of bytes from the bucket to transmit
-		 * the first PDU in the queue */
-		msecs = (fcqe->llc_pdu_len * 1000) / fc->bucket_leak_rate;
-		/* FIXME: add that time to fc->time_last_pdu and subtract it from
-		 * current time */
-		fc->timer.data = fc;
-		fc->timer.cb = &fc_timer_cb;
-		osmo_timer_schedule(&fc->timer, msecs / 1000, (msecs % 1000) * 1000);
-	} else {
-		/* If the PCU is telling us to not send any more data at all,
-		* there's no point starting a timer. */
-	}
+	/* Calculate the point in time at which we will have leaked a
+	 * sufficient number of bytes from the bucket to transmit the
+	 * first PDU in the queue, counting from now rather than from
+	 * the last transmission */
+	fc_leak(fc, fc_now());
+	excess = fc->bucket_level + fcqe->llc_pdu_len * FC_UNIT;
+	if (excess > fc->bucket_size_max * FC_UNIT)
+		excess -= fc->bucket_size_max * FC_UNIT;
+	else
+		excess = 0;
+	usecs = (excess + fc->bucket_leak_rate - 1) / fc->bucket_leak_rate;
+
+	osmo_timer_schedule(&fc->timer, usecs / 1000000, usecs % 1000000);
 
 	return 0;
 }
 
+static void fc_timer_cb(void *data)
+{
+	struct bssgp_flow_control *fc = data;
+	struct bssgp_fc_queue_element *fcqe;
+
+	fc_leak(fc, fc_now());
+
+	/* transmit all PDUs from the head of the queue that fit into the
+	 * bucket, not just one per timer expiration */
+	while (!llist_empty(&fc->queue)) {
+		fcqe = llist_entry(fc->queue.next,
+				   struct bssgp_fc_queue_element, list);
+
+		if (fcqe->llc_pdu_len > fc->bucket_size_max) {
+			/* the bucket was shrunk after we enqueued it */
+			LOGP(DBSSGP, LOGL_NOTICE, "BSSGP-FC: dropping queued "
+			     "PDU (size=%u) larger than maximum bucket size "
+			     "(%u)\n", fcqe->llc_pdu_len, fc->bucket_size_max);
+			llist_del(&fcqe->list);
+			fc->queue_depth--;
+			msgb_free(fcqe->msg);
+			fc_qe_free(fcqe);
+			continue;
+		}
+
+		if (!fc_pdu_fits(fc, fcqe->llc_pdu_len))
+			break;
+
+		/* remove from the queue */
+		llist_del(&fcqe->list);
+		fc->queue_depth--;
+		fc_pdu_pass(fc, fcqe->llc_pdu_len);
+
+		/* call the output callback for this FC instance, we
+		 * expect that out_cb will in the end free the msgb once
+		 * it is no longer needed */
+		fc->out_cb(fcqe->priv, fcqe->msg, fcqe->llc_pdu_len, NULL);
+
+		/* but we have to release the queue element ourselves */
+		fc_qe_free(fcqe);
+	}
+
+	/* re-configure the timer for the next PDU */
+	fc_queue_timer_cfg(fc);
+}
+
 /* Enqueue a PDU in the flow control queue for delayed transmission */
 static int fc_enqueue(struct bssgp_flow_control *fc, struct msgb *msg,
 		      uint32_t llc_pdu_len, void *priv)
@@ -660,7 +711,7 @@ static int fc_enqueue(struct bssgp_flow_control *fc, struct msgb *msg,
 	if (fc->queue_depth >= fc->max_queue_depth)
 		return -ENOSPC;
 
-	fcqe = talloc_zero(fc, struct bssgp_fc_queue_element);
+	fcqe = fc_qe_alloc();
 	if (!fcqe)
 		return -ENOMEM;
 	fcqe->msg = msg;
@@ -669,54 +720,10 @@ static int fc_enqueue(struct bssgp_flow_control *fc, struct msgb *msg,
 
 	llist_add_tail(&fcqe->list, &fc->queue);
 
-	fc->queue_depth++;
-
-	/* re-configure the timer for dequeueing the pdu */
-	fc_queue_timer_cfg(fc);
-
-	return 0;
-}
-
-/* According to Section 8.2 */
-static int bssgp_fc_needs_queueing(struct bssgp_flow_control *fc, uint32_t pdu_len)
-{
-	struct timeval time_now, time_diff;
-	int64_t bucket_predicted;
-	uint32_t csecs_elapsed, leaked;
-
-	/* B' = B + L(p) - (Tc - Tp)*R */
-
-	/* compute number of centi-seconds that have elapsed since transmitting
-	 * the last PDU (Tc - Tp) */
-	gettimeofday(&time_now, NULL);
-	timersub(&time_now, &fc->time_last_pdu, &time_diff);
-	csecs_elapsed = time_diff.tv_sec*100 + time_diff.tv_usec/10000;
-
-	/* compute number of bytes that have leaked in the elapsed number
-	 * of centi-seconds */
-	leaked = csecs_elapsed * (fc->bucket_leak_rate / 100);
-	/* add the current PDU length to the last bucket level */
-	bucket_predicted = fc->bucket_counter + pdu_len;
-	/* ... and subtract the number of leaked bytes */
-	bucket_predicted -= leaked;
-
-	if (bucket_predicted < pdu_len) {
-		/* this is just to make sure the bucket doesn't underflow */
-		bucket_predicted = pdu_len;
-		goto pass;
-	}
-
-	if (bucket_predicted <= fc->bucket_size_max) {
-		/* the bucket is not full yet, we can pass the packet */
-		fc->bucket_counter = bucket_predicted;
-		goto pass;
-	}
-
-	/* bucket is full, PDU needs to be delayed */
-	return 1;
+	/* the timer only depends on the head of the queue */
+	if (fc->queue_depth++ == 0)
+		fc_queue_timer_cfg(fc);
 
-pass:
-	/* if we reach here, the PDU can pass */
 	return 0;
 }
 
@@ -733,8 +740,6 @@ static int _bssgp_tx_dl_ud(struct bssgp_flow_control *fc, struct msgb *msg,
 int bssgp_fc_in(struct bssgp_flow_control *fc, struct msgb *msg,
 		uint32_t llc_pdu_len, void *priv)
 {
-	struct timeval time_now;
-
 	if (llc_pdu_len > fc->bucket_size_max) {
 		LOGP(DBSSGP, LOGL_NOTICE, "Single PDU (size=%u) is larger "
 		     "than maximum bucket size (%u)!\n", llc_pdu_len,
@@ -743,18 +748,30 @@ int bssgp_fc_in(struct bssgp_flow_control *fc, struct msgb *msg,
 		return -EIO;
 	}
 
-	if (bssgp_fc_needs_queueing(fc, llc_pdu_len)) {
+	/* don't overtake PDUs that are already waiting */
+	if (!llist_empty(&fc->queue))
 		return fc_enqueue(fc, msg, llc_pdu_len, priv);
-	} else {
-		/* record the time we transmitted this PDU */
-		gettimeofday(&time_now, NULL);
-		fc->time_last_pdu = time_now;
-		return fc->out_cb(priv, msg, llc_pdu_len, NULL);
-	}
+
+	/* According to Section 8.2 */
+	fc_leak(fc, fc_now());
+	if (!fc_pdu_fits(fc, llc_pdu_len))
+		return fc_enqueue(fc, msg, llc_pdu_len, priv);
+
+	fc_pdu_pass(fc, llc_pdu_len);
+	return fc->out_cb(priv, msg, llc_pdu_len, NULL);
 }
 
 
-/* Initialize the Flow Control structure */
+/* queue elements aren't talloc children of the FC, so drop them and
+ * stop the timer before the FC goes away */
+static int fc_talloc_destructor(struct bssgp_flow_control *fc)
+{
+	bssgp_fc_flush_queue(fc);
+	return 0;
+}
+
+/* Initialize the Flow Control structure.  fc must be allocated by
+ * talloc, its queue is flushed when it is freed */
 void bssgp_fc_init(struct bssgp_flow_control *fc,
 		   uint32_t bucket_size_max, uint32_t bucket_leak_rate,
 		   uint32_t max_queue_depth,
@@ -765,8 +782,33 @@ void bssgp_fc_init(struct bssgp_flow_control *fc,
 	fc->bucket_size_max = bucket_size_max;
 	fc->bucket_leak_rate = bucket_leak_rate;
 	fc->max_queue_depth = max_queue_depth;
+	fc->bucket_counter = 0;
+	fc->bucket_level = 0;
+	fc->time_last_leak = fc_now();
 	INIT_LLIST_HEAD(&fc->queue);
-	gettimeofday(&fc->time_last_pdu, NULL);
+	fc->timer.cb = &fc_timer_cb;
+	fc->timer.data = fc;
+	talloc_set_destructor(fc, fc_talloc_destructor);
+}
+
+/*! \brief Drop all PDUs queued in a flow control instance
+ *  \param[in] fc flow control instance
+ *
+ * The queued msgbs are freed and their queue elements are returned to
+ * the pool.  This is done automatically when a flow control instance
+ * set up by \ref bssgp_fc_init is freed.
+ */
+void bssgp_fc_flush_queue(struct bssgp_flow_control *fc)
+{
+	struct bssgp_fc_queue_element *fcqe, *tmp;
+
+	osmo_timer_del(&fc->timer);
+	llist_for_each_entry_safe(fcqe, tmp, &fc->queue, list) {
+		llist_del(&fcqe->list);
+		msgb_free(fcqe->msg);
+		fc_qe_free(fcqe);
+	}
+	fc->queue_depth = 0;
 }
 
 /* Initialize the Flow Control parameters for a new MS according to
@@ -796,15 +838,8 @@ static int bssgp_rx_fc_bvc(struct msgb *msg, struct tlv_parsed *tp,
 	DEBUGP(DBSSGP, "BSSGP BVCI=%u Rx Flow Control BVC\n",
 		bctx->bvci);
 
-	if (!TLVP_PRESENT(tp, BSSGP_IE_TAG) ||
-	    !TLVP_PRESENT(tp, BSSGP_IE_BVC_BUCKET_SIZE) ||
-	    !TLVP_PRESENT(tp, BSSGP_IE_BUCKET_LEAK_RATE) ||
-	    !TLVP_PRESENT(tp, BSSGP_IE_BMAX_DEFAULT_MS) ||
-	    !TLVP_PRESENT(tp, BSSGP_IE_R_DEFAULT_MS)) {
-		LOGP(DBSSGP, LOGL_ERROR, "BSSGP BVCI=%u Rx FC BVC "
-			"missing mandatory IE\n", bctx->bvci);
-		return bssgp_tx_status(BSSGP_CAUSE_MISSING_MAND_IE, NULL, msg);
-	}
+	/* the bucket has leaked at the old rate until now */
+	fc_leak(bctx->fc, fc_now());
 
 	/* 11.3.5 Bucket Size in 100 octets unit */
 	bctx->fc->bucket_size_max = 100 *
@@ -958,31 +993,14 @@ static int bssgp_rx_sign(struct msgb *msg, struct tlv_parsed *tp,
 		break;
 	case BSSGP_PDUT_BVC_BLOCK:
 		/* BSS tells us that BVC shall be blocked */
-		if (!TLVP_PRESENT(tp, BSSGP_IE_BVCI) ||
-		    !TLVP_PRESENT(tp, BSSGP_IE_CAUSE)) {
-			LOGP(DBSSGP, LOGL_ERROR, "BSSGP Rx BVC-BLOCK "
-				"missing mandatory IE\n");
-			goto err_mand_ie;
-		}
 		rc = bssgp_rx_bvc_block(msg, tp);
 		break;
 	case BSSGP_PDUT_BVC_UNBLOCK:
 		/* BSS tells us that BVC shall be unblocked */
-		if (!TLVP_PRESENT(tp, BSSGP_IE_BVCI)) {
-			LOGP(DBSSGP, LOGL_ERROR, "BSSGP Rx BVC-UNBLOCK "
-				"missing mandatory IE\n");
-			goto err_mand_ie;
-		}
 		rc = bssgp_rx_bvc_unblock(msg, tp);
 		break;
 	case BSSGP_PDUT_BVC_RESET:
 		/* BSS tells us that BVC init is required */
-		if (!TLVP_PRESENT(tp, BSSGP_IE_BVCI) ||
-		    !TLVP_PRESENT(tp, BSSGP_IE_CAUSE)) {
-			LOGP(DBSSGP, LOGL_ERROR, "BSSGP Rx BVC-RESET "
-				"missing mandatory IE\n");
-			goto err_mand_ie;
-		}
 		rc = bssgp_rx_bvc_reset(msg, tp, ns_bvci);
 		break;
 	case BSSGP_PDUT_STATUS:
@@ -1016,6 +1034,42 @@ err_mand_ie:
 	return bssgp_tx_status(BSSGP_CAUSE_MISSING_MAND_IE, NULL, msg);
 }
 
+/* IEs of the PDUs received by the SGSN, 3GPP TS 08.18 Chapter 10 */
+static const struct tlv_msg_def bssgp_msg_defs[] = {
+	TLV_MSG_DEF(BSSGP_PDUT_UL_UNITDATA, TLV_IE_M(BSSGP_IE_CELL_ID, 8),
+		    TLV_IE_M(BSSGP_IE_LLC_PDU, 0)),
+	TLV_MSG_DEF(BSSGP_PDUT_SUSPEND, TLV_IE_M(BSSGP_IE_TLLI, 4),
+		    TLV_IE_M(BSSGP_IE_ROUTEING_AREA, 6)),
+	TLV_MSG_DEF(BSSGP_PDUT_RESUME, TLV_IE_M(BSSGP_IE_TLLI, 4),
+		    TLV_IE_M(BSSGP_IE_ROUTEING_AREA, 6),
+		    TLV_IE_M(BSSGP_IE_SUSPEND_REF_NR, 1)),
+	TLV_MSG_DEF(BSSGP_PDUT_BVC_BLOCK, TLV_IE_M(BSSGP_IE_BVCI, 2),
+		    TLV_IE_M(BSSGP_IE_CAUSE, 1)),
+	TLV_MSG_DEF(BSSGP_PDUT_BVC_RESET, TLV_IE_M(BSSGP_IE_BVCI, 2),
+		    TLV_IE_M(BSSGP_IE_CAUSE, 1),
+		    TLV_IE_O(BSSGP_IE_CELL_ID, 8)),
+	TLV_MSG_DEF(BSSGP_PDUT_BVC_UNBLOCK, TLV_IE_M(BSSGP_IE_BVCI, 2)),
+	TLV_MSG_DEF(BSSGP_PDUT_FLOW_CONTROL_BVC, TLV_IE_M(BSSGP_IE_TAG, 1),
+		    TLV_IE_M(BSSGP_IE_BVC_BUCKET_SIZE, 2),
+		    TLV_IE_M(BSSGP_IE_BUCKET_LEAK_RATE, 2),
+		    TLV_IE_M(BSSGP_IE_BMAX_DEFAULT_MS, 2),
+		    TLV_IE_M(BSSGP_IE_R_DEFAULT_MS, 2)),
+	TLV_MSG_DEF(BSSGP_PDUT_LLC_DISCARD, TLV_IE_M(BSSGP_IE_TLLI, 4),
+		    TLV_IE_M(BSSGP_IE_LLC_FRAMES_DISCARDED, 1),
+		    TLV_IE_M(BSSGP_IE_BVCI, 2),
+		    TLV_IE_M(BSSGP_IE_NUM_OCT_AFF, 3)),
+	TLV_MSG_DEF(BSSGP_PDUT_STATUS, TLV_IE_M(BSSGP_IE_CAUSE, 1),
+		    TLV_IE_O(BSSGP_IE_BVCI, 2)),
+};
+
+static const struct tlv_compiled_def *bssgp_tlvdef_compiled(void)
+{
+	static struct tlv_compiled_once once =
+		TLV_COMPILED_ONCE(&tvlv_att_def, bssgp_msg_defs);
+
+	return tlv_compiled_get(&once);
+}
+
 /* We expect msgb_bssgph() to point to the BSSGP header */
 int bssgp_rcvmsg(struct msgb *msg)
 {
@@ -1027,8 +1081,9 @@ int bssgp_rcvmsg(struct msgb *msg)
 	uint8_t pdu_type = bgph->pdu_type;
 	uint16_t ns_bvci = msgb_bvci(msg);
 	uint16_t bvci = ns_bvci;
+	uint8_t err_tag = 0;
 	int data_len;
-	int rc = 0;
+	int dec_rc, rc = 0;
 
 	/* Identifiers from DOWN: NSEI, BVCI (both in msg->cb) */
 
@@ -1036,13 +1091,15 @@ int bssgp_rcvmsg(struct msgb *msg)
 	if (pdu_type != BSSGP_PDUT_UL_UNITDATA &&
 	    pdu_type != BSSGP_PDUT_DL_UNITDATA) {
 		data_len = msgb_bssgp_len(msg) - sizeof(*bgph);
-		rc = bssgp_tlv_parse(&tp, bgph->data, data_len);
+		dec_rc = tlv_decode_dense(&tp, bssgp_tlvdef_compiled(), pdu_type,
+					  bgph->data, data_len, &err_tag);
 	} else {
 		data_len = msgb_bssgp_len(msg) - sizeof(*budh);
-		rc = bssgp_tlv_parse(&tp, budh->data, data_len);
+		dec_rc = tlv_decode_dense(&tp, bssgp_tlvdef_compiled(), pdu_type,
+					  budh->data, data_len, &err_tag);
 	}
 
-	if (bvci == BVCI_SIGNALLING && TLVP_PRESENT(&tp, BSSGP_IE_BVCI))
+	if (bvci == BVCI_SIGNALLING && TLVP_PRES_LEN(&tp, BSSGP_IE_BVCI, 2))
 		bvci = ntohs(*(uint16_t *)TLVP_VAL(&tp, BSSGP_IE_BVCI));
 
 	/* look-up or create the BTS context for this BVC */
@@ -1071,6 +1128,25 @@ int bssgp_rcvmsg(struct msgb *msg)
 		return bssgp_tx_status(BSSGP_CAUSE_UNKNOWN_BVCI, &bvci, msg);
 	}
 
+	if (dec_rc < 0) {
+		LOGP(DBSSGP, LOGL_ERROR, "NSEI=%u/BVCI=%u Rx PDU type %u: "
+			"%s IE 0x%02x\n", msgb_nsei(msg), bvci, pdu_type,
+			dec_rc == TLV_DEC_ERR_MISSING_IE ? "missing mandatory" :
+			dec_rc == TLV_DEC_ERR_SHORT_IE ? "too short" :
+			"cannot parse", err_tag);
+		switch (dec_rc) {
+		case TLV_DEC_ERR_MISSING_IE:
+			return bssgp_tx_status(BSSGP_CAUSE_MISSING_MAND_IE,
+					       NULL, msg);
+		case TLV_DEC_ERR_SHORT_IE:
+			return bssgp_tx_status(BSSGP_CAUSE_INV_MAND_INF,
+					       NULL, msg);
+		default:
+			return bssgp_tx_status(BSSGP_CAUSE_PROTO_ERR_UNSPEC,
+					       NULL, msg);
+		}
+	}
+
 	if (ns_bvci == BVCI_SIGNALLING)
 		rc = bssgp_rx_sign(msg, &tp, bctx);
 	else if (ns_bvci == BVCI_PTM)
@@ -1086,6 +1162,29 @@ int bssgp_rcvmsg(struct msgb *msg)
 	return rc;
 }
 
+/* room for the NS-UNITDATA and FR/GRE headers in front of BSSGP */
+#define BSSGP_NS_HEADROOM	16
+
+/* If \a msg lacks the headroom for \a len bytes of headers, put them
+ * into a new msgb and chain \a msg behind it instead of copying it */
+static struct msgb *bssgp_chain_headroom(struct msgb *msg, unsigned int len)
+{
+	struct msgb *head;
+
+	len += BSSGP_NS_HEADROOM;
+	if (msgb_headroom(msg) >= len)
+		return msg;
+
+	head = msgb_alloc(len, "BSSGP");
+	if (!head)
+		return NULL;
+	msgb_reserve(head, len);
+	memcpy(head->cb, msg->cb, sizeof(head->cb));
+	msgb_frag_append(head, msg);
+
+	return head;
+}
+
 int bssgp_tx_dl_ud(struct msgb *msg, uint16_t pdu_lifetime,
 		   struct bssgp_dl_ud_par *dup)
 {
@@ -1093,11 +1192,15 @@ int bssgp_tx_dl_ud(struct msgb *msg, uint16_t pdu_lifetime,
 	struct bssgp_ud_hdr *budh;
 	uint8_t llc_pdu_tlv_hdr_len = 2;
 	uint8_t *llc_pdu_tlv;
-	uint16_t msg_len = msg->len;
+	uint16_t msg_len = msgb_chain_len(msg);
 	uint16_t bvci = msgb_bvci(msg);
 	uint16_t nsei = msgb_nsei(msg);
 	uint16_t _pdu_lifetime = htons(pdu_lifetime); /* centi-seconds */
 	uint16_t drx_params;
+	uint8_t mi[10];
+	int imsi_len = 0;
+	unsigned int hdr_len;
+	struct msgb *head;
 
 	OSMO_ASSERT(dup != NULL);
 
@@ -1117,9 +1220,27 @@ int bssgp_tx_dl_ud(struct msgb *msg, uint16_t pdu_lifetime,
 		return -ENODEV;
 	}
 
-	if (msg->len > TVLV_MAX_ONEBYTE)
+	if (msg_len > TVLV_MAX_ONEBYTE)
 		llc_pdu_tlv_hdr_len += 1;
 
+	if (dup->imsi && strlen(dup->imsi))
+		imsi_len = gsm48_generate_mid_from_imsi(mi, dup->imsi);
+
+	/* a LLC-PDU without enough headroom is not copied but chained */
+	hdr_len = llc_pdu_tlv_hdr_len + TVLV_GROSS_LEN(2) * 2 + sizeof(*budh);
+	if (dup->tlli)
+		hdr_len += TVLV_GROSS_LEN(4);
+	if (imsi_len > 2)
+		hdr_len += TVLV_GROSS_LEN(imsi_len - 2);
+	if (dup->ms_ra_cap.len)
+		hdr_len += TVLV_GROSS_LEN(dup->ms_ra_cap.len);
+	head = bssgp_chain_headroom(msg, hdr_len);
+	if (!head) {
+		msgb_free(msg);
+		return -ENOMEM;
+	}
+	msg = head;
+
 	/* prepend the tag and length of the LLC-PDU TLV */
 	llc_pdu_tlv = msgb_push(msg, llc_pdu_tlv_hdr_len);
 	llc_pdu_tlv[0] = BSSGP_IE_LLC_PDU;
@@ -1140,13 +1261,8 @@ int bssgp_tx_dl_ud(struct msgb *msg, uint16_t pdu_lifetime,
 	}
 
 	/* IMSI */
-	if (dup->imsi && strlen(dup->imsi)) {
-		uint8_t mi[10];
-		int imsi_len = gsm48_generate_mid_from_imsi(mi, dup->imsi);
-		if (imsi_len > 2)
-			msgb_tvlv_push(msg, BSSGP_IE_IMSI,
-				imsi_len-2, mi+2);
-	}
+	if (imsi_len > 2)
+		msgb_tvlv_push(msg, BSSGP_IE_IMSI, imsi_len-2, mi+2);
 
 	/* DRX parameters */
 	drx_params = htons(dup->drx_parms);
@@ -1170,7 +1286,7 @@ int bssgp_tx_dl_ud(struct msgb *msg, uint16_t pdu_lifetime,
 	budh->pdu_type = BSSGP_PDUT_DL_UNITDATA;
 
 	rate_ctr_inc(&bctx->ctrg->ctr[BSSGP_CTR_PKTS_OUT]);
-	rate_ctr_add(&bctx->ctrg->ctr[BSSGP_CTR_BYTES_OUT], msg->len);
+	rate_ctr_add(&bctx->ctrg->ctr[BSSGP_CTR_BYTES_OUT], msgb_chain_len(msg));
 
 	/* Identifiers down: BVCI, NSEI (in msgb->cb) */
 
@@ -61,10 +61,14 @@
  *  o There are no BLOCK and UNBLOCK timers (yet?)
  */
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
 #include <stdint.h>
+#include <string.h>
+
+#include "../../config.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -85,6 +89,12 @@
 
 #include "common_vty.h"
 
+/* batched NS-over-IP I/O using recvmmsg()/sendmmsg() */
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+#define NSIP_MMSG
+static void nsip_mmsg_free(struct gprs_ns_inst *nsi);
+#endif
+
 static const struct tlv_definition ns_att_tlvdef = {
 	.def = {
 		[NS_IE_CAUSE]	= { TLV_TYPE_TvLV, 0 },
@@ -95,6 +105,42 @@ static const struct tlv_definition ns_att_tlvdef = {
 	},
 };
 
+/* IEs of the NS signalling PDUs, 3GPP TS 08.16 Chapter 9.2 */
+static const struct tlv_msg_def ns_msg_defs[] = {
+	TLV_MSG_DEF(NS_PDUT_RESET, TLV_IE_M(NS_IE_CAUSE, 1),
+		    TLV_IE_M(NS_IE_VCI, 2), TLV_IE_M(NS_IE_NSEI, 2)),
+	TLV_MSG_DEF(NS_PDUT_RESET_ACK, TLV_IE_M(NS_IE_VCI, 2),
+		    TLV_IE_M(NS_IE_NSEI, 2)),
+	TLV_MSG_DEF(NS_PDUT_BLOCK, TLV_IE_M(NS_IE_CAUSE, 1),
+		    TLV_IE_M(NS_IE_VCI, 2)),
+	TLV_MSG_DEF(NS_PDUT_BLOCK_ACK, TLV_IE_M(NS_IE_VCI, 2)),
+	TLV_MSG_DEF(NS_PDUT_STATUS, TLV_IE_M(NS_IE_CAUSE, 1),
+		    TLV_IE_O(NS_IE_VCI, 2), TLV_IE_O(NS_IE_PDU, 0),
+		    TLV_IE_O(NS_IE_BVCI, 2)),
+};
+
+/* parse and validate the IEs of the NS signalling PDU in msg */
+static int ns_tlv_decode(struct tlv_parsed_sparse *tp, struct msgb *msg)
+{
+	struct gprs_ns_hdr *nsh = (struct gprs_ns_hdr *) msg->l2h;
+	static struct tlv_compiled_once once =
+		TLV_COMPILED_ONCE(&ns_att_tlvdef, ns_msg_defs);
+
+	return tlv_decode(tp, tlv_compiled_get(&once), nsh->pdu_type,
+			  nsh->data, msgb_l2len(msg) - sizeof(*nsh), NULL);
+}
+
+/* NS STATUS cause for a missing or invalid mandatory IE */
+static inline uint8_t ns_ie_err_cause(int rc)
+{
+	return rc == TLV_DEC_ERR_SHORT_IE ? NS_CAUSE_INVAL_ESSENT_IE :
+					    NS_CAUSE_MISSING_ESSENT_IE;
+}
+
+/* TLV decoder error for a missing or too short mandatory IE */
+#define NS_IE_ERR(rc) \
+	((rc) == TLV_DEC_ERR_MISSING_IE || (rc) == TLV_DEC_ERR_SHORT_IE)
+
 enum ns_ctr {
 	NS_CTR_PKTS_IN,
 	NS_CTR_PKTS_OUT,
@@ -166,6 +212,204 @@ struct msgb *gprs_ns_msgb_alloc(void)
 }
 
 
+/* Hash tables indexing the NS-VCs of an instance by NSVCI, NSEI and
+ * remote address.  Keys may be shared (e.g. after gprs_ns_ll_clear()),
+ * so buckets are lists and lookups compare the full key. */
+#define NS_HASH_BITS	10
+#define NS_HASH_SIZE	(1 << NS_HASH_BITS)
+
+/*! \brief NS Entity: all NS-VCs of one NSEI */
+struct gprs_nse {
+	/*! \brief entry in the NSEI hash bucket */
+	struct llist_head list;
+	uint16_t nsei;
+	/*! \brief all NS-VCs of this NSE, most recently added first */
+	struct llist_head nsvcs;
+	/*! \brief NS-VCs that are ALIVE and not BLOCKED */
+	struct gprs_nsvc **active;
+	unsigned int num_active;
+	unsigned int active_size;
+};
+
+struct gprs_ns_lookup {
+	struct llist_head nsvci[NS_HASH_SIZE];
+	struct llist_head nse[NS_HASH_SIZE];
+	struct llist_head addr[NS_HASH_SIZE];
+};
+
+static inline unsigned int ns_hash(uint32_t key)
+{
+	return (key * 2654435761U) >> (32 - NS_HASH_BITS);
+}
+
+static inline unsigned int ns_hash_addr(const struct sockaddr_in *sin)
+{
+	return ns_hash(sin->sin_addr.s_addr ^ (sin->sin_port * 0x10001U));
+}
+
+static struct gprs_ns_lookup *ns_lookup_alloc(void *ctx)
+{
+	struct gprs_ns_lookup *lu = talloc(ctx, struct gprs_ns_lookup);
+	unsigned int i;
+
+	if (!lu)
+		return NULL;
+
+	for (i = 0; i < NS_HASH_SIZE; i++) {
+		INIT_LLIST_HEAD(&lu->nsvci[i]);
+		INIT_LLIST_HEAD(&lu->nse[i]);
+		INIT_LLIST_HEAD(&lu->addr[i]);
+	}
+	return lu;
+}
+
+static struct gprs_nse *nse_by_nsei(struct gprs_ns_inst *nsi, uint16_t nsei)
+{
+	struct gprs_nse *nse;
+
+	llist_for_each_entry(nse, &nsi->lookup->nse[ns_hash(nsei)], list) {
+		if (nse->nsei == nsei)
+			return nse;
+	}
+	return NULL;
+}
+
+static inline int nsvc_is_usable(const struct gprs_nsvc *nsvc)
+{
+	return !(nsvc->state & NSE_S_BLOCKED) && (nsvc->state & NSE_S_ALIVE);
+}
+
+static void nse_del_active(struct gprs_nse *nse, struct gprs_nsvc *nsvc)
+{
+	struct gprs_nsvc *last = nse->active[--nse->num_active];
+
+	nse->active[nsvc->active_idx] = last;
+	last->active_idx = nsvc->active_idx;
+	nsvc->active_idx = -1;
+}
+
+/* add/remove the NS-VC to/from the list of usable NS-VCs of its NSE */
+static void nsvc_update_active(struct gprs_nsvc *nsvc)
+{
+	struct gprs_nse *nse = nsvc->nse;
+	int usable = nse && nsvc_is_usable(nsvc);
+
+	if (usable && nsvc->active_idx < 0) {
+		if (nse->num_active == nse->active_size) {
+			unsigned int size = nse->active_size ? nse->active_size * 2 : 4;
+			struct gprs_nsvc **a;
+
+			a = talloc_realloc(nse, nse->active, struct gprs_nsvc *, size);
+			if (!a) {
+				/* the old array is still valid, and the
+				 * next state change retries */
+				LOGP(DNS, LOGL_ERROR, "NSEI=%u NSVCI=%u is "
+				     "usable but not used for traffic, out of "
+				     "memory\n", nsvc->nsei, nsvc->nsvci);
+				return;
+			}
+			nse->active = a;
+			nse->active_size = size;
+		}
+		nsvc->active_idx = nse->num_active;
+		nse->active[nse->num_active++] = nsvc;
+	} else if (!usable && nsvc->active_idx >= 0)
+		nse_del_active(nse, nsvc);
+}
+
+/* nsvc->state must only be changed here, as the list of usable NS-VCs of
+ * the NSE has to follow it */
+static void nsvc_set_state(struct gprs_nsvc *nsvc, uint32_t state)
+{
+	nsvc->state = state;
+	nsvc_update_active(nsvc);
+}
+
+static int nse_join(struct gprs_nsvc *nsvc)
+{
+	struct gprs_ns_inst *nsi = nsvc->nsi;
+	struct gprs_nse *nse;
+
+	nse = nse_by_nsei(nsi, nsvc->nsei);
+	if (!nse) {
+		nse = talloc_zero(nsi->lookup, struct gprs_nse);
+		if (!nse)
+			return -ENOMEM;
+		nse->nsei = nsvc->nsei;
+		INIT_LLIST_HEAD(&nse->nsvcs);
+		llist_add(&nse->list, &nsi->lookup->nse[ns_hash(nse->nsei)]);
+	}
+
+	nsvc->nse = nse;
+	llist_add(&nsvc->nse_entry, &nse->nsvcs);
+	nsvc_update_active(nsvc);
+	return 0;
+}
+
+static void nse_leave(struct gprs_nsvc *nsvc)
+{
+	struct gprs_nse *nse = nsvc->nse;
+
+	if (nsvc->active_idx >= 0)
+		nse_del_active(nse, nsvc);
+	llist_del(&nsvc->nse_entry);
+	nsvc->nse = NULL;
+
+	if (llist_empty(&nse->nsvcs)) {
+		llist_del(&nse->list);
+		talloc_free(nse);
+	}
+}
+
+static void nsvc_index_add(struct gprs_nsvc *nsvc)
+{
+	struct gprs_ns_lookup *lu = nsvc->nsi->lookup;
+
+	if (nse_join(nsvc) < 0)
+		return;
+	llist_add(&nsvc->nsvci_entry, &lu->nsvci[ns_hash(nsvc->nsvci)]);
+	llist_add(&nsvc->addr_entry, &lu->addr[ns_hash_addr(&nsvc->ip.bts_addr)]);
+}
+
+static void nsvc_index_del(struct gprs_nsvc *nsvc)
+{
+	if (!nsvc->nse)
+		return;
+
+	llist_del(&nsvc->nsvci_entry);
+	llist_del(&nsvc->addr_entry);
+	nse_leave(nsvc);
+}
+
+/*! \brief Update the lookup tables after changing NSEI, NSVCI or address
+ *  \param[in] nsvc NS-VC whose nsei, nsvci or link layer address changed
+ *
+ * The NS instance indexes its NS-VCs by NSVCI, NSEI and remote address.
+ * Any code modifying one of those fields directly must call this
+ * function afterwards, otherwise the lookup functions will not find the
+ * NS-VC under its new identity.
+ */
+void gprs_nsvc_rehash(struct gprs_nsvc *nsvc)
+{
+	struct gprs_ns_lookup *lu = nsvc->nsi->lookup;
+
+	if (!nsvc->nse)
+		return;
+
+	llist_del(&nsvc->nsvci_entry);
+	llist_add(&nsvc->nsvci_entry, &lu->nsvci[ns_hash(nsvc->nsvci)]);
+	llist_del(&nsvc->addr_entry);
+	llist_add(&nsvc->addr_entry, &lu->addr[ns_hash_addr(&nsvc->ip.bts_addr)]);
+
+	if (nsvc->nse->nsei != nsvc->nsei) {
+		nse_leave(nsvc);
+		if (nse_join(nsvc) < 0) {
+			llist_del(&nsvc->nsvci_entry);
+			llist_del(&nsvc->addr_entry);
+		}
+	}
+}
+
 /*! \brief Lookup struct gprs_nsvc based on NSVCI
  *  \param[in] nsi NS instance in which to search
  *  \param[in] nsvci NSVCI to be searched
@@ -174,7 +418,8 @@ struct msgb *gprs_ns_msgb_alloc(void)
 struct gprs_nsvc *gprs_nsvc_by_nsvci(struct gprs_ns_inst *nsi, uint16_t nsvci)
 {
 	struct gprs_nsvc *nsvc;
-	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
+	llist_for_each_entry(nsvc, &nsi->lookup->nsvci[ns_hash(nsvci)],
+			     nsvci_entry) {
 		if (nsvc->nsvci == nsvci)
 			return nsvc;
 	}
@@ -188,26 +433,23 @@ struct gprs_nsvc *gprs_nsvc_by_nsvci(struct gprs_ns_inst *nsi, uint16_t nsvci)
  */
 struct gprs_nsvc *gprs_nsvc_by_nsei(struct gprs_ns_inst *nsi, uint16_t nsei)
 {
-	struct gprs_nsvc *nsvc;
-	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
-		if (nsvc->nsei == nsei)
-			return nsvc;
-	}
-	return NULL;
+	struct gprs_nse *nse = nse_by_nsei(nsi, nsei);
+
+	if (!nse)
+		return NULL;
+	return llist_entry(nse->nsvcs.next, struct gprs_nsvc, nse_entry);
 }
 
+/* Select one of the usable NS-VCs of the NSE. The link selector keeps
+ * the PDUs of one MS (or BVC) on the same NS-VC, see TS 08.16 4.4 */
 static struct gprs_nsvc *gprs_active_nsvc_by_nsei(struct gprs_ns_inst *nsi,
-						  uint16_t nsei)
+						  uint16_t nsei, uint32_t lsp)
 {
-	struct gprs_nsvc *nsvc;
-	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
-		if (nsvc->nsei == nsei) {
-			if (!(nsvc->state & NSE_S_BLOCKED) &&
-			    nsvc->state & NSE_S_ALIVE)
-				return nsvc;
-		}
-	}
-	return NULL;
+	struct gprs_nse *nse = nse_by_nsei(nsi, nsei);
+
+	if (!nse || !nse->num_active)
+		return NULL;
+	return nse->active[lsp % nse->num_active];
 }
 
 /* Lookup struct gprs_nsvc based on remote peer socket addr */
@@ -215,7 +457,8 @@ static struct gprs_nsvc *nsvc_by_rem_addr(struct gprs_ns_inst *nsi,
 					  struct sockaddr_in *sin)
 {
 	struct gprs_nsvc *nsvc;
-	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
+	llist_for_each_entry(nsvc, &nsi->lookup->addr[ns_hash_addr(sin)],
+			     addr_entry) {
 		if (nsvc->ip.bts_addr.sin_addr.s_addr ==
 					sin->sin_addr.s_addr &&
 		    nsvc->ip.bts_addr.sin_port == sin->sin_port)
@@ -242,8 +485,10 @@ struct gprs_nsvc *gprs_nsvc_create(struct gprs_ns_inst *nsi, uint16_t nsvci)
 	nsvc->timer.data = nsvc;
 	nsvc->ctrg = rate_ctr_group_alloc(nsvc, &nsvc_ctrg_desc, nsvci);
 	nsvc->statg = osmo_stat_item_group_alloc(nsvc, &nsvc_statg_desc, nsvci);
+	nsvc->active_idx = -1;
 
 	llist_add(&nsvc->list, &nsi->gprs_nsvcs);
+	nsvc_index_add(nsvc);
 
 	return nsvc;
 }
@@ -255,6 +500,7 @@ void gprs_nsvc_delete(struct gprs_nsvc *nsvc)
 {
 	if (osmo_timer_pending(&nsvc->timer))
 		osmo_timer_del(&nsvc->timer);
+	nsvc_index_del(nsvc);
 	llist_del(&nsvc->list);
 	rate_ctr_group_free(nsvc->ctrg);
 	osmo_stat_item_group_free(nsvc->statg);
@@ -329,7 +575,8 @@ static int gprs_ns_tx(struct gprs_nsvc *nsvc, struct msgb *msg)
 
 	/* Increment number of Uplink bytes */
 	rate_ctr_inc(&nsvc->ctrg->ctr[NS_CTR_PKTS_OUT]);
-	rate_ctr_add(&nsvc->ctrg->ctr[NS_CTR_BYTES_OUT], msgb_l2len(msg));
+	rate_ctr_add(&nsvc->ctrg->ctr[NS_CTR_BYTES_OUT],
+		     msgb_l2len(msg) + msgb_chain_len(msg) - msg->len);
 
 	switch (nsvc->ll) {
 	case GPRS_NS_LL_UDP:
@@ -478,7 +725,7 @@ int gprs_ns_tx_block(struct gprs_nsvc *nsvc, uint8_t cause)
 		nsvc->nsei, nsvc->nsvci, gprs_ns_cause_str(cause));
 
 	/* be conservative and mark it as blocked even now! */
-	nsvc->state |= NSE_S_BLOCKED;
+	nsvc_set_state(nsvc, nsvc->state | NSE_S_BLOCKED);
 	rate_ctr_inc(&nsvc->ctrg->ctr[NS_CTR_BLOCKED]);
 
 	msg->l2h = msgb_put(msg, sizeof(*nsh));
@@ -556,7 +803,7 @@ static void nsvc_start_timer(struct gprs_nsvc *nsvc, enum nsvc_timer_mode mode)
 	if (osmo_timer_pending(&nsvc->timer))
 		osmo_timer_del(&nsvc->timer);
 
-	gettimeofday(&nsvc->timer_started, NULL);
+	osmo_clock_now_cached(&nsvc->timer_started);
 	nsvc->timer_mode = mode;
 	osmo_timer_schedule(&nsvc->timer, seconds, 0);
 }
@@ -564,7 +811,7 @@ static void nsvc_start_timer(struct gprs_nsvc *nsvc, enum nsvc_timer_mode mode)
 static int nsvc_timer_elapsed_ms(struct gprs_nsvc *nsvc)
 {
 	struct timeval now, elapsed;
-	gettimeofday(&now, NULL);
+	osmo_clock_now_cached(&now);
 	timersub(&now, &nsvc->timer_started, &elapsed);
 
 	return 1000 * elapsed.tv_sec + elapsed.tv_usec / 1000;
@@ -589,7 +836,7 @@ static void gprs_ns_timer_cb(void *data)
 		if (nsvc->alive_retries >
 			nsvc->nsi->timeout[NS_TOUT_TNS_ALIVE_RETRIES]) {
 			/* mark as dead and blocked */
-			nsvc->state = NSE_S_BLOCKED;
+			nsvc_set_state(nsvc, NSE_S_BLOCKED);
 			rate_ctr_inc(&nsvc->ctrg->ctr[NS_CTR_BLOCKED]);
 			rate_ctr_inc(&nsvc->ctrg->ctr[NS_CTR_DEAD]);
 			LOGP(DNS, LOGL_NOTICE,
@@ -620,7 +867,7 @@ static void gprs_ns_timer_cb(void *data)
 				"NSEI=%u Reset timed out but RESET flag is not set\n",
 				nsvc->nsei);
 		/* Mark NS-VC locally as blocked and dead */
-		nsvc->state = NSE_S_BLOCKED | NSE_S_RESET;
+		nsvc_set_state(nsvc, NSE_S_BLOCKED | NSE_S_RESET);
 		/* Chapter 7.3: Re-send the RESET */
 		gprs_ns_tx_reset(nsvc, NS_CAUSE_OM_INTERVENTION);
 		/* Re-start Tns-reset timer */
@@ -674,8 +921,9 @@ int gprs_ns_sendmsg(struct gprs_ns_inst *nsi, struct msgb *msg)
 	struct gprs_nsvc *nsvc;
 	struct gprs_ns_hdr *nsh;
 	uint16_t bvci = msgb_bvci(msg);
+	uint32_t lsp = msgb_tlli(msg) ? msgb_tlli(msg) : bvci;
 
-	nsvc = gprs_active_nsvc_by_nsei(nsi, msgb_nsei(msg));
+	nsvc = gprs_active_nsvc_by_nsei(nsi, msgb_nsei(msg), lsp);
 	if (!nsvc) {
 		int rc;
 		if (gprs_nsvc_by_nsei(nsi, msgb_nsei(msg))) {
@@ -732,15 +980,17 @@ static int gprs_ns_rx_unitdata(struct gprs_nsvc *nsvc, struct msgb *msg)
 /* Section 9.2.7 */
 static int gprs_ns_rx_status(struct gprs_nsvc *nsvc, struct msgb *msg)
 {
-	struct gprs_ns_hdr *nsh = (struct gprs_ns_hdr *) msg->l2h;
-	struct tlv_parsed tp;
+	struct tlv_parsed_sparse tp;
 	uint8_t cause;
 	int rc;
 
 	LOGP(DNS, LOGL_NOTICE, "NSEI=%u Rx NS STATUS ", nsvc->nsei);
 
-	rc = tlv_parse(&tp, &ns_att_tlvdef, nsh->data,
-			msgb_l2len(msg) - sizeof(*nsh), 0, 0);
+	rc = ns_tlv_decode(&tp, msg);
+	if (NS_IE_ERR(rc)) {
+		LOGPC(DNS, LOGL_INFO, "missing cause IE\n");
+		return -EINVAL;
+	}
 	if (rc < 0) {
 		LOGPC(DNS, LOGL_NOTICE, "Error during TLV Parse\n");
 		LOGP(DNS, LOGL_ERROR, "NSEI=%u Rx NS STATUS: "
@@ -748,12 +998,7 @@ static int gprs_ns_rx_status(struct gprs_nsvc *nsvc, struct msgb *msg)
 		return rc;
 	}
 
-	if (!TLVP_PRESENT(&tp, NS_IE_CAUSE)) {
-		LOGPC(DNS, LOGL_INFO, "missing cause IE\n");
-		return -EINVAL;
-	}
-
-	cause = *TLVP_VAL(&tp, NS_IE_CAUSE);
+	cause = *TLVPS_VAL(&tp, NS_IE_CAUSE);
 	LOGPC(DNS, LOGL_NOTICE, "cause=%s\n", gprs_ns_cause_str(cause));
 
 	return 0;
@@ -802,32 +1047,27 @@ static int gprs_nsvc_replace_if_found(uint16_t nsvci,
 /* Section 7.3 */
 static int gprs_ns_rx_reset(struct gprs_nsvc **nsvc, struct msgb *msg)
 {
-	struct gprs_ns_hdr *nsh = (struct gprs_ns_hdr *) msg->l2h;
-	struct tlv_parsed tp;
+	struct tlv_parsed_sparse tp;
 	uint8_t cause;
 	uint16_t nsvci, nsei;
 	struct gprs_nsvc *orig_nsvc = NULL;
 	int rc;
 
-	rc = tlv_parse(&tp, &ns_att_tlvdef, nsh->data,
-			msgb_l2len(msg) - sizeof(*nsh), 0, 0);
+	rc = ns_tlv_decode(&tp, msg);
+	if (NS_IE_ERR(rc)) {
+		LOGP(DNS, LOGL_ERROR, "NS RESET Missing mandatory IE\n");
+		gprs_ns_tx_status(*nsvc, ns_ie_err_cause(rc), 0, msg);
+		return -EINVAL;
+	}
 	if (rc < 0) {
 		LOGP(DNS, LOGL_ERROR, "NSEI=%u Rx NS RESET "
 			"Error during TLV Parse\n", (*nsvc)->nsei);
 		return rc;
 	}
 
-	if (!TLVP_PRESENT(&tp, NS_IE_CAUSE) ||
-	    !TLVP_PRESENT(&tp, NS_IE_VCI) ||
-	    !TLVP_PRESENT(&tp, NS_IE_NSEI)) {
-		LOGP(DNS, LOGL_ERROR, "NS RESET Missing mandatory IE\n");
-		gprs_ns_tx_status(*nsvc, NS_CAUSE_MISSING_ESSENT_IE, 0, msg);
-		return -EINVAL;
-	}
-
-	cause = *(uint8_t  *) TLVP_VAL(&tp, NS_IE_CAUSE);
-	nsvci = ntohs(*(uint16_t *) TLVP_VAL(&tp, NS_IE_VCI));
-	nsei  = ntohs(*(uint16_t *) TLVP_VAL(&tp, NS_IE_NSEI));
+	cause = *(uint8_t  *) TLVPS_VAL(&tp, NS_IE_CAUSE);
+	nsvci = ntohs(*(uint16_t *) TLVPS_VAL(&tp, NS_IE_VCI));
+	nsei  = ntohs(*(uint16_t *) TLVPS_VAL(&tp, NS_IE_NSEI));
 
 	LOGP(DNS, LOGL_INFO, "NSVCI=%u%s Rx NS RESET (NSEI=%u, NSVCI=%u, cause=%s)\n",
 	     (*nsvc)->nsvci, (*nsvc)->nsvci_is_valid ? "" : "(invalid)",
@@ -856,6 +1096,7 @@ static int gprs_ns_rx_reset(struct gprs_nsvc **nsvc, struct msgb *msg)
 			orig_nsvc = *nsvc;
 			*nsvc = gprs_nsvc_create((*nsvc)->nsi, nsvci);
 			(*nsvc)->nsei  = nsei;
+			gprs_nsvc_rehash(*nsvc);
 		}
 	}
 
@@ -877,10 +1118,11 @@ static int gprs_ns_rx_reset(struct gprs_nsvc **nsvc, struct msgb *msg)
 		/* NSEI has changed */
 		rate_ctr_inc(&(*nsvc)->ctrg->ctr[NS_CTR_NSEI_CHG]);
 		(*nsvc)->nsei = nsei;
+		gprs_nsvc_rehash(*nsvc);
 	}
 
 	/* Mark NS-VC as blocked and alive */
-	(*nsvc)->state = NSE_S_BLOCKED | NSE_S_ALIVE;
+	nsvc_set_state(*nsvc, NSE_S_BLOCKED | NSE_S_ALIVE);
 
 	if (orig_nsvc) {
 		rate_ctr_inc(&(*nsvc)->ctrg->ctr[NS_CTR_REPLACED]);
@@ -893,6 +1135,7 @@ static int gprs_ns_rx_reset(struct gprs_nsvc **nsvc, struct msgb *msg)
 		(*nsvc)->nsei  = nsei;
 		(*nsvc)->nsvci = nsvci;
 		(*nsvc)->nsvci_is_valid = 1;
+		gprs_nsvc_rehash(*nsvc);
 		rate_ctr_group_upd_idx((*nsvc)->ctrg, nsvci);
 		osmo_stat_item_group_udp_idx((*nsvc)->statg, nsvci);
 	}
@@ -912,30 +1155,26 @@ static int gprs_ns_rx_reset(struct gprs_nsvc **nsvc, struct msgb *msg)
 
 static int gprs_ns_rx_reset_ack(struct gprs_nsvc **nsvc, struct msgb *msg)
 {
-	struct gprs_ns_hdr *nsh = (struct gprs_ns_hdr *) msg->l2h;
-	struct tlv_parsed tp;
+	struct tlv_parsed_sparse tp;
 	uint16_t nsvci, nsei;
 	struct gprs_nsvc *orig_nsvc = NULL;
 	int rc;
 
-	rc = tlv_parse(&tp, &ns_att_tlvdef, nsh->data,
-			msgb_l2len(msg) - sizeof(*nsh), 0, 0);
+	rc = ns_tlv_decode(&tp, msg);
+	if (NS_IE_ERR(rc)) {
+		LOGP(DNS, LOGL_ERROR, "NS RESET ACK Missing mandatory IE\n");
+		rc = gprs_ns_tx_status(*nsvc, ns_ie_err_cause(rc), 0, msg);
+		CHECK_TX_RC(rc, *nsvc);
+		return -EINVAL;
+	}
 	if (rc < 0) {
 		LOGP(DNS, LOGL_ERROR, "NSEI=%u Rx NS RESET ACK "
 			"Error during TLV Parse\n", (*nsvc)->nsei);
 		return rc;
 	}
 
-	if (!TLVP_PRESENT(&tp, NS_IE_VCI) ||
-	    !TLVP_PRESENT(&tp, NS_IE_NSEI)) {
-		LOGP(DNS, LOGL_ERROR, "NS RESET ACK Missing mandatory IE\n");
-		rc = gprs_ns_tx_status(*nsvc, NS_CAUSE_MISSING_ESSENT_IE, 0, msg);
-		CHECK_TX_RC(rc, *nsvc);
-		return -EINVAL;
-	}
-
-	nsvci = ntohs(*(uint16_t *) TLVP_VAL(&tp, NS_IE_VCI));
-	nsei  = ntohs(*(uint16_t *) TLVP_VAL(&tp, NS_IE_NSEI));
+	nsvci = ntohs(*(uint16_t *) TLVPS_VAL(&tp, NS_IE_VCI));
+	nsei  = ntohs(*(uint16_t *) TLVPS_VAL(&tp, NS_IE_NSEI));
 
 	LOGP(DNS, LOGL_INFO, "NSVCI=%u%s Rx NS RESET ACK (NSEI=%u, NSVCI=%u)\n",
 	     (*nsvc)->nsvci, (*nsvc)->nsvci_is_valid ? "" : "(invalid)",
@@ -1017,10 +1256,11 @@ static int gprs_ns_rx_reset_ack(struct gprs_nsvc **nsvc, struct msgb *msg)
 		/* NSEI has changed */
 		rate_ctr_inc(&(*nsvc)->ctrg->ctr[NS_CTR_NSEI_CHG]);
 		(*nsvc)->nsei = nsei;
+		gprs_nsvc_rehash(*nsvc);
 	}
 
 	/* Mark NS-VC as blocked and alive */
-	(*nsvc)->state = NSE_S_BLOCKED | NSE_S_ALIVE;
+	nsvc_set_state(*nsvc, NSE_S_BLOCKED | NSE_S_ALIVE);
 	(*nsvc)->remote_state = NSE_S_BLOCKED | NSE_S_ALIVE;
 	rate_ctr_inc(&(*nsvc)->ctrg->ctr[NS_CTR_BLOCKED]);
 	if ((*nsvc)->persistent || (*nsvc)->remote_end_is_sgsn) {
@@ -1036,32 +1276,28 @@ static int gprs_ns_rx_reset_ack(struct gprs_nsvc **nsvc, struct msgb *msg)
 
 static int gprs_ns_rx_block(struct gprs_nsvc *nsvc, struct msgb *msg)
 {
-	struct gprs_ns_hdr *nsh = (struct gprs_ns_hdr *) msg->l2h;
-	struct tlv_parsed tp;
+	struct tlv_parsed_sparse tp;
 	uint8_t *cause;
 	int rc;
 
 	LOGP(DNS, LOGL_INFO, "NSEI=%u Rx NS BLOCK\n", nsvc->nsei);
 
-	nsvc->state |= NSE_S_BLOCKED;
+	nsvc_set_state(nsvc, nsvc->state | NSE_S_BLOCKED);
 
-	rc = tlv_parse(&tp, &ns_att_tlvdef, nsh->data,
-			msgb_l2len(msg) - sizeof(*nsh), 0, 0);
+	rc = ns_tlv_decode(&tp, msg);
+	if (NS_IE_ERR(rc)) {
+		LOGP(DNS, LOGL_ERROR, "NS RESET Missing mandatory IE\n");
+		gprs_ns_tx_status(nsvc, ns_ie_err_cause(rc), 0, msg);
+		return -EINVAL;
+	}
 	if (rc < 0) {
 		LOGP(DNS, LOGL_ERROR, "NSEI=%u Rx NS BLOCK "
 			"Error during TLV Parse\n", nsvc->nsei);
 		return rc;
 	}
 
-	if (!TLVP_PRESENT(&tp, NS_IE_CAUSE) ||
-	    !TLVP_PRESENT(&tp, NS_IE_VCI)) {
-		LOGP(DNS, LOGL_ERROR, "NS RESET Missing mandatory IE\n");
-		gprs_ns_tx_status(nsvc, NS_CAUSE_MISSING_ESSENT_IE, 0, msg);
-		return -EINVAL;
-	}
-
-	cause = (uint8_t *) TLVP_VAL(&tp, NS_IE_CAUSE);
-	//nsvci = (uint16_t *) TLVP_VAL(&tp, NS_IE_VCI);
+	cause = (uint8_t *) TLVPS_VAL(&tp, NS_IE_CAUSE);
+	//nsvci = (uint16_t *) TLVPS_VAL(&tp, NS_IE_VCI);
 
 	ns_osmo_signal_dispatch(nsvc, S_NS_BLOCK, *cause);
 	rate_ctr_inc(&nsvc->ctrg->ctr[NS_CTR_BLOCKED]);
@@ -1142,6 +1378,7 @@ void gprs_ns_ll_copy(struct gprs_nsvc *nsvc, struct gprs_nsvc *other)
 	default:
 		break;
 	}
+	gprs_nsvc_rehash(nsvc);
 }
 
 void gprs_ns_ll_clear(struct gprs_nsvc *nsvc)
@@ -1158,6 +1395,7 @@ void gprs_ns_ll_clear(struct gprs_nsvc *nsvc)
 	default:
 		break;
 	}
+	gprs_nsvc_rehash(nsvc);
 }
 
 /*! \brief Create/get NS-VC independently from underlying transport layer
@@ -1182,7 +1420,7 @@ int gprs_ns_vc_create(struct gprs_ns_inst *nsi, struct msgb *msg,
 	struct gprs_ns_hdr *nsh = (struct gprs_ns_hdr *)msg->l2h;
 	struct gprs_nsvc *existing_nsvc;
 
-	struct tlv_parsed tp;
+	struct tlv_parsed_sparse tp;
 	uint16_t nsvci;
 	uint16_t nsei;
 
@@ -1221,7 +1459,7 @@ int gprs_ns_vc_create(struct gprs_ns_inst *nsi, struct msgb *msg,
 		     nsh->pdu_type, gprs_ns_ll_str(fallback_nsvc));
 		fallback_nsvc->nsvci = fallback_nsvc->nsei = 0xfffe;
 		fallback_nsvc->nsvci_is_valid = 0;
-		fallback_nsvc->state = NSE_S_ALIVE;
+		nsvc_set_state(fallback_nsvc, NSE_S_ALIVE);
 
 		rc = gprs_ns_tx_status(fallback_nsvc,
 				       NS_CAUSE_PDU_INCOMP_PSTATE, 0, msg);
@@ -1233,23 +1471,21 @@ int gprs_ns_vc_create(struct gprs_ns_inst *nsi, struct msgb *msg,
 		return GPRS_NS_CS_REJECTED;
 	}
 
-	rc = tlv_parse(&tp, &ns_att_tlvdef, nsh->data,
-		       msgb_l2len(msg) - sizeof(*nsh), 0, 0);
-	if (rc < 0) {
-		LOGP(DNS, LOGL_ERROR, "Rx NS RESET Error %d during "
-		     "TLV Parse\n", rc);
-		return rc;
-	}
-	if (!TLVP_PRESENT(&tp, NS_IE_CAUSE) ||
-	    !TLVP_PRESENT(&tp, NS_IE_VCI) || !TLVP_PRESENT(&tp, NS_IE_NSEI)) {
+	rc = ns_tlv_decode(&tp, msg);
+	if (NS_IE_ERR(rc)) {
 		LOGP(DNS, LOGL_ERROR, "NS RESET Missing mandatory IE\n");
-		rc = gprs_ns_tx_status(fallback_nsvc, NS_CAUSE_MISSING_ESSENT_IE, 0,
+		rc = gprs_ns_tx_status(fallback_nsvc, ns_ie_err_cause(rc), 0,
 				  msg);
 		CHECK_TX_RC(rc, fallback_nsvc);
 		return -EINVAL;
 	}
-	nsvci = ntohs(*(uint16_t *) TLVP_VAL(&tp, NS_IE_VCI));
-	nsei  = ntohs(*(uint16_t *) TLVP_VAL(&tp, NS_IE_NSEI));
+	if (rc < 0) {
+		LOGP(DNS, LOGL_ERROR, "Rx NS RESET Error %d during "
+		     "TLV Parse\n", rc);
+		return rc;
+	}
+	nsvci = ntohs(*(uint16_t *) TLVPS_VAL(&tp, NS_IE_VCI));
+	nsei  = ntohs(*(uint16_t *) TLVPS_VAL(&tp, NS_IE_NSEI));
 	/* Check if we already know this NSVCI, the remote end might
 	 * simply have changed addresses, or it is a SGSN */
 	existing_nsvc = gprs_nsvc_by_nsvci(nsi, nsvci);
@@ -1272,6 +1508,7 @@ int gprs_ns_vc_create(struct gprs_ns_inst *nsi, struct msgb *msg,
 
 		/* Override old NSEI */
 		existing_nsvc->nsei  = nsei;
+		gprs_nsvc_rehash(existing_nsvc);
 
 		/* Do statistics */
 		rate_ctr_inc(&existing_nsvc->ctrg->ctr[NS_CTR_NSEI_CHG]);
@@ -1344,14 +1581,14 @@ int gprs_ns_process_msg(struct gprs_ns_inst *nsi, struct msgb *msg,
 	case NS_PDUT_UNBLOCK:
 		/* Section 7.2: unblocking procedure */
 		LOGP(DNS, LOGL_INFO, "NSEI=%u Rx NS UNBLOCK\n", (*nsvc)->nsei);
-		(*nsvc)->state &= ~NSE_S_BLOCKED;
+		nsvc_set_state(*nsvc, (*nsvc)->state & ~NSE_S_BLOCKED);
 		ns_osmo_signal_dispatch(*nsvc, S_NS_UNBLOCK, 0);
 		rc = gprs_ns_tx_simple(*nsvc, NS_PDUT_UNBLOCK_ACK);
 		break;
 	case NS_PDUT_UNBLOCK_ACK:
 		LOGP(DNS, LOGL_INFO, "NSEI=%u Rx NS UNBLOCK ACK\n", (*nsvc)->nsei);
 		/* mark NS-VC as unblocked + active */
-		(*nsvc)->state = NSE_S_ALIVE;
+		nsvc_set_state(*nsvc, NSE_S_ALIVE);
 		(*nsvc)->remote_state = NSE_S_ALIVE;
 		ns_osmo_signal_dispatch(*nsvc, S_NS_UNBLOCK, 0);
 		break;
@@ -1374,14 +1611,21 @@ int gprs_ns_process_msg(struct gprs_ns_inst *nsi, struct msgb *msg,
 
 /*! \brief Create a new GPRS NS instance
  *  \param[in] cb Call-back function for incoming BSSGP data
- *  \returns dynamically allocated gprs_ns_inst
+ *  \returns dynamically allocated gprs_ns_inst; NULL on error
  */
 struct gprs_ns_inst *gprs_ns_instantiate(gprs_ns_cb_t *cb, void *ctx)
 {
 	struct gprs_ns_inst *nsi = talloc_zero(ctx, struct gprs_ns_inst);
 
+	if (!nsi)
+		return NULL;
 	nsi->cb = cb;
 	INIT_LLIST_HEAD(&nsi->gprs_nsvcs);
+	nsi->lookup = ns_lookup_alloc(nsi);
+	if (!nsi->lookup) {
+		talloc_free(nsi);
+		return NULL;
+	}
 	nsi->timeout[NS_TOUT_TNS_BLOCK] = 3;
 	nsi->timeout[NS_TOUT_TNS_BLOCK_RETRIES] = 3;
 	nsi->timeout[NS_TOUT_TNS_RESET] = 3;
@@ -1396,6 +1640,7 @@ struct gprs_ns_inst *gprs_ns_instantiate(gprs_ns_cb_t *cb, void *ctx)
 	nsi->unknown_nsvc->nsvci_is_valid = 0;
 	llist_del(&nsi->unknown_nsvc->list);
 	INIT_LLIST_HEAD(&nsi->unknown_nsvc->list);
+	nsvc_index_del(nsi->unknown_nsvc);
 
 	return nsi;
 }
@@ -1404,6 +1649,11 @@ void gprs_ns_close(struct gprs_ns_inst *nsi)
 {
 	struct gprs_nsvc *nsvc, *nsvc2;
 
+#ifdef NSIP_MMSG
+	/* send what is still queued while the socket is open */
+	nsip_mmsg_free(nsi);
+#endif
+
 	gprs_nsvc_delete(nsi->unknown_nsvc);
 
 	/* delete all NSVCs and clear their timers */
@@ -1468,13 +1718,269 @@ static struct msgb *read_nsip_msg(struct osmo_fd *bfd, int *error,
 	return msg;
 }
 
+#ifdef NSIP_MMSG
+struct gprs_nsip_mmsg {
+	unsigned int size;
+
+	/* set while handle_nsip_read_mmsg() dispatches a batch.  If the
+	 * NS instance is closed meanwhile, the batch state is detached
+	 * from it and marked closed, the reader frees it */
+	unsigned int busy:1;
+	unsigned int closed:1;
+
+	/* receive side: msgbs are allocated ahead and kept if unused */
+	struct msgb **rx_msg;
+	struct mmsghdr *rx_hdr;
+	struct iovec *rx_iov;
+	struct sockaddr_in *rx_addr;
+
+	/* transmit side: datagrams waiting for the socket to be writable */
+	unsigned int tx_num;
+	struct msgb **tx_msg;
+	struct mmsghdr *tx_hdr;
+	struct iovec (*tx_iov)[MSGB_IOV_MAX];
+	struct sockaddr_in *tx_addr;
+};
+
+static int nsip_mmsg_flush(struct gprs_ns_inst *nsi, struct gprs_nsip_mmsg *mm);
+
+static void nsip_mmsg_release(struct gprs_nsip_mmsg *mm)
+{
+	unsigned int i;
+
+	for (i = 0; i < mm->size; i++)
+		msgb_free(mm->rx_msg[i]);
+	talloc_free(mm);
+}
+
+/* send the queued datagrams as far as the socket takes them, and free
+ * the batch state */
+static void nsip_mmsg_free(struct gprs_ns_inst *nsi)
+{
+	struct gprs_nsip_mmsg *mm = nsi->nsip.mmsg;
+	unsigned int i;
+
+	if (!mm)
+		return;
+
+	if (mm->tx_num)
+		nsip_mmsg_flush(nsi, mm);
+	if (mm->tx_num) {
+		LOGP(DNS, LOGL_NOTICE, "dropping %u queued NS datagrams\n",
+			mm->tx_num);
+		for (i = 0; i < mm->tx_num; i++)
+			msgb_free(mm->tx_msg[i]);
+		mm->tx_num = 0;
+	}
+	nsi->nsip.mmsg = NULL;
+
+	if (mm->busy) {
+		/* let handle_nsip_read_mmsg() finish, even if the nsi is
+		 * freed by the call-back that closed it */
+		talloc_steal(NULL, mm);
+		mm->closed = 1;
+		return;
+	}
+	nsip_mmsg_release(mm);
+}
+
+/* obtain the batch state matching nsi->nsip.batch, NULL if disabled */
+static struct gprs_nsip_mmsg *nsip_mmsg_get(struct gprs_ns_inst *nsi)
+{
+	struct gprs_nsip_mmsg *mm = nsi->nsip.mmsg;
+	unsigned int size = nsi->nsip.batch;
+	unsigned int i;
+
+	if (mm && (mm->size == size || mm->tx_num || mm->busy))
+		return mm;
+	nsip_mmsg_free(nsi);
+	if (size <= 1)
+		return NULL;
+
+	mm = talloc_zero(nsi, struct gprs_nsip_mmsg);
+	if (!mm)
+		return NULL;
+	mm->size = size;
+	mm->rx_msg = talloc_zero_array(mm, struct msgb *, size);
+	mm->rx_hdr = talloc_zero_array(mm, struct mmsghdr, size);
+	mm->rx_iov = talloc_zero_array(mm, struct iovec, size);
+	mm->rx_addr = talloc_zero_array(mm, struct sockaddr_in, size);
+	mm->tx_msg = talloc_zero_array(mm, struct msgb *, size);
+	mm->tx_hdr = talloc_zero_array(mm, struct mmsghdr, size);
+	mm->tx_iov = talloc_zero_size(mm, size * sizeof(*mm->tx_iov));
+	mm->tx_addr = talloc_zero_array(mm, struct sockaddr_in, size);
+	if (!mm->rx_msg || !mm->rx_hdr || !mm->rx_iov || !mm->rx_addr ||
+	    !mm->tx_msg || !mm->tx_hdr || !mm->tx_iov || !mm->tx_addr) {
+		talloc_free(mm);
+		return NULL;
+	}
+
+	for (i = 0; i < size; i++) {
+		mm->rx_hdr[i].msg_hdr.msg_name = &mm->rx_addr[i];
+		mm->rx_hdr[i].msg_hdr.msg_iov = &mm->rx_iov[i];
+		mm->rx_hdr[i].msg_hdr.msg_iovlen = 1;
+		mm->tx_hdr[i].msg_hdr.msg_name = &mm->tx_addr[i];
+		mm->tx_hdr[i].msg_hdr.msg_namelen = sizeof(mm->tx_addr[i]);
+		mm->tx_hdr[i].msg_hdr.msg_iov = mm->tx_iov[i];
+	}
+
+	nsi->nsip.mmsg = mm;
+	return mm;
+}
+
+/* Read up to mm->size NS-over-IP messages by a single recvmmsg() */
+static int handle_nsip_read_mmsg(struct gprs_ns_inst *nsi,
+				 struct gprs_nsip_mmsg *mm)
+{
+	struct msgb *msg;
+	unsigned int i;
+	int rc;
+
+	for (i = 0; i < mm->size; i++) {
+		if (!mm->rx_msg[i]) {
+			mm->rx_msg[i] = gprs_ns_msgb_alloc();
+			if (!mm->rx_msg[i])
+				break;
+		}
+		msg = mm->rx_msg[i];
+		mm->rx_iov[i].iov_base = msg->data;
+		mm->rx_iov[i].iov_len = NS_ALLOC_SIZE - NS_ALLOC_HEADROOM;
+		mm->rx_hdr[i].msg_hdr.msg_namelen = sizeof(mm->rx_addr[i]);
+	}
+	if (i == 0)
+		return -ENOMEM;
+
+	rc = recvmmsg(nsi->nsip.fd.fd, mm->rx_hdr, i, MSG_DONTWAIT, NULL);
+	if (rc < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		LOGP(DNS, LOGL_ERROR, "recv error %s during NSIP recv\n",
+			strerror(errno));
+		return -errno;
+	}
+
+	mm->busy = 1;
+	for (i = 0; i < rc; i++) {
+		msg = mm->rx_msg[i];
+		mm->rx_msg[i] = NULL;
+
+		msg->l2h = msg->data;
+		msgb_put(msg, mm->rx_hdr[i].msg_len);
+		gprs_ns_rcvmsg(nsi, msg, &mm->rx_addr[i], GPRS_NS_LL_UDP);
+
+		/* the call-back closed (and maybe freed) the nsi, drop the
+		 * rest of the batch without touching the nsi again */
+		if (mm->closed) {
+			msgb_free(msg);
+			nsip_mmsg_release(mm);
+			return -EBADF;
+		}
+
+		/* re-use the msgb, unless it was cloned while processing */
+		if (msg->shinfo || msg->frag) {
+			msgb_free(msg);
+			continue;
+		}
+		msgb_reset(msg);
+		msgb_reserve(msg, NS_ALLOC_HEADROOM);
+		mm->rx_msg[i] = msg;
+	}
+	mm->busy = 0;
+
+	return 0;
+}
+
+/* Send the queued datagrams by as few sendmmsg() as possible */
+static int nsip_mmsg_flush(struct gprs_ns_inst *nsi, struct gprs_nsip_mmsg *mm)
+{
+	unsigned int i, done = 0;
+	int rc = 0;
+
+	while (done < mm->tx_num) {
+		rc = sendmmsg(nsi->nsip.fd.fd, mm->tx_hdr + done,
+			      mm->tx_num - done, MSG_DONTWAIT);
+		if (rc < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				break;
+			/* drop the datagram that caused the error */
+			rc = -errno;
+			LOGP(DNS, LOGL_INFO, "failed to send NS message via "
+				"UDP: %s\n", strerror(-rc));
+			msgb_free(mm->tx_msg[done++]);
+			continue;
+		}
+		for (i = done; i < done + rc; i++)
+			msgb_free(mm->tx_msg[i]);
+		done += rc;
+	}
+
+	/* move what's left to the front */
+	for (i = done; i < mm->tx_num; i++) {
+		mm->tx_msg[i - done] = mm->tx_msg[i];
+		mm->tx_addr[i - done] = mm->tx_addr[i];
+		memcpy(mm->tx_iov[i - done], mm->tx_iov[i], sizeof(mm->tx_iov[i]));
+		mm->tx_hdr[i - done].msg_hdr.msg_iovlen =
+			mm->tx_hdr[i].msg_hdr.msg_iovlen;
+	}
+	mm->tx_num -= done;
+
+	if (mm->tx_num)
+		nsi->nsip.fd.when |= BSC_FD_WRITE;
+	else
+		nsi->nsip.fd.when &= ~BSC_FD_WRITE;
+
+	return rc < 0 ? rc : 0;
+}
+
+/* Queue a datagram, it is sent once the socket becomes writable */
+static int nsip_mmsg_enqueue(struct gprs_ns_inst *nsi,
+			     struct gprs_nsip_mmsg *mm,
+			     const struct sockaddr_in *daddr, struct msgb *msg)
+{
+	unsigned int i;
+	int rc, len = msgb_chain_len(msg);
+
+	if (mm->tx_num == mm->size) {
+		nsip_mmsg_flush(nsi, mm);
+		if (mm->tx_num == mm->size) {
+			msgb_free(msg);
+			return -ENOBUFS;
+		}
+	}
+
+	i = mm->tx_num;
+	rc = msgb_iovec(msg, mm->tx_iov[i], MSGB_IOV_MAX);
+	if (rc < 0) {
+		msgb_free(msg);
+		return rc;
+	}
+	mm->tx_hdr[i].msg_hdr.msg_iovlen = rc;
+	mm->tx_addr[i] = *daddr;
+	mm->tx_msg[i] = msg;
+	mm->tx_num++;
+
+	nsi->nsip.fd.when |= BSC_FD_WRITE;
+
+	return len;
+}
+#endif
+
 static int handle_nsip_read(struct osmo_fd *bfd)
 {
 	int error;
 	struct sockaddr_in saddr;
 	struct gprs_ns_inst *nsi = bfd->data;
-	struct msgb *msg = read_nsip_msg(bfd, &error, &saddr);
+	struct msgb *msg;
+#ifdef NSIP_MMSG
+	struct gprs_nsip_mmsg *mm = nsip_mmsg_get(nsi);
+
+	/* a nested select loop run from within the dispatch of a batch
+	 * reads single datagrams, the batch buffers are in use */
+	if (mm && !mm->busy)
+		return handle_nsip_read_mmsg(nsi, mm);
+#endif
 
+	msg = read_nsip_msg(bfd, &error, &saddr);
 	if (!msg)
 		return error;
 
@@ -1487,8 +1993,14 @@ static int handle_nsip_read(struct osmo_fd *bfd)
 
 static int handle_nsip_write(struct osmo_fd *bfd)
 {
-	/* FIXME: actually send the data here instead of nsip_sendmsg() */
-	return -EIO;
+#ifdef NSIP_MMSG
+	struct gprs_ns_inst *nsi = bfd->data;
+
+	if (nsi->nsip.mmsg)
+		return nsip_mmsg_flush(nsi, nsi->nsip.mmsg);
+#endif
+	bfd->when &= ~BSC_FD_WRITE;
+	return 0;
 }
 
 static int nsip_sendmsg(struct gprs_nsvc *nsvc, struct msgb *msg)
@@ -1496,9 +2008,30 @@ static int nsip_sendmsg(struct gprs_nsvc *nsvc, struct msgb *msg)
 	int rc;
 	struct gprs_ns_inst *nsi = nsvc->nsi;
 	struct sockaddr_in *daddr = &nsvc->ip.bts_addr;
-
-	rc = sendto(nsi->nsip.fd.fd, msg->data, msg->len, 0,
-		  (struct sockaddr *)daddr, sizeof(*daddr));
+	struct iovec iov[MSGB_IOV_MAX];
+	struct msghdr mh = {
+		.msg_name = daddr,
+		.msg_namelen = sizeof(*daddr),
+		.msg_iov = iov,
+	};
+#ifdef NSIP_MMSG
+	struct gprs_nsip_mmsg *mm = nsip_mmsg_get(nsi);
+
+	if (mm)
+		return nsip_mmsg_enqueue(nsi, mm, daddr, msg);
+#endif
+
+	if (!msg->frag) {
+		rc = sendto(nsi->nsip.fd.fd, msg->data, msg->len, 0,
+			  (struct sockaddr *)daddr, sizeof(*daddr));
+	} else {
+		/* a msgb chain is sent without copying the payload */
+		rc = msgb_iovec(msg, iov, ARRAY_SIZE(iov));
+		if (rc >= 0) {
+			mh.msg_iovlen = rc;
+			rc = sendmsg(nsi->nsip.fd.fd, &mh, 0);
+		}
+	}
 
 	msgb_free(msg);
 
@@ -1510,8 +2043,12 @@ static int nsip_fd_cb(struct osmo_fd *bfd, unsigned int what)
 {
 	int rc = 0;
 
-	if (what & BSC_FD_READ)
+	if (what & BSC_FD_READ) {
 		rc = handle_nsip_read(bfd);
+		/* the nsi may be gone, see handle_nsip_read_mmsg() */
+		if (rc == -EBADF)
+			return rc;
+	}
 	if (what & BSC_FD_WRITE)
 		rc = handle_nsip_write(bfd);
 
@@ -1568,7 +2105,7 @@ int gprs_nsvc_reset(struct gprs_nsvc *nsvc, uint8_t cause)
 		nsvc->nsei);
 
 	/* Mark NS-VC locally as blocked and dead */
-	nsvc->state = NSE_S_BLOCKED | NSE_S_RESET;
+	nsvc_set_state(nsvc, NSE_S_BLOCKED | NSE_S_RESET);
 
 	/* Send NS-RESET PDU */
 	rc = gprs_ns_tx_reset(nsvc, cause);
@@ -1604,6 +2141,7 @@ struct gprs_nsvc *gprs_ns_nsip_connect(struct gprs_ns_inst *nsi,
 	nsvc->ip.bts_addr = *dest;
 	nsvc->nsei = nsei;
 	nsvc->remote_end_is_sgsn = 1;
+	gprs_nsvc_rehash(nsvc);
 
 	gprs_nsvc_reset(nsvc, NS_CAUSE_OM_INTERVENTION);
 	return nsvc;
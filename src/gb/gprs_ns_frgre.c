@@ -284,6 +284,12 @@ int gprs_ns_frgre_sendmsg(struct gprs_nsvc *nsvc, struct msgb *msg)
 	uint16_t dlci = ntohs(nsvc->frgre.bts_addr.sin_port);
 	uint8_t *frh;
 	struct gre_hdr *greh;
+	struct iovec iov[MSGB_IOV_MAX];
+	struct msghdr mh = {
+		.msg_name = &daddr,
+		.msg_namelen = sizeof(daddr),
+		.msg_iov = iov,
+	};
 
 	/* Build socket address for the packet destionation */
 	daddr.sin_family = AF_INET;
@@ -300,8 +306,17 @@ int gprs_ns_frgre_sendmsg(struct gprs_nsvc *nsvc, struct msgb *msg)
 	greh->flags = 0;
 	greh->ptype = htons(GRE_PTYPE_FR);
 
-	rc = sendto(nsi->frgre.fd.fd, msg->data, msg->len, 0,
-		  (struct sockaddr *)&daddr, sizeof(daddr));
+	if (!msg->frag) {
+		rc = sendto(nsi->frgre.fd.fd, msg->data, msg->len, 0,
+			  (struct sockaddr *)&daddr, sizeof(daddr));
+	} else {
+		/* a msgb chain is sent without copying the payload */
+		rc = msgb_iovec(msg, iov, ARRAY_SIZE(iov));
+		if (rc >= 0) {
+			mh.msg_iovlen = rc;
+			rc = sendmsg(nsi->frgre.fd.fd, &mh, 0);
+		}
+	}
 
 	msgb_free(msg);
 
@@ -134,6 +134,9 @@ static int config_write_ns(struct vty *vty)
 	if (vty_nsi->nsip.dscp)
 		vty_out(vty, " encapsulation udp dscp %d%s",
 			vty_nsi->nsip.dscp, VTY_NEWLINE);
+	if (vty_nsi->nsip.batch > 1)
+		vty_out(vty, " encapsulation udp batch %u%s",
+			vty_nsi->nsip.batch, VTY_NEWLINE);
 
 	vty_out(vty, " encapsulation framerelay-gre enabled %u%s",
 		vty_nsi->frgre.enabled ? 1 : 0, VTY_NEWLINE);
@@ -259,6 +262,7 @@ DEFUN(cfg_nse_nsvc, cfg_nse_nsvci_cmd,
 		nsvc->nsei = nsei;
 	}
 	nsvc->nsvci = nsvci;
+	gprs_nsvc_rehash(nsvc);
 	/* All NSVCs that are explicitly configured by VTY are
 	 * marked as persistent so we can write them to the config
 	 * file at some later point */
@@ -282,6 +286,7 @@ DEFUN(cfg_nse_remoteip, cfg_nse_remoteip_cmd,
 		return CMD_WARNING;
 	}
 	inet_aton(argv[1], &nsvc->ip.bts_addr.sin_addr);
+	gprs_nsvc_rehash(nsvc);
 
 	return CMD_SUCCESS;
 
@@ -310,6 +315,7 @@ DEFUN(cfg_nse_remoteport, cfg_nse_remoteport_cmd,
 	}
 
 	nsvc->ip.bts_addr.sin_port = htons(port);
+	gprs_nsvc_rehash(nsvc);
 
 	return CMD_SUCCESS;
 }
@@ -337,6 +343,7 @@ DEFUN(cfg_nse_fr_dlci, cfg_nse_fr_dlci_cmd,
 	}
 
 	nsvc->frgre.bts_addr.sin_port = htons(dlci);
+	gprs_nsvc_rehash(nsvc);
 
 	return CMD_SUCCESS;
 }
@@ -469,6 +476,16 @@ DEFUN(cfg_nsip_dscp, cfg_nsip_dscp_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_nsip_batch, cfg_nsip_batch_cmd,
+      "encapsulation udp batch <1-64>",
+	ENCAPS_STR "NS over UDP Encapsulation\n"
+	"Set the number of datagrams received/sent per system call\n"
+	"Number of datagrams (1 disables batching)\n")
+{
+	vty_nsi->nsip.batch = atoi(argv[0]);
+	return CMD_SUCCESS;
+}
+
 DEFUN(cfg_frgre_local_ip, cfg_frgre_local_ip_cmd,
       "encapsulation framerelay-gre local-ip A.B.C.D",
 	ENCAPS_STR "NS over Frame Relay over GRE Encapsulation\n"
@@ -598,6 +615,7 @@ int gprs_ns_vty_init(struct gprs_ns_inst *nsi)
 	install_element(L_NS_NODE, &cfg_nsip_local_ip_cmd);
 	install_element(L_NS_NODE, &cfg_nsip_local_port_cmd);
 	install_element(L_NS_NODE, &cfg_nsip_dscp_cmd);
+	install_element(L_NS_NODE, &cfg_nsip_batch_cmd);
 	install_element(L_NS_NODE, &cfg_frgre_enable_cmd);
 	install_element(L_NS_NODE, &cfg_frgre_local_ip_cmd);
 
@@ -34,10 +34,13 @@
  *  \brief Osmocom GSM A5 ciphering algorithm implementation
  */
 
+#include "../../config.h"
+
 #include <errno.h>
 #include <string.h>
 #include <stdbool.h>
 
+#include <osmocom/core/bits.h>
 #include <osmocom/gsm/a5.h>
 #include <osmocom/gsm/kasumi.h>
 
@@ -50,6 +53,33 @@
 /* A5/3&4                                                                   */
 /* ------------------------------------------------------------------------ */
 
+/* build the 128 bit KASUMI key of A5/3 (Kc concatenated with itself) or A5/4 */
+static void a5_kasumi_ck(int n, const uint8_t *key, uint8_t *ck)
+{
+	memcpy(ck, key, 8);
+	memcpy(ck + 8, n == 4 ? key + 8 : key, 8);
+}
+
+/* convert the KGCORE output into the DL (bits 0..113) and UL (bits
+ * 114..227) cipher streams */
+static void a5_kasumi_out(const uint8_t *gamma, ubit_t *dl, ubit_t *ul)
+{
+	if (ul)
+		osmo_pbit2ubit_ext(ul, 0, gamma, 114, 114, 0);
+	if (dl)
+		osmo_pbit2ubit(dl, gamma, 114);
+}
+
+static void
+a5_kasumi(const struct kasumi_kgcore_key *k, uint32_t fn_count, ubit_t *dl, ubit_t *ul)
+{
+	uint8_t gamma[29];
+
+	/* DL is a prefix of the UL keystream, so one KGCORE run covers both */
+	_kasumi_kgcore_prepared(k, 0xF, 0, fn_count, 0, gamma, ul ? 228 : 114);
+	a5_kasumi_out(gamma, dl, ul);
+}
+
 /*! \brief Generate a GSM A5/4 cipher stream
  *  \param[in] key 16 byte array for the key (as received from the SIM)
  *  \param[in] fn Frame number
@@ -65,18 +95,10 @@
 void
 _a5_4(const uint8_t *ck, uint32_t fn, ubit_t *dl, ubit_t *ul, bool fn_correct)
 {
-       uint8_t i, gamma[32], uplink[15];
-       uint32_t fn_count = (fn_correct) ? osmo_a5_fn_count(fn) : fn;
-
-       if (ul) {
-               _kasumi_kgcore(0xF, 0, fn_count, 0, ck, gamma, 228);
-               for(i = 0; i < 15; i++) uplink[i] = (gamma[i + 14] << 2) + (gamma[i + 15] >> 6);
-               osmo_pbit2ubit(ul, uplink, 114);
-       }
-       if (dl) {
-               _kasumi_kgcore(0xF, 0, fn_count, 0, ck, gamma, 114);
-               osmo_pbit2ubit(dl, gamma, 114);
-       }
+	struct kasumi_kgcore_key k;
+
+	_kasumi_kgcore_key_init(&k, ck);
+	a5_kasumi(&k, fn_correct ? osmo_a5_fn_count(fn) : fn, dl, ul);
 }
 
 /*! \brief Generate a GSM A5/3 cipher stream
@@ -94,11 +116,48 @@ _a5_4(const uint8_t *ck, uint32_t fn, ubit_t *dl, ubit_t *ul, bool fn_correct)
 void
 _a5_3(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul, bool fn_correct)
 {
-       uint8_t ck[16];
-       memcpy(ck, key, 8);
-       memcpy(ck + 8, key, 8);
-       /* internal function require 128 bit key so we expand by concatenating supplied 64 bit key */
-       _a5_4(ck, fn, dl, ul, fn_correct);
+	uint8_t ck[16];
+
+	/* internal function require 128 bit key so we expand by concatenating supplied 64 bit key */
+	a5_kasumi_ck(3, key, ck);
+	_a5_4(ck, fn, dl, ul, fn_correct);
+}
+
+/*! \brief Prepare an A5/3 or A5/4 key for generating many cipher streams
+ *  \param[out] k prepared key
+ *  \param[in] n Which A5/x method to use (3 or 4)
+ *  \param[in] key 8 or 16 (for a5/4) byte array for the key (as received from the SIM)
+ *  \returns 0 for success, -ENOTSUP for invalid cipher selection.
+ *
+ * The KASUMI key schedules are expanded once here instead of for every
+ * burst, as Kc does not change during a connection.
+ */
+int
+osmo_a5_key_init(struct osmo_a5_key *k, int n, const uint8_t *key)
+{
+	uint8_t ck[16];
+
+	if (n != 3 && n != 4)
+		return -ENOTSUP;
+
+	a5_kasumi_ck(n, key, ck);
+	_kasumi_kgcore_key_init(&k->kg, ck);
+	return 0;
+}
+
+/*! \brief Generate an A5/3 or A5/4 cipher stream with a prepared key
+ *  \param[in] k key prepared by osmo_a5_key_init()
+ *  \param[in] fn Frame number
+ *  \param[out] dl Pointer to array of ubits to return Downlink cipher stream
+ *  \param[out] ul Pointer to array of ubits to return Uplink cipher stream
+ *
+ * Same as osmo_a5() with the key and A5/x method of \a k.
+ * Either (or both) of dl/ul can be NULL if not needed.
+ */
+void
+osmo_a5_key_gen(const struct osmo_a5_key *k, uint32_t fn, ubit_t *dl, ubit_t *ul)
+{
+	a5_kasumi(&k->kg, osmo_a5_fn_count(fn), dl, ul);
 }
 
 /*! \brief Main method to generate a A5/x cipher stream
@@ -438,4 +497,186 @@ osmo_a5_2(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul)
 	}
 }
 
+
+/* ------------------------------------------------------------------------ */
+/* A5/1&2 batch                                                             */
+/* ------------------------------------------------------------------------ */
+
+/* Below this many keystreams the scalar code is faster */
+#define A5_BATCH_MIN	8
+
+/* number of A5/3 and A5/4 channels prepared at a time */
+#define A5_KASUMI_BATCH	16
+
+/* feedback taps of the registers (bit positions, -1 terminated) */
+static const int a5bs_r1_taps[4] = { 13, 16, 17, 18 };
+static const int a5bs_r2_taps[4] = { 20, 21, -1, -1 };
+static const int a5bs_r3_taps[4] = { 7, 20, 21, 22 };
+static const int a5bs_r4_taps[4] = { 11, 16, -1, -1 };
+
+/* transpose a 64x64 bit matrix: bit j of m[i] becomes bit i of m[j] */
+static void a5bs_transpose64(uint64_t m[64])
+{
+	uint64_t mask = 0x00000000ffffffffULL;
+	unsigned int s, k;
+
+	for (s = 32; s; s >>= 1, mask ^= mask << s) {
+		/* swap the upper s columns of row k with the lower s
+		 * columns of row k + s, in all 2s x 2s blocks */
+		for (k = 0; k < 64; k = ((k | s) + 1) & ~s) {
+			uint64_t t = ((m[k] >> s) ^ m[k | s]) & mask;
+			m[k] ^= t << s;
+			m[k | s] ^= t;
+		}
+	}
+}
+
+#define A5BS_WORD	uint64_t
+#define A5BS_NAME(x)	_a5bs64_##x
+#define A5BS_ATTR
+#include "a5_bitslice.h"
+#undef A5BS_WORD
+#undef A5BS_NAME
+#undef A5BS_ATTR
+
+#if defined(__GNUC__) && (defined(__SSE2__) || defined(__ARM_NEON))
+#define HAVE_A5BS128
+typedef uint64_t a5bs_v128 __attribute__((vector_size(16)));
+#define A5BS_WORD	a5bs_v128
+#define A5BS_NAME(x)	_a5bs128_##x
+#define A5BS_ATTR
+#include "a5_bitslice.h"
+#undef A5BS_WORD
+#undef A5BS_NAME
+#undef A5BS_ATTR
+#endif
+
+#ifdef HAVE_X86_SIMD
+typedef uint64_t a5bs_v256 __attribute__((vector_size(32)));
+#define A5BS_WORD	a5bs_v256
+#define A5BS_NAME(x)	_a5bs256_##x
+#define A5BS_ATTR	__attribute__((target("avx2")))
+#include "a5_bitslice.h"
+#undef A5BS_WORD
+#undef A5BS_NAME
+#undef A5BS_ATTR
+#endif
+
+/* A5/3 and A5/4 of up to A5_KASUMI_BATCH channels, interleaved by
+ * _kasumi_kgcore_multi(), returns the number of channels done */
+static unsigned int
+a5_kasumi_batch(int n, const uint8_t *keys, const uint32_t *fns,
+		ubit_t *dl, ubit_t *ul, unsigned int count)
+{
+	const unsigned int key_len = n == 4 ? 16 : 8;
+	const unsigned int len = ul ? 29 : 15;
+	struct kasumi_kgcore_key kg[A5_KASUMI_BATCH];
+	const struct kasumi_kgcore_key *kp[A5_KASUMI_BATCH];
+	uint32_t cc[A5_KASUMI_BATCH];
+	uint8_t gamma[A5_KASUMI_BATCH * 29];
+	uint8_t ck[16];
+	unsigned int i, num_kg = 1;
+
+	if (count > A5_KASUMI_BATCH)
+		count = A5_KASUMI_BATCH;
+
+	a5_kasumi_ck(n, keys, ck);
+	_kasumi_kgcore_key_init(&kg[0], ck);
+	kp[0] = &kg[0];
+	cc[0] = osmo_a5_fn_count(fns[0]);
+
+	for (i = 1; i < count; i++) {
+		const uint8_t *key = keys + key_len * i;
+
+		/* successive frames of one channel share the key schedules */
+		if (memcmp(key, key - key_len, key_len)) {
+			a5_kasumi_ck(n, key, ck);
+			_kasumi_kgcore_key_init(&kg[num_kg++], ck);
+		}
+		kp[i] = &kg[num_kg - 1];
+		cc[i] = osmo_a5_fn_count(fns[i]);
+	}
+
+	_kasumi_kgcore_multi(kp, cc, count, 0xF, 0, 0, gamma, ul ? 228 : 114);
+
+	for (i = 0; i < count; i++)
+		a5_kasumi_out(gamma + len * i, dl ? dl + 114 * i : NULL,
+			      ul ? ul + 114 * i : NULL);
+
+	return count;
+}
+
+/*! \brief Generate the A5/x cipher streams of many channels at once
+ *  \param[in] n Which A5/x method to use
+ *  \param[in] keys \a count keys of 8 bytes each (16 bytes for A5/4)
+ *  \param[in] fns \a count frame numbers
+ *  \param[out] dl \a count * 114 ubits of downlink cipher streams, or NULL
+ *  \param[out] ul \a count * 114 ubits of uplink cipher streams, or NULL
+ *  \param[in] count number of (key, frame number) pairs
+ *  \returns 0 for success, -ENOTSUP for invalid cipher selection.
+ *
+ * The result is the same as calling osmo_a5() for each pair, but A5/1
+ * and A5/2 are computed bitsliced, i.e. 64, 128 or 256 (AVX2) cipher
+ * streams in parallel using one bit of a machine word / SIMD register
+ * each. The KASUMI of A5/3 and A5/4 runs several channels interleaved
+ * and expands the key schedules only once for successive pairs with
+ * the same key.
+ */
+int
+osmo_a5_batch(int n, const uint8_t *keys, const uint32_t *fns,
+	      ubit_t *dl, ubit_t *ul, unsigned int count)
+{
+	const unsigned int key_len = n == 4 ? 16 : 8;
+
+	if (n < 0 || n > 4)
+		return -ENOTSUP;
+
+	while (count) {
+		unsigned int num = count;
+
+		if (n == 3 || n == 4) {
+			num = a5_kasumi_batch(n, keys, fns, dl, ul, count);
+		} else if (n != 1 && n != 2) {
+			osmo_a5(n, keys, *fns, dl, ul);
+			num = 1;
+		} else if (count < A5_BATCH_MIN) {
+			if (n == 1)
+				osmo_a5_1(keys, *fns, dl, ul);
+			else
+				osmo_a5_2(keys, *fns, dl, ul);
+			num = 1;
+		}
+#ifdef HAVE_X86_SIMD
+		else if (count > 128 && (__builtin_cpu_init(),
+					 __builtin_cpu_supports("avx2"))) {
+			if (num > 256)
+				num = 256;
+			_a5bs256_a5_12(n, keys, fns, dl, ul, num);
+		}
+#endif
+#ifdef HAVE_A5BS128
+		else if (count > 64) {
+			if (num > 128)
+				num = 128;
+			_a5bs128_a5_12(n, keys, fns, dl, ul, num);
+		}
+#endif
+		else {
+			if (num > 64)
+				num = 64;
+			_a5bs64_a5_12(n, keys, fns, dl, ul, num);
+		}
+
+		keys += key_len * num;
+		fns += num;
+		if (dl)
+			dl += 114 * num;
+		if (ul)
+			ul += 114 * num;
+		count -= num;
+	}
+
+	return 0;
+}
+
 /*! @} */
@@ -0,0 +1,197 @@
+/*
+ * a5_bitslice.h
+ *
+ * Bitsliced A5/1 and A5/2, generating one keystream per bit of a lane word
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Included by a5.c once per lane word type, with
+ *  A5BS_WORD	  the lane word, an unsigned integer or GCC vector of uint64_t
+ *  A5BS_NAME(x)  the name of the instantiated function x
+ *  A5BS_ATTR	  attributes of all instantiated functions (may be empty)
+ *
+ * Every register bit is held in one lane word, i.e. r1[i] holds bit i of
+ * the R1 register of all lanes. Conditional clocking of a lane becomes
+ * a select between the old and the shifted bit under a lane mask.
+ */
+
+/* 64 lanes g * 64 ... g * 64 + 63 of a lane word, as uint64_t (vector
+ * types may alias their element type) */
+#define A5BS_GROUP(w, g)	(((uint64_t *) &(w))[g])
+
+/* clock all lanes of a register, feedback from the given taps */
+A5BS_ATTR static inline void
+A5BS_NAME(shift)(A5BS_WORD *r, int len, const int *taps)
+{
+	A5BS_WORD fb = r[taps[0]] ^ r[taps[1]];
+	int i;
+
+	if (taps[2] >= 0)
+		fb ^= r[taps[2]] ^ r[taps[3]];
+	for (i = len - 1; i > 0; i--)
+		r[i] = r[i - 1];
+	r[0] = fb;
+}
+
+/* clock the lanes of a register in which en is set */
+A5BS_ATTR static inline void
+A5BS_NAME(shift_en)(A5BS_WORD *r, int len, const int *taps, A5BS_WORD en)
+{
+	A5BS_WORD fb = r[taps[0]] ^ r[taps[1]];
+	int i;
+
+	if (taps[2] >= 0)
+		fb ^= r[taps[2]] ^ r[taps[3]];
+	for (i = len - 1; i > 0; i--)
+		r[i] ^= en & (r[i] ^ r[i - 1]);
+	r[0] ^= en & (r[0] ^ fb);
+}
+
+A5BS_ATTR static inline A5BS_WORD
+A5BS_NAME(majority)(A5BS_WORD a, A5BS_WORD b, A5BS_WORD c)
+{
+	return (a & b) | (c & (a ^ b));
+}
+
+/*! \brief generate A5/1 or A5/2 keystreams, one per bit of A5BS_WORD
+ *  \param[in] n 1 or 2
+ *  \param[in] keys \a count keys of 8 bytes each
+ *  \param[in] fns \a count frame numbers
+ *  \param[out] dl \a count * 114 ubits of downlink keystream, or NULL
+ *  \param[out] ul \a count * 114 ubits of uplink keystream, or NULL
+ *  \param[in] count number of keystreams (1 .. bits of A5BS_WORD)
+ */
+A5BS_ATTR static void
+A5BS_NAME(a5_12)(int n, const uint8_t *keys, const uint32_t *fns,
+		 ubit_t *dl, ubit_t *ul, unsigned int count)
+{
+	A5BS_WORD r1[A5_R1_LEN], r2[A5_R2_LEN], r3[A5_R3_LEN], r4[A5_R4_LEN];
+	A5BS_WORD in[64 + 22], ks[228];
+	A5BS_WORD maj, ones;
+	uint64_t m[4][64];
+	unsigned int i, j, g, b;
+
+	memset(r1, 0, sizeof(r1));
+	memset(r2, 0, sizeof(r2));
+	memset(r3, 0, sizeof(r3));
+	memset(r4, 0, sizeof(r4));
+	memset(&ones, 0xff, sizeof(ones));
+
+	/* transpose key and frame count bits into lane words, in the order
+	 * in which they are loaded into the registers */
+	for (g = 0; g < sizeof(A5BS_WORD) / 8; g++) {
+		for (j = 0; j < 64; j++) {
+			unsigned int lane = 64 * g + j;
+
+			m[0][j] = lane < count ? osmo_load64be(keys + 8 * lane) : 0;
+			m[1][j] = lane < count ? osmo_a5_fn_count(fns[lane]) : 0;
+		}
+		a5bs_transpose64(m[0]);
+		a5bs_transpose64(m[1]);
+		for (i = 0; i < 64; i++)
+			A5BS_GROUP(in[i], g) = m[0][i];
+		for (i = 0; i < 22; i++)
+			A5BS_GROUP(in[64 + i], g) = m[1][i];
+	}
+
+	/* Key and frame count load */
+	for (i = 0; i < 64 + 22; i++) {
+		A5BS_NAME(shift)(r1, A5_R1_LEN, a5bs_r1_taps);
+		A5BS_NAME(shift)(r2, A5_R2_LEN, a5bs_r2_taps);
+		A5BS_NAME(shift)(r3, A5_R3_LEN, a5bs_r3_taps);
+		r1[0] ^= in[i];
+		r2[0] ^= in[i];
+		r3[0] ^= in[i];
+		if (n == 2) {
+			A5BS_NAME(shift)(r4, A5_R4_LEN, a5bs_r4_taps);
+			r4[0] ^= in[i];
+		}
+	}
+
+	if (n == 2) {
+		r1[15] = ones;
+		r2[16] = ones;
+		r3[18] = ones;
+		r4[10] = ones;
+	}
+
+	/* Mix and output */
+	for (i = 0; i < (n == 2 ? 99 : 100) + 228; i++) {
+		A5BS_WORD cb[3];
+
+		if (n == 2) {
+			cb[0] = r4[10];
+			cb[1] = r4[3];
+			cb[2] = r4[7];
+		} else {
+			cb[0] = r1[8];
+			cb[1] = r2[10];
+			cb[2] = r3[10];
+		}
+
+		maj = A5BS_NAME(majority)(cb[0], cb[1], cb[2]);
+		A5BS_NAME(shift_en)(r1, A5_R1_LEN, a5bs_r1_taps, ~(cb[0] ^ maj));
+		A5BS_NAME(shift_en)(r2, A5_R2_LEN, a5bs_r2_taps, ~(cb[1] ^ maj));
+		A5BS_NAME(shift_en)(r3, A5_R3_LEN, a5bs_r3_taps, ~(cb[2] ^ maj));
+
+		if (n == 2)
+			A5BS_NAME(shift)(r4, A5_R4_LEN, a5bs_r4_taps);
+
+		if (i < (n == 2 ? 99 : 100))
+			continue;
+
+		ks[i - (n == 2 ? 99 : 100)] =
+			r1[A5_R1_LEN - 1] ^ r2[A5_R2_LEN - 1] ^ r3[A5_R3_LEN - 1];
+		if (n == 2)
+			ks[i - 99] ^=
+				A5BS_NAME(majority)(r1[15], ~r1[14], r1[12]) ^
+				A5BS_NAME(majority)(~r2[16], r2[13], r2[9]) ^
+				A5BS_NAME(majority)(r3[18], r3[16], ~r3[13]);
+	}
+
+	/* transpose back, in blocks of 64 keystream bits, first bit in the
+	 * MSB, so that each lane gets them as packed bits */
+	for (g = 0; 64 * g < count; g++) {
+		for (b = 0; b < 4; b++) {
+			if (!(b < 2 ? dl : ul))
+				continue;
+			for (i = 0; i < 64; i++) {
+				unsigned int t = 114 * (b / 2) + 64 * (b % 2) + i;
+				m[b][63 - i] = b % 2 && i >= 114 - 64 ? 0 :
+					       A5BS_GROUP(ks[t], g);
+			}
+			a5bs_transpose64(m[b]);
+		}
+
+		for (j = 0; j < 64 && 64 * g + j < count; j++) {
+			unsigned int lane = 64 * g + j;
+			pbit_t pb[16];
+
+			if (dl) {
+				osmo_store64be(m[0][j], pb);
+				osmo_store64be(m[1][j], pb + 8);
+				osmo_pbit2ubit(dl + 114 * lane, pb, 114);
+			}
+			if (ul) {
+				osmo_store64be(m[2][j], pb);
+				osmo_store64be(m[3][j], pb + 8);
+				osmo_pbit2ubit(ul + 114 * lane, pb, 114);
+			}
+		}
+	}
+}
+
+#undef A5BS_GROUP
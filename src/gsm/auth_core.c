@@ -120,6 +120,47 @@ int osmo_auth_gen_vec(struct osmo_auth_vector *vec,
 	return 0;
 }
 
+/*! \brief Generate several authentication vectors of one subscriber
+ *  \param[out] vec Array of \a num generated authentication vectors
+ *  \param[in] num Number of vectors to generate
+ *  \param[in] aud Subscriber-specific key material
+ *  \param[in] _rand \a num random challenges of 16 bytes each
+ *
+ * The result is the same as calling osmo_auth_gen_vec() \a num times,
+ * i.e. the sequence number of UMTS subscribers is incremented for each
+ * vector. Implementations can set up the subscriber key only once for
+ * all of them, which is what an AUC answering a SendAuthInfo with
+ * several quintuplets wants.
+ */
+int osmo_auth_gen_vec_batch(struct osmo_auth_vector *vec, unsigned int num,
+			    struct osmo_sub_auth_data *aud,
+			    const uint8_t *_rand)
+{
+	struct osmo_auth_impl *impl = selected_auths[aud->algo];
+	unsigned int i;
+	int rc;
+
+	if (!impl)
+		return -ENOENT;
+
+	if (impl->gen_vec_batch) {
+		rc = impl->gen_vec_batch(vec, num, aud, _rand);
+		if (rc < 0)
+			return rc;
+	} else {
+		for (i = 0; i < num; i++) {
+			rc = impl->gen_vec(&vec[i], aud, _rand + 16 * i);
+			if (rc < 0)
+				return rc;
+		}
+	}
+
+	for (i = 0; i < num; i++)
+		memcpy(vec[i].rand, _rand + 16 * i, sizeof(vec[i].rand));
+
+	return 0;
+}
+
 /*! \brief Generate authentication vector and re-sync sequence
  *  \param[out] vec Generated authentication vector
  *  \param[in] aud Subscriber-specific key material
@@ -54,29 +54,49 @@ static uint64_t sqn_48bit_to_u64(const uint8_t *sqn)
 }
 
 
-static int milenage_gen_vec(struct osmo_auth_vector *vec,
-			    struct osmo_sub_auth_data *aud,
-			    const uint8_t *_rand)
+/* one vector with K already expanded; the GSM values are derived from
+ * RES, CK and IK instead of running f2345 a second time */
+static void milenage_gen_vec_ctx(struct osmo_auth_vector *vec,
+				 const struct milenage_ctx *ctx,
+				 struct osmo_sub_auth_data *aud,
+				 const uint8_t *_rand)
 {
 	size_t res_len = sizeof(vec->res);
 	uint8_t sqn[6];
-	int rc;
 
 	sqn_u64_to_48bit(sqn, aud->u.umts.sqn);
-	milenage_generate(aud->u.umts.opc, aud->u.umts.amf, aud->u.umts.k,
-			  sqn, _rand,
-			  vec->autn, vec->ik, vec->ck, vec->res, &res_len);
+	milenage_generate_ctx(ctx, aud->u.umts.amf, sqn, _rand,
+			      vec->autn, vec->ik, vec->ck, vec->res, &res_len);
 	vec->res_len = res_len;
-	rc = gsm_milenage(aud->u.umts.opc, aud->u.umts.k, _rand, vec->sres, vec->kc);
-	if (rc < 0)
-		return rc;
+	gsm_milenage_c2c3(vec->res, vec->ck, vec->ik, vec->sres, vec->kc);
 
 	vec->auth_types = OSMO_AUTH_TYPE_UMTS | OSMO_AUTH_TYPE_GSM;
 	aud->u.umts.sqn++;
+}
+
+static int milenage_gen_vec_batch(struct osmo_auth_vector *vec,
+				  unsigned int num,
+				  struct osmo_sub_auth_data *aud,
+				  const uint8_t *_rand)
+{
+	struct milenage_ctx ctx;
+	unsigned int i;
+
+	milenage_ctx_init(&ctx, aud->u.umts.opc, aud->u.umts.k);
+	for (i = 0; i < num; i++)
+		milenage_gen_vec_ctx(&vec[i], &ctx, aud, _rand + 16 * i);
+	milenage_ctx_clear(&ctx);
 
 	return 0;
 }
 
+static int milenage_gen_vec(struct osmo_auth_vector *vec,
+			    struct osmo_sub_auth_data *aud,
+			    const uint8_t *_rand)
+{
+	return milenage_gen_vec_batch(vec, 1, aud, _rand);
+}
+
 static int milenage_gen_vec_auts(struct osmo_auth_vector *vec,
 				 struct osmo_sub_auth_data *aud,
 				 const uint8_t *auts, const uint8_t *rand_auts,
@@ -112,6 +132,7 @@ static struct osmo_auth_impl milenage_alg = {
 	.priority = 1000,
 	.gen_vec = &milenage_gen_vec,
 	.gen_vec_auts = &milenage_gen_vec_auts,
+	.gen_vec_batch = &milenage_gen_vec_batch,
 };
 
 static __attribute__((constructor)) void on_dso_load_milenage(void)
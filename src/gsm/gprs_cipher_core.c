@@ -22,6 +22,7 @@
 
 #include <errno.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <osmocom/core/utils.h>
 #include <osmocom/core/linuxlist.h>
@@ -73,6 +74,54 @@ int gprs_cipher_run(uint8_t *out, uint16_t len, enum gprs_ciph_algo algo,
 	return selected_ciphers[algo]->run(out, len, kc, iv, dir);
 }
 
+/* prepare Kc for repeated use with gprs_cipher_run_key().  The key is
+ * bound to the implementation selected at this time */
+int gprs_cipher_key_init(struct gprs_cipher_key *key, enum gprs_ciph_algo algo,
+			 uint64_t kc)
+{
+	if (algo >= ARRAY_SIZE(selected_ciphers))
+		return -ERANGE;
+
+	if (!selected_ciphers[algo])
+		return -EINVAL;
+
+	memset(key, 0, sizeof(*key));
+	key->algo = algo;
+	key->kc = kc;
+	key->impl = selected_ciphers[algo];
+
+	if (!key->impl->prepare_key)
+		return 0;
+
+	return key->impl->prepare_key(key);
+}
+
+/* wipe the key material of a prepared key.  The barrier keeps the
+ * compiler from dropping the memset() of a soon to be dead object */
+void gprs_cipher_key_clear(struct gprs_cipher_key *key)
+{
+	memset(key, 0, sizeof(*key));
+	__asm__ __volatile__("" : : "r"(key) : "memory");
+}
+
+/* as gprs_cipher_run(), with a key prepared by gprs_cipher_key_init() */
+int gprs_cipher_run_key(uint8_t *out, uint16_t len,
+			const struct gprs_cipher_key *key, uint32_t iv,
+			enum gprs_cipher_direction dir)
+{
+	if (!key->impl)
+		return -EINVAL;
+
+	if (len > GSM0464_CIPH_MAX_BLOCK)
+		return -ERANGE;
+
+	/* implementations without prepared keys get Kc for every frame */
+	if (!key->impl->run_key)
+		return key->impl->run(out, len, key->kc, iv, dir);
+
+	return key->impl->run_key(out, len, key, iv, dir);
+}
+
 int gprs_cipher_supported(enum gprs_ciph_algo algo)
 {
 	if (algo >= ARRAY_SIZE(selected_ciphers))
@@ -0,0 +1,78 @@
+/* GPRS GEA3 cipher, built on the KASUMI KGCORE */
+
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/crypt/gprs_cipher.h>
+#include <osmocom/gsm/kasumi.h>
+
+/* Kc is passed with its first octet in the least significant byte, CK
+ * is Kc concatenated with itself (TS 55.216 4.2) */
+static int gea3_prepare_key(struct gprs_cipher_key *key)
+{
+	uint8_t ck[16];
+
+	osmo_store64le(key->kc, ck);
+	memcpy(ck + 8, ck, 8);
+	_kasumi_kgcore_key_init(&key->u.kasumi, ck);
+
+	/* the same barrier as gprs_cipher_key_clear() */
+	memset(ck, 0, sizeof(ck));
+	__asm__ __volatile__("" : : "r"(ck) : "memory");
+	return 0;
+}
+
+/* TS 55.216 4.2: CA = 0xFF, CB = 0, CC = INPUT, CD = DIRECTION, CE = 0 */
+static int gea3_run_key(uint8_t *out, uint16_t len,
+			const struct gprs_cipher_key *key, uint32_t iv,
+			enum gprs_cipher_direction direction)
+{
+	_kasumi_kgcore_prepared(&key->u.kasumi, 0xFF, 0, iv, direction,
+				out, len * 8);
+	return 0;
+}
+
+/* one-off frame: expand the key schedules just for this one */
+static int gea3_run(uint8_t *out, uint16_t len, uint64_t kc, uint32_t iv,
+		    enum gprs_cipher_direction direction)
+{
+	struct gprs_cipher_key key;
+
+	key.kc = kc;
+	gea3_prepare_key(&key);
+	gea3_run_key(out, len, &key, iv, direction);
+	gprs_cipher_key_clear(&key);
+	return 0;
+}
+
+static struct gprs_cipher_impl gea3_impl = {
+	.algo = GPRS_ALGO_GEA3,
+	.name = "GEA3 (libosmogsm built-in)",
+	.priority = 1000,
+	.run = &gea3_run,
+	.prepare_key = &gea3_prepare_key,
+	.run_key = &gea3_run_key,
+};
+
+static __attribute__((constructor)) void on_dso_load_gea3(void)
+{
+	gprs_cipher_register(&gea3_impl);
+}
@@ -432,6 +432,67 @@ const struct tlv_definition *gsm0808_att_tlvdef(void)
 	return &bss_att_tlvdef;
 }
 
+/* IEs of the BSSMAP messages following the message type, see 3GPP TS
+ * 48.008 Chapter 3.2.1 */
+static const struct tlv_msg_def bss_msg_defs[] = {
+	TLV_MSG_DEF(BSS_MAP_MSG_ASSIGMENT_RQST,
+		    TLV_IE_M(GSM0808_IE_CHANNEL_TYPE, 3),
+		    TLV_IE_O(GSM0808_IE_CIRCUIT_IDENTITY_CODE, 2)),
+	TLV_MSG_DEF(BSS_MAP_MSG_ASSIGMENT_COMPLETE,
+		    TLV_IE_O(GSM0808_IE_RR_CAUSE, 1),
+		    TLV_IE_O(GSM0808_IE_CHOSEN_CHANNEL, 1),
+		    TLV_IE_O(GSM0808_IE_CHOSEN_ENCR_ALG, 1),
+		    TLV_IE_O(GSM0808_IE_SPEECH_VERSION, 1)),
+	TLV_MSG_DEF(BSS_MAP_MSG_ASSIGMENT_FAILURE,
+		    TLV_IE_M(GSM0808_IE_CAUSE, 1),
+		    TLV_IE_O(GSM0808_IE_RR_CAUSE, 1)),
+	TLV_MSG_DEF(BSS_MAP_MSG_HANDOVER_REQUIRED,
+		    TLV_IE_M(GSM0808_IE_CAUSE, 1),
+		    TLV_IE_M(GSM0808_IE_CELL_IDENTIFIER_LIST, 2)),
+	TLV_MSG_DEF(BSS_MAP_MSG_CLEAR_CMD,
+		    TLV_IE_O(GSM0808_IE_LAYER_3_HEADER_INFORMATION, 2),
+		    TLV_IE_M(GSM0808_IE_CAUSE, 1)),
+	TLV_MSG_DEF(BSS_MAP_MSG_CLEAR_RQST,
+		    TLV_IE_M(GSM0808_IE_CAUSE, 1)),
+	TLV_MSG_DEF(BSS_MAP_MSG_SAPI_N_REJECT,
+		    TLV_IE_M(GSM0808_IE_DLCI, 1),
+		    TLV_IE_M(GSM0808_IE_CAUSE, 1)),
+	TLV_MSG_DEF(BSS_MAP_MSG_RESET,
+		    TLV_IE_M(GSM0808_IE_CAUSE, 1)),
+	TLV_MSG_DEF(BSS_MAP_MSG_PAGING,
+		    TLV_IE_M(GSM0808_IE_IMSI, 1),
+		    TLV_IE_O(GSM0808_IE_TMSI, 4),
+		    TLV_IE_M(GSM0808_IE_CELL_IDENTIFIER_LIST, 1),
+		    TLV_IE_O(GSM0808_IE_CHANNEL_NEEDED, 1)),
+	TLV_MSG_DEF(BSS_MAP_MSG_CIPHER_MODE_CMD,
+		    TLV_IE_O(GSM0808_IE_LAYER_3_HEADER_INFORMATION, 2),
+		    TLV_IE_M(GSM0808_IE_ENCRYPTION_INFORMATION, 1),
+		    TLV_IE_O(GSM0808_IE_CIPHER_RESPONSE_MODE, 1)),
+	TLV_MSG_DEF(BSS_MAP_MSG_CLASSMARK_UPDATE,
+		    TLV_IE_M(GSM0808_IE_CLASSMARK_INFORMATION_T2, 2),
+		    TLV_IE_O(GSM0808_IE_CLASSMARK_INFORMATION_T3, 1)),
+	TLV_MSG_DEF(BSS_MAP_MSG_CIPHER_MODE_COMPLETE,
+		    TLV_IE_O(GSM0808_IE_LAYER_3_MESSAGE_CONTENTS, 1),
+		    TLV_IE_O(GSM0808_IE_CHOSEN_ENCR_ALG, 1)),
+	TLV_MSG_DEF(BSS_MAP_MSG_COMPLETE_LAYER_3,
+		    TLV_IE_M(GSM0808_IE_CELL_IDENTIFIER, 3),
+		    TLV_IE_M(GSM0808_IE_LAYER_3_INFORMATION, 1),
+		    TLV_IE_O(GSM0808_IE_CHOSEN_CHANNEL, 1)),
+	TLV_MSG_DEF(BSS_MAP_MSG_CIPHER_MODE_REJECT,
+		    TLV_IE_M(GSM0808_IE_CAUSE, 1)),
+};
+
+/*! \brief \ref gsm0808_att_tlvdef compiled with the BSSMAP message IE rules
+ *  \returns compiled definition for \ref tlv_decode
+ */
+const struct tlv_compiled_def *gsm0808_att_tlvdef_compiled(void)
+{
+	static struct tlv_compiled_once once =
+		TLV_COMPILED_ONCE(&bss_att_tlvdef, bss_msg_defs);
+
+	return tlv_compiled_get(&once);
+}
+
 static const struct value_string gsm0808_msgt_names[] = {
 	{ BSS_MAP_MSG_ASSIGMENT_RQST,		"ASSIGNMENT REQ" },
 	{ BSS_MAP_MSG_ASSIGMENT_COMPLETE,	"ASSIGNMENT COMPL" },
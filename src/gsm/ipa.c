@@ -28,6 +28,7 @@
 
 #include <arpa/inet.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 
 #include <osmocom/core/msgb.h>
@@ -219,6 +220,28 @@ int ipa_send(int fd, const void *msg, size_t msglen)
 	return ret;
 }
 
+/* all fragments of a msgb chain are written by a single writev(), so
+ * the payload needn't be copied behind the IPA header */
+int ipa_msg_send(int fd, const struct msgb *msg)
+{
+	struct iovec iov[MSGB_IOV_MAX];
+	unsigned int len = msgb_chain_len(msg);
+	int ret;
+
+	ret = msgb_iovec(msg, iov, ARRAY_SIZE(iov));
+	if (ret < 0)
+		return ret;
+
+	ret = writev(fd, iov, ret);
+	if (ret < 0)
+		return -errno;
+	if (ret < len) {
+		LOGP(DLINP, LOGL_ERROR, "ipa_msg_send: short write\n");
+		return -EIO;
+	}
+	return ret;
+}
+
 int ipa_ccm_send_pong(int fd)
 {
 	return ipa_send(fd, ipa_pong_msg, sizeof(ipa_pong_msg));
@@ -312,7 +335,7 @@ void ipa_prepend_header(struct msgb *msg, int proto)
 
 	/* prepend the ip.access header */
 	hh = (struct ipaccess_head *) msgb_push(msg, sizeof(*hh));
-	hh->len = htons(msg->len - sizeof(*hh));
+	hh->len = htons(msgb_chain_len(msg) - sizeof(*hh));
 	hh->proto = proto;
 }
 
@@ -21,6 +21,8 @@
  */
 
 #include <stdint.h>
+#include <string.h>
+
 #include <osmocom/core/bits.h>
 #include <osmocom/gsm/kasumi.h>
 
@@ -157,30 +159,126 @@ void _kasumi_key_expand(const uint8_t *key, uint16_t *KLi1, uint16_t *KLi2, uint
 	}
 }
 
-void _kasumi_kgcore(uint8_t CA, uint8_t cb, uint32_t cc, uint8_t cd, const uint8_t *ck, uint8_t *co, uint16_t cl)
+void _kasumi_kgcore_key_init(struct kasumi_kgcore_key *k, const uint8_t *ck)
 {
-	uint16_t KLi1[8], KLi2[8], KOi1[8], KOi2[8], KOi3[8], KIi1[8], KIi2[8], KIi3[8], i;
-	uint64_t A = ((uint64_t)cc) << 32, BLK = 0, _ca = ((uint64_t)CA << 16) ;
-	A |= _ca;
-	_ca = (uint64_t)((cb << 3) | (cd << 2)) << 24;
-	A |= _ca;
-	/* Register loading complete: see TR 55.919 8.2 and TS 55.216 3.2 */
-
 	uint8_t ck_km[16];
+	unsigned int i;
+
 	for (i = 0; i < 16; i++)
 		ck_km[i] = ck[i] ^ 0x55;
 	/* Modified key established */
 
+	_kasumi_key_expand(ck_km, k->km.KLi1, k->km.KLi2, k->km.KOi1, k->km.KOi2, k->km.KOi3, k->km.KIi1, k->km.KIi2, k->km.KIi3);
+	_kasumi_key_expand(ck, k->ck.KLi1, k->ck.KLi2, k->ck.KOi1, k->ck.KOi2, k->ck.KOi3, k->ck.KIi1, k->ck.KIi2, k->ck.KIi3);
+}
+
+inline static uint64_t kasumi_sched(uint64_t P, const struct kasumi_sched *s)
+{
+	return _kasumi(P, s->KLi1, s->KLi2, s->KOi1, s->KOi2, s->KOi3, s->KIi1, s->KIi2, s->KIi3);
+}
+
+/* Register loading: see TR 55.919 8.2 and TS 55.216 3.2 */
+inline static uint64_t kgcore_reg(uint8_t CA, uint8_t cb, uint32_t cc, uint8_t cd)
+{
+	return ((uint64_t)cc << 32) | ((uint64_t)CA << 16) |
+	       ((uint64_t)((cb << 3) | (cd << 2)) << 24);
+}
+
+/* store the first len bytes of a keystream block */
+inline static void kgcore_store(uint64_t BLK, uint8_t *co, unsigned int len)
+{
+	uint8_t tmp[8];
+
+	if (len >= 8) {
+		osmo_store64be(BLK, co);
+		return;
+	}
+	osmo_store64be(BLK, tmp);
+	memcpy(co, tmp, len);
+}
+
+void _kasumi_kgcore_prepared(const struct kasumi_kgcore_key *k, uint8_t CA, uint8_t cb, uint32_t cc, uint8_t cd, uint8_t *co, uint16_t cl)
+{
+	unsigned int i, len = (cl + 7) / 8;
+	uint64_t A, BLK = 0;
+
 	/* preliminary round with modified key */
-	_kasumi_key_expand(ck_km, KLi1, KLi2, KOi1, KOi2, KOi3, KIi1, KIi2, KIi3);
-	A = _kasumi(A, KLi1, KLi2, KOi1, KOi2, KOi3, KIi1, KIi2, KIi3);
+	A = kasumi_sched(kgcore_reg(CA, cb, cc, cd), &k->km);
 
 	/* Run Kasumi in OFB to obtain enough data for gamma. */
-	_kasumi_key_expand(ck, KLi1, KLi2, KOi1, KOi2, KOi3, KIi1, KIi2, KIi3);
+	for (i = 0; 8 * i < len; i++) {
+		BLK = kasumi_sched(A ^ i ^ BLK, &k->ck);
+		kgcore_store(BLK, co + 8 * i, len - 8 * i);
+	}
+}
+
+/* KASUMI on KASUMI_LANES independent blocks, each with its own key
+ * schedule. The rounds of all blocks are interleaved, so that the S-box
+ * lookups of one block overlap with those of the others instead of
+ * waiting for the previous round of the same block. */
+static void kasumi_lanes(uint64_t *blk, const struct kasumi_sched *const *s)
+{
+	uint32_t L[KASUMI_LANES], R[KASUMI_LANES];
+	unsigned int i, j;
+
+	for (j = 0; j < KASUMI_LANES; j++) {
+		L[j] = blk[j] >> 32;
+		R[j] = blk[j];
+	}
+
+	for (i = 0; i < 8; i += 2) {
+		for (j = 0; j < KASUMI_LANES; j++)
+			R[j] ^= kasumi_FO(kasumi_FL(L[j], s[j]->KLi1, s[j]->KLi2, i), s[j]->KOi1, s[j]->KOi2, s[j]->KOi3, s[j]->KIi1, s[j]->KIi2, s[j]->KIi3, i); /* odd round */
+		for (j = 0; j < KASUMI_LANES; j++)
+			L[j] ^= kasumi_FL(kasumi_FO(R[j], s[j]->KOi1, s[j]->KOi2, s[j]->KOi3, s[j]->KIi1, s[j]->KIi2, s[j]->KIi3, i + 1), s[j]->KLi1, s[j]->KLi2, i + 1); /* even round */
+	}
+
+	for (j = 0; j < KASUMI_LANES; j++)
+		blk[j] = (((uint64_t)L[j]) << 32) + R[j];
+}
+
+void _kasumi_kgcore_multi(const struct kasumi_kgcore_key *const *k, const uint32_t *cc, unsigned int n, uint8_t CA, uint8_t cb, uint8_t cd, uint8_t *co, uint16_t cl)
+{
+	const unsigned int len = (cl + 7) / 8;
+
+	while (n) {
+		const struct kasumi_sched *s[KASUMI_LANES];
+		uint64_t A[KASUMI_LANES], BLK[KASUMI_LANES];
+		unsigned int i, j, num = n < KASUMI_LANES ? n : KASUMI_LANES;
+
+		/* unused lanes redo the first stream */
+		for (j = 0; j < KASUMI_LANES; j++) {
+			unsigned int l = j < num ? j : 0;
+
+			A[j] = kgcore_reg(CA, cb, cc[l], cd);
+			s[j] = &k[l]->km;
+		}
+		kasumi_lanes(A, s);
+
+		for (j = 0; j < KASUMI_LANES; j++) {
+			s[j] = &k[j < num ? j : 0]->ck;
+			BLK[j] = 0;
+		}
+		for (i = 0; 8 * i < len; i++) {
+			for (j = 0; j < KASUMI_LANES; j++)
+				BLK[j] ^= A[j] ^ i;
+			kasumi_lanes(BLK, s);
+			for (j = 0; j < num; j++)
+				kgcore_store(BLK[j], co + j * len + 8 * i, len - 8 * i);
+		}
 
-	/* i is a block counter */
-	for (i = 0; i < cl / 64 + 1; i++) {
-		BLK = _kasumi(A ^ i ^ BLK, KLi1, KLi2, KOi1, KOi2, KOi3, KIi1, KIi2, KIi3);
-		osmo_store64be(BLK, co + (i * 8));
+		k += num;
+		cc += num;
+		co += num * len;
+		n -= num;
 	}
 }
+
+void _kasumi_kgcore(uint8_t CA, uint8_t cb, uint32_t cc, uint8_t cd, const uint8_t *ck, uint8_t *co, uint16_t cl)
+{
+	struct kasumi_kgcore_key k;
+
+	_kasumi_kgcore_key_init(&k, ck);
+	/* always a whole number of blocks, at least one more than cl / 64 */
+	_kasumi_kgcore_prepared(&k, CA, cb, cc, cd, co, (cl / 64 + 1) * 64);
+}
@@ -785,7 +785,7 @@ static int rslms_rx_rll_est_req(struct msgb *msg, struct lapdm_datalink *dl)
 	uint8_t chan_nr = rllh->chan_nr;
 	uint8_t link_id = rllh->link_id;
 	uint8_t sapi = rllh->link_id & 7;
-	struct tlv_parsed tv;
+	struct tlv_parsed_sparse tv;
 	uint8_t length;
 	uint8_t n201 = (rllh->link_id & 0x40) ? N201_AB_SACCH : N201_AB_SDCCH;
 	struct osmo_dlsap_prim dp;
@@ -793,9 +793,15 @@ static int rslms_rx_rll_est_req(struct msgb *msg, struct lapdm_datalink *dl)
 	/* Set LAPDm context for established connection */
 	set_lapdm_context(dl, chan_nr, link_id, n201, sapi);
 
-	rsl_tlv_parse(&tv, rllh->data, msgb_l2len(msg) - sizeof(*rllh));
-	if (TLVP_PRESENT(&tv, RSL_IE_L3_INFO)) {
-		msg->l3h = (uint8_t *) TLVP_VAL(&tv, RSL_IE_L3_INFO);
+	if (rsl_tlv_decode(&tv, rllh->c.msg_type, rllh->data,
+			   msgb_l2len(msg) - sizeof(*rllh), NULL) < 0) {
+		LOGP(DLLAPD, LOGL_ERROR, "establish request with invalid IEs "
+			"(discarding)\n");
+		msgb_free(msg);
+		return send_rll_simple(RSL_MT_REL_IND, &dl->mctx);
+	}
+	if (TLVPS_PRESENT(&tv, RSL_IE_L3_INFO)) {
+		msg->l3h = (uint8_t *) TLVPS_VAL(&tv, RSL_IE_L3_INFO);
 		/* contention resolution establishment procedure */
 		if (sapi != 0) {
 			/* According to clause 6, the contention resolution
@@ -807,7 +813,7 @@ static int rslms_rx_rll_est_req(struct msgb *msg, struct lapdm_datalink *dl)
 		}
 		/* transmit a SABM command with the P bit set to "1". The SABM
 		 * command shall contain the layer 3 message unit */
-		length = TLVP_LEN(&tv, RSL_IE_L3_INFO);
+		length = TLVPS_LEN(&tv, RSL_IE_L3_INFO);
 	} else {
 		/* normal establishment procedure */
 		msg->l3h = msg->l2h + sizeof(*rllh);
@@ -842,27 +848,27 @@ static int rslms_rx_rll_udata_req(struct msgb *msg, struct lapdm_datalink *dl)
 	uint8_t link_id = rllh->link_id;
 	int ui_bts = (le->mode == LAPDM_MODE_BTS && (link_id & 0x40));
 	uint8_t sapi = link_id & 7;
-	struct tlv_parsed tv;
+	struct tlv_parsed_sparse tv;
 	int length;
 
 	/* check if the layer3 message length exceeds N201 */
 
-	rsl_tlv_parse(&tv, rllh->data, msgb_l2len(msg)-sizeof(*rllh));
-
-	if (TLVP_PRESENT(&tv, RSL_IE_TIMING_ADVANCE)) {
-		le->ta = *TLVP_VAL(&tv, RSL_IE_TIMING_ADVANCE);
-	}
-	if (TLVP_PRESENT(&tv, RSL_IE_MS_POWER)) {
-		le->tx_power = *TLVP_VAL(&tv, RSL_IE_MS_POWER);
-	}
-	if (!TLVP_PRESENT(&tv, RSL_IE_L3_INFO)) {
+	if (rsl_tlv_decode(&tv, rllh->c.msg_type, rllh->data,
+			   msgb_l2len(msg)-sizeof(*rllh), NULL) < 0) {
 		LOGP(DLLAPD, LOGL_ERROR, "unit data request without message "
 			"error\n");
 		msgb_free(msg);
 		return -EINVAL;
 	}
-	msg->l3h = (uint8_t *) TLVP_VAL(&tv, RSL_IE_L3_INFO);
-	length = TLVP_LEN(&tv, RSL_IE_L3_INFO);
+
+	if (TLVPS_PRESENT(&tv, RSL_IE_TIMING_ADVANCE)) {
+		le->ta = *TLVPS_VAL(&tv, RSL_IE_TIMING_ADVANCE);
+	}
+	if (TLVPS_PRESENT(&tv, RSL_IE_MS_POWER)) {
+		le->tx_power = *TLVPS_VAL(&tv, RSL_IE_MS_POWER);
+	}
+	msg->l3h = (uint8_t *) TLVPS_VAL(&tv, RSL_IE_L3_INFO);
+	length = TLVPS_LEN(&tv, RSL_IE_L3_INFO);
 	/* check if the layer3 message length exceeds N201 */
 	if (length + ((link_id & 0x40) ? 4 : 2) + !ui_bts > 23) {
 		LOGP(DLLAPD, LOGL_ERROR, "frame too large: %d > N201(%d) "
@@ -899,19 +905,19 @@ static int rslms_rx_rll_udata_req(struct msgb *msg, struct lapdm_datalink *dl)
 static int rslms_rx_rll_data_req(struct msgb *msg, struct lapdm_datalink *dl)
 {
 	struct abis_rsl_rll_hdr *rllh = msgb_l2(msg);
-	struct tlv_parsed tv;
+	struct tlv_parsed_sparse tv;
 	int length;
 	struct osmo_dlsap_prim dp;
 
-	rsl_tlv_parse(&tv, rllh->data, msgb_l2len(msg)-sizeof(*rllh));
-	if (!TLVP_PRESENT(&tv, RSL_IE_L3_INFO)) {
+	if (rsl_tlv_decode(&tv, rllh->c.msg_type, rllh->data,
+			   msgb_l2len(msg)-sizeof(*rllh), NULL) < 0) {
 		LOGP(DLLAPD, LOGL_ERROR, "data request without message "
 			"error\n");
 		msgb_free(msg);
 		return -EINVAL;
 	}
-	msg->l3h = (uint8_t *) TLVP_VAL(&tv, RSL_IE_L3_INFO);
-	length = TLVP_LEN(&tv, RSL_IE_L3_INFO);
+	msg->l3h = (uint8_t *) TLVPS_VAL(&tv, RSL_IE_L3_INFO);
+	length = TLVPS_LEN(&tv, RSL_IE_L3_INFO);
 
 	/* Remove RLL header from msgb and set length to L3-info */
 	msgb_pull_to_l3(msg);
@@ -952,7 +958,7 @@ static int rslms_rx_rll_res_req(struct msgb *msg, struct lapdm_datalink *dl)
 	uint8_t chan_nr = rllh->chan_nr;
 	uint8_t link_id = rllh->link_id;
 	uint8_t sapi = rllh->link_id & 7;
-	struct tlv_parsed tv;
+	struct tlv_parsed_sparse tv;
 	uint8_t length;
 	uint8_t n201 = (rllh->link_id & 0x40) ? N201_AB_SACCH : N201_AB_SDCCH;
 	struct osmo_dlsap_prim dp;
@@ -960,14 +966,14 @@ static int rslms_rx_rll_res_req(struct msgb *msg, struct lapdm_datalink *dl)
 	/* Set LAPDm context for established connection */
 	set_lapdm_context(dl, chan_nr, link_id, n201, sapi);
 
-	rsl_tlv_parse(&tv, rllh->data, msgb_l2len(msg)-sizeof(*rllh));
-	if (!TLVP_PRESENT(&tv, RSL_IE_L3_INFO)) {
+	if (rsl_tlv_decode(&tv, msg_type, rllh->data,
+			   msgb_l2len(msg)-sizeof(*rllh), NULL) < 0) {
 		LOGP(DLLAPD, LOGL_ERROR, "resume without message error\n");
 		msgb_free(msg);
 		return send_rll_simple(RSL_MT_REL_IND, &dl->mctx);
 	}
-	msg->l3h = (uint8_t *) TLVP_VAL(&tv, RSL_IE_L3_INFO);
-	length = TLVP_LEN(&tv, RSL_IE_L3_INFO);
+	msg->l3h = (uint8_t *) TLVPS_VAL(&tv, RSL_IE_L3_INFO);
+	length = TLVPS_LEN(&tv, RSL_IE_L3_INFO);
 
 	/* Remove RLL header from msgb and set length to L3-info */
 	msgb_pull_to_l3(msg);
@@ -28,11 +28,9 @@
  */
 int aes_128_encrypt_block(const u8 *key, const u8 *in, u8 *out)
 {
-	void *ctx;
-	ctx = aes_encrypt_init(key, 16);
-	if (ctx == NULL)
-		return -1;
-	aes_encrypt(ctx, in, out);
-	aes_encrypt_deinit(ctx);
+	struct aes_enc_ctx ctx;
+	aes_encrypt_init_ctx(&ctx, key);
+	aes_encrypt_ctx(&ctx, in, out);
+	os_memset(&ctx, 0, sizeof(ctx));
 	return 0;
 }
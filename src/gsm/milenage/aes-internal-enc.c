@@ -21,12 +21,18 @@
  * See README and COPYING for more details.
  */
 
+#include "../../../config.h"
+
 #include "includes.h"
 
 #include "common.h"
 #include "crypto.h"
 #include "aes_i.h"
 
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 static void rijndaelEncrypt(const u32 rk[/*44*/], const u8 pt[16], u8 ct[16])
 {
 	u32 s0, s1, s2, s3, t0, t1, t2, t3;
@@ -95,27 +101,82 @@ d##3 = TE0(s##3) ^ TE1(s##0) ^ TE2(s##1) ^ TE3(s##2) ^ rk[4 * i + 3]
 }
 
 
+#ifdef HAVE_X86_SIMD
+__attribute__((target("aes,sse2")))
+static void aesni_encrypt(const u8 rk[/*176*/], const u8 pt[16], u8 ct[16])
+{
+	__m128i s = _mm_loadu_si128((const __m128i *) pt);
+	int r;
+
+	s = _mm_xor_si128(s, _mm_loadu_si128((const __m128i *) rk));
+	for (r = 1; r < 10; r++)
+		s = _mm_aesenc_si128(s, _mm_loadu_si128((const __m128i *) (rk + 16 * r)));
+	s = _mm_aesenclast_si128(s, _mm_loadu_si128((const __m128i *) (rk + 160)));
+	_mm_storeu_si128((__m128i *) ct, s);
+}
+
+static int aesni_supported(void)
+{
+	static int supported = -1;
+
+	if (supported < 0) {
+		__builtin_cpu_init();
+		supported = __builtin_cpu_supports("aes");
+	}
+	return supported;
+}
+#endif /* HAVE_X86_SIMD */
+
+
+void aes_encrypt_init_ctx(struct aes_enc_ctx *ctx, const u8 *key)
+{
+	rijndaelKeySetupEnc(ctx->rk, key);
+	ctx->aesni = 0;
+#ifdef HAVE_X86_SIMD
+	if (aesni_supported()) {
+		int i;
+
+		for (i = 0; i < 44; i++)
+			PUTU32(ctx->rk_bytes + 4 * i, ctx->rk[i]);
+		ctx->aesni = 1;
+	}
+#endif
+}
+
+
+void aes_encrypt_ctx(const struct aes_enc_ctx *ctx, const u8 *plain, u8 *crypt)
+{
+#ifdef HAVE_X86_SIMD
+	if (ctx->aesni) {
+		aesni_encrypt(ctx->rk_bytes, plain, crypt);
+		return;
+	}
+#endif
+	rijndaelEncrypt(ctx->rk, plain, crypt);
+}
+
+
 void * aes_encrypt_init(const u8 *key, size_t len)
 {
-	u32 *rk;
+	struct aes_enc_ctx *ctx;
 	if (len != 16)
 		return NULL;
-	rk = os_malloc(AES_PRIV_SIZE);
-	if (rk == NULL)
+	ctx = os_malloc(sizeof(*ctx));
+	if (ctx == NULL)
 		return NULL;
-	rijndaelKeySetupEnc(rk, key);
-	return rk;
+	aes_encrypt_init_ctx(ctx, key);
+	return ctx;
 }
 
 
 void aes_encrypt(void *ctx, const u8 *plain, u8 *crypt)
 {
-	rijndaelEncrypt(ctx, plain, crypt);
+	aes_encrypt_ctx(ctx, plain, crypt);
 }
 
 
 void aes_encrypt_deinit(void *ctx)
 {
-	os_memset(ctx, 0, AES_PRIV_SIZE);
+	os_memset(ctx, 0, sizeof(struct aes_enc_ctx));
 	os_free(ctx);
 }
@@ -16,6 +16,17 @@
 
 #define AES_BLOCK_SIZE 16
 
+/* AES-128 encryption key schedule, to be kept on the stack or embedded
+ * in another context instead of being allocated by aes_encrypt_init() */
+struct aes_enc_ctx {
+	u32 rk[44];		/* round keys as big endian words */
+	u8 rk_bytes[176];	/* the same as bytes, used by AES-NI */
+	int aesni;
+};
+
+void aes_encrypt_init_ctx(struct aes_enc_ctx *ctx, const u8 *key);
+void aes_encrypt_ctx(const struct aes_enc_ctx *ctx, const u8 *plain, u8 *crypt);
+
 void * aes_encrypt_init(const u8 *key, size_t len);
 void aes_encrypt(void *ctx, const u8 *plain, u8 *crypt);
 void aes_encrypt_deinit(void *ctx);
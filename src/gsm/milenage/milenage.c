@@ -24,32 +24,59 @@
 #include "includes.h"
 
 #include "common.h"
+#include "aes.h"
 #include "aes_wrap.h"
 #include "milenage.h"
 
 
 /**
- * milenage_f1 - Milenage f1 and f1* algorithms
+ * milenage_ctx_init - Expand K for use by the milenage_*_ctx() functions
+ * @ctx: Context to initialize, typically on the stack
  * @opc: OPc = 128-bit value derived from OP and K
  * @k: K = 128-bit subscriber key
+ */
+void milenage_ctx_init(struct milenage_ctx *ctx, const u8 *opc, const u8 *k)
+{
+	aes_encrypt_init_ctx(&ctx->aes, k);
+	os_memcpy(ctx->opc, opc, 16);
+}
+
+
+/**
+ * milenage_ctx_clear - Wipe the key material of a context
+ * @ctx: Context initialized by milenage_ctx_init()
+ */
+void milenage_ctx_clear(struct milenage_ctx *ctx)
+{
+	os_memset(ctx, 0, sizeof(*ctx));
+}
+
+
+/**
+ * milenage_temp - TEMP = E_K(RAND XOR OP_C), shared by f1 and f2345
+ * @ctx: Context initialized by milenage_ctx_init()
  * @_rand: RAND = 128-bit random challenge
- * @sqn: SQN = 48-bit sequence number
- * @amf: AMF = 16-bit authentication management field
- * @mac_a: Buffer for MAC-A = 64-bit network authentication code, or %NULL
- * @mac_s: Buffer for MAC-S = 64-bit resync authentication code, or %NULL
- * Returns: 0 on success, -1 on failure
+ * @temp: Buffer for TEMP (16 bytes)
  */
-int milenage_f1(const u8 *opc, const u8 *k, const u8 *_rand,
-		const u8 *sqn, const u8 *amf, u8 *mac_a, u8 *mac_s)
+static void milenage_temp(const struct milenage_ctx *ctx, const u8 *_rand,
+			  u8 *temp)
 {
-	u8 tmp1[16], tmp2[16], tmp3[16];
+	u8 tmp1[16];
 	int i;
 
-	/* tmp1 = TEMP = E_K(RAND XOR OP_C) */
 	for (i = 0; i < 16; i++)
-		tmp1[i] = _rand[i] ^ opc[i];
-	if (aes_128_encrypt_block(k, tmp1, tmp1))
-		return -1;
+		tmp1[i] = _rand[i] ^ ctx->opc[i];
+	aes_encrypt_ctx(&ctx->aes, tmp1, temp);
+}
+
+
+/* f1 and f1* from TEMP, see milenage_f1() */
+static void milenage_f1_temp(const struct milenage_ctx *ctx, const u8 *temp,
+			     const u8 *sqn, const u8 *amf, u8 *mac_a, u8 *mac_s)
+{
+	const u8 *opc = ctx->opc;
+	u8 tmp1[16], tmp2[16], tmp3[16];
+	int i;
 
 	/* tmp2 = IN1 = SQN || AMF || SQN || AMF */
 	os_memcpy(tmp2, sqn, 6);
@@ -63,65 +90,49 @@ int milenage_f1(const u8 *opc, const u8 *k, const u8 *_rand,
 		tmp3[(i + 8) % 16] = tmp2[i] ^ opc[i];
 	/* XOR with TEMP = E_K(RAND XOR OP_C) */
 	for (i = 0; i < 16; i++)
-		tmp3[i] ^= tmp1[i];
+		tmp3[i] ^= temp[i];
 	/* XOR with c1 (= ..00, i.e., NOP) */
 
 	/* f1 || f1* = E_K(tmp3) XOR OP_c */
-	if (aes_128_encrypt_block(k, tmp3, tmp1))
-		return -1;
+	aes_encrypt_ctx(&ctx->aes, tmp3, tmp1);
 	for (i = 0; i < 16; i++)
 		tmp1[i] ^= opc[i];
 	if (mac_a)
 		os_memcpy(mac_a, tmp1, 8); /* f1 */
 	if (mac_s)
 		os_memcpy(mac_s, tmp1 + 8, 8); /* f1* */
-	return 0;
 }
 
 
-/**
- * milenage_f2345 - Milenage f2, f3, f4, f5, f5* algorithms
- * @opc: OPc = 128-bit value derived from OP and K
- * @k: K = 128-bit subscriber key
- * @_rand: RAND = 128-bit random challenge
- * @res: Buffer for RES = 64-bit signed response (f2), or %NULL
- * @ck: Buffer for CK = 128-bit confidentiality key (f3), or %NULL
- * @ik: Buffer for IK = 128-bit integrity key (f4), or %NULL
- * @ak: Buffer for AK = 48-bit anonymity key (f5), or %NULL
- * @akstar: Buffer for AK = 48-bit anonymity key (f5*), or %NULL
- * Returns: 0 on success, -1 on failure
- */
-int milenage_f2345(const u8 *opc, const u8 *k, const u8 *_rand,
-		   u8 *res, u8 *ck, u8 *ik, u8 *ak, u8 *akstar)
+/* f2, f3, f4, f5 and f5* from TEMP, see milenage_f2345() */
+static void milenage_f2345_temp(const struct milenage_ctx *ctx,
+				const u8 *tmp2, u8 *res, u8 *ck, u8 *ik,
+				u8 *ak, u8 *akstar)
 {
-	u8 tmp1[16], tmp2[16], tmp3[16];
+	const u8 *opc = ctx->opc;
+	u8 tmp1[16], tmp3[16];
 	int i;
 
-	/* tmp2 = TEMP = E_K(RAND XOR OP_C) */
-	for (i = 0; i < 16; i++)
-		tmp1[i] = _rand[i] ^ opc[i];
-	if (aes_128_encrypt_block(k, tmp1, tmp2))
-		return -1;
-
 	/* OUT2 = E_K(rot(TEMP XOR OP_C, r2) XOR c2) XOR OP_C */
 	/* OUT3 = E_K(rot(TEMP XOR OP_C, r3) XOR c3) XOR OP_C */
 	/* OUT4 = E_K(rot(TEMP XOR OP_C, r4) XOR c4) XOR OP_C */
 	/* OUT5 = E_K(rot(TEMP XOR OP_C, r5) XOR c5) XOR OP_C */
 
 	/* f2 and f5 */
-	/* rotate by r2 (= 0, i.e., NOP) */
-	for (i = 0; i < 16; i++)
-		tmp1[i] = tmp2[i] ^ opc[i];
-	tmp1[15] ^= 1; /* XOR c2 (= ..01) */
-	/* f5 || f2 = E_K(tmp1) XOR OP_c */
-	if (aes_128_encrypt_block(k, tmp1, tmp3))
-		return -1;
-	for (i = 0; i < 16; i++)
-		tmp3[i] ^= opc[i];
-	if (res)
-		os_memcpy(res, tmp3 + 8, 8); /* f2 */
-	if (ak)
-		os_memcpy(ak, tmp3, 6); /* f5 */
+	if (res || ak) {
+		/* rotate by r2 (= 0, i.e., NOP) */
+		for (i = 0; i < 16; i++)
+			tmp1[i] = tmp2[i] ^ opc[i];
+		tmp1[15] ^= 1; /* XOR c2 (= ..01) */
+		/* f5 || f2 = E_K(tmp1) XOR OP_c */
+		aes_encrypt_ctx(&ctx->aes, tmp1, tmp3);
+		for (i = 0; i < 16; i++)
+			tmp3[i] ^= opc[i];
+		if (res)
+			os_memcpy(res, tmp3 + 8, 8); /* f2 */
+		if (ak)
+			os_memcpy(ak, tmp3, 6); /* f5 */
+	}
 
 	/* f3 */
 	if (ck) {
@@ -129,8 +140,7 @@ int milenage_f2345(const u8 *opc, const u8 *k, const u8 *_rand,
 		for (i = 0; i < 16; i++)
 			tmp1[(i + 12) % 16] = tmp2[i] ^ opc[i];
 		tmp1[15] ^= 2; /* XOR c3 (= ..02) */
-		if (aes_128_encrypt_block(k, tmp1, ck))
-			return -1;
+		aes_encrypt_ctx(&ctx->aes, tmp1, ck);
 		for (i = 0; i < 16; i++)
 			ck[i] ^= opc[i];
 	}
@@ -141,8 +151,7 @@ int milenage_f2345(const u8 *opc, const u8 *k, const u8 *_rand,
 		for (i = 0; i < 16; i++)
 			tmp1[(i + 8) % 16] = tmp2[i] ^ opc[i];
 		tmp1[15] ^= 4; /* XOR c4 (= ..04) */
-		if (aes_128_encrypt_block(k, tmp1, ik))
-			return -1;
+		aes_encrypt_ctx(&ctx->aes, tmp1, ik);
 		for (i = 0; i < 16; i++)
 			ik[i] ^= opc[i];
 	}
@@ -153,21 +162,68 @@ int milenage_f2345(const u8 *opc, const u8 *k, const u8 *_rand,
 		for (i = 0; i < 16; i++)
 			tmp1[(i + 4) % 16] = tmp2[i] ^ opc[i];
 		tmp1[15] ^= 8; /* XOR c5 (= ..08) */
-		if (aes_128_encrypt_block(k, tmp1, tmp1))
-			return -1;
+		aes_encrypt_ctx(&ctx->aes, tmp1, tmp1);
 		for (i = 0; i < 6; i++)
 			akstar[i] = tmp1[i] ^ opc[i];
 	}
+}
+
+
+/**
+ * milenage_f1 - Milenage f1 and f1* algorithms
+ * @opc: OPc = 128-bit value derived from OP and K
+ * @k: K = 128-bit subscriber key
+ * @_rand: RAND = 128-bit random challenge
+ * @sqn: SQN = 48-bit sequence number
+ * @amf: AMF = 16-bit authentication management field
+ * @mac_a: Buffer for MAC-A = 64-bit network authentication code, or %NULL
+ * @mac_s: Buffer for MAC-S = 64-bit resync authentication code, or %NULL
+ * Returns: 0 on success, -1 on failure
+ */
+int milenage_f1(const u8 *opc, const u8 *k, const u8 *_rand,
+		const u8 *sqn, const u8 *amf, u8 *mac_a, u8 *mac_s)
+{
+	struct milenage_ctx ctx;
+	u8 temp[16];
 
+	milenage_ctx_init(&ctx, opc, k);
+	milenage_temp(&ctx, _rand, temp);
+	milenage_f1_temp(&ctx, temp, sqn, amf, mac_a, mac_s);
+	milenage_ctx_clear(&ctx);
 	return 0;
 }
 
 
 /**
- * milenage_generate - Generate AKA AUTN,IK,CK,RES
- * @opc: OPc = 128-bit operator variant algorithm configuration field (encr.)
- * @amf: AMF = 16-bit authentication management field
+ * milenage_f2345 - Milenage f2, f3, f4, f5, f5* algorithms
+ * @opc: OPc = 128-bit value derived from OP and K
  * @k: K = 128-bit subscriber key
+ * @_rand: RAND = 128-bit random challenge
+ * @res: Buffer for RES = 64-bit signed response (f2), or %NULL
+ * @ck: Buffer for CK = 128-bit confidentiality key (f3), or %NULL
+ * @ik: Buffer for IK = 128-bit integrity key (f4), or %NULL
+ * @ak: Buffer for AK = 48-bit anonymity key (f5), or %NULL
+ * @akstar: Buffer for AK = 48-bit anonymity key (f5*), or %NULL
+ * Returns: 0 on success, -1 on failure
+ */
+int milenage_f2345(const u8 *opc, const u8 *k, const u8 *_rand,
+		   u8 *res, u8 *ck, u8 *ik, u8 *ak, u8 *akstar)
+{
+	struct milenage_ctx ctx;
+	u8 temp[16];
+
+	milenage_ctx_init(&ctx, opc, k);
+	milenage_temp(&ctx, _rand, temp);
+	milenage_f2345_temp(&ctx, temp, res, ck, ik, ak, akstar);
+	milenage_ctx_clear(&ctx);
+	return 0;
+}
+
+
+/**
+ * milenage_generate_ctx - Generate AKA AUTN,IK,CK,RES with an expanded K
+ * @ctx: Context initialized by milenage_ctx_init()
+ * @amf: AMF = 16-bit authentication management field
  * @sqn: SQN = 48-bit sequence number
  * @_rand: RAND = 128-bit random challenge
  * @autn: Buffer for AUTN = 128-bit authentication token
@@ -176,22 +232,20 @@ int milenage_f2345(const u8 *opc, const u8 *k, const u8 *_rand,
  * @res: Buffer for RES = 64-bit signed response (f2), or %NULL
  * @res_len: Max length for res; set to used length or 0 on failure
  */
-void milenage_generate(const u8 *opc, const u8 *amf, const u8 *k,
-		       const u8 *sqn, const u8 *_rand, u8 *autn, u8 *ik,
-		       u8 *ck, u8 *res, size_t *res_len)
+void milenage_generate_ctx(const struct milenage_ctx *ctx, const u8 *amf,
+			   const u8 *sqn, const u8 *_rand, u8 *autn, u8 *ik,
+			   u8 *ck, u8 *res, size_t *res_len)
 {
 	int i;
-	u8 mac_a[8], ak[6];
+	u8 temp[16], mac_a[8], ak[6];
 
 	if (*res_len < 8) {
 		*res_len = 0;
 		return;
 	}
-	if (milenage_f1(opc, k, _rand, sqn, amf, mac_a, NULL) ||
-	    milenage_f2345(opc, k, _rand, res, ck, ik, ak, NULL)) {
-		*res_len = 0;
-		return;
-	}
+	milenage_temp(ctx, _rand, temp);
+	milenage_f1_temp(ctx, temp, sqn, amf, mac_a, NULL);
+	milenage_f2345_temp(ctx, temp, res, ck, ik, ak, NULL);
 	*res_len = 8;
 
 	/* AUTN = (SQN ^ AK) || AMF || MAC */
@@ -202,6 +256,32 @@ void milenage_generate(const u8 *opc, const u8 *amf, const u8 *k,
 }
 
 
+/**
+ * milenage_generate - Generate AKA AUTN,IK,CK,RES
+ * @opc: OPc = 128-bit operator variant algorithm configuration field (encr.)
+ * @amf: AMF = 16-bit authentication management field
+ * @k: K = 128-bit subscriber key
+ * @sqn: SQN = 48-bit sequence number
+ * @_rand: RAND = 128-bit random challenge
+ * @autn: Buffer for AUTN = 128-bit authentication token
+ * @ik: Buffer for IK = 128-bit integrity key (f4), or %NULL
+ * @ck: Buffer for CK = 128-bit confidentiality key (f3), or %NULL
+ * @res: Buffer for RES = 64-bit signed response (f2), or %NULL
+ * @res_len: Max length for res; set to used length or 0 on failure
+ */
+void milenage_generate(const u8 *opc, const u8 *amf, const u8 *k,
+		       const u8 *sqn, const u8 *_rand, u8 *autn, u8 *ik,
+		       u8 *ck, u8 *res, size_t *res_len)
+{
+	struct milenage_ctx ctx;
+
+	milenage_ctx_init(&ctx, opc, k);
+	milenage_generate_ctx(&ctx, amf, sqn, _rand, autn, ik, ck, res,
+			      res_len);
+	milenage_ctx_clear(&ctx);
+}
+
+
 /**
  * milenage_auts - Milenage AUTS validation
  * @opc: OPc = 128-bit operator variant algorithm configuration field (encr.)
@@ -215,15 +295,18 @@ int milenage_auts(const u8 *opc, const u8 *k, const u8 *_rand, const u8 *auts,
 		  u8 *sqn)
 {
 	u8 amf[2] = { 0x00, 0x00 }; /* TS 33.102 v7.0.0, 6.3.3 */
-	u8 ak[6], mac_s[8];
+	struct milenage_ctx ctx;
+	u8 temp[16], ak[6], mac_s[8];
 	int i;
 
-	if (milenage_f2345(opc, k, _rand, NULL, NULL, NULL, NULL, ak))
-		return -1;
+	milenage_ctx_init(&ctx, opc, k);
+	milenage_temp(&ctx, _rand, temp);
+	milenage_f2345_temp(&ctx, temp, NULL, NULL, NULL, NULL, ak);
 	for (i = 0; i < 6; i++)
 		sqn[i] = auts[i] ^ ak[i];
-	if (milenage_f1(opc, k, _rand, sqn, amf, NULL, mac_s) ||
-	    memcmp(mac_s, auts + 6, 8) != 0)
+	milenage_f1_temp(&ctx, temp, sqn, amf, NULL, mac_s);
+	milenage_ctx_clear(&ctx);
+	if (memcmp(mac_s, auts + 6, 8) != 0)
 		return -1;
 	return 0;
 }
@@ -241,11 +324,28 @@ int milenage_auts(const u8 *opc, const u8 *k, const u8 *_rand, const u8 *auts,
 int gsm_milenage(const u8 *opc, const u8 *k, const u8 *_rand, u8 *sres, u8 *kc)
 {
 	u8 res[8], ck[16], ik[16];
-	int i;
 
 	if (milenage_f2345(opc, k, _rand, res, ck, ik, NULL, NULL))
 		return -1;
 
+	gsm_milenage_c2c3(res, ck, ik, sres, kc);
+	return 0;
+}
+
+
+/**
+ * gsm_milenage_c2c3 - Derive SRES and Kc from RES, CK and IK (c2, c3)
+ * @res: RES = 64-bit signed response (f2)
+ * @ck: CK = 128-bit confidentiality key (f3)
+ * @ik: IK = 128-bit integrity key (f4)
+ * @sres: Buffer for SRES = 32-bit SRES
+ * @kc: Buffer for Kc = 64-bit Kc
+ */
+void gsm_milenage_c2c3(const u8 *res, const u8 *ck, const u8 *ik, u8 *sres,
+		       u8 *kc)
+{
+	int i;
+
 	for (i = 0; i < 8; i++)
 		kc[i] = ck[i] ^ ck[i + 8] ^ ik[i] ^ ik[i + 8];
 
@@ -255,7 +355,6 @@ int gsm_milenage(const u8 *opc, const u8 *k, const u8 *_rand, u8 *sres, u8 *kc)
 	for (i = 0; i < 4; i++)
 		sres[i] = res[i] ^ res[i + 4];
 #endif /* GSM_MILENAGE_ALT_SRES */
-	return 0;
 }
 
 
@@ -14,6 +14,23 @@
 
 #pragma once
 
+#include "aes.h"
+
+/* MILENAGE state that only depends on the subscriber, so that K is
+ * expanded once for any number of vectors */
+struct milenage_ctx {
+	struct aes_enc_ctx aes;	/* E_K */
+	u8 opc[16];
+};
+
+void milenage_ctx_init(struct milenage_ctx *ctx, const u8 *opc, const u8 *k);
+void milenage_ctx_clear(struct milenage_ctx *ctx);
+void milenage_generate_ctx(const struct milenage_ctx *ctx, const u8 *amf,
+			   const u8 *sqn, const u8 *_rand, u8 *autn, u8 *ik,
+			   u8 *ck, u8 *res, size_t *res_len);
+void gsm_milenage_c2c3(const u8 *res, const u8 *ck, const u8 *ik, u8 *sres,
+		       u8 *kc);
+
 void milenage_generate(const u8 *opc, const u8 *amf, const u8 *k,
 		       const u8 *sqn, const u8 *_rand, u8 *autn, u8 *ik,
 		       u8 *ck, u8 *res, size_t *res_len);
@@ -137,6 +137,75 @@ const struct tlv_definition rsl_att_tlvdef = {
 	},
 };
 
+/* IEs of the RSL messages following the common header, i.e. not counting
+ * the Channel Number and Link Identifier of the RLL/DCHAN/CCHAN headers
+ * (TS 08.58 Chapter 8) */
+static const struct tlv_msg_def rsl_msg_defs[] = {
+	/* 8.3 Radio Link Layer Management messages */
+	TLV_MSG_DEF(RSL_MT_DATA_REQ, TLV_IE_M(RSL_IE_L3_INFO, 0)),
+	TLV_MSG_DEF(RSL_MT_DATA_IND, TLV_IE_M(RSL_IE_L3_INFO, 0)),
+	TLV_MSG_DEF(RSL_MT_ERROR_IND, TLV_IE_M(RSL_IE_RLM_CAUSE, 1)),
+	TLV_MSG_DEF(RSL_MT_EST_REQ, TLV_IE_O(RSL_IE_L3_INFO, 0)),
+	TLV_MSG_DEF(RSL_MT_EST_IND, TLV_IE_O(RSL_IE_L3_INFO, 0)),
+	TLV_MSG_DEF(RSL_MT_REL_REQ, TLV_IE_M(RSL_IE_RELEASE_MODE, 1)),
+	TLV_MSG_DEF(RSL_MT_UNIT_DATA_REQ, TLV_IE_M(RSL_IE_L3_INFO, 0),
+		    TLV_IE_O(RSL_IE_TIMING_ADVANCE, 1),
+		    TLV_IE_O(RSL_IE_MS_POWER, 1)),
+	TLV_MSG_DEF(RSL_MT_UNIT_DATA_IND, TLV_IE_M(RSL_IE_L3_INFO, 0)),
+	TLV_MSG_DEF(RSL_MT_RES_REQ, TLV_IE_M(RSL_IE_L3_INFO, 0)),
+	TLV_MSG_DEF(RSL_MT_RECON_REQ, TLV_IE_M(RSL_IE_L3_INFO, 0)),
+	/* 8.4 Dedicated Channel Management messages */
+	TLV_MSG_DEF(RSL_MT_CHAN_ACTIV, TLV_IE_M(RSL_IE_ACT_TYPE, 1),
+		    TLV_IE_M(RSL_IE_CHAN_MODE, 4),
+		    TLV_IE_O(RSL_IE_CHAN_IDENT, 4),
+		    TLV_IE_O(RSL_IE_ENCR_INFO, 1),
+		    TLV_IE_O(RSL_IE_MR_CONFIG, 1)),
+	TLV_MSG_DEF(RSL_MT_CHAN_ACTIV_ACK, TLV_IE_M(RSL_IE_FRAME_NUMBER, 2)),
+	TLV_MSG_DEF(RSL_MT_CHAN_ACTIV_NACK, TLV_IE_M(RSL_IE_CAUSE, 1)),
+	TLV_MSG_DEF(RSL_MT_CONN_FAIL, TLV_IE_M(RSL_IE_CAUSE, 1)),
+	TLV_MSG_DEF(RSL_MT_ENCR_CMD, TLV_IE_M(RSL_IE_ENCR_INFO, 1),
+		    TLV_IE_M(RSL_IE_LINK_IDENT, 1),
+		    TLV_IE_M(RSL_IE_L3_INFO, 1)),
+	TLV_MSG_DEF(RSL_MT_HANDO_DET, TLV_IE_O(RSL_IE_ACCESS_DELAY, 1)),
+	TLV_MSG_DEF(RSL_MT_MEAS_RES, TLV_IE_M(RSL_IE_MEAS_RES_NR, 1),
+		    TLV_IE_M(RSL_IE_UPLINK_MEAS, 3),
+		    TLV_IE_M(RSL_IE_BS_POWER, 1),
+		    TLV_IE_O(RSL_IE_L1_INFO, 2),
+		    TLV_IE_O(RSL_IE_L3_INFO, 1),
+		    TLV_IE_O(RSL_IE_MS_TIMING_OFFSET, 1)),
+	TLV_MSG_DEF(RSL_MT_MODE_MODIFY_REQ, TLV_IE_M(RSL_IE_CHAN_MODE, 4),
+		    TLV_IE_O(RSL_IE_ENCR_INFO, 1),
+		    TLV_IE_O(RSL_IE_MR_CONFIG, 1)),
+	/* 8.5 Common Channel Management messages */
+	TLV_MSG_DEF(RSL_MT_BCCH_INFO, TLV_IE_M(RSL_IE_SYSINFO_TYPE, 1),
+		    TLV_IE_O(RSL_IE_FULL_BCCH_INFO, 0),
+		    TLV_IE_O(RSL_IE_STARTNG_TIME, 2)),
+	TLV_MSG_DEF(RSL_MT_CHAN_RQD, TLV_IE_M(RSL_IE_REQ_REFERENCE, 3),
+		    TLV_IE_M(RSL_IE_ACCESS_DELAY, 1)),
+	TLV_MSG_DEF(RSL_MT_DELETE_IND, TLV_IE_M(RSL_IE_FULL_IMM_ASS_INFO, 1)),
+	TLV_MSG_DEF(RSL_MT_PAGING_CMD, TLV_IE_M(RSL_IE_PAGING_GROUP, 1),
+		    TLV_IE_M(RSL_IE_MS_IDENTITY, 1),
+		    TLV_IE_O(RSL_IE_CHAN_NEEDED, 1)),
+	/* 8.6 TRX Management messages */
+	TLV_MSG_DEF(RSL_MT_RF_RES_IND, TLV_IE_M(RSL_IE_RESOURCE_INFO, 0)),
+	TLV_MSG_DEF(RSL_MT_SACCH_FILL, TLV_IE_M(RSL_IE_SYSINFO_TYPE, 1),
+		    TLV_IE_O(RSL_IE_L3_INFO, 0),
+		    TLV_IE_O(RSL_IE_STARTNG_TIME, 2)),
+	TLV_MSG_DEF(RSL_MT_ERROR_REPORT, TLV_IE_M(RSL_IE_CAUSE, 1),
+		    TLV_IE_O(RSL_IE_MSG_ID, 1)),
+};
+
+/*! \brief \ref rsl_att_tlvdef compiled with the RSL message IE rules
+ *  \returns compiled definition for \ref tlv_decode
+ */
+const struct tlv_compiled_def *rsl_att_tlvdef_compiled(void)
+{
+	static struct tlv_compiled_once once =
+		TLV_COMPILED_ONCE(&rsl_att_tlvdef, rsl_msg_defs);
+
+	return tlv_compiled_get(&once);
+}
+
 /*! \brief Encode channel number as per Section 9.3.1 */
 uint8_t rsl_enc_chan_nr(uint8_t type, uint8_t subch, uint8_t timeslot)
 {
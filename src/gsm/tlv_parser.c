@@ -19,7 +19,9 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
 #include <osmocom/gsm/tlv.h>
 
 /*! \addtogroup tlv
@@ -202,6 +204,354 @@ int tlv_parse(struct tlv_parsed *dec, const struct tlv_definition *def,
 	return num_parsed;
 }
 
+/* record an IE in a sparse parse result, later occurrences of a tag
+ * replace the value like they do in \ref tlv_parse */
+static inline int sparse_add(struct tlv_parsed_sparse *dec, uint8_t tag,
+			     const uint8_t *val, uint16_t len)
+{
+	uint32_t bit = 1U << (tag & 31);
+	struct tlv_sparse_entry *e;
+
+	if (dec->present[tag >> 5] & bit) {
+		e = &dec->ie[dec->idx[tag]];
+	} else {
+		if (dec->num_ie >= TLV_SPARSE_MAX_IE)
+			return -4;
+		dec->present[tag >> 5] |= bit;
+		dec->idx[tag] = dec->num_ie;
+		e = &dec->ie[dec->num_ie++];
+		e->tag = tag;
+	}
+	e->val = val;
+	e->len = len;
+
+	return 0;
+}
+
+/*! \brief Parse an entire buffer of TLV encoded IEs into a sparse result
+ *  \param[out] dec caller-allocated pointer to \ref tlv_parsed_sparse
+ *  \param[in] def structure defining the valid TLV tags / configurations
+ *  \param[in] buf the input data buffer to be parsed
+ *  \param[in] buf_len length of the input data buffer
+ *  \param[in] lv_tag an initial LV tag at the start of the buffer
+ *  \param[in] lv_tag2 a second initial LV tag following the \a lv_tag
+ *  \returns number of IEs parsed, negative in case of error like
+ *  \ref tlv_parse, or -4 for more than \ref TLV_SPARSE_MAX_IE distinct IEs
+ *
+ *  This gives the same results as \ref tlv_parse, but only touches
+ *  memory for the IEs that are actually present, which makes it much
+ *  cheaper for the common messages with a handful of IEs.
+ */
+int tlv_parse_sparse(struct tlv_parsed_sparse *dec,
+		     const struct tlv_definition *def,
+		     const uint8_t *buf, int buf_len, uint8_t lv_tag,
+		     uint8_t lv_tag2)
+{
+	int ofs = 0, num_parsed = 0;
+	uint8_t lv_tags[2] = { lv_tag, lv_tag2 };
+	uint16_t len;
+	int i, rc;
+
+	memset(dec->present, 0, sizeof(dec->present));
+	dec->num_ie = 0;
+
+	for (i = 0; i < ARRAY_SIZE(lv_tags); i++) {
+		if (!lv_tags[i])
+			continue;
+		if (ofs >= buf_len)
+			return -1;
+		len = buf[ofs] + 1;
+		if (ofs + len > buf_len)
+			return -2;
+		rc = sparse_add(dec, lv_tags[i], &buf[ofs+1], buf[ofs]);
+		if (rc < 0)
+			return rc;
+		num_parsed++;
+		ofs += len;
+	}
+
+	while (ofs < buf_len) {
+		int rv;
+		uint8_t tag;
+		const uint8_t *val;
+
+		rv = tlv_parse_one(&tag, &len, &val, def,
+		                   &buf[ofs], buf_len-ofs);
+		if (rv < 0)
+			return rv;
+		rc = sparse_add(dec, tag, val, len);
+		if (rc < 0)
+			return rc;
+		ofs += rv;
+		num_parsed++;
+	}
+
+	return num_parsed;
+}
+
+/*! \brief Compile a TLV definition and message IE sets for \ref tlv_decode
+ *  \param[in] ctx talloc context to allocate the result from
+ *  \param[in] def structure defining the valid TLV tags / configurations
+ *  \param[in] msgs mandatory and optional IEs by message type
+ *  \param[in] num_msgs number of entries in \a msgs
+ *  \returns compiled definition, to be freed with talloc_free()
+ *
+ *  The single octet TV lookup is resolved for all 256 tag octets at
+ *  compile time, so the decoder needs a single table access per IE.
+ *  Message types not in \a msgs are decoded without any presence or
+ *  length checks.
+ */
+struct tlv_compiled_def *tlv_compile(void *ctx, const struct tlv_definition *def,
+				     const struct tlv_msg_def *msgs,
+				     unsigned int num_msgs)
+{
+	struct tlv_compiled_def *cdef;
+	unsigned int i, j;
+
+	if (num_msgs > 255)
+		return NULL;
+
+	cdef = talloc_zero_size(ctx, sizeof(*cdef) +
+				num_msgs * sizeof(cdef->msg[0]));
+	if (!cdef)
+		return NULL;
+	talloc_set_name_const(cdef, "struct tlv_compiled_def");
+
+	for (i = 0; i < 256; i++) {
+		struct tlv_compiled_ie *cie = &cdef->ie[i];
+
+		if (def->def[i & 0xf0].type == TLV_TYPE_SINGLE_TV) {
+			cie->type = TLV_TYPE_SINGLE_TV;
+			cie->tag = i & 0xf0;
+		} else {
+			cie->type = def->def[i].type;
+			cie->tag = i;
+			cie->fixed_len = def->def[i].fixed_len;
+		}
+	}
+
+	cdef->num_msgs = num_msgs;
+	for (i = 0; i < num_msgs; i++) {
+		struct tlv_compiled_msg *cm = &cdef->msg[i];
+
+		cdef->msg_idx[msgs[i].msg_type] = i + 1;
+		for (j = 0; j < msgs[i].num_ies; j++) {
+			const struct tlv_msg_ie *ie = &msgs[i].ies[j];
+
+			if (ie->mandatory)
+				cm->mandatory[ie->tag >> 5] |= 1U << (ie->tag & 31);
+			cm->min_len[ie->tag] = ie->min_len;
+		}
+	}
+
+	return cdef;
+}
+
+/*! \brief Get a TLV definition compiled on first use
+ *  \param[in] once definition and message IE sets to compile
+ *  \returns compiled definition for \ref tlv_decode
+ *
+ *  This is meant for the static definitions of a protocol, which are
+ *  compiled once and then kept for the lifetime of the process.  It may
+ *  be called from several threads: if they race on the first use, each
+ *  compiles the definition, one result is published and the others are
+ *  freed again.
+ */
+const struct tlv_compiled_def *tlv_compiled_get(struct tlv_compiled_once *once)
+{
+	struct tlv_compiled_def *cdef, *cur;
+
+	cur = __atomic_load_n(&once->cdef, __ATOMIC_ACQUIRE);
+	if (cur)
+		return cur;
+
+	cdef = tlv_compile(NULL, once->def, once->msgs, once->num_msgs);
+	OSMO_ASSERT(cdef);
+
+	if (!__atomic_compare_exchange_n(&once->cdef, &cur, cdef, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		talloc_free(cdef);
+		return cur;
+	}
+	return cdef;
+}
+
+/* the single pass of tlv_decode() and tlv_decode_dense(), exactly one of
+ * sdec and ddec is set */
+static inline __attribute__((always_inline)) int
+tlv_decode_core(struct tlv_parsed_sparse *sdec, struct tlv_parsed *ddec,
+		const struct tlv_compiled_def *cdef, uint8_t msg_type,
+		const uint8_t *buf, int buf_len, uint8_t *err_tag)
+{
+	const struct tlv_compiled_msg *cm = NULL;
+	uint32_t dpresent[256 / 32];
+	uint32_t *present = ddec ? dpresent : sdec->present;
+	int ofs = 0, num_parsed = 0;
+	int i, rc;
+
+	memset(present, 0, sizeof(dpresent));
+	if (ddec)
+		memset(ddec, 0, sizeof(*ddec));
+	else
+		sdec->num_ie = 0;
+
+	if (cdef->msg_idx[msg_type])
+		cm = &cdef->msg[cdef->msg_idx[msg_type] - 1];
+
+	while (ofs < buf_len) {
+		const uint8_t *p = &buf[ofs];
+		const struct tlv_compiled_ie *cie = &cdef->ie[*p];
+		int rem = buf_len - ofs;
+		const uint8_t *val;
+		int len, total;
+
+		switch (cie->type) {
+		case TLV_TYPE_SINGLE_TV:
+			val = p;
+			len = 1;
+			total = 1;
+			break;
+		case TLV_TYPE_T:
+			/* GSM TS 04.07 11.2.4: Type 1 TV or Type 2 T */
+			val = p;
+			len = 0;
+			total = 1;
+			break;
+		case TLV_TYPE_TV:
+			val = p + 1;
+			len = 1;
+			total = 2;
+			break;
+		case TLV_TYPE_FIXED:
+			val = p + 1;
+			len = cie->fixed_len;
+			total = len + 1;
+			break;
+		case TLV_TYPE_vTvLV_GAN:	/* 44.318 / 11.1.4 */
+			if (rem < 2)
+				goto truncated;
+			if (p[1] & 0x80) {
+				/* like TL16V, but without highest bit of len */
+				if (rem < 3)
+					goto truncated;
+				val = p + 3;
+				len = (p[1] & 0x7f) << 8 | p[2];
+				total = len + 3;
+			} else {
+				val = p + 2;
+				len = p[1];
+				total = len + 2;
+			}
+			break;
+		case TLV_TYPE_TvLV:
+			if (rem < 2)
+				goto truncated;
+			if (p[1] & 0x80) {
+				/* like TLV, but without highest bit of len */
+				val = p + 2;
+				len = p[1] & 0x7f;
+				total = len + 2;
+				break;
+			}
+			/* like TL16V, fallthrough */
+		case TLV_TYPE_TL16V:
+			if (rem < 3)
+				goto truncated;
+			val = p + 3;
+			len = p[1] << 8 | p[2];
+			total = len + 3;
+			break;
+		case TLV_TYPE_TLV:
+			/* GSM TS 04.07 11.2.4: Type 4 TLV */
+			if (rem < 2)
+				goto truncated;
+			val = p + 2;
+			len = p[1];
+			total = len + 2;
+			break;
+		default:
+			if (err_tag)
+				*err_tag = *p;
+			return TLV_DEC_ERR_UNKNOWN_IE;
+		}
+
+		if (total > rem)
+			goto truncated;
+		if (cm && len < cm->min_len[cie->tag]) {
+			if (err_tag)
+				*err_tag = cie->tag;
+			return TLV_DEC_ERR_SHORT_IE;
+		}
+
+		if (ddec) {
+			present[cie->tag >> 5] |= 1U << (cie->tag & 31);
+			ddec->lv[cie->tag].val = val;
+			ddec->lv[cie->tag].len = len;
+		} else {
+			rc = sparse_add(sdec, cie->tag, val, len);
+			if (rc < 0)
+				return rc;
+		}
+
+		ofs += total;
+		num_parsed++;
+	}
+
+	if (!cm)
+		return num_parsed;
+
+	for (i = 0; i < ARRAY_SIZE(dpresent); i++) {
+		uint32_t missing = cm->mandatory[i] & ~present[i];
+
+		if (missing) {
+			if (err_tag)
+				*err_tag = i * 32 + __builtin_ctz(missing);
+			return TLV_DEC_ERR_MISSING_IE;
+		}
+	}
+
+	return num_parsed;
+
+truncated:
+	if (err_tag)
+		*err_tag = cdef->ie[buf[ofs]].tag;
+	return TLV_DEC_ERR_TRUNCATED;
+}
+
+/*! \brief Parse and validate the IEs of a message in a single pass
+ *  \param[out] dec caller-allocated pointer to \ref tlv_parsed_sparse
+ *  \param[in] cdef definition compiled by \ref tlv_compile
+ *  \param[in] msg_type message type selecting the IE rules
+ *  \param[in] buf the input data buffer to be parsed
+ *  \param[in] buf_len length of the input data buffer
+ *  \param[out] err_tag tag of the offending IE in case of error (may be NULL)
+ *  \returns number of IEs parsed, or a negative \ref tlv_decode_error
+ *
+ *  Unlike \ref tlv_parse, every IE is checked against the end of the
+ *  buffer and the minimum length given for \a msg_type, and the
+ *  presence of all mandatory IEs is verified.
+ */
+int tlv_decode(struct tlv_parsed_sparse *dec,
+	       const struct tlv_compiled_def *cdef, uint8_t msg_type,
+	       const uint8_t *buf, int buf_len, uint8_t *err_tag)
+{
+	return tlv_decode_core(dec, NULL, cdef, msg_type, buf, buf_len,
+			       err_tag);
+}
+
+/*! \brief Parse and validate the IEs of a message into a \ref tlv_parsed
+ *
+ *  Like \ref tlv_decode, for callers that need to pass the result on as
+ *  a \ref tlv_parsed.
+ */
+int tlv_decode_dense(struct tlv_parsed *dec,
+		     const struct tlv_compiled_def *cdef, uint8_t msg_type,
+		     const uint8_t *buf, int buf_len, uint8_t *err_tag)
+{
+	return tlv_decode_core(NULL, dec, cdef, msg_type, buf, buf_len,
+			       err_tag);
+}
+
 /*! \brief take a master (src) tlvdev and fill up all empty slots in 'dst' */
 void tlv_def_patch(struct tlv_definition *dst, const struct tlv_definition *src)
 {
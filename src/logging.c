@@ -40,10 +40,14 @@
 #include <time.h>
 #include <sys/time.h>
 #include <errno.h>
+#include <pthread.h>
+#include <signal.h>
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/logging.h>
+#include <osmocom/core/logging_bin.h>
+#include <osmocom/core/timer.h>
 
 #include <osmocom/vty/logging.h>	/* for LOGGING_STR. */
 
@@ -53,6 +57,11 @@ static struct log_context log_context;
 static void *tall_log_ctx = NULL;
 LLIST_HEAD(osmo_log_target_list);
 
+/* no categories before log_init() */
+static uint8_t min_level_init[OSMO_NUM_DLIB];
+uint8_t *osmo_log_min_level = min_level_init + OSMO_NUM_DLIB;
+int osmo_log_num_cat_user;
+
 #define LOGLEVEL_DEFS	6	/* Number of loglevels.*/
 
 static const struct value_string loglevel_strs[LOGLEVEL_DEFS+1] = {
@@ -222,6 +231,7 @@ void log_parse_category_mask(struct log_target* target, const char *_mask)
 	} while ((category_token = strtok(NULL, ":")));
 
 	free(mask);
+	log_cache_update();
 }
 
 static const char* color(int subsys)
@@ -240,12 +250,13 @@ static const char* category_name(int subsys)
 	return NULL;
 }
 
-static void _output(struct log_target *target, unsigned int subsys,
-		    unsigned int level, const char *file, int line, int cont,
-		    const char *format, va_list ap)
+/* format the prefix of a log message for the given target into buf,
+ * returns its length */
+static int _format_prefix(struct log_target *target, char *buf, int size,
+			  unsigned int subsys, const char *file, int line,
+			  int cont, const struct timeval *tv)
 {
-	char buf[4096];
-	int ret, len = 0, offset = 0, rem = sizeof(buf);
+	int ret, len = 0, offset = 0, rem = size;
 
 	/* are we using color */
 	if (target->use_color) {
@@ -260,21 +271,20 @@ static void _output(struct log_target *target, unsigned int subsys,
 	if (!cont) {
 		if (target->print_ext_timestamp) {
 			struct tm tm;
-			struct timeval tv;
-			gettimeofday(&tv, NULL);
-			localtime_r(&tv.tv_sec, &tm);
+			localtime_r(&tv->tv_sec, &tm);
 			ret = snprintf(buf + offset, rem, "%04d%02d%02d%02d%02d%02d%03d ",
 					tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
 					tm.tm_hour, tm.tm_min, tm.tm_sec,
-					(int)(tv.tv_usec / 1000));
+					(int)(tv->tv_usec / 1000));
 			if (ret < 0)
 				goto err;
 			OSMO_SNPRINTF_RET(ret, rem, offset, len);
 		} else if (target->print_timestamp) {
-			char *timestr;
+			/* the writer thread formats messages, too */
+			char timestr[26];
 			time_t tm;
-			tm = time(NULL);
-			timestr = ctime(&tm);
+			tm = tv->tv_sec;
+			ctime_r(&tm, timestr);
 			timestr[strlen(timestr)-1] = '\0';
 			ret = snprintf(buf + offset, rem, "%s ", timestr);
 			if (ret < 0)
@@ -295,18 +305,193 @@ static void _output(struct log_target *target, unsigned int subsys,
 			OSMO_SNPRINTF_RET(ret, rem, offset, len);
 		}
 	}
-	ret = vsnprintf(buf + offset, rem, format, ap);
-	if (ret < 0)
-		goto err;
-	OSMO_SNPRINTF_RET(ret, rem, offset, len);
+err:
+	return offset;
+}
 
-	ret = snprintf(buf + offset, rem, "%s",
-			target->use_color ? "\033[0;m" : "");
+/* terminate a log message of length ret behind the prefix */
+static void _format_end(struct log_target *target, char *buf, int size,
+			int offset, int ret)
+{
 	if (ret < 0)
 		goto err;
-	OSMO_SNPRINTF_RET(ret, rem, offset, len);
+	offset += ret < size - offset ? ret : size - offset;
+
+	snprintf(buf + offset, size - offset, "%s",
+		 target->use_color ? "\033[0;m" : "");
 err:
-	buf[sizeof(buf)-1] = '\0';
+	buf[size-1] = '\0';
+}
+
+static inline int need_timestamp(struct log_target *target, int cont)
+{
+	return !cont && (target->print_timestamp || target->print_ext_timestamp);
+}
+
+/* format a log message for the given target into buf */
+static void _format(struct log_target *target, char *buf, int size,
+		    unsigned int subsys, const char *file, int line, int cont,
+		    const char *format, va_list ap)
+{
+	struct timeval tv;
+	int offset;
+
+	if (need_timestamp(target, cont))
+		osmo_clock_realtime_cached(&tv);
+	offset = _format_prefix(target, buf, size, subsys, file, line, cont,
+				&tv);
+	_format_end(target, buf, size, offset,
+		    vsnprintf(buf + offset, size - offset, format, ap));
+}
+
+/*! \brief Format a binary log record as a log target prints messages
+ *  \param[in] target log target whose settings are used
+ *  \param[out] buf output buffer
+ *  \param[in] size size of \a buf
+ *  \param[in] rec the record
+ *
+ *  The timestamp, category, file name and color are added as configured
+ *  for \a target when the record is formatted, not when it was captured.
+ */
+void log_bin_format(struct log_target *target, char *buf, int size,
+		    const struct log_bin_rec *rec)
+{
+	int cont = rec->flags & LOG_BIN_F_CONT;
+	struct timeval tv;
+	int offset;
+
+	if (need_timestamp(target, cont))
+		log_bin_realtime(rec, &tv);
+	offset = _format_prefix(target, buf, size, rec->subsys, rec->file,
+				rec->line, cont, &tv);
+	_format_end(target, buf, size, offset,
+		    log_bin_render(buf + offset, size - offset, rec));
+}
+
+/* Asynchronous logging: the messages are captured by the caller as binary
+ * records in the slots of a bounded multi-producer ring, and formatted and
+ * written by a single writer thread. A slot is free for the producer
+ * reserving position pos if its seq equals pos, and ready for the writer
+ * if it equals pos + 1. */
+
+/*! \brief maximum length of a message in asynchronous mode */
+#define LOG_ASYNC_MSG_LEN	1024
+/* targets with unflushed output, before the writer flushes at once */
+#define LOG_ASYNC_MAX_DIRTY	8
+/* the idle writer polls the ring in this interval (ms), producers only
+ * wake it up early once the ring is half full */
+#define LOG_ASYNC_POLL_MS	10
+
+struct log_async_rec {
+	unsigned long seq;
+	struct log_target *target;
+	union {
+		struct log_bin_rec bin;
+		uint8_t buf[LOG_BIN_MAX_LEN];
+	};
+};
+
+static struct {
+	/* reserved by the producers */
+	unsigned long enq_pos __attribute__((aligned(64)));
+	/* taken by the writer */
+	unsigned long deq_pos __attribute__((aligned(64)));
+	unsigned long dropped;
+	/* writer is waiting for wake */
+	int sleeping;
+
+	struct log_async_rec *ring;
+	unsigned long mask;
+	int running;
+
+	pthread_t thread;
+	/* held by the writer while it writes to a target, and by
+	 * log_target_file_reopen() while it replaces the FILE */
+	pthread_mutex_t file_lock;
+	pthread_mutex_t lock;
+	/* the following are protected by lock */
+	pthread_cond_t wake;
+	pthread_cond_t idle;
+	unsigned long done_pos;
+	int stop;
+} log_async = {
+	.file_lock = PTHREAD_MUTEX_INITIALIZER,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+	.idle = PTHREAD_COND_INITIALIZER,
+};
+
+/* capture a message in a ring slot, or count it as dropped */
+static void _output_async(struct log_target *target, unsigned int subsys,
+			  unsigned int level, const char *file, int line,
+			  int cont, const char *format, va_list ap)
+{
+	struct log_async_rec *rec;
+	unsigned long pos;
+	long dif;
+
+	pos = __atomic_load_n(&log_async.enq_pos, __ATOMIC_RELAXED);
+	while (1) {
+		rec = &log_async.ring[pos & log_async.mask];
+		dif = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) - pos;
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n(&log_async.enq_pos,
+							&pos, pos + 1, 1,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (dif < 0) {
+			/* ring full, the writer reports it later */
+			__atomic_add_fetch(&log_async.dropped, 1,
+					   __ATOMIC_RELAXED);
+			__atomic_add_fetch(&target->async_dropped, 1,
+					   __ATOMIC_RELAXED);
+			return;
+		} else
+			pos = __atomic_load_n(&log_async.enq_pos,
+					      __ATOMIC_RELAXED);
+	}
+
+	rec->target = target;
+	log_bin_encode(&rec->bin, sizeof(rec->buf), subsys, level, file, line,
+		       cont, format, ap);
+	__atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE);
+
+	if (__atomic_load_n(&log_async.sleeping, __ATOMIC_RELAXED) &&
+	    pos - __atomic_load_n(&log_async.deq_pos, __ATOMIC_RELAXED) >=
+	    log_async.mask / 2) {
+		pthread_mutex_lock(&log_async.lock);
+		pthread_cond_signal(&log_async.wake);
+		pthread_mutex_unlock(&log_async.lock);
+	}
+}
+
+static void _output(struct log_target *target, unsigned int subsys,
+		    unsigned int level, const char *file, int line, int cont,
+		    const char *format, va_list ap)
+{
+	char buf[4096];
+
+	if (target->async && log_async.running) {
+		_output_async(target, subsys, level, file, line, cont,
+			      format, ap);
+		return;
+	}
+
+	if (target->output_bin) {
+		union {
+			struct log_bin_rec rec;
+			uint8_t buf[LOG_BIN_MAX_LEN];
+		} bin;
+
+		log_bin_encode(&bin.rec, sizeof(bin), subsys, level, file,
+			       line, cont, format, ap);
+		target->output_bin(target, &bin.rec);
+		return;
+	}
+
+	_format(target, buf, sizeof(buf), subsys, file, line, cont,
+		format, ap);
 	target->output(target, level, buf);
 }
 
@@ -358,6 +543,9 @@ void osmo_vlogp(int subsys, int level, const char *file, int line,
 {
 	struct log_target *tar;
 
+	if (!log_check_level_cached(subsys, level))
+		return;
+
 	subsys = map_subsys(subsys);
 
 	llist_for_each_entry(tar, &osmo_log_target_list, entry) {
@@ -402,6 +590,7 @@ void logp2(int subsys, unsigned int level, const char *file, int line, int cont,
 void log_add_target(struct log_target *target)
 {
 	llist_add_tail(&target->entry, &osmo_log_target_list);
+	log_cache_update();
 }
 
 /*! \brief Unregister a log target from the logging core
@@ -410,6 +599,9 @@ void log_add_target(struct log_target *target)
 void log_del_target(struct log_target *target)
 {
 	llist_del(&target->entry);
+	log_cache_update();
+	/* the writer thread might still hold messages for it */
+	log_async_flush();
 }
 
 /*! \brief Reset (clear) the logging context */
@@ -512,6 +704,7 @@ void log_set_print_category(struct log_target *target, int print_category)
 void log_set_log_level(struct log_target *target, int log_level)
 {
 	target->loglevel = log_level;
+	log_cache_update();
 }
 
 /*! \brief Set a category filter on a given log target
@@ -527,6 +720,23 @@ void log_set_category_filter(struct log_target *target, int category,
 		return;
 	target->categories[category].enabled = !!enable;
 	target->categories[category].loglevel = level;
+	log_cache_update();
+}
+
+/*! \brief Set when the asynchronous writer flushes a target
+ *  \param[in] target Log target to be affected
+ *  \param[in] policy flush policy
+ *  \param[in] level lowest log level flushed at once with
+ *	       \ref LOG_FLUSH_LEVEL
+ *
+ *  Only file based targets are buffered. In synchronous mode, every
+ *  message is flushed.
+ */
+void log_set_flush_policy(struct log_target *target,
+			  enum log_flush_policy policy, int level)
+{
+	target->flush_policy = policy;
+	target->flush_level = level;
 }
 
 static void _file_output(struct log_target *target, unsigned int level,
@@ -536,6 +746,243 @@ static void _file_output(struct log_target *target, unsigned int level,
 	fflush(target->tgt_file.out);
 }
 
+/* write a message in the writer thread, honouring the flush policy of
+ * file based targets */
+static void log_async_write(struct log_target *tar, unsigned int level,
+			    const char *log, struct log_target **dirty,
+			    unsigned int *num_dirty)
+{
+	unsigned int i;
+
+	if (tar->output != _file_output) {
+		tar->output(tar, level, log);
+		return;
+	}
+
+	fputs(log, tar->tgt_file.out);
+
+	if (tar->flush_policy == LOG_FLUSH_ALWAYS ||
+	    (tar->flush_policy == LOG_FLUSH_LEVEL &&
+	     level >= tar->flush_level)) {
+		fflush(tar->tgt_file.out);
+		return;
+	}
+
+	for (i = 0; i < *num_dirty; i++) {
+		if (dirty[i] == tar)
+			return;
+	}
+	if (*num_dirty == LOG_ASYNC_MAX_DIRTY) {
+		fflush(tar->tgt_file.out);
+		return;
+	}
+	dirty[(*num_dirty)++] = tar;
+}
+
+static void *log_async_writer(void *arg)
+{
+	struct log_target *dirty[LOG_ASYNC_MAX_DIRTY];
+	char buf[LOG_ASYNC_MSG_LEN];
+	unsigned int num_dirty = 0, i;
+	unsigned long pos = log_async.deq_pos;
+	struct timespec ts;
+
+	while (1) {
+		struct log_async_rec *rec = &log_async.ring[pos & log_async.mask];
+		struct log_target *tar;
+		unsigned long dropped;
+
+		if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) == pos + 1) {
+			tar = rec->target;
+			__atomic_store_n(&log_async.deq_pos, pos + 1,
+					 __ATOMIC_RELAXED);
+
+			log_bin_format(tar, buf, sizeof(buf), &rec->bin);
+
+			pthread_mutex_lock(&log_async.file_lock);
+			dropped = __atomic_exchange_n(&tar->async_dropped, 0,
+						      __ATOMIC_RELAXED);
+			if (dropped) {
+				char note[64];
+
+				snprintf(note, sizeof(note), "%lu log messages "
+					 "dropped\n", dropped);
+				log_async_write(tar, LOGL_NOTICE, note, dirty,
+						&num_dirty);
+			}
+			log_async_write(tar, rec->bin.level, buf, dirty,
+					&num_dirty);
+			pthread_mutex_unlock(&log_async.file_lock);
+
+			/* hand the slot back to the producers */
+			__atomic_store_n(&rec->seq, pos + log_async.mask + 1,
+					 __ATOMIC_RELEASE);
+			pos++;
+			continue;
+		}
+
+		/* ring empty: flush the buffered output, report progress to
+		 * log_async_flush() and wait for more */
+		pthread_mutex_lock(&log_async.file_lock);
+		for (i = 0; i < num_dirty; i++)
+			fflush(dirty[i]->tgt_file.out);
+		pthread_mutex_unlock(&log_async.file_lock);
+		num_dirty = 0;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += LOG_ASYNC_POLL_MS * 1000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+
+		pthread_mutex_lock(&log_async.lock);
+		log_async.done_pos = pos;
+		pthread_cond_broadcast(&log_async.idle);
+		if (log_async.stop) {
+			pthread_mutex_unlock(&log_async.lock);
+			break;
+		}
+		__atomic_store_n(&log_async.sleeping, 1, __ATOMIC_RELAXED);
+		pthread_cond_timedwait(&log_async.wake, &log_async.lock, &ts);
+		__atomic_store_n(&log_async.sleeping, 0, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&log_async.lock);
+	}
+
+	return NULL;
+}
+
+/*! \brief Start the asynchronous logging writer thread
+ *  \param[in] num_msgs capacity of the ring, rounded up to a power of two
+ *  \returns 0 in case of success, negative in case of error
+ *
+ *  Messages to targets switched to asynchronous mode with
+ *  \ref log_target_set_async are captured by the calling thread as
+ *  binary records (see \ref log_bin_encode) in a lock-free ring, and
+ *  formatted and written by a dedicated thread, so that the caller
+ *  neither formats them nor blocks on I/O. If the ring is full, messages are dropped
+ *  and their number is written to the target before the next message
+ *  written to it. Messages are truncated to 1023 characters.
+ */
+int log_async_start(unsigned int num_msgs)
+{
+	struct log_async_rec *ring;
+	unsigned long i, size = 2;
+	sigset_t all, old;
+	int rc;
+
+	if (log_async.running)
+		return -EALREADY;
+
+	while (size < num_msgs)
+		size <<= 1;
+
+	ring = talloc_array(tall_log_ctx, struct log_async_rec, size);
+	if (!ring)
+		return -ENOMEM;
+	for (i = 0; i < size; i++)
+		ring[i].seq = i;
+
+	log_async.ring = ring;
+	log_async.mask = size - 1;
+	log_async.enq_pos = 0;
+	log_async.deq_pos = 0;
+	log_async.done_pos = 0;
+	log_async.dropped = 0;
+	log_async.stop = 0;
+
+	/* the writer inherits the signal mask, signals are for the
+	 * application's threads to handle */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	rc = pthread_create(&log_async.thread, NULL, log_async_writer, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (rc != 0) {
+		log_async.ring = NULL;
+		talloc_free(ring);
+		return -rc;
+	}
+	log_async.running = 1;
+
+	return 0;
+}
+
+/*! \brief Write all pending messages and stop the writer thread
+ *
+ *  Targets in asynchronous mode are written synchronously afterwards.
+ *  Must not be called concurrently with logging from other threads.
+ */
+void log_async_stop(void)
+{
+	if (!log_async.running)
+		return;
+
+	pthread_mutex_lock(&log_async.lock);
+	log_async.stop = 1;
+	pthread_cond_signal(&log_async.wake);
+	pthread_mutex_unlock(&log_async.lock);
+	pthread_join(log_async.thread, NULL);
+
+	log_async.running = 0;
+	talloc_free(log_async.ring);
+	log_async.ring = NULL;
+}
+
+/*! \brief Wait until all messages logged so far are written and flushed */
+void log_async_flush(void)
+{
+	unsigned long pos;
+
+	if (!log_async.running)
+		return;
+
+	pos = __atomic_load_n(&log_async.enq_pos, __ATOMIC_ACQUIRE);
+
+	pthread_mutex_lock(&log_async.lock);
+	while ((long) (log_async.done_pos - pos) < 0) {
+		pthread_cond_signal(&log_async.wake);
+		pthread_cond_wait(&log_async.idle, &log_async.lock);
+	}
+	pthread_mutex_unlock(&log_async.lock);
+}
+
+/*! \brief Get the counters of the asynchronous logging pipeline
+ *  \param[out] stats counters since \ref log_async_start
+ */
+void log_async_get_stats(struct log_async_stats *stats)
+{
+	stats->enqueued = __atomic_load_n(&log_async.enq_pos, __ATOMIC_RELAXED);
+	stats->dequeued = __atomic_load_n(&log_async.deq_pos, __ATOMIC_RELAXED);
+	stats->dropped = __atomic_load_n(&log_async.dropped, __ATOMIC_RELAXED);
+}
+
+/*! \brief Switch a log target to or from asynchronous mode
+ *  \param[in] target Log target to be affected
+ *  \param[in] async enable (1) or disable (0) asynchronous mode
+ *  \returns 0 in case of success, -ENOTSUP for targets that can't be
+ *	      written from another thread (VTY, ring buffer)
+ *
+ *  Asynchronous mode takes effect while the writer thread started by
+ *  \ref log_async_start is running.
+ */
+int log_target_set_async(struct log_target *target, int async)
+{
+	switch (target->type) {
+	case LOG_TGT_TYPE_FILE:
+	case LOG_TGT_TYPE_STDERR:
+	case LOG_TGT_TYPE_SYSLOG:
+		break;
+	default:
+		if (async)
+			return -ENOTSUP;
+	}
+
+	if (!async)
+		log_async_flush();
+	target->async = !!async;
+	return 0;
+}
+
 /*! \brief Create a new log target skeleton */
 struct log_target *log_target_create(void)
 {
@@ -663,11 +1110,21 @@ void log_target_destroy(struct log_target *target)
 /*! \brief close and re-open a log file (for log file rotation) */
 int log_target_file_reopen(struct log_target *target)
 {
+	int rc = 0;
+
+	/* messages logged so far still go to the old file.  Other threads
+	 * may go on logging, so the writer must not touch the FILE while
+	 * it is being replaced */
+	log_async_flush();
+	pthread_mutex_lock(&log_async.file_lock);
 	fclose(target->tgt_file.out);
 
 	target->tgt_file.out = fopen(target->tgt_file.fname, "a");
 	if (!target->tgt_file.out)
-		return -errno;
+		rc = -errno;
+	pthread_mutex_unlock(&log_async.file_lock);
+	if (rc < 0)
+		return rc;
 
 	/* we assume target->output already to be set */
 
@@ -838,6 +1295,7 @@ err:
  */
 int log_init(const struct log_info *inf, void *ctx)
 {
+	uint8_t *min_level;
 	int i;
 
 	tall_log_ctx = talloc_named_const(ctx, 1, "logging");
@@ -876,6 +1334,17 @@ int log_init(const struct log_info *inf, void *ctx)
 			&internal_cat[i], sizeof(struct log_info_cat));
 	}
 
+	min_level = talloc_array(osmo_log_info, uint8_t,
+				 OSMO_NUM_DLIB + inf->num_cat);
+	if (!min_level) {
+		talloc_free(osmo_log_info);
+		osmo_log_info = NULL;
+		return -ENOMEM;
+	}
+	osmo_log_min_level = min_level + OSMO_NUM_DLIB;
+	osmo_log_num_cat_user = inf->num_cat;
+	log_cache_update();
+
 	return 0;
 }
 
@@ -885,9 +1354,10 @@ int log_check_level(int subsys, unsigned int level)
 {
 	struct log_target *tar;
 
-	subsys = map_subsys(subsys);
+	if (!log_check_level_cached(subsys, level))
+		return 0;
 
-	/* TODO: The following could/should be cached (update on config) */
+	subsys = map_subsys(subsys);
 
 	llist_for_each_entry(tar, &osmo_log_target_list, entry) {
 		if (!check_log_to_target(tar, subsys, level))
@@ -901,4 +1371,38 @@ int log_check_level(int subsys, unsigned int level)
 	return 0;
 }
 
+/*! \brief Update the levels cached for \ref log_check_level_cached
+ *
+ *  This is done by all functions changing the log levels or categories
+ *  of the targets, and by \ref log_add_target and \ref log_del_target.
+ *  Only code changing \ref log_target.categories or \ref
+ *  log_target.loglevel directly has to call it.
+ */
+void log_cache_update(void)
+{
+	struct log_target *tar;
+	int subsys;
+
+	if (!osmo_log_info)
+		return;
+
+	for (subsys = -OSMO_NUM_DLIB; subsys < osmo_log_num_cat_user; subsys++) {
+		int i = map_subsys(subsys);
+		uint8_t min = 0xff;
+
+		llist_for_each_entry(tar, &osmo_log_target_list, entry) {
+			const struct log_category *cat = &tar->categories[i];
+			uint8_t level;
+
+			if (!cat->enabled)
+				continue;
+			/* see check_log_to_target(), 0 is everything */
+			level = tar->loglevel ? tar->loglevel : cat->loglevel;
+			if (level < min)
+				min = level;
+		}
+		osmo_log_min_level[subsys] = min;
+	}
+}
+
 /*! @} */
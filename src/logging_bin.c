@@ -0,0 +1,509 @@
+/* Binary log records with deferred formatting */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*! \addtogroup logging
+ *  @{
+ */
+
+/*! \file logging_bin.c */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/logging_bin.h>
+
+/* The record doesn't describe its arguments, both the encoder and the
+ * renderer walk the conversions of the format string to find them. */
+
+/* type of the argument of a conversion */
+enum bin_arg {
+	ARG_NONE,	/* %% */
+	ARG_INT,
+	ARG_LONG,
+	ARG_LLONG,
+	ARG_INTMAX,
+	ARG_SIZE,
+	ARG_PTRDIFF,
+	ARG_DOUBLE,
+	ARG_LDOUBLE,
+	ARG_PTR,
+	ARG_STR,	/* uint16_t length and the characters */
+	ARG_BAD,	/* %n, %m, %ls, positional arguments, ... */
+};
+
+/* longest conversion specification we deal with */
+#define MAX_SPEC	32
+/* length of a NULL string */
+#define STR_NULL	0xffff
+
+struct conv {
+	const char *start;	/* the '%' */
+	const char *dot;	/* the '.' of the precision, or NULL */
+	const char *mod;	/* the length modifier */
+	const char *end;	/* behind the conversion specifier */
+	int star_width;		/* width is an int argument */
+	int star_prec;		/* precision is an int argument */
+	int prec;		/* literal precision, -1 if none */
+	enum bin_arg arg;
+};
+
+/* find the next conversion in fmt, returns 0 if there is none */
+static int next_conv(const char *fmt, struct conv *c)
+{
+	enum bin_arg iarg = ARG_INT;
+	const char *p = strchr(fmt, '%');
+	int ldouble = 0;
+
+	if (!p)
+		return 0;
+
+	c->start = p++;
+	c->dot = NULL;
+	c->star_width = 0;
+	c->star_prec = 0;
+	c->prec = -1;
+
+	while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' ||
+	       *p == '0' || *p == '\'')
+		p++;
+	if (*p == '*') {
+		c->star_width = 1;
+		p++;
+	} else {
+		while (isdigit(*p))
+			p++;
+	}
+	if (*p == '.') {
+		c->dot = p++;
+		if (*p == '*') {
+			c->star_prec = 1;
+			p++;
+		} else {
+			c->prec = 0;
+			while (isdigit(*p))
+				c->prec = c->prec * 10 + *p++ - '0';
+		}
+	}
+
+	c->mod = p;
+	switch (*p) {
+	case 'h':
+		if (*++p == 'h')
+			p++;
+		break;
+	case 'l':
+		if (*++p == 'l') {
+			p++;
+			iarg = ARG_LLONG;
+		} else
+			iarg = ARG_LONG;
+		break;
+	case 'q':
+		p++;
+		iarg = ARG_LLONG;
+		break;
+	case 'L':
+		p++;
+		iarg = ARG_LLONG;
+		ldouble = 1;
+		break;
+	case 'j':
+		p++;
+		iarg = ARG_INTMAX;
+		break;
+	case 'z':
+	case 'Z':
+		p++;
+		iarg = ARG_SIZE;
+		break;
+	case 't':
+		p++;
+		iarg = ARG_PTRDIFF;
+		break;
+	}
+
+	switch (*p) {
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		c->arg = iarg;
+		break;
+	case 'c':
+		c->arg = ARG_INT;
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		c->arg = ldouble ? ARG_LDOUBLE : ARG_DOUBLE;
+		break;
+	case 's':
+		c->arg = iarg == ARG_INT ? ARG_STR : ARG_BAD;
+		break;
+	case 'p':
+		c->arg = ARG_PTR;
+		break;
+	case '%':
+		c->arg = p == c->start + 1 ? ARG_NONE : ARG_BAD;
+		break;
+	default:
+		c->arg = ARG_BAD;
+		break;
+	}
+	c->end = *p ? p + 1 : p;
+
+	if (c->end - c->start > MAX_SPEC)
+		c->arg = ARG_BAD;
+
+	return 1;
+}
+
+#define PUT(type, val) \
+	do { \
+		type _v = (val); \
+		if (out + sizeof(_v) > end) \
+			goto text; \
+		memcpy(out, &_v, sizeof(_v)); \
+		out += sizeof(_v); \
+	} while (0)
+
+/*! \brief Capture a log message in a binary record
+ *  \param[out] rec the record
+ *  \param[in] size size of the buffer at \a rec, more than
+ *	       \ref LOG_BIN_HDR_LEN
+ *  \param[in] subsys subsystem (index into \ref log_info.cat)
+ *  \param[in] level log level
+ *  \param[in] file source file name
+ *  \param[in] line source line
+ *  \param[in] cont continuation of the previous message
+ *  \param[in] format printf format string
+ *  \param[in] ap arguments
+ *  \returns length of the record
+ *
+ *  Strings are truncated to what fits into the record. If the other
+ *  arguments don't fit or the format uses conversions that can't be
+ *  captured (like %n, %m or positional arguments), the record holds the
+ *  formatted message with \ref LOG_BIN_F_TEXT instead.
+ */
+int log_bin_encode(struct log_bin_rec *rec, size_t size, unsigned int subsys,
+		   unsigned int level, const char *file, int line, int cont,
+		   const char *format, va_list ap)
+{
+	uint8_t *out = rec->args, *end;
+	const char *p = format;
+	struct timespec ts;
+	struct conv c;
+	va_list bp;
+	int n;
+
+	if (size > UINT16_MAX)
+		size = UINT16_MAX;
+	end = (uint8_t *) rec + size;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	rec->time = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	rec->file = file;
+	rec->fmt = format;
+	rec->line = line;
+	rec->subsys = subsys;
+	rec->level = level;
+	rec->flags = cont ? LOG_BIN_F_CONT : 0;
+
+	/* for the fallback, ap is consumed while capturing */
+	va_copy(bp, ap);
+
+	while (next_conv(p, &c)) {
+		int prec = c.prec;
+
+		p = c.end;
+		if (c.star_width)
+			PUT(int, va_arg(ap, int));
+		if (c.star_prec) {
+			prec = va_arg(ap, int);
+			PUT(int, prec);
+		}
+
+		switch (c.arg) {
+		case ARG_NONE:
+			break;
+		case ARG_INT:
+			PUT(int, va_arg(ap, int));
+			break;
+		case ARG_LONG:
+			PUT(long, va_arg(ap, long));
+			break;
+		case ARG_LLONG:
+			PUT(long long, va_arg(ap, long long));
+			break;
+		case ARG_INTMAX:
+			PUT(intmax_t, va_arg(ap, intmax_t));
+			break;
+		case ARG_SIZE:
+			PUT(size_t, va_arg(ap, size_t));
+			break;
+		case ARG_PTRDIFF:
+			PUT(ptrdiff_t, va_arg(ap, ptrdiff_t));
+			break;
+		case ARG_DOUBLE:
+			PUT(double, va_arg(ap, double));
+			break;
+		case ARG_LDOUBLE:
+			PUT(long double, va_arg(ap, long double));
+			break;
+		case ARG_PTR:
+			PUT(void *, va_arg(ap, void *));
+			break;
+		case ARG_STR: {
+			const char *s = va_arg(ap, const char *);
+			size_t max;
+			uint16_t len;
+
+			if (out + sizeof(len) > end)
+				goto text;
+			max = end - out - sizeof(len);
+			if (prec >= 0 && prec < max)
+				max = prec;
+			len = s ? strnlen(s, max) : STR_NULL;
+			memcpy(out, &len, sizeof(len));
+			out += sizeof(len);
+			if (s) {
+				memcpy(out, s, len);
+				out += len;
+			}
+			break;
+		}
+		case ARG_BAD:
+			goto text;
+		}
+	}
+
+	va_end(bp);
+	rec->len = out - (uint8_t *) rec;
+	return rec->len;
+
+text:
+	n = vsnprintf((char *) rec->args, end - rec->args, format, bp);
+	va_end(bp);
+	if (n < 0)
+		n = 0;
+	else if (n >= end - rec->args)
+		n = end - rec->args - 1;
+	rec->args[n] = '\0';
+	rec->flags |= LOG_BIN_F_TEXT;
+	rec->len = LOG_BIN_HDR_LEN + n + 1;
+	return rec->len;
+}
+
+#undef PUT
+
+/* rebuild the specification of a conversion with the captured width and
+ * precision, str_len >= 0 replaces the precision */
+static void build_spec(char *spec, const struct conv *c, int width, int prec,
+		       int str_len)
+{
+	const char *s, *stop = c->dot ? c->dot : c->mod;
+
+	for (s = c->start; s < stop; s++) {
+		if (*s == '*')
+			spec += sprintf(spec, "%d", width);
+		else
+			*spec++ = *s;
+	}
+
+	if (str_len >= 0)
+		spec += sprintf(spec, ".%d", str_len);
+	else if (c->star_prec && prec >= 0)
+		spec += sprintf(spec, ".%d", prec);
+	else if (c->dot && !c->star_prec) {
+		memcpy(spec, c->dot, c->mod - c->dot);
+		spec += c->mod - c->dot;
+	}
+
+	memcpy(spec, c->mod, c->end - c->mod);
+	spec[c->end - c->mod] = '\0';
+}
+
+#define GET(var) \
+	do { \
+		if (in + sizeof(var) > end) \
+			goto out; \
+		memcpy(&var, in, sizeof(var)); \
+		in += sizeof(var); \
+	} while (0)
+
+/*! \brief Render the message of a binary log record
+ *  \param[out] buf output buffer
+ *  \param[in] size size of \a buf
+ *  \param[in] rec the record
+ *  \returns length of the message, like snprintf()
+ *
+ *  Only the message itself is rendered, use \ref log_bin_format for
+ *  the prefixes of a log target.
+ */
+int log_bin_render(char *buf, size_t size, const struct log_bin_rec *rec)
+{
+	const uint8_t *in = rec->args, *end = (const uint8_t *) rec + rec->len;
+	const char *p = rec->fmt;
+	int ret, len = 0, offset = 0, rem = size;
+	struct conv c;
+
+	if (rec->flags & LOG_BIN_F_TEXT)
+		return snprintf(buf, size, "%s", (const char *) rec->args);
+
+	while (next_conv(p, &c)) {
+		char spec[MAX_SPEC + 32];
+		int width = 0, prec = -1;
+
+		/* the text before the conversion */
+		ret = snprintf(buf + offset, rem, "%.*s", (int) (c.start - p), p);
+		OSMO_SNPRINTF_RET(ret, rem, offset, len);
+		p = c.end;
+
+		if (c.star_width)
+			GET(width);
+		if (c.star_prec)
+			GET(prec);
+		build_spec(spec, &c, width, prec, -1);
+
+		switch (c.arg) {
+		case ARG_NONE:
+			ret = snprintf(buf + offset, rem, "%%");
+			break;
+		case ARG_INT: {
+			int v;
+			GET(v);
+			ret = snprintf(buf + offset, rem, spec, v);
+			break;
+		}
+		case ARG_LONG: {
+			long v;
+			GET(v);
+			ret = snprintf(buf + offset, rem, spec, v);
+			break;
+		}
+		case ARG_LLONG: {
+			long long v;
+			GET(v);
+			ret = snprintf(buf + offset, rem, spec, v);
+			break;
+		}
+		case ARG_INTMAX: {
+			intmax_t v;
+			GET(v);
+			ret = snprintf(buf + offset, rem, spec, v);
+			break;
+		}
+		case ARG_SIZE: {
+			size_t v;
+			GET(v);
+			ret = snprintf(buf + offset, rem, spec, v);
+			break;
+		}
+		case ARG_PTRDIFF: {
+			ptrdiff_t v;
+			GET(v);
+			ret = snprintf(buf + offset, rem, spec, v);
+			break;
+		}
+		case ARG_DOUBLE: {
+			double v;
+			GET(v);
+			ret = snprintf(buf + offset, rem, spec, v);
+			break;
+		}
+		case ARG_LDOUBLE: {
+			long double v;
+			GET(v);
+			ret = snprintf(buf + offset, rem, spec, v);
+			break;
+		}
+		case ARG_PTR: {
+			void *v;
+			GET(v);
+			ret = snprintf(buf + offset, rem, spec, v);
+			break;
+		}
+		case ARG_STR: {
+			uint16_t slen;
+			GET(slen);
+			if (slen == STR_NULL) {
+				build_spec(spec, &c, width, prec, 6);
+				ret = snprintf(buf + offset, rem, spec, "(null)");
+				break;
+			}
+			if (in + slen > end)
+				goto out;
+			/* not terminated, the precision limits it */
+			build_spec(spec, &c, width, prec, slen);
+			ret = snprintf(buf + offset, rem, spec, in);
+			in += slen;
+			break;
+		}
+		default:
+			/* never captured */
+			goto out;
+		}
+		if (ret < 0)
+			goto out;
+		OSMO_SNPRINTF_RET(ret, rem, offset, len);
+	}
+
+	/* the text after the last conversion */
+	ret = snprintf(buf + offset, rem, "%s", p);
+	OSMO_SNPRINTF_RET(ret, rem, offset, len);
+out:
+	return len;
+}
+
+#undef GET
+
+/*! \brief Get the wall-clock time at which a record was captured
+ *  \param[in] rec the record
+ *  \param[out] tv CLOCK_REALTIME of \ref log_bin_rec.time
+ *
+ *  The monotonic timestamp is converted with the current offset between
+ *  the two clocks, i.e. wall-clock changes since the record was captured
+ *  are applied to it.
+ */
+void log_bin_realtime(const struct log_bin_rec *rec, struct timeval *tv)
+{
+	struct timespec mono, real;
+	int64_t ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	clock_gettime(CLOCK_REALTIME, &real);
+	ns = real.tv_sec * 1000000000LL + real.tv_nsec -
+	     (mono.tv_sec * 1000000000LL + mono.tv_nsec - (int64_t) rec->time);
+
+	tv->tv_sec = ns / 1000000000;
+	tv->tv_usec = ns % 1000000000 / 1000;
+}
+
+/*! @} */
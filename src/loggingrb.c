@@ -25,8 +25,12 @@
 
 /*! \file loggingrb.c */
 
+#include <string.h>
+
+#include <osmocom/core/talloc.h>
 #include <osmocom/core/strrb.h>
 #include <osmocom/core/logging.h>
+#include <osmocom/core/logging_bin.h>
 #include <osmocom/core/loggingrb.h>
 
 static void _rb_output(struct log_target *target,
@@ -95,4 +99,150 @@ struct log_target *log_target_create_rb(size_t size)
 	return target;
 }
 
+/* Binary records are stored back to back, wrapping around the end of
+ * the buffer. The oldest records are dropped to make room. */
+struct log_bin_rb {
+	uint8_t *buf;
+	size_t size;
+	size_t head;	/* offset of the oldest record */
+	size_t used;	/* bytes in use */
+	size_t num;	/* number of records */
+};
+
+static void bin_rb_read(const struct log_bin_rb *rb, size_t pos, void *data,
+			size_t len)
+{
+	size_t n = rb->size - pos;
+
+	if (n > len)
+		n = len;
+	memcpy(data, rb->buf + pos, n);
+	memcpy((uint8_t *) data + n, rb->buf, len - n);
+}
+
+static void bin_rb_write(struct log_bin_rb *rb, size_t pos, const void *data,
+			 size_t len)
+{
+	size_t n = rb->size - pos;
+
+	if (n > len)
+		n = len;
+	memcpy(rb->buf + pos, data, n);
+	memcpy(rb->buf, (const uint8_t *) data + n, len - n);
+}
+
+static void _rb_bin_output(struct log_target *target,
+			   const struct log_bin_rec *rec)
+{
+	struct log_bin_rb *rb = target->tgt_rb.rb;
+
+	while (rb->size - rb->used < rec->len) {
+		struct log_bin_rec hdr;
+
+		bin_rb_read(rb, rb->head, &hdr, LOG_BIN_HDR_LEN);
+		rb->head = (rb->head + hdr.len) % rb->size;
+		rb->used -= hdr.len;
+		rb->num--;
+	}
+
+	bin_rb_write(rb, (rb->head + rb->used) % rb->size, rec, rec->len);
+	rb->used += rec->len;
+	rb->num++;
+}
+
+/*! \brief Create a new logging target for binary ring buffer logging
+ *  \param[in] size The capacity of the ring buffer in bytes, at least
+ *		    \ref LOG_BIN_MAX_LEN
+ *  \returns A log target in case of success, NULL in case of error.
+ *
+ *  Messages are captured as binary records (see \ref log_bin_encode),
+ *  which are only formatted when read with \ref log_target_rb_bin_foreach.
+ *  This is a lot cheaper than formatting them, so that e.g. DEBUG
+ *  messages can always be kept for the post mortem.
+ */
+struct log_target *log_target_create_rb_bin(size_t size)
+{
+	struct log_target *target;
+	struct log_bin_rb *rb;
+
+	if (size < LOG_BIN_MAX_LEN)
+		return NULL;
+
+	target = log_target_create();
+	if (!target)
+		return NULL;
+
+	rb = talloc_zero(target, struct log_bin_rb);
+	if (!rb)
+		goto err;
+	rb->buf = talloc_size(rb, size);
+	if (!rb->buf)
+		goto err;
+	rb->size = size;
+
+	target->tgt_rb.rb = rb;
+	target->type = LOG_TGT_TYPE_BIN_RB;
+	target->output_bin = _rb_bin_output;
+
+	return target;
+
+err:
+	log_target_destroy(target);
+	return NULL;
+}
+
+/*! \brief Return the number of records in a binary ring buffer target
+ *  \param[in] target The target to search.
+ */
+size_t log_target_rb_bin_used_size(struct log_target const *target)
+{
+	const struct log_bin_rb *rb = target->tgt_rb.rb;
+	return rb->num;
+}
+
+/*! \brief Return the capacity of a binary ring buffer target in bytes
+ *  \param[in] target The target to search.
+ */
+size_t log_target_rb_bin_avail_size(struct log_target const *target)
+{
+	const struct log_bin_rb *rb = target->tgt_rb.rb;
+	return rb->size;
+}
+
+/*! \brief Call a function for each record in a binary ring buffer target
+ *  \param[in] target The target to search.
+ *  \param[in] cb call-back function, returning non-zero stops the walk
+ *  \param[in] data opaque data passed to \a cb
+ *  \returns 0, or the non-zero value returned by \a cb
+ *
+ *  The records are passed from the oldest to the newest one. Use
+ *  \ref log_bin_format to turn them into text.
+ */
+int log_target_rb_bin_foreach(struct log_target const *target,
+			      int (*cb)(const struct log_bin_rec *rec,
+					void *data),
+			      void *data)
+{
+	const struct log_bin_rb *rb = target->tgt_rb.rb;
+	union {
+		struct log_bin_rec rec;
+		uint8_t buf[LOG_BIN_MAX_LEN];
+	} u;
+	size_t pos = rb->head, i;
+	int rc;
+
+	for (i = 0; i < rb->num; i++) {
+		bin_rb_read(rb, pos, &u.rec, LOG_BIN_HDR_LEN);
+		bin_rb_read(rb, (pos + LOG_BIN_HDR_LEN) % rb->size,
+			    u.rec.args, u.rec.len - LOG_BIN_HDR_LEN);
+		pos = (pos + u.rec.len) % rb->size;
+
+		rc = cb(&u.rec, data);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
 /* @} */
@@ -29,14 +29,193 @@
 #include <string.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <errno.h>
+
+#include "../config.h"
+
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 
 #include <osmocom/core/msgb.h>
 //#include <openbsc/gsm_data.h>
 #include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stats.h>
 //#include <openbsc/debug.h>
 
 void *tall_msgb_ctx;
 
+/* msgb pool: free lists of message buffers of a few fixed sizes */
+#define MSGB_POOL_MAX_CLASSES	8
+
+struct msgb_pool_class {
+	uint16_t size;		/* size of the data area */
+	unsigned int max_free;	/* maximum number of cached buffers */
+	unsigned int num_free;
+	struct llist_head free;
+};
+
+static struct msgb_pool_class pool_classes[MSGB_POOL_MAX_CLASSES];
+static unsigned int pool_num_classes;
+/* cached buffers are parented here, so they don't show up as leaks */
+static void *tall_msgb_pool_ctx;
+static struct rate_ctr_group *pool_ctrg;
+
+/* state of a data buffer shared by msgb_clone() */
+struct msgb_shinfo {
+	struct msgb *owner;	/* msgb whose allocation holds the buffer */
+	unsigned char *buf;	/* start of the shared buffer */
+	unsigned int refcnt;	/* number of msgbs using the buffer */
+	int owner_freed;	/* msgb_free() was called for the owner */
+	/* range of the buffer that may be in use by any of the msgbs;
+	 * only its boundaries can be extended without copying */
+	unsigned char *lo;
+	unsigned char *hi;
+};
+
+static const struct rate_ctr_desc msgb_pool_ctr_description[] = {
+	[MSGB_POOL_CTR_HIT]	= { "pool.hit",		"Allocations served from the pool  " },
+	[MSGB_POOL_CTR_MISS]	= { "pool.miss",	"Allocations with empty pool class " },
+	[MSGB_POOL_CTR_RECYCLE]	= { "pool.recycle",	"Buffers returned to the pool      " },
+	[MSGB_POOL_CTR_RELEASE]	= { "pool.release",	"Buffers freed as pool class full  " },
+};
+
+static const struct rate_ctr_group_desc msgb_pool_ctrg_desc = {
+	.group_name_prefix = "msgb",
+	.group_description = "Message Buffer Pool Statistics",
+	.num_ctr = ARRAY_SIZE(msgb_pool_ctr_description),
+	.ctr_desc = msgb_pool_ctr_description,
+	.class_id = OSMO_STATS_CLASS_GLOBAL,
+};
+
+/* smallest class that fits \a size */
+static struct msgb_pool_class *pool_class_fit(uint16_t size)
+{
+	unsigned int i;
+
+	for (i = 0; i < pool_num_classes; i++) {
+		if (pool_classes[i].size >= size)
+			return &pool_classes[i];
+	}
+	return NULL;
+}
+
+static struct msgb_pool_class *pool_class_exact(size_t size)
+{
+	unsigned int i;
+
+	for (i = 0; i < pool_num_classes; i++) {
+		if (pool_classes[i].size == size)
+			return &pool_classes[i];
+	}
+	return NULL;
+}
+
+static struct msgb *pool_alloc(struct msgb_pool_class *pc, const char *name)
+{
+	struct msgb *msg;
+
+	if (!llist_empty(&pc->free)) {
+		msg = llist_entry(pc->free.next, struct msgb, list);
+		llist_del(&msg->list);
+		pc->num_free--;
+		talloc_steal(tall_msgb_ctx, msg);
+		talloc_set_name_const(msg, name);
+		rate_ctr_inc(&pool_ctrg->ctr[MSGB_POOL_CTR_HIT]);
+	} else {
+		msg = talloc_named_const(tall_msgb_ctx,
+					 sizeof(*msg) + pc->size, name);
+		rate_ctr_inc(&pool_ctrg->ctr[MSGB_POOL_CTR_MISS]);
+		if (!msg)
+			return NULL;
+	}
+
+	/* only the header, the data area is not cleared */
+	memset(msg, 0, sizeof(*msg));
+	return msg;
+}
+
+/*! \brief Add a size class to the msgb pool
+ *  \param[in] size size of the data area, including headroom
+ *  \param[in] max_free maximum number of free buffers kept in the pool
+ *  \returns 0 on success; negative errno otherwise
+ *
+ * Once a size class exists, \ref msgb_alloc serves all requests up to
+ * \a size (and larger than the next smaller class) from a free list
+ * of buffers of this size, which are put back by \ref msgb_free.
+ * Unlike a regular allocation, the data area of a pooled msgb is not
+ * initialized to zero.  The class is updated if it already exists.
+ */
+int msgb_pool_add_class(uint16_t size, unsigned int max_free)
+{
+	struct msgb_pool_class *pc;
+	unsigned int i;
+
+	pc = pool_class_exact(size);
+	if (pc) {
+		pc->max_free = max_free;
+		return 0;
+	}
+
+	if (pool_num_classes >= ARRAY_SIZE(pool_classes))
+		return -ENOSPC;
+
+	if (!pool_ctrg) {
+		pool_ctrg = rate_ctr_group_alloc(tall_msgb_ctx,
+						 &msgb_pool_ctrg_desc, 0);
+		if (!pool_ctrg)
+			return -ENOMEM;
+	}
+	if (!tall_msgb_pool_ctx)
+		tall_msgb_pool_ctx = talloc_named_const(tall_msgb_ctx, 0,
+							"msgb_pool");
+
+	/* keep the classes sorted by size */
+	for (i = pool_num_classes; i > 0; i--) {
+		if (pool_classes[i-1].size < size)
+			break;
+		pool_classes[i] = pool_classes[i-1];
+		INIT_LLIST_HEAD(&pool_classes[i].free);
+		llist_splice(&pool_classes[i-1].free, &pool_classes[i].free);
+	}
+	pc = &pool_classes[i];
+	pc->size = size;
+	pc->max_free = max_free;
+	pc->num_free = 0;
+	INIT_LLIST_HEAD(&pc->free);
+	pool_num_classes++;
+
+	return 0;
+}
+
+/*! \brief Release all free buffers cached by the msgb pool */
+void msgb_pool_flush(void)
+{
+	struct msgb *msg, *tmp;
+	unsigned int i;
+
+	for (i = 0; i < pool_num_classes; i++) {
+		struct msgb_pool_class *pc = &pool_classes[i];
+
+		llist_for_each_entry_safe(msg, tmp, &pc->free, list) {
+			llist_del(&msg->list);
+			talloc_free(msg);
+		}
+		pc->num_free = 0;
+	}
+}
+
+/*! \brief Obtain the hit/miss counters of the msgb pool
+ *  \returns counter group (see \ref msgb_pool_ctr), NULL if there is
+ *  no size class
+ */
+struct rate_ctr_group *msgb_pool_get_ctrg(void)
+{
+	return pool_ctrg;
+}
+
 /*! \brief Allocate a new message buffer
  * \param[in] size Length in octets, including headroom
  * \param[in] name Human-readable name to be associated with msgb
@@ -47,9 +226,16 @@ void *tall_msgb_ctx;
  */
 struct msgb *msgb_alloc(uint16_t size, const char *name)
 {
+	struct msgb_pool_class *pc = NULL;
 	struct msgb *msg;
 
-	msg = _talloc_zero(tall_msgb_ctx, sizeof(*msg) + size, name);
+	if (pool_num_classes)
+		pc = pool_class_fit(size);
+
+	if (pc)
+		msg = pool_alloc(pc, name);
+	else
+		msg = _talloc_zero(tall_msgb_ctx, sizeof(*msg) + size, name);
 
 	if (!msg) {
 		//LOGP(DRSL, LOGL_FATAL, "unable to allocate msgb\n");
@@ -65,12 +251,99 @@ struct msgb *msgb_alloc(uint16_t size, const char *name)
 	return msg;
 }
 
+/* does \a msg (still) use the shared buffer of its shinfo? */
+static inline int shinfo_ref(const struct msgb *msg)
+{
+	return msg->shinfo && msg->head == msg->shinfo->buf;
+}
+
+/* drop the shinfo once no other msgb uses the buffer of its owner */
+static void shinfo_release(struct msgb_shinfo *sh)
+{
+	struct msgb *owner = sh->owner;
+	int owner_freed = sh->owner_freed;
+
+	if (sh->refcnt > 1)
+		return;
+	if (sh->refcnt == 1 && (owner_freed || owner->head != sh->buf))
+		return;
+
+	owner->shinfo = NULL;
+	talloc_free(sh);
+	if (owner_freed)
+		msgb_free(owner);
+}
+
+static void shinfo_update(struct msgb_shinfo *sh, const unsigned char *p)
+{
+	if (!p)
+		return;
+	if (p < sh->lo)
+		sh->lo = (unsigned char *) p;
+	if (p > sh->hi)
+		sh->hi = (unsigned char *) p;
+}
+
+static void msgb_free_one(struct msgb *m)
+{
+	struct msgb_pool_class *pc;
+
+	if (m && m->shinfo) {
+		struct msgb_shinfo *sh = m->shinfo;
+
+		if (shinfo_ref(m))
+			sh->refcnt--;
+		if (m == sh->owner) {
+			sh->owner_freed = 1;
+			shinfo_release(sh);
+			return;
+		}
+		/* a clone without a buffer of its own */
+		m->shinfo = NULL;
+		talloc_free(m);
+		shinfo_release(sh);
+		return;
+	}
+
+	if (pool_num_classes && m) {
+		pc = pool_class_exact(talloc_get_size(m) - sizeof(*m));
+		/* don't recycle buffers that have talloc children */
+		if (pc && pc->num_free < pc->max_free &&
+		    talloc_total_blocks(m) == 1) {
+			talloc_steal(tall_msgb_pool_ctx, m);
+			llist_add(&m->list, &pc->free);
+			pc->num_free++;
+			rate_ctr_inc(&pool_ctrg->ctr[MSGB_POOL_CTR_RECYCLE]);
+			return;
+		}
+		if (pc)
+			rate_ctr_inc(&pool_ctrg->ctr[MSGB_POOL_CTR_RELEASE]);
+	}
+
+	talloc_free(m);
+}
+
 /*! \brief Release given message buffer
  * \param[in] m Message buffer to be free'd
+ *
+ * If the size of \a m matches a size class of the msgb pool, it is
+ * put on the free list of that class instead of being free'd.
+ *
+ * If the data buffer of \a m is shared with clones (see \ref
+ * msgb_clone), it is free'd only after the last one is released.
+ *
+ * If \a m is the head of a msgb chain, all its fragments are free'd.
  */
 void msgb_free(struct msgb *m)
 {
-	talloc_free(m);
+	struct msgb *next;
+
+	while (m) {
+		next = m->frag;
+		m->frag = NULL;
+		msgb_free_one(m);
+		m = next;
+	}
 }
 
 /*! \brief Enqueue message buffer to tail of a queue
@@ -105,19 +378,196 @@ struct msgb *msgb_dequeue(struct llist_head *queue)
 	return llist_entry(lh, struct msgb, list);
 }
 
+/* give \a msg a private copy of the shared buffer */
+static int unshare(struct msgb *msg, int copy)
+{
+	struct msgb_shinfo *sh = msg->shinfo;
+	unsigned char *buf;
+
+	if (!shinfo_ref(msg))
+		return 0;
+
+	if (sh->refcnt == 1) {
+		/* nobody else uses the buffer (anymore) */
+		if (msg == sh->owner)
+			shinfo_release(sh);
+		return 0;
+	}
+
+	buf = talloc_named_const(msg, msg->data_len, "msgb_data");
+	if (!buf)
+		return -ENOMEM;
+	if (copy)
+		memcpy(buf, msg->head, msg->tail - msg->head);
+
+#define REBASE(p) if (p) p = buf + (p - msg->head)
+	REBASE(msg->l1h);
+	REBASE(msg->l2h);
+	REBASE(msg->l3h);
+	REBASE(msg->l4h);
+	REBASE(msg->data);
+	REBASE(msg->tail);
+#undef REBASE
+	msg->head = buf;
+
+	/* the owner keeps the shinfo until the last clone is gone */
+	if (msg != sh->owner)
+		msg->shinfo = NULL;
+	sh->refcnt--;
+	shinfo_release(sh);
+
+	return 0;
+}
+
+static struct msgb *copy_one(const struct msgb *msg, const char *name);
+
+static struct msgb *clone_one(struct msgb *msg, const char *name)
+{
+	struct msgb_shinfo *sh = msg->shinfo;
+	struct msgb *clone;
+
+	/* an owner with a private copy can't share a second buffer */
+	if (sh && !shinfo_ref(msg))
+		return copy_one(msg, name);
+
+	if (!sh) {
+		sh = talloc_zero(tall_msgb_ctx, struct msgb_shinfo);
+		if (!sh)
+			return NULL;
+		sh->owner = msg;
+		sh->buf = msg->head;
+		sh->refcnt = 1;
+		sh->lo = msg->data;
+		sh->hi = msg->tail;
+		msg->shinfo = sh;
+	}
+
+	clone = talloc_named_const(tall_msgb_ctx, sizeof(*clone), name);
+	if (!clone) {
+		shinfo_release(sh);
+		return NULL;
+	}
+	memcpy(clone, msg, sizeof(*clone));
+	INIT_LLIST_HEAD(&clone->list);
+	clone->frag = NULL;
+	sh->refcnt++;
+
+	shinfo_update(sh, msg->data);
+	shinfo_update(sh, msg->tail);
+	shinfo_update(sh, msg->l1h);
+	shinfo_update(sh, msg->l2h);
+	shinfo_update(sh, msg->l3h);
+	shinfo_update(sh, msg->l4h);
+
+	return clone;
+}
+
+/*! \brief Create a clone of a message buffer sharing its data
+ *  \param[in] msg message buffer to be cloned
+ *  \param[in] name Human-readable name to be associated with the clone
+ *  \returns newly-allocated msgb; NULL on error
+ *
+ *  Unlike \ref msgb_copy, the data buffer of \a msg is not copied but
+ *  shared among \a msg and all its clones, each of which has its own
+ *  set of data/tail/l1h-l4h pointers and its own control buffer.  The
+ *  buffer is free'd after \ref msgb_free was called for all of them.
+ *
+ *  The shared buffer is copied on write: \ref msgb_push and \ref
+ *  msgb_put of the first msgb that extends the used part of the buffer
+ *  operate in place, all others implicitly make a private copy first.
+ *  Any other modification of the data requires a call to \ref
+ *  msgb_unshare beforehand.
+ *
+ *  If \a msg is the head of a msgb chain, all fragments are cloned.
+ */
+struct msgb *msgb_clone(struct msgb *msg, const char *name)
+{
+	struct msgb *clone, **next;
+
+	clone = clone_one(msg, name);
+	if (!clone)
+		return NULL;
+
+	for (next = &clone->frag; msg->frag; next = &(*next)->frag) {
+		msg = msg->frag;
+		*next = clone_one(msg, name);
+		if (!*next) {
+			msgb_free(clone);
+			return NULL;
+		}
+	}
+
+	return clone;
+}
+
+/*! \brief Make the data buffer of a message buffer writable
+ *  \param[in] msg message buffer
+ *  \returns 0 on success; negative errno otherwise
+ *
+ *  If the data buffer of \a msg is shared with any clone (see \ref
+ *  msgb_clone), a private copy of it is made.
+ */
+int msgb_unshare(struct msgb *msg)
+{
+	if (!msg->shinfo)
+		return 0;
+	return unshare(msg, 1);
+}
+
+/*! \brief Check whether a message buffer shares its data
+ *  \param[in] msg message buffer
+ *  \returns 1 if the data buffer is shared with a clone, 0 otherwise
+ */
+int msgb_shared(const struct msgb *msg)
+{
+	return shinfo_ref(msg) && msg->shinfo->refcnt > 1;
+}
+
+/* Called by msgb_push()/msgb_put() before extending a msgb with a
+ * shared buffer by \a headroom / \a tailroom bytes */
+void _msgb_claim(struct msgb *msg, unsigned int headroom,
+		 unsigned int tailroom)
+{
+	struct msgb_shinfo *sh = msg->shinfo;
+
+	if (!shinfo_ref(msg) || sh->refcnt == 1)
+		return;
+
+	/* the caller checks the head-/tailroom */
+	if (headroom > msgb_headroom(msg) || tailroom > msgb_tailroom(msg))
+		return;
+
+	if ((headroom && msg->data != sh->lo) ||
+	    (tailroom && msg->tail != sh->hi)) {
+		if (unshare(msg, 1) < 0)
+			MSGB_ABORT(msg, "Unable to unshare msgb\n");
+		return;
+	}
+
+	if (headroom)
+		sh->lo = msg->data - headroom;
+	if (tailroom)
+		sh->hi = msg->tail + tailroom;
+}
+
 /*! \brief Re-set all message buffer pointers
  *  \param[in] msg message buffer that is to be resetted
  *
  * This will re-set the various internal pointers into the underlying
  * message buffer, i.e. remvoe all headroom and treat the msgb as
- * completely empty.  It also initializes the control buffer to zero.
+ * completely empty.  It also initializes the control buffer to zero
+ * and releases all fragments of a msgb chain.
  */
 void msgb_reset(struct msgb *msg)
 {
+	if (msg->shinfo)
+		unshare(msg, 0);
+	msgb_free(msg->frag);
+	msg->frag = NULL;
+
 	msg->len = 0;
-	msg->data = msg->_data;
-	msg->head = msg->_data;
-	msg->tail = msg->_data;
+	msg->data = msg->head;
+	msg->tail = msg->head;
 
 	msg->trx = NULL;
 	msg->lchan = NULL;
@@ -154,15 +604,7 @@ void msgb_set_talloc_ctx(void *ctx)
 	tall_msgb_ctx = ctx;
 }
 
-/*! \brief Copy an msgb.
- *
- *  This function allocates a new msgb, copies the data buffer of msg,
- *  and adjusts the pointers (incl l1h-l4h) accordingly. The cb part
- *  is not copied.
- *  \param[in] msg  The old msgb object
- *  \param[in] name Human-readable name to be associated with msgb
- */
-struct msgb *msgb_copy(const struct msgb *msg, const char *name)
+static struct msgb *copy_one(const struct msgb *msg, const char *name)
 {
 	struct msgb *new_msg;
 
@@ -171,26 +613,170 @@ struct msgb *msgb_copy(const struct msgb *msg, const char *name)
 		return NULL;
 
 	/* copy data */
-	memcpy(new_msg->_data, msg->_data, new_msg->data_len);
+	memcpy(new_msg->_data, msg->head, new_msg->data_len);
 
 	/* copy header */
 	new_msg->len = msg->len;
-	new_msg->data += msg->data - msg->_data;
-	new_msg->head += msg->head - msg->_data;
-	new_msg->tail += msg->tail - msg->_data;
+	new_msg->data += msg->data - msg->head;
+	new_msg->tail += msg->tail - msg->head;
 
 	if (msg->l1h)
-		new_msg->l1h = new_msg->_data + (msg->l1h - msg->_data);
+		new_msg->l1h = new_msg->_data + (msg->l1h - msg->head);
 	if (msg->l2h)
-		new_msg->l2h = new_msg->_data + (msg->l2h - msg->_data);
+		new_msg->l2h = new_msg->_data + (msg->l2h - msg->head);
 	if (msg->l3h)
-		new_msg->l3h = new_msg->_data + (msg->l3h - msg->_data);
+		new_msg->l3h = new_msg->_data + (msg->l3h - msg->head);
 	if (msg->l4h)
-		new_msg->l4h = new_msg->_data + (msg->l4h - msg->_data);
+		new_msg->l4h = new_msg->_data + (msg->l4h - msg->head);
 
 	return new_msg;
 }
 
+/*! \brief Copy an msgb.
+ *
+ *  This function allocates a new msgb, copies the data buffer of msg,
+ *  and adjusts the pointers (incl l1h-l4h) accordingly. The cb part
+ *  is not copied.  If \a msg is the head of a msgb chain, all fragments
+ *  are copied.
+ *  \param[in] msg  The old msgb object
+ *  \param[in] name Human-readable name to be associated with msgb
+ */
+struct msgb *msgb_copy(const struct msgb *msg, const char *name)
+{
+	struct msgb *new_msg, **next;
+
+	new_msg = copy_one(msg, name);
+	if (!new_msg)
+		return NULL;
+
+	for (next = &new_msg->frag; msg->frag; next = &(*next)->frag) {
+		msg = msg->frag;
+		*next = copy_one(msg, name);
+		if (!*next) {
+			msgb_free(new_msg);
+			return NULL;
+		}
+	}
+
+	return new_msg;
+}
+
+/*! \brief Append a fragment to a msgb chain
+ *  \param[in] msg head of the msgb chain
+ *  \param[in] frag msgb (or msgb chain) to be appended
+ *
+ *  A msgb chain consists of a head msgb, usually holding the protocol
+ *  headers, followed by any number of fragments holding the payload.
+ *  The chain is transmitted as a whole by the library, without copying
+ *  the fragments into a single buffer.  The fragments are owned by the
+ *  chain and free'd along with its head by \ref msgb_free.
+ *
+ *  Everything that operates on a single msgb, like \ref msgb_push,
+ *  \ref msgb_put or \ref msgb_length, only affects the head.
+ */
+void msgb_frag_append(struct msgb *msg, struct msgb *frag)
+{
+	while (msg->frag)
+		msg = msg->frag;
+	msg->frag = frag;
+}
+
+/*! \brief Determine the total length of a msgb chain
+ *  \param[in] msg head of the msgb chain
+ *  \returns number of bytes in the head and all fragments
+ */
+unsigned int msgb_chain_len(const struct msgb *msg)
+{
+	unsigned int len = 0;
+
+	for (; msg; msg = msg->frag)
+		len += msg->len;
+	return len;
+}
+
+/*! \brief Move all fragments of a msgb chain into its head
+ *  \param[in] msg head of the msgb chain
+ *  \returns 0 on success; -ENOSPC if the head lacks tailroom
+ *
+ *  This is meant for code that needs to parse a message; the library
+ *  transmits msgb chains without linearizing them.
+ */
+int msgb_linearize(struct msgb *msg)
+{
+	struct msgb *frag;
+
+	if (!msg->frag)
+		return 0;
+	if (msgb_tailroom(msg) < (int) (msgb_chain_len(msg->frag)))
+		return -ENOSPC;
+
+	for (frag = msg->frag; frag; frag = frag->frag)
+		memcpy(msgb_put(msg, frag->len), frag->data, frag->len);
+
+	msgb_free(msg->frag);
+	msg->frag = NULL;
+
+	return 0;
+}
+
+/*! \brief Remove bytes from the front of a msgb chain
+ *  \param[in] msg head of the msgb chain
+ *  \param[in] len number of bytes to be removed
+ *
+ *  Fragments that become empty are free'd, the head is kept.  This is
+ *  used to skip the part of a chain that was transmitted by a partial
+ *  write.
+ */
+void msgb_chain_pull(struct msgb *msg, unsigned int len)
+{
+	struct msgb *frag;
+
+	if (len > msg->len) {
+		len -= msg->len;
+		msgb_pull(msg, msg->len);
+	} else {
+		msgb_pull(msg, len);
+		return;
+	}
+
+	while ((frag = msg->frag) && len >= frag->len) {
+		len -= frag->len;
+		msg->frag = frag->frag;
+		frag->frag = NULL;
+		msgb_free(frag);
+	}
+	if (frag)
+		msgb_pull(frag, len);
+}
+
+#ifdef HAVE_SYS_UIO_H
+/*! \brief Describe a msgb chain by an iovec array
+ *  \param[in] msg head of the msgb chain
+ *  \param[out] iov iovec array to be filled
+ *  \param[in] iovcnt number of elements in \a iov
+ *  \returns number of elements used; -EMSGSIZE if \a iov is too small
+ *
+ *  Empty fragments are skipped.  The result can be passed to writev()
+ *  or sendmsg() as long as the chain isn't modified.
+ */
+int msgb_iovec(const struct msgb *msg, struct iovec *iov, unsigned int iovcnt)
+{
+	unsigned int n = 0;
+
+	for (; msg; msg = msg->frag) {
+		if (!msg->len)
+			continue;
+		if (n >= iovcnt)
+			return -EMSGSIZE;
+		iov[n].iov_base = msg->data;
+		iov[n].iov_len = msg->len;
+		n++;
+	}
+
+	return n;
+}
+#endif
+
 /*! \brief Resize an area within an msgb
  *
  *  This resizes a sub area of the msgb data and adjusts the pointers (incl
@@ -208,11 +794,19 @@ int msgb_resize_area(struct msgb *msg, uint8_t *area,
 			    int old_size, int new_size)
 {
 	int rc;
-	uint8_t *post_start = area + old_size;
+	uint8_t *post_start;
 	int pre_len = area - msg->data;
 	int post_len = msg->len - old_size - pre_len;
 	int delta_size = new_size - old_size;
 
+	if (msg->shinfo) {
+		rc = msgb_unshare(msg);
+		if (rc < 0)
+			return -1;
+		area = msg->data + pre_len;
+	}
+	post_start = area + old_size;
+
 	if (old_size < 0 || new_size < 0)
 		MSGB_ABORT(msg, "Negative sizes are not allowed\n");
 	if (area < msg->data || post_start > msg->tail)
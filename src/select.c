@@ -23,14 +23,21 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
 #include <sys/select.h>
 
 #include <osmocom/core/select.h>
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
 
 #include "../config.h"
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 #ifdef HAVE_SYS_SELECT_H
 
 /*! \addtogroup select
@@ -43,7 +50,226 @@
 
 static int maxfd = 0;
 static LLIST_HEAD(osmo_fds);
-static int unregistered_count;
+static enum osmo_select_backend backend = OSMO_SELECT_BACKEND_SELECT;
+
+/* dispatch state of an osmo_select_main() invocation.  Call-backs may
+ * call osmo_select_main() again, so these form a stack, and
+ * osmo_fd_unregister() fixes up every one of them */
+struct select_cursor {
+	struct select_cursor *outer;
+	/* next entry of osmo_fds to be dispatched by select_main() */
+	struct llist_head *next;
+#ifdef HAVE_SYS_EPOLL_H
+	/* events returned by epoll_wait(), index of the next one to be
+	 * dispatched by epoll_main() and number of events */
+	struct epoll_event *ev;
+	int next_ev;
+	int num_ev;
+#endif
+};
+static struct select_cursor *cursors;
+
+#ifdef HAVE_SYS_EPOLL_H
+/* maximum number of events fetched by a single epoll_wait() call */
+#define EPOLL_MAX_EVENTS	256
+
+static int epoll_fd = -1;
+
+static uint32_t when2epoll(unsigned int when)
+{
+	uint32_t events = 0;
+
+	if (when & BSC_FD_READ)
+		events |= EPOLLIN;
+	if (when & BSC_FD_WRITE)
+		events |= EPOLLOUT;
+	if (when & BSC_FD_EXCEPT)
+		events |= EPOLLPRI;
+
+	return events;
+}
+
+/* map epoll events to BSC_FD_* the same way select(2) reports them */
+static unsigned int epoll2when(uint32_t events)
+{
+	unsigned int what = 0;
+
+	if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+		what |= BSC_FD_READ;
+	if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+		what |= BSC_FD_WRITE;
+	if (events & EPOLLPRI)
+		what |= BSC_FD_EXCEPT;
+
+	return what;
+}
+
+/* install fd->when into the kernel interest set.  An fd without any
+ * interest is removed from the set altogether, as EPOLLHUP/EPOLLERR
+ * would otherwise keep waking us up for it */
+static int epoll_sync(struct osmo_fd *fd)
+{
+	struct epoll_event ev;
+	int op;
+
+	if (fd->when == fd->kernel_when)
+		return 0;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = when2epoll(fd->when);
+	ev.data.ptr = fd;
+
+	if (!fd->when)
+		op = EPOLL_CTL_DEL;
+	else if (!fd->kernel_when)
+		op = EPOLL_CTL_ADD;
+	else
+		op = EPOLL_CTL_MOD;
+
+	if (epoll_ctl(epoll_fd, op, fd->fd, &ev) < 0)
+		return -errno;
+
+	fd->kernel_when = fd->when;
+	return 0;
+}
+
+static void epoll_unregister(struct osmo_fd *fd)
+{
+	struct select_cursor *c;
+	int i;
+
+	/* the fd may already have been closed, which implicitly removed
+	 * it from the interest set, so ignore any error here */
+	if (fd->kernel_when) {
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd->fd, NULL);
+		fd->kernel_when = 0;
+	}
+
+	/* make sure we don't dispatch any pending event to it */
+	for (c = cursors; c; c = c->outer) {
+		for (i = c->next_ev; i < c->num_ev; i++) {
+			if (c->ev[i].data.ptr == fd)
+				c->ev[i].data.ptr = NULL;
+		}
+	}
+}
+
+static int epoll_main(int polling)
+{
+	struct epoll_event events[EPOLL_MAX_EVENTS];
+	struct select_cursor cur;
+	struct osmo_fd *ufd;
+	struct timeval *tv;
+	int timeout = -1;
+	int work = 0, rc;
+
+	/* users are allowed to modify ->when directly, so compare it
+	 * against what the kernel knows.  This is only an integer
+	 * comparison per fd, epoll_ctl() is only called on changes.
+	 * Don't wait on an interest set that doesn't match ->when */
+	llist_for_each_entry(ufd, &osmo_fds, list) {
+		rc = epoll_sync(ufd);
+		if (rc < 0)
+			return rc;
+	}
+
+	osmo_timers_check();
+
+	if (polling)
+		timeout = 0;
+	else {
+		osmo_clock_update();
+		osmo_timers_prepare();
+		tv = osmo_timers_nearest();
+		/* round up, we don't want to wake up before the timer */
+		if (tv && tv->tv_sec >= INT_MAX / 1000)
+			timeout = INT_MAX;
+		else if (tv)
+			timeout = tv->tv_sec * 1000 + (tv->tv_usec + 999) / 1000;
+	}
+
+	rc = epoll_wait(epoll_fd, events, ARRAY_SIZE(events), timeout);
+	osmo_clock_update();
+	if (rc < 0)
+		return 0;
+
+	memset(&cur, 0, sizeof(cur));
+	cur.ev = events;
+	cur.num_ev = rc;
+	cur.outer = cursors;
+	cursors = &cur;
+
+	/* fire timers */
+	osmo_timers_update();
+
+	/* call registered call-back functions.  epoll_unregister() clears
+	 * the pending events of fds that are unregistered meanwhile */
+	while (cur.next_ev < cur.num_ev) {
+		struct epoll_event *ev = &events[cur.next_ev++];
+		unsigned int flags;
+
+		ufd = ev->data.ptr;
+		if (!ufd)
+			continue;
+
+		flags = epoll2when(ev->events);
+		/* EPOLLHUP/EPOLLERR can't be masked.  Report them to fds
+		 * that only wait for exceptions as such, so that their
+		 * call-back can react instead of us waking up again and
+		 * again for nothing */
+		if ((ev->events & (EPOLLHUP | EPOLLERR)) &&
+		    !(ufd->when & (BSC_FD_READ | BSC_FD_WRITE)))
+			flags |= BSC_FD_EXCEPT;
+		flags &= ufd->when;
+		if (flags) {
+			work = 1;
+			ufd->cb(ufd, flags);
+		}
+	}
+	cursors = cur.outer;
+
+	return work;
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
+/*! \brief Select the backend used by \ref osmo_select_main
+ *  \param[in] new_backend backend to be used
+ *  \returns 0 on success; negative errno otherwise
+ *
+ * The backend can only be changed while no file descriptors are
+ * registered, i.e. typically once at application start-up.  The
+ * default backend is \ref OSMO_SELECT_BACKEND_SELECT.
+ */
+int osmo_select_set_backend(enum osmo_select_backend new_backend)
+{
+	if (!llist_empty(&osmo_fds))
+		return -EBUSY;
+
+	switch (new_backend) {
+	case OSMO_SELECT_BACKEND_SELECT:
+		break;
+#ifdef HAVE_SYS_EPOLL_H
+	case OSMO_SELECT_BACKEND_EPOLL:
+		if (epoll_fd < 0) {
+			epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+			if (epoll_fd < 0)
+				return -errno;
+		}
+		break;
+#endif
+	default:
+		return -ENOTSUP;
+	}
+
+	backend = new_backend;
+	return 0;
+}
+
+/*! \brief Obtain the backend currently used by \ref osmo_select_main */
+enum osmo_select_backend osmo_select_get_backend(void)
+{
+	return backend;
+}
 
 /*! \brief Register a new file descriptor with select loop abstraction
  *  \param[in] fd osmocom file descriptor to be registered
@@ -84,6 +310,16 @@ int osmo_fd_register(struct osmo_fd *fd)
 	}
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+	fd->kernel_when = 0;
+	if (backend == OSMO_SELECT_BACKEND_EPOLL) {
+		/* epoll refuses e.g. regular files */
+		int rc = epoll_sync(fd);
+		if (rc < 0)
+			return rc;
+	}
+#endif
+
 	llist_add_tail(&fd->list, &osmo_fds);
 
 	return 0;
@@ -94,16 +330,23 @@ int osmo_fd_register(struct osmo_fd *fd)
  */
 void osmo_fd_unregister(struct osmo_fd *fd)
 {
-	unregistered_count++;
+	struct select_cursor *c;
+
+#ifdef HAVE_SYS_EPOLL_H
+	if (backend == OSMO_SELECT_BACKEND_EPOLL)
+		epoll_unregister(fd);
+#endif
+	for (c = cursors; c; c = c->outer) {
+		if (c->next == &fd->list)
+			c->next = fd->list.next;
+	}
 	llist_del(&fd->list);
 }
 
-/*! \brief select main loop integration
- *  \param[in] polling should we pollonly (1) or block on select (0)
- */
-int osmo_select_main(int polling)
+static int select_main(int polling)
 {
-	struct osmo_fd *ufd, *tmp;
+	struct select_cursor cur;
+	struct osmo_fd *ufd;
 	fd_set readset, writeset, exceptset;
 	int work = 0, rc;
 	struct timeval no_time = {0, 0};
@@ -126,21 +369,35 @@ int osmo_select_main(int polling)
 
 	osmo_timers_check();
 
-	if (!polling)
+	if (!polling) {
+		osmo_clock_update();
 		osmo_timers_prepare();
+	}
 	rc = select(maxfd+1, &readset, &writeset, &exceptset, polling ? &no_time : osmo_timers_nearest());
+	osmo_clock_update();
 	if (rc < 0)
 		return 0;
 
+	memset(&cur, 0, sizeof(cur));
+	cur.next = osmo_fds.next;
+	cur.outer = cursors;
+	cursors = &cur;
+
 	/* fire timers */
 	osmo_timers_update();
 
-	/* call registered callback functions */
-restart:
-	unregistered_count = 0;
-	llist_for_each_entry_safe(ufd, tmp, &osmo_fds, list) {
+	/* call registered callback functions.  The call-backs may
+	 * unregister any fd, including the current and the next one.
+	 * llist_for_each_entry_safe() is not sufficient for the latter,
+	 * so osmo_fd_unregister() advances cur.next for us.  Flags are
+	 * cleared once dispatched, so fds that are re-registered (and
+	 * thus appended to the list) are not dispatched twice. */
+	while (cur.next != &osmo_fds) {
 		int flags = 0;
 
+		ufd = llist_entry(cur.next, struct osmo_fd, list);
+		cur.next = cur.next->next;
+
 		if (FD_ISSET(ufd->fd, &readset)) {
 			flags |= BSC_FD_READ;
 			FD_CLR(ufd->fd, &readset);
@@ -160,16 +417,29 @@ restart:
 			work = 1;
 			ufd->cb(ufd, flags);
 		}
-		/* ugly, ugly hack. If more than one filedescriptor was
-		 * unregistered, they might have been consecutive and
-		 * llist_for_each_entry_safe() is no longer safe */
-		/* this seems to happen with the last element of the list as well */
-		if (unregistered_count >= 1)
-			goto restart;
 	}
+	cursors = cur.outer;
+
 	return work;
 }
 
+/*! \brief select main loop integration
+ *  \param[in] polling should we pollonly (1) or block on select (0)
+ *  \returns 1 if any fd was dispatched, 0 if not, negative errno if
+ *  the epoll backend failed to update the kernel interest set
+ *
+ * This may be called from within a call-back, fds unregistered by the
+ * inner invocation are not dispatched by the outer one either.
+ */
+int osmo_select_main(int polling)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (backend == OSMO_SELECT_BACKEND_EPOLL)
+		return epoll_main(polling);
+#endif
+	return select_main(polling);
+}
+
 /*! @} */
 
 #endif /* _HAVE_SYS_SELECT_H */
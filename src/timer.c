@@ -33,6 +33,8 @@
 
 #include <assert.h>
 #include <string.h>
+#include <stdint.h>
+#include <errno.h>
 #include <limits.h>
 #include <osmocom/core/timer.h>
 #include <osmocom/core/timer_compat.h>
@@ -44,6 +46,214 @@ static struct timeval *nearest_p;
 
 static struct rb_root timer_root = RB_ROOT;
 
+static enum osmo_timer_backend timer_backend = OSMO_TIMER_BACKEND_RBTREE;
+
+/* Hierarchical timing wheel, modelled after the classic Linux kernel
+ * timers: level 0 has one slot per tick, each of the higher levels has
+ * slots spanning a whole rotation of the level below.  Timers are
+ * cascaded down a level whenever the level below wraps around. */
+#define TW_TICK_USEC	1000
+#define TW_L0_BITS	8
+#define TW_LN_BITS	6
+#define TW_LN_NUM	4
+#define TW_L0_SIZE	(1 << TW_L0_BITS)
+#define TW_LN_SIZE	(1 << TW_LN_BITS)
+#define TW_L0_MASK	(TW_L0_SIZE - 1)
+#define TW_LN_MASK	(TW_LN_SIZE - 1)
+#define TW_MAX_IDX	((1ULL << (TW_L0_BITS + TW_LN_NUM * TW_LN_BITS)) - 1)
+#define TW_LN_SHIFT(n)	(TW_L0_BITS + (n) * TW_LN_BITS)
+
+static struct {
+	struct llist_head l0[TW_L0_SIZE];
+	struct llist_head ln[TW_LN_NUM][TW_LN_SIZE];
+	/* slots that may be non-empty, cleared lazily when searched */
+	uint64_t l0_used[TW_L0_SIZE / 64];
+	uint64_t ln_used[TW_LN_NUM];
+	/* next tick to be processed */
+	uint64_t base;
+	/* number of timers in the wheel */
+	unsigned int count;
+} wheel;
+
+static uint64_t tw_tick(const struct timeval *tv, int round_up)
+{
+	uint64_t usec = (uint64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+
+	if (round_up)
+		usec += TW_TICK_USEC - 1;
+
+	return usec / TW_TICK_USEC;
+}
+
+static uint64_t tw_now(void)
+{
+	struct timeval current_time;
+
+	osmo_clock_now_cached(&current_time);
+	return tw_tick(&current_time, 0);
+}
+
+static void tw_init(void)
+{
+	int i, n;
+
+	for (i = 0; i < TW_L0_SIZE; i++)
+		INIT_LLIST_HEAD(&wheel.l0[i]);
+	for (n = 0; n < TW_LN_NUM; n++) {
+		for (i = 0; i < TW_LN_SIZE; i++)
+			INIT_LLIST_HEAD(&wheel.ln[n][i]);
+	}
+	memset(wheel.l0_used, 0, sizeof(wheel.l0_used));
+	memset(wheel.ln_used, 0, sizeof(wheel.ln_used));
+	wheel.count = 0;
+	wheel.base = tw_now();
+}
+
+/* put the timer into the slot matching its expiration */
+static void tw_add(struct osmo_timer_list *timer)
+{
+	uint64_t expires = tw_tick(&timer->timeout, 1);
+	uint64_t idx;
+	unsigned int slot;
+	int n;
+
+	/* already expired, process with the next tick */
+	if (expires < wheel.base)
+		expires = wheel.base;
+
+	idx = expires - wheel.base;
+	if (idx < TW_L0_SIZE) {
+		slot = expires & TW_L0_MASK;
+		llist_add_tail(&timer->list, &wheel.l0[slot]);
+		wheel.l0_used[slot / 64] |= 1ULL << (slot % 64);
+		return;
+	}
+
+	/* beyond the range of the wheel, re-evaluated when cascading */
+	if (idx > TW_MAX_IDX)
+		expires = wheel.base + TW_MAX_IDX;
+
+	for (n = 0; n < TW_LN_NUM - 1; n++) {
+		if (idx < 1ULL << TW_LN_SHIFT(n + 1))
+			break;
+	}
+	slot = (expires >> TW_LN_SHIFT(n)) & TW_LN_MASK;
+	llist_add_tail(&timer->list, &wheel.ln[n][slot]);
+	wheel.ln_used[n] |= 1ULL << slot;
+}
+
+/* called when level 0 wraps around: move the timers of the current
+ * slot of level 1 one level down, and so on for the higher levels */
+static void tw_cascade(void)
+{
+	struct osmo_timer_list *this, *tmp;
+	LLIST_HEAD(cascade);
+	unsigned int slot;
+	int n;
+
+	for (n = 0; n < TW_LN_NUM; n++) {
+		slot = (wheel.base >> TW_LN_SHIFT(n)) & TW_LN_MASK;
+
+		llist_splice_init(&wheel.ln[n][slot], &cascade);
+		wheel.ln_used[n] &= ~(1ULL << slot);
+		llist_for_each_entry_safe(this, tmp, &cascade, list) {
+			llist_del(&this->list);
+			tw_add(this);
+		}
+
+		if (slot)
+			break;
+	}
+}
+
+/* find the offset of the first non-empty slot at or after \a pos */
+static int tw_find_slot(struct llist_head *slots, uint64_t *used,
+			unsigned int size, unsigned int pos)
+{
+	unsigned int nwords = size / 64;
+	unsigned int i, slot;
+	uint64_t bits;
+
+	for (i = 0; i <= nwords; i++) {
+		unsigned int w = (pos / 64 + i) % nwords;
+
+		bits = used[w];
+		if (i == 0)
+			bits &= ~0ULL << (pos % 64);
+		else if (i == nwords)
+			bits &= ~(~0ULL << (pos % 64));
+
+		while (bits) {
+			slot = w * 64 + __builtin_ctzll(bits);
+			if (!llist_empty(&slots[slot]))
+				return (slot - pos) & (size - 1);
+			/* timers have been deleted meanwhile */
+			used[w] &= ~(1ULL << (slot % 64));
+			bits &= bits - 1;
+		}
+	}
+
+	return -1;
+}
+
+/* the tick when the first timer expires or a cascade of a non-empty
+ * slot may move such a timer into level 0, whichever comes first */
+static uint64_t tw_next_tick(void)
+{
+	uint64_t next = UINT64_MAX, t;
+	unsigned int shift, pos;
+	int n, first, k;
+
+	k = tw_find_slot(wheel.l0, wheel.l0_used, TW_L0_SIZE,
+			 wheel.base & TW_L0_MASK);
+	if (k >= 0)
+		next = wheel.base + k;
+
+	for (n = 0; n < TW_LN_NUM; n++) {
+		shift = TW_LN_SHIFT(n);
+		pos = (wheel.base >> shift) & TW_LN_MASK;
+		/* the cascade of the current slot is still pending if we
+		 * are exactly at its boundary */
+		first = (wheel.base & ((1ULL << shift) - 1)) ? 1 : 0;
+		k = tw_find_slot(wheel.ln[n], &wheel.ln_used[n], TW_LN_SIZE,
+				 (pos + first) & TW_LN_MASK);
+		if (k < 0)
+			continue;
+		t = ((wheel.base >> shift) + first + k) << shift;
+		if (t < next)
+			next = t;
+	}
+
+	return next;
+}
+
+/*! \brief Select the data structure used to manage pending timers
+ *  \param[in] backend backend to be used
+ *  \returns 0 on success; negative errno otherwise
+ *
+ * The backend can only be changed while no timer is pending, i.e.
+ * typically once at application start-up.  The default backend is
+ * \ref OSMO_TIMER_BACKEND_RBTREE.
+ */
+int osmo_timers_set_backend(enum osmo_timer_backend backend)
+{
+	if (osmo_timers_check())
+		return -EBUSY;
+
+	switch (backend) {
+	case OSMO_TIMER_BACKEND_RBTREE:
+		break;
+	case OSMO_TIMER_BACKEND_WHEEL:
+		tw_init();
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	timer_backend = backend;
+	return 0;
+}
+
 static void __add_timer(struct osmo_timer_list *timer)
 {
 	struct rb_node **new = &(timer_root.rb_node);
@@ -73,6 +283,15 @@ void osmo_timer_add(struct osmo_timer_list *timer)
 	osmo_timer_del(timer);
 	timer->active = 1;
 	INIT_LLIST_HEAD(&timer->list);
+
+	if (timer_backend == OSMO_TIMER_BACKEND_WHEEL) {
+		/* don't walk the wheel for the time it was empty */
+		if (!wheel.count++)
+			wheel.base = tw_now();
+		tw_add(timer);
+		return;
+	}
+
 	__add_timer(timer);
 }
 
@@ -91,7 +310,7 @@ osmo_timer_schedule(struct osmo_timer_list *timer, int seconds, int microseconds
 {
 	struct timeval current_time;
 
-	gettimeofday(&current_time, NULL);
+	osmo_clock_now_cached(&current_time);
 	timer->timeout.tv_sec = seconds;
 	timer->timeout.tv_usec = microseconds;
 	timeradd(&timer->timeout, &current_time, &timer->timeout);
@@ -106,7 +325,11 @@ osmo_timer_schedule(struct osmo_timer_list *timer, int seconds, int microseconds
  */
 void osmo_timer_del(struct osmo_timer_list *timer)
 {
-	if (timer->active) {
+	if (timer->active && timer_backend == OSMO_TIMER_BACKEND_WHEEL) {
+		timer->active = 0;
+		llist_del_init(&timer->list);
+		wheel.count--;
+	} else if (timer->active) {
 		timer->active = 0;
 		rb_erase(&timer->node, &timer_root);
 		/* make sure this is not already scheduled for removal. */
@@ -129,7 +352,8 @@ int osmo_timer_pending(struct osmo_timer_list *timer)
 
 /*! \brief compute the remaining time of a timer
  *  \param[in] timer the to-be-checked timer
- *  \param[in] now the current time (NULL if not known)
+ *  \param[in] now the current time as of \ref osmo_clock_now_cached (NULL if
+ *  not known)
  *  \param[out] remaining remaining time until timer fires
  *  \return 0 if timer has not expired yet, -1 if it has
  *
@@ -143,7 +367,7 @@ int osmo_timer_remaining(const struct osmo_timer_list *timer,
 	struct timeval current_time;
 
 	if (!now)
-		gettimeofday(&current_time, NULL);
+		osmo_clock_now_cached(&current_time);
 	else
 		current_time = *now;
 
@@ -193,7 +417,22 @@ void osmo_timers_prepare(void)
 	struct rb_node *node;
 	struct timeval current;
 
-	gettimeofday(&current, NULL);
+	osmo_clock_now_cached(&current);
+
+	if (timer_backend == OSMO_TIMER_BACKEND_WHEEL) {
+		struct timeval cand;
+		uint64_t next;
+
+		if (!wheel.count) {
+			nearest_p = NULL;
+			return;
+		}
+		next = tw_next_tick();
+		cand.tv_sec = next * TW_TICK_USEC / 1000000;
+		cand.tv_usec = next * TW_TICK_USEC % 1000000;
+		update_nearest(&cand, &current);
+		return;
+	}
 
 	node = rb_first(&timer_root);
 	if (node) {
@@ -205,6 +444,42 @@ void osmo_timers_prepare(void)
 	}
 }
 
+static int tw_update(const struct timeval *current_time)
+{
+	uint64_t now = tw_tick(current_time, 0);
+	struct osmo_timer_list *this;
+	LLIST_HEAD(expired);
+	unsigned int slot;
+	int work = 0;
+
+	while (wheel.base <= now) {
+		if (!wheel.count) {
+			wheel.base = now;
+			break;
+		}
+
+		slot = wheel.base & TW_L0_MASK;
+		if (!slot)
+			tw_cascade();
+		wheel.base++;
+
+		llist_splice_init(&wheel.l0[slot], &expired);
+		wheel.l0_used[slot / 64] &= ~(1ULL << (slot % 64));
+
+		/* call-backs may delete any of the expired timers, so
+		 * always take the first remaining one */
+		while (!llist_empty(&expired)) {
+			this = llist_entry(expired.next,
+					   struct osmo_timer_list, list);
+			osmo_timer_del(this);
+			this->cb(this->data);
+			work = 1;
+		}
+	}
+
+	return work;
+}
+
 /*! \brief fire all timers... and remove them */
 int osmo_timers_update(void)
 {
@@ -214,7 +489,11 @@ int osmo_timers_update(void)
 	struct osmo_timer_list *this;
 	int work = 0;
 
-	gettimeofday(&current_time, NULL);
+	/* osmo_select_main() sampled the clock when the wait returned */
+	osmo_clock_now_cached(&current_time);
+
+	if (timer_backend == OSMO_TIMER_BACKEND_WHEEL)
+		return tw_update(&current_time);
 
 	INIT_LLIST_HEAD(&timer_eviction_list);
 	for (node = rb_first(&timer_root); node; node = rb_next(node)) {
@@ -254,6 +533,9 @@ int osmo_timers_check(void)
 	struct rb_node *node;
 	int i = 0;
 
+	if (timer_backend == OSMO_TIMER_BACKEND_WHEEL)
+		return wheel.count;
+
 	for (node = rb_first(&timer_root); node; node = rb_next(node)) {
 		i++;
 	}
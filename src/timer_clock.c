@@ -0,0 +1,179 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*! \addtogroup timer
+ *  @{
+ */
+
+/*! \file timer_clock.c
+ *  \brief Clock used as time base of the timer core
+ *
+ * The timers run on CLOCK_MONOTONIC, so they don't jump if the
+ * wall-clock is changed.  Reading the clock for every timer that is
+ * scheduled adds up, so osmo_select_main() samples it via \ref
+ * osmo_clock_update before it computes the select timeout and again
+ * once the wait returned.  The timer core, the log timestamps and
+ * other per-event users read that sample via \ref osmo_clock_now_cached
+ * and \ref osmo_clock_realtime_cached, while \ref osmo_clock_now and
+ * \ref osmo_clock_realtime always read the clock.
+ *
+ * The sample is per thread.  Threads that never called \ref
+ * osmo_clock_update, i.e. that don't run the select loop, read the
+ * clock from the cached accessors as well.
+ *
+ * For tests, the monotonic clock can be replaced by a fake clock that
+ * only advances when told to.
+ */
+
+#include <time.h>
+#include <sys/time.h>
+
+#include <osmocom/core/timer.h>
+#include <osmocom/core/timer_compat.h>
+
+static __thread struct timeval clock_mono;
+static __thread struct timeval clock_real;
+static __thread int clock_valid;
+static __thread int clock_real_valid;
+
+static int override_enabled;
+static struct timeval override_time;
+
+static void sample(clockid_t clk_id, struct timeval *tv)
+{
+	struct timespec ts;
+
+	clock_gettime(clk_id, &ts);
+	tv->tv_sec = ts.tv_sec;
+	tv->tv_usec = ts.tv_nsec / 1000;
+}
+
+/*! \brief Sample the clocks for the cached accessors
+ *
+ * osmo_select_main() calls this before it computes the timeout and
+ * after the wait returned.  Programs that drive the timers without
+ * osmo_select_main() may call it once per iteration of their own loop.
+ */
+void osmo_clock_update(void)
+{
+	osmo_clock_now(&clock_mono);
+	/* the wall-clock is only read if somebody asks for it */
+	clock_real_valid = 0;
+	clock_valid = 1;
+}
+
+/*! \brief Obtain the current monotonic time
+ *  \param[out] now current CLOCK_MONOTONIC time (or fake clock)
+ *
+ * This is the time base of \ref osmo_timer_list.timeout.  It doesn't
+ * jump if the wall-clock is changed.  The clock is read on every call,
+ * see \ref osmo_clock_now_cached for the variant used by the timers.
+ */
+void osmo_clock_now(struct timeval *now)
+{
+	if (override_enabled)
+		*now = override_time;
+	else
+		sample(CLOCK_MONOTONIC, now);
+}
+
+/*! \brief Obtain the monotonic time sampled by \ref osmo_clock_update
+ *  \param[out] now CLOCK_MONOTONIC time (or fake clock) as of the last
+ *  \ref osmo_clock_update of the calling thread
+ *
+ * This is what the timer core uses to schedule and expire timers.  If
+ * the calling thread never called \ref osmo_clock_update, the clock is
+ * read like \ref osmo_clock_now does.
+ */
+void osmo_clock_now_cached(struct timeval *now)
+{
+	if (clock_valid)
+		*now = clock_mono;
+	else
+		osmo_clock_now(now);
+}
+
+/*! \brief Obtain the current wall-clock time
+ *  \param[out] now current CLOCK_REALTIME time
+ */
+void osmo_clock_realtime(struct timeval *now)
+{
+	sample(CLOCK_REALTIME, now);
+}
+
+/*! \brief Obtain the wall-clock time as of the last clock update
+ *  \param[out] now CLOCK_REALTIME time, read once after each \ref
+ *  osmo_clock_update of the calling thread
+ *
+ * If the calling thread never called \ref osmo_clock_update, the clock
+ * is read like \ref osmo_clock_realtime does.
+ */
+void osmo_clock_realtime_cached(struct timeval *now)
+{
+	if (!clock_valid) {
+		osmo_clock_realtime(now);
+		return;
+	}
+	if (!clock_real_valid) {
+		osmo_clock_realtime(&clock_real);
+		clock_real_valid = 1;
+	}
+	*now = clock_real;
+}
+
+/*! \brief Enable or disable the fake monotonic clock
+ *  \param[in] enable 1 to use the fake clock, 0 for CLOCK_MONOTONIC
+ *
+ * The fake clock starts at the time passed to \ref
+ * osmo_clock_override_set (0 by default).  It is meant for tests only,
+ * timers that are already pending are not adjusted.  While it is
+ * enabled, the cached time of the calling thread follows the fake
+ * clock immediately.
+ */
+void osmo_clock_override_enable(int enable)
+{
+	override_enabled = enable;
+	if (enable)
+		osmo_clock_update();
+	else
+		clock_valid = 0;
+}
+
+/*! \brief Set the time of the fake monotonic clock
+ *  \param[in] tv new time of the fake clock
+ */
+void osmo_clock_override_set(const struct timeval *tv)
+{
+	override_time = *tv;
+	if (override_enabled)
+		clock_mono = override_time;
+}
+
+/*! \brief Advance the fake monotonic clock
+ *  \param[in] secs seconds to add
+ *  \param[in] usecs microseconds to add
+ */
+void osmo_clock_override_add(time_t secs, suseconds_t usecs)
+{
+	struct timeval delta = { secs, usecs };
+
+	timeradd(&override_time, &delta, &override_time);
+	if (override_enabled)
+		clock_mono = override_time;
+}
+
+/*! @} */
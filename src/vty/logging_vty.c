@@ -29,6 +29,7 @@
 #include <osmocom/core/utils.h>
 #include <osmocom/core/strrb.h>
 #include <osmocom/core/loggingrb.h>
+#include <osmocom/core/logging_bin.h>
 
 #include <osmocom/vty/command.h>
 #include <osmocom/vty/buffer.h>
@@ -211,8 +212,7 @@ DEFUN(logging_level,
 		return CMD_WARNING;
 	}
 
-	tgt->categories[category].enabled = 1;
-	tgt->categories[category].loglevel = level;
+	log_set_category_filter(tgt, category, 1, level);
 
 	return CMD_SUCCESS;
 }
@@ -336,6 +336,46 @@ DEFUN(show_alarms,
 	return CMD_SUCCESS;
 }
 
+struct show_trace_state {
+	struct vty *vty;
+	struct log_target *tgt;
+};
+
+static int show_trace_rec(const struct log_bin_rec *rec, void *data)
+{
+	struct show_trace_state *st = data;
+	char buf[4096];
+
+	log_bin_format(st->tgt, buf, sizeof(buf), rec);
+	vty_out(st->vty, "%s", buf);
+	if (strchr(buf, '\n'))
+		vty_out(st->vty, "\r");
+
+	return 0;
+}
+
+DEFUN(show_logging_trace,
+	show_logging_trace_cmd,
+	"show logging trace",
+	SHOW_STR SHOW_LOG_STR
+	"Show the contents of the binary trace ringbuffer\n")
+{
+	struct show_trace_state st = { .vty = vty };
+
+	st.tgt = log_target_find(LOG_TGT_TYPE_BIN_RB, NULL);
+	if (!st.tgt) {
+		vty_out(vty, "%% No trace, run 'log trace <1024-1073741824>'%s",
+			VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	vty_out(vty, "%% Showing %zu messages%s",
+		log_target_rb_bin_used_size(st.tgt), VTY_NEWLINE);
+	log_target_rb_bin_foreach(st.tgt, show_trace_rec, &st);
+
+	return CMD_SUCCESS;
+}
+
 gDEFUN(cfg_description, cfg_description_cmd,
 	"description .TEXT",
 	"Save human-readable decription of the object\n"
@@ -622,6 +662,49 @@ DEFUN(cfg_no_log_alarms, cfg_no_log_alarms_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_log_trace, cfg_log_trace_cmd,
+	"log trace <1024-1073741824>",
+	LOG_STR "Logging to a binary ringbuffer, formatted when shown\n"
+	"Size of the ringbuffer in bytes\n")
+{
+	struct log_target *tgt;
+	size_t size = atoi(argv[0]);
+
+	tgt = log_target_find(LOG_TGT_TYPE_BIN_RB, NULL);
+	if (tgt)
+		log_target_destroy(tgt);
+
+	tgt = log_target_create_rb_bin(size);
+	if (!tgt) {
+		vty_out(vty, "%% Unable to create trace ringbuffer "
+			"(size %zu)%s", size, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	log_add_target(tgt);
+
+	vty->index = tgt;
+	vty->node = CFG_LOG_NODE;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_no_log_trace, cfg_no_log_trace_cmd,
+	"no log trace",
+	NO_STR LOG_STR "Logging to a binary ringbuffer, formatted when shown\n")
+{
+	struct log_target *tgt;
+
+	tgt = log_target_find(LOG_TGT_TYPE_BIN_RB, NULL);
+	if (!tgt) {
+		vty_out(vty, "%% No trace ringbuffer found%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	log_target_destroy(tgt);
+
+	return CMD_SUCCESS;
+}
+
 static int config_write_log_single(struct vty *vty, struct log_target *tgt)
 {
 	int i;
@@ -649,6 +732,10 @@ static int config_write_log_single(struct vty *vty, struct log_target *tgt)
 		vty_out(vty, "log alarms %zu%s",
 			log_target_rb_avail_size(tgt), VTY_NEWLINE);
 		break;
+	case LOG_TGT_TYPE_BIN_RB:
+		vty_out(vty, "log trace %zu%s",
+			log_target_rb_bin_avail_size(tgt), VTY_NEWLINE);
+		break;
 	}
 
 	vty_out(vty, "  logging filter all %u%s",
@@ -720,6 +807,7 @@ void logging_vty_add_cmds(const struct log_info *cat)
 	install_element_ve(&logging_level_cmd);
 	install_element_ve(&show_logging_vty_cmd);
 	install_element_ve(&show_alarms_cmd);
+	install_element_ve(&show_logging_trace_cmd);
 
 	install_node(&cfg_log_node, config_write_log);
 	vty_install_default(CFG_LOG_NODE);
@@ -736,6 +824,8 @@ void logging_vty_add_cmds(const struct log_info *cat)
 	install_element(CONFIG_NODE, &cfg_no_log_file_cmd);
 	install_element(CONFIG_NODE, &cfg_log_alarms_cmd);
 	install_element(CONFIG_NODE, &cfg_no_log_alarms_cmd);
+	install_element(CONFIG_NODE, &cfg_log_trace_cmd);
+	install_element(CONFIG_NODE, &cfg_no_log_trace_cmd);
 #ifdef HAVE_SYSLOG_H
 	install_element(CONFIG_NODE, &cfg_log_syslog_cmd);
 	install_element(CONFIG_NODE, &cfg_log_syslog_local_cmd);
@@ -22,6 +22,14 @@
  */
 
 #include <errno.h>
+#include <unistd.h>
+
+#include "../config.h"
+
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
 #include <osmocom/core/write_queue.h>
 
 /*! \addtogroup write_queue
@@ -30,6 +38,79 @@
 
 /*! \file write_queue.c */
 
+/* remove a msgb from the queue and free it */
+static void wqueue_release(struct osmo_wqueue *queue, struct msgb *msg)
+{
+	if (msg == llist_entry(queue->msg_queue.next, struct msgb, list))
+		queue->partial = 0;
+	llist_del(&msg->list);
+	--queue->current_length;
+	msgb_free(msg);
+}
+
+/* write up to queue->batch msgbs (chains) of the queue by a single
+ * writev(), default for a NULL write_cb */
+static int wqueue_writev(struct osmo_wqueue *queue)
+{
+	struct msgb *msg;
+	int rc;
+#ifdef HAVE_SYS_UIO_H
+	struct msgb *tmp;
+	struct iovec iov[OSMO_WQUEUE_IOV_MAX];
+	unsigned int num = 0, iovcnt = 0;
+
+	llist_for_each_entry(msg, &queue->msg_queue, list) {
+		if (num > 0 && num >= queue->batch)
+			break;
+		rc = msgb_iovec(msg, iov + iovcnt, ARRAY_SIZE(iov) - iovcnt);
+		if (rc < 0)
+			break;
+		iovcnt += rc;
+		num++;
+	}
+
+	msg = llist_entry(queue->msg_queue.next, struct msgb, list);
+	if (num == 0) {
+		/* too many fragments for a single writev() */
+		rc = -EMSGSIZE;
+		goto drop;
+	}
+
+	rc = writev(queue->bfd.fd, iov, iovcnt);
+	if (rc < 0) {
+		rc = -errno;
+		if (rc == -EAGAIN || rc == -EINTR)
+			return 0;
+		goto drop;
+	}
+
+	/* release what was written, keep the rest of a partially written
+	 * msgb for the next time */
+	llist_for_each_entry_safe(msg, tmp, &queue->msg_queue, list) {
+		unsigned int len = msgb_chain_len(msg);
+
+		if (rc < len) {
+			if (rc > 0) {
+				msgb_chain_pull(msg, rc);
+				queue->partial = 1;
+			}
+			break;
+		}
+		rc -= len;
+		wqueue_release(queue, msg);
+	}
+
+	return 0;
+#else
+	msg = llist_entry(queue->msg_queue.next, struct msgb, list);
+	rc = -ENOTSUP;
+#endif
+
+drop:
+	wqueue_release(queue, msg);
+	return rc;
+}
+
 /*! \brief Select loop function for write queue handling
  *  \param[in] fd osmocom file descriptor
  *  \param[in] what bit-mask of events that have happened
@@ -58,23 +139,33 @@ int osmo_wqueue_bfd_cb(struct osmo_fd *fd, unsigned int what)
 
 	if (what & BSC_FD_WRITE) {
 		struct msgb *msg;
+		unsigned int num = 0;
 
 		fd->when &= ~BSC_FD_WRITE;
+		rc = 0;
 
 		/* the queue might have been emptied */
-		if (!llist_empty(&queue->msg_queue)) {
-			--queue->current_length;
-
-			msg = msgb_dequeue(&queue->msg_queue);
-			rc = queue->write_cb(fd, msg);
-			msgb_free(msg);
+		if (!queue->write_cb) {
+			if (!llist_empty(&queue->msg_queue))
+				rc = wqueue_writev(queue);
+		} else {
+			while (!llist_empty(&queue->msg_queue)) {
+				--queue->current_length;
 
-			if (rc == -EBADF)
-				goto err_badfd;
+				msg = msgb_dequeue(&queue->msg_queue);
+				rc = queue->write_cb(fd, msg);
+				msgb_free(msg);
 
-			if (!llist_empty(&queue->msg_queue))
-				fd->when |= BSC_FD_WRITE;
+				if (rc < 0 || ++num >= queue->batch)
+					break;
+			}
 		}
+
+		if (rc == -EBADF)
+			goto err_badfd;
+
+		if (!llist_empty(&queue->msg_queue))
+			fd->when |= BSC_FD_WRITE;
 	}
 
 err_badfd:
@@ -93,17 +184,52 @@ void osmo_wqueue_init(struct osmo_wqueue *queue, int max_length)
 	queue->read_cb = NULL;
 	queue->write_cb = NULL;
 	queue->bfd.cb = osmo_wqueue_bfd_cb;
+	queue->batch = 1;
+	queue->policy = OSMO_WQUEUE_UNLIMITED;
+	queue->partial = 0;
+	queue->dropped = 0;
+	queue->rejected = 0;
 	INIT_LLIST_HEAD(&queue->msg_queue);
 }
 
 /*! \brief Enqueue a new \ref msgb into a write queue
  *  \param[in] queue Write queue to be used
  *  \param[in] data to-be-enqueued message buffer
+ *  \returns 0 if \a data was consumed; -ENOSPC if it was rejected
+ *
+ * If the queue already holds max_length msgbs, the queue's policy
+ * decides whether the oldest msgb in the queue or \a data is dropped,
+ * or whether \a data is rejected.  A msgb that was partially written
+ * is never dropped.
  */
 int osmo_wqueue_enqueue(struct osmo_wqueue *queue, struct msgb *data)
 {
-//	if (queue->current_length + 1 >= queue->max_length)
-//		LOGP(DMSC, LOGL_ERROR, "The queue is full. Dropping not yet implemented.\n");
+	struct llist_head *oldest;
+
+	if (queue->policy != OSMO_WQUEUE_UNLIMITED &&
+	    queue->current_length >= queue->max_length) {
+		switch (queue->policy) {
+		case OSMO_WQUEUE_REJECT:
+			queue->rejected++;
+			return -ENOSPC;
+		case OSMO_WQUEUE_DROP_OLDEST:
+			oldest = queue->msg_queue.next;
+			if (queue->partial)
+				oldest = oldest->next;
+			if (oldest != &queue->msg_queue) {
+				wqueue_release(queue,
+					llist_entry(oldest, struct msgb, list));
+				queue->dropped++;
+				break;
+			}
+			/* only a partially written msgb in the queue */
+			/* fall through */
+		default:
+			queue->dropped++;
+			msgb_free(data);
+			return 0;
+		}
+	}
 
 	++queue->current_length;
 	msgb_enqueue(&queue->msg_queue, data);
@@ -125,6 +251,7 @@ void osmo_wqueue_clear(struct osmo_wqueue *queue)
 	}
 
 	queue->current_length = 0;
+	queue->partial = 0;
 	queue->bfd.when &= ~BSC_FD_WRITE;
 }
 
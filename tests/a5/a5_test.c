@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include <errno.h>
 
 #include <osmocom/core/bits.h>
 #include <osmocom/core/utils.h>
@@ -79,6 +80,78 @@ static inline bool test_a54(const char * kc, uint32_t count, const char * block1
 	return print_a5(4, 8, "DL", dlout, block1) & print_a5(4, 8, "UL", ulout, block2);
 }
 
+static void test_batch(int n, unsigned int count)
+{
+	uint8_t keys[300 * 16];
+	uint32_t fns[300];
+	ubit_t dl_b[300 * 114], ul_b[300 * 114], dl_s[114], ul_s[114];
+	unsigned int i, bad = 0;
+
+	for (i = 0; i < sizeof(keys); i++)
+		keys[i] = rand();
+	for (i = 0; i < count; i++)
+		fns[i] = rand() % (26 * 51 * 2048);
+
+	osmo_a5_batch(n, keys, fns, dl_b, ul_b, count);
+
+	for (i = 0; i < count; i++) {
+		osmo_a5(n, keys + (n == 4 ? 16 : 8) * i, fns[i], dl_s, ul_s);
+		if (memcmp(dl_s, dl_b + 114 * i, 114) ||
+		    memcmp(ul_s, ul_b + 114 * i, 114))
+			bad++;
+	}
+
+	/* only one direction */
+	osmo_a5_batch(n, keys, fns, NULL, ul_b, count);
+	for (i = 0; i < count; i++) {
+		osmo_a5(n, keys + (n == 4 ? 16 : 8) * i, fns[i], NULL, ul_s);
+		if (memcmp(ul_s, ul_b + 114 * i, 114))
+			bad++;
+	}
+
+	printf("A5/%d - batch of %u: %s\n", n, count, bad ? "FAIL" : "OK");
+}
+
+/* several successive frames of a few channels, as a BTS would cipher them */
+static void test_prepared(int n)
+{
+	const unsigned int key_len = n == 4 ? 16 : 8;
+	uint8_t keys[40 * 16];
+	uint32_t fns[40];
+	ubit_t dl_b[40 * 114], ul_b[40 * 114], dl_s[114], ul_s[114];
+	struct osmo_a5_key k;
+	unsigned int i, bad = 0;
+
+	for (i = 0; i < 40; i++) {
+		if (i % 10 == 0) {
+			unsigned int j;
+
+			for (j = 0; j < key_len; j++)
+				keys[key_len * i + j] = rand();
+		} else
+			memcpy(keys + key_len * i, keys + key_len * (i - 1), key_len);
+		fns[i] = rand() % (26 * 51 * 2048);
+	}
+
+	osmo_a5_batch(n, keys, fns, dl_b, ul_b, 40);
+
+	for (i = 0; i < 40; i++) {
+		if (i % 10 == 0)
+			OSMO_ASSERT(osmo_a5_key_init(&k, n, keys + key_len * i) == 0);
+		osmo_a5(n, keys + key_len * i, fns[i], dl_s, ul_s);
+		if (memcmp(dl_s, dl_b + 114 * i, 114) ||
+		    memcmp(ul_s, ul_b + 114 * i, 114))
+			bad++;
+
+		osmo_a5_key_gen(&k, fns[i], dl_b + 114 * i, NULL);
+		osmo_a5_key_gen(&k, fns[i], NULL, ul_b + 114 * i);
+		if (memcmp(dl_s, dl_b + 114 * i, 114) ||
+		    memcmp(ul_s, ul_b + 114 * i, 114))
+			bad++;
+	}
+
+	printf("A5/%d - prepared keys: %s\n", n, bad ? "FAIL" : "OK");
+}
 
 int main(int argc, char **argv)
 {
@@ -137,5 +210,19 @@ int main(int argc, char **argv)
 	test_a54("3D43C388C9581E337FF1F97EB5C1F85E", 0x35D2CF, "A2FE3034B6B22CC4E33C7090BEC340", "170D7497432FF897B91BE8AECBA880");
 	test_a54("A4496A64DF4F399F3B4506814A3E07A1", 0x212777, "89CDEE360DF9110281BCF57755A040", "33822C0C779598C9CBFC49183AF7C0");
 
+	/* scalar, 64, 128 and 256 lanes and combinations thereof */
+	srand(1);
+	for (n = 1; n <= 2; n++) {
+		test_batch(n, 5);
+		test_batch(n, 64);
+		test_batch(n, 100);
+		test_batch(n, 300);
+	}
+	test_batch(3, 9);
+	test_batch(4, 9);
+	test_prepared(3);
+	test_prepared(4);
+	OSMO_ASSERT(osmo_a5_key_init(NULL, 1, NULL) == -ENOTSUP);
+
 	return 0;
 }
@@ -57,6 +57,57 @@ static int opc_test(const struct osmo_sub_auth_data *aud)
 	return rc;
 }
 
+/* 3GPP TS 35.208 test set 1 */
+static void test_set_1(void)
+{
+	struct osmo_sub_auth_data aud = {
+		.type = OSMO_AUTH_TYPE_UMTS,
+		.algo = OSMO_AUTH_ALG_MILENAGE,
+		.u.umts = {
+			.opc = { 0xcd, 0x63, 0xcb, 0x71, 0x95, 0x4a, 0x9f, 0x4e,
+				 0x48, 0xa5, 0x99, 0x4e, 0x37, 0xa0, 0x2b, 0xaf },
+			.k =   { 0x46, 0x5b, 0x5c, 0xe8, 0xb1, 0x99, 0xb4, 0x9f,
+				 0xaa, 0x5f, 0x0a, 0x2e, 0xe2, 0x38, 0xa6, 0xbc },
+			.amf = { 0xb9, 0xb9 },
+			.sqn = 0xff9bb4d0b607ULL,
+		},
+	};
+	const uint8_t _rand[16] = { 0x23, 0x55, 0x3c, 0xbe, 0x96, 0x37, 0xa8, 0x9d,
+				    0x21, 0x8a, 0xe6, 0x4d, 0xae, 0x47, 0xbf, 0x35 };
+	struct osmo_auth_vector vec;
+
+	printf("3GPP TS 35.208 test set 1:\n");
+	memset(&vec, 0, sizeof(vec));
+	OSMO_ASSERT(osmo_auth_gen_vec(&vec, &aud, _rand) == 0);
+	dump_auth_vec(&vec);
+}
+
+/* a batch must give the same vectors as generating them one by one */
+static void test_batch(void)
+{
+	struct osmo_sub_auth_data aud_b = test_aud, aud_s = test_aud;
+	struct osmo_auth_vector vec_b[5], vec_s;
+	uint8_t _rand[5 * 16];
+	unsigned int i, bad = 0;
+
+	for (i = 0; i < sizeof(_rand); i++)
+		_rand[i] = i * 37;
+	memset(vec_b, 0, sizeof(vec_b));
+
+	OSMO_ASSERT(osmo_auth_gen_vec_batch(vec_b, 5, &aud_b, _rand) == 0);
+	for (i = 0; i < 5; i++) {
+		memset(&vec_s, 0, sizeof(vec_s));
+		OSMO_ASSERT(osmo_auth_gen_vec(&vec_s, &aud_s, _rand + 16 * i) == 0);
+		if (memcmp(&vec_s, &vec_b[i], sizeof(vec_s)))
+			bad++;
+	}
+
+	printf("Batch of 5: %s, SQN %llu -> %llu\n", bad ? "FAIL" : "OK",
+		(unsigned long long)test_aud.u.umts.sqn,
+		(unsigned long long)aud_b.u.umts.sqn);
+	OSMO_ASSERT(aud_b.u.umts.sqn == aud_s.u.umts.sqn);
+}
+
 int main(int argc, char **argv)
 {
 	struct osmo_auth_vector _vec;
@@ -95,6 +146,9 @@ int main(int argc, char **argv)
 
 	opc_test(&test_aud);
 
+	test_set_1();
+	test_batch();
+
 	exit(0);
 
 }
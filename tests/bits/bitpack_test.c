@@ -0,0 +1,195 @@
+/* Cross-check of the bulk bit conversion implementations
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+
+#define MAX_BITS	1024
+#define GUARD		16
+
+static unsigned int rnd_state;
+
+/* deterministic pseudo random numbers */
+static unsigned int rnd(void)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 16) & 0x7fff;
+}
+
+/* bit at a time reference implementations */
+static void ref_ubit2pbit_ext(pbit_t *out, unsigned int out_ofs,
+			      const ubit_t *in, unsigned int in_ofs,
+			      unsigned int num_bits, int lsb_mode)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_bits; i++) {
+		unsigned int op = out_ofs + i;
+		unsigned int bn = lsb_mode ? (op & 7) : (7 - (op & 7));
+
+		if (in[in_ofs + i])
+			out[op >> 3] |= 1 << bn;
+		else
+			out[op >> 3] &= ~(1 << bn);
+	}
+}
+
+static void ref_pbit2ubit_ext(ubit_t *out, unsigned int out_ofs,
+			      const pbit_t *in, unsigned int in_ofs,
+			      unsigned int num_bits, int lsb_mode)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_bits; i++) {
+		unsigned int ip = in_ofs + i;
+		unsigned int bn = lsb_mode ? (ip & 7) : (7 - (ip & 7));
+
+		out[out_ofs + i] = !!(in[ip >> 3] & (1 << bn));
+	}
+}
+
+static ubit_t ubits[MAX_BITS + GUARD], ks[MAX_BITS + GUARD];
+static sbit_t sbits[MAX_BITS + GUARD];
+static pbit_t pbits[MAX_BITS / 8 + GUARD];
+
+static void fill(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(ubits); i++) {
+		ubits[i] = rnd() & 1;
+		ks[i] = rnd() & 1;
+		sbits[i] = (rnd() & 0xff) - 128;
+	}
+	for (i = 0; i < sizeof(pbits); i++)
+		pbits[i] = rnd();
+}
+
+/* returns the number of mismatching conversions */
+static unsigned int check_backend(void)
+{
+	uint8_t a[MAX_BITS + GUARD], b[MAX_BITS + GUARD];
+	unsigned int errors = 0, n, ofs, i;
+	int rc, lsb;
+
+	for (n = 0; n <= MAX_BITS; n += 1 + n / 8) {
+		/* plain conversions; bytes behind the end stay untouched */
+		memset(a, 0xaa, sizeof(a));
+		memset(b, 0xaa, sizeof(b));
+		ref_ubit2pbit_ext(b, 0, ubits, 0, n, 0);
+		for (i = n; i < osmo_pbit_bytesize(n) * 8; i++)
+			b[i / 8] &= ~(0x80 >> (i % 8));
+		rc = osmo_ubit2pbit(a, ubits, n);
+		if (rc != osmo_pbit_bytesize(n) || memcmp(a, b, sizeof(a)))
+			errors++;
+
+		memset(a, 0xaa, sizeof(a));
+		memset(b, 0xaa, sizeof(b));
+		ref_pbit2ubit_ext(b, 0, pbits, 0, n, 0);
+		rc = osmo_pbit2ubit(a, pbits, n);
+		if (rc != n || memcmp(a, b, sizeof(a)))
+			errors++;
+
+		memset(a, 0xaa, sizeof(a));
+		memset(b, 0xaa, sizeof(b));
+		for (i = 0; i < n; i++)
+			b[i] = sbits[i] < 0;
+		osmo_sbit2ubit(a, sbits, n);
+		if (memcmp(a, b, sizeof(a)))
+			errors++;
+
+		memset(a, 0xaa, sizeof(a));
+		memset(b, 0xaa, sizeof(b));
+		for (i = 0; i < n; i++)
+			b[i] = ubits[i] ? -127 : 127;
+		osmo_ubit2sbit((sbit_t *) a, ubits, n);
+		if (memcmp(a, b, sizeof(a)))
+			errors++;
+
+		memset(a, 0xaa, sizeof(a));
+		memset(b, 0xaa, sizeof(b));
+		for (i = 0; i < n; i++)
+			b[i] = ubits[i] ^ ks[i];
+		osmo_ubit_xor(a, ubits, ks, n);
+		if (memcmp(a, b, sizeof(a)))
+			errors++;
+
+		memset(a, 0xaa, sizeof(a));
+		memset(b, 0xaa, sizeof(b));
+		for (i = 0; i < n; i++)
+			b[i] = ks[i] ? -sbits[i] : sbits[i];
+		osmo_sbit_xor((sbit_t *) a, sbits, ks, n);
+		if (memcmp(a, b, sizeof(a)))
+			errors++;
+
+		/* extended variants at all offsets within a byte */
+		for (ofs = 0; ofs < 16; ofs++) {
+			if (n + ofs > MAX_BITS)
+				break;
+			for (lsb = 0; lsb < 2; lsb++) {
+				memcpy(a, pbits, sizeof(pbits));
+				memcpy(b, pbits, sizeof(pbits));
+				ref_ubit2pbit_ext(b, ofs, ubits, ofs / 3, n, lsb);
+				osmo_ubit2pbit_ext(a, ofs, ubits, ofs / 3, n, lsb);
+				if (memcmp(a, b, sizeof(pbits)))
+					errors++;
+
+				memset(a, 0xaa, sizeof(a));
+				memset(b, 0xaa, sizeof(b));
+				ref_pbit2ubit_ext(b, ofs / 3, pbits, ofs, n, lsb);
+				rc = osmo_pbit2ubit_ext(a, ofs / 3, pbits, ofs, n, lsb);
+				if (rc != ofs / 3 + n || memcmp(a, b, sizeof(a)))
+					errors++;
+			}
+		}
+	}
+
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	const struct {
+		enum osmo_bits_backend be;
+		const char *name;
+	} backends[] = {
+		{ OSMO_BITS_GENERIC, "generic" },
+		{ OSMO_BITS_SSE2, "sse2" },
+		{ OSMO_BITS_AVX2, "avx2" },
+	};
+	unsigned int i, errors = 0;
+
+	rnd_state = 1;
+	fill();
+
+	/* the output depends on neither the build nor the CPU */
+	for (i = 0; i < ARRAY_SIZE(backends); i++) {
+		if (osmo_bits_set_backend(backends[i].be) < 0)
+			continue;
+		errors += check_backend();
+	}
+
+	printf("Checking bulk bit conversions: %s\n",
+		errors ? "FAILED" : "ok");
+
+	return errors ? 1 : 0;
+}
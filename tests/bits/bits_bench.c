@@ -0,0 +1,194 @@
+/* Benchmark of the bulk bit conversion implementations
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+
+/* bits converted per implementation and block size */
+#define TOTAL_BITS	(64 * 1024 * 1024)
+
+static ubit_t ubits[1392], ks[1392], uout[1392], uref[1392];
+static sbit_t sbits[1392];
+static pbit_t pbits[1392 / 8], pout[1392 / 8], pref[1392 / 8];
+
+/* the bit at a time implementations this replaced */
+static void ref_ubit2pbit(pbit_t *out, const ubit_t *in, unsigned int num_bits)
+{
+	unsigned int i;
+
+	memset(out, 0, osmo_pbit_bytesize(num_bits));
+	for (i = 0; i < num_bits; i++)
+		out[i / 8] |= in[i] << (7 - (i % 8));
+}
+
+static void ref_pbit2ubit(ubit_t *out, const pbit_t *in, unsigned int num_bits)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_bits; i++)
+		out[i] = (in[i / 8] >> (7 - (i % 8))) & 1;
+}
+
+enum op {
+	OP_UBIT2PBIT,
+	OP_PBIT2UBIT,
+	OP_SBIT2UBIT,
+	OP_UBIT_XOR,
+	_NUM_OP
+};
+
+static const char *op_name[_NUM_OP] = {
+	[OP_UBIT2PBIT] = "ubit2pbit",
+	[OP_PBIT2UBIT] = "pbit2ubit",
+	[OP_SBIT2UBIT] = "sbit2ubit",
+	[OP_UBIT_XOR] = "ubit_xor",
+};
+
+static void run(enum op op, unsigned int n)
+{
+	switch (op) {
+	case OP_UBIT2PBIT:
+		osmo_ubit2pbit(pout, ubits, n);
+		break;
+	case OP_PBIT2UBIT:
+		osmo_pbit2ubit(uout, pbits, n);
+		break;
+	case OP_SBIT2UBIT:
+		osmo_sbit2ubit(uout, sbits, n);
+		break;
+	case OP_UBIT_XOR:
+		osmo_ubit_xor(uout, ubits, ks, n);
+		break;
+	default:
+		break;
+	}
+}
+
+static int mismatch(enum op op, unsigned int n)
+{
+	if (op == OP_UBIT2PBIT)
+		return memcmp(pout, pref, osmo_pbit_bytesize(n));
+	return memcmp(uout, uref, n);
+}
+
+static void reference(enum op op, unsigned int n)
+{
+	unsigned int i;
+
+	switch (op) {
+	case OP_UBIT2PBIT:
+		ref_ubit2pbit(pref, ubits, n);
+		break;
+	case OP_PBIT2UBIT:
+		ref_pbit2ubit(uref, pbits, n);
+		break;
+	case OP_SBIT2UBIT:
+		for (i = 0; i < n; i++)
+			uref[i] = sbits[i] < 0;
+		break;
+	case OP_UBIT_XOR:
+		for (i = 0; i < n; i++)
+			uref[i] = ubits[i] ^ ks[i];
+		break;
+	default:
+		break;
+	}
+}
+
+static double bench_ref(enum op op, unsigned int n)
+{
+	struct timeval start, stop, diff;
+	unsigned int i, rounds = TOTAL_BITS / n;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < rounds; i++)
+		reference(op, n);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	return (double) rounds * n / (diff.tv_sec * 1000000.0 + diff.tv_usec);
+}
+
+int main(int argc, char **argv)
+{
+	const struct {
+		enum osmo_bits_backend be;
+		const char *name;
+	} backends[] = {
+		{ OSMO_BITS_GENERIC, "generic" },
+		{ OSMO_BITS_SSE2, "sse2" },
+		{ OSMO_BITS_AVX2, "avx2" },
+	};
+	/* a burst, a CS-1..4 block and an EDGE MCS-9 block */
+	const unsigned int sizes[] = { 114, 456, 1392 };
+	unsigned int s, b, i;
+	enum op op;
+
+	srandom(1);
+	for (i = 0; i < sizeof(ubits); i++) {
+		ubits[i] = random() & 1;
+		ks[i] = random() & 1;
+		sbits[i] = random();
+	}
+	for (i = 0; i < sizeof(pbits); i++)
+		pbits[i] = random();
+
+	for (op = 0; op < _NUM_OP; op++) {
+		for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+			unsigned int n = sizes[s], rounds = TOTAL_BITS / n;
+
+			printf("%-9s %4u bits %-8s: %8.1f Mbit/s\n", op_name[op],
+				n, "bitwise", bench_ref(op, n));
+
+			for (b = 0; b < ARRAY_SIZE(backends); b++) {
+				struct timeval start, stop, diff;
+				int bad;
+
+				if (osmo_bits_set_backend(backends[b].be) < 0) {
+					printf("%-9s %4u bits %-8s: not available\n",
+						op_name[op], n, backends[b].name);
+					continue;
+				}
+
+				/* check the result before timing */
+				reference(op, n);
+				run(op, n);
+				bad = mismatch(op, n);
+
+				gettimeofday(&start, NULL);
+				for (i = 0; i < rounds; i++)
+					run(op, n);
+				gettimeofday(&stop, NULL);
+				timersub(&stop, &start, &diff);
+
+				printf("%-9s %4u bits %-8s: %8.1f Mbit/s%s\n",
+					op_name[op], n, backends[b].name,
+					(double) rounds * n /
+					(diff.tv_sec * 1000000.0 + diff.tv_usec),
+					bad ? " MISMATCH" : "");
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,191 @@
+/* Benchmark of bit vector field access
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <osmocom/core/bitvec.h>
+#include <osmocom/core/utils.h>
+
+#define ROUNDS		200000
+
+/* field sizes of a CSN.1 encoded RLC/MAC control block (23 octets) */
+static const unsigned int lens[] = {
+	2, 6, 1, 2, 1, 5, 1, 32, 1, 7, 2, 1, 4, 1, 3, 5, 1, 16, 1, 6,
+	3, 1, 8, 1, 5, 2, 1, 11, 1, 4, 6, 1, 2, 1, 20, 1, 3, 1, 7,
+};
+
+static uint8_t data[23];
+static uint64_t vals[ARRAY_SIZE(lens)];
+
+/* the bit by bit implementation of bitvec_{read,write}_field() */
+static uint64_t serial_read(struct bitvec *bv, unsigned int *idx,
+			    unsigned int len)
+{
+	uint64_t ui = 0;
+	unsigned int i;
+
+	bv->cur_bit = *idx;
+	for (i = 0; i < len; i++) {
+		int bit = bitvec_get_bit_pos(bv, bv->cur_bit);
+		if (bit < 0)
+			return bit;
+		if (bit)
+			ui |= ((uint64_t)1 << (len - i - 1));
+		bv->cur_bit++;
+	}
+	*idx += len;
+	return ui;
+}
+
+static int serial_write(struct bitvec *bv, unsigned int *idx, uint64_t val,
+			unsigned int len)
+{
+	unsigned int i;
+	int rc;
+
+	bv->cur_bit = *idx;
+	for (i = 0; i < len; i++) {
+		rc = bitvec_set_bit(bv, (val >> (len - i - 1)) & 1);
+		if (rc)
+			return rc;
+	}
+	*idx += len;
+	return 0;
+}
+
+enum mode {
+	MODE_SERIAL,
+	MODE_FIELD,
+	MODE_CURSOR,
+};
+
+static const char *mode_name[] = {
+	[MODE_SERIAL] = "bit-serial",
+	[MODE_FIELD] = "read/write_field",
+	[MODE_CURSOR] = "cursor",
+};
+
+static void encode(enum mode mode, struct bitvec *bv)
+{
+	struct bitvec_cursor c;
+	unsigned int i, idx = 0;
+
+	switch (mode) {
+	case MODE_SERIAL:
+		for (i = 0; i < ARRAY_SIZE(lens); i++)
+			serial_write(bv, &idx, vals[i], lens[i]);
+		break;
+	case MODE_FIELD:
+		for (i = 0; i < ARRAY_SIZE(lens); i++)
+			bitvec_write_field(bv, &idx, vals[i], lens[i]);
+		break;
+	case MODE_CURSOR:
+		bitvec_cursor_init(&c, bv, 0);
+		for (i = 0; i < ARRAY_SIZE(lens); i++)
+			bitvec_cursor_write(&c, vals[i], lens[i]);
+		bitvec_cursor_finish(&c);
+		break;
+	}
+}
+
+static uint64_t decode(enum mode mode, struct bitvec *bv)
+{
+	struct bitvec_cursor c;
+	unsigned int i, idx = 0;
+	uint64_t sum = 0;
+
+	switch (mode) {
+	case MODE_SERIAL:
+		for (i = 0; i < ARRAY_SIZE(lens); i++)
+			sum += serial_read(bv, &idx, lens[i]);
+		break;
+	case MODE_FIELD:
+		for (i = 0; i < ARRAY_SIZE(lens); i++)
+			sum += bitvec_read_field(bv, &idx, lens[i]);
+		break;
+	case MODE_CURSOR:
+		bitvec_cursor_init(&c, bv, 0);
+		for (i = 0; i < ARRAY_SIZE(lens); i++)
+			sum += bitvec_cursor_read(&c, lens[i]);
+		bitvec_cursor_finish(&c);
+		break;
+	}
+
+	return sum;
+}
+
+static double elapsed_us(const struct timeval *start)
+{
+	struct timeval stop, diff;
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, start, &diff);
+	return diff.tv_sec * 1000000.0 + diff.tv_usec;
+}
+
+int main(int argc, char **argv)
+{
+	struct bitvec bv = { 0, sizeof(data), data };
+	uint8_t ref[sizeof(data)];
+	uint64_t ref_sum = 0, sum;
+	unsigned int i, bits = 0;
+	enum mode mode;
+
+	srandom(1);
+	for (i = 0; i < ARRAY_SIZE(lens); i++) {
+		vals[i] = random() & (((uint64_t)1 << lens[i]) - 1);
+		bits += lens[i];
+	}
+
+	for (mode = MODE_SERIAL; mode <= MODE_CURSOR; mode++) {
+		struct timeval start;
+		double enc_us, dec_us;
+		int mismatch;
+
+		memset(data, 0, sizeof(data));
+		gettimeofday(&start, NULL);
+		for (i = 0; i < ROUNDS; i++)
+			encode(mode, &bv);
+		enc_us = elapsed_us(&start);
+
+		sum = 0;
+		gettimeofday(&start, NULL);
+		for (i = 0; i < ROUNDS; i++)
+			sum += decode(mode, &bv);
+		dec_us = elapsed_us(&start);
+
+		if (mode == MODE_SERIAL) {
+			memcpy(ref, data, sizeof(ref));
+			ref_sum = sum;
+		}
+		mismatch = sum != ref_sum || memcmp(ref, data, sizeof(ref));
+
+		printf("%-16s: encode %7.1f ns/block, decode %7.1f ns/block, "
+			"%6.1f Mfields/s%s\n", mode_name[mode],
+			enc_us * 1000.0 / ROUNDS, dec_us * 1000.0 / ROUNDS,
+			2.0 * ROUNDS * ARRAY_SIZE(lens) / (enc_us + dec_us),
+			mismatch ? " MISMATCH" : "");
+	}
+	printf("(%zu fields, %u bits per block)\n", ARRAY_SIZE(lens), bits);
+
+	return 0;
+}
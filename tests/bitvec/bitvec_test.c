@@ -132,6 +132,104 @@ static void test_unhex(const char *hex)
 	printf("%s\n", hex);
 }
 
+/* the bit by bit implementations of bitvec_{read,write}_field() */
+static uint64_t ref_read_field(struct bitvec *bv, unsigned int *read_index,
+			       unsigned int len)
+{
+	unsigned int i;
+	uint64_t ui = 0;
+
+	bv->cur_bit = *read_index;
+	for (i = 0; i < len; i++) {
+		int bit = bitvec_get_bit_pos(bv, bv->cur_bit);
+		if (bit < 0)
+			return bit;
+		if (bit)
+			ui |= ((uint64_t)1 << (len - i - 1));
+		bv->cur_bit++;
+	}
+	*read_index += len;
+	return ui;
+}
+
+static int ref_write_field(struct bitvec *bv, unsigned int *write_index,
+			   uint64_t val, unsigned int len)
+{
+	unsigned int i;
+	int rc;
+
+	bv->cur_bit = *write_index;
+	for (i = 0; i < len; i++) {
+		rc = bitvec_set_bit(bv, (val >> (len - i - 1)) & 1);
+		if (rc)
+			return rc;
+	}
+	*write_index += len;
+	return 0;
+}
+
+static void test_fields(void)
+{
+	const unsigned int lens[] = { 0, 1, 7, 13, 32, 57, 64 };
+	uint8_t d1[32], d2[32];
+	struct bitvec bv1 = { 0, sizeof(d1), d1 }, bv2 = { 0, sizeof(d2), d2 };
+	struct bitvec_cursor c;
+	unsigned int i, errors = 0;
+	int rc;
+
+	printf("=== start %s ===\n", __func__);
+
+	srand(1);
+	for (i = 0; i < sizeof(d1); i++)
+		d1[i] = d2[i] = rand();
+
+	/* random fields, some of them running past the end */
+	for (i = 0; i < 100000; i++) {
+		unsigned int pos = rand() % (sizeof(d1) * 8 + 8);
+		unsigned int len = rand() % 65;
+		unsigned int idx1 = pos, idx2 = pos;
+		uint64_t val = (uint64_t)rand() << 40 ^ (uint64_t)rand() << 20 ^
+			       rand();
+
+		if (rand() & 1) {
+			if (bitvec_read_field(&bv1, &idx1, len) !=
+			    ref_read_field(&bv2, &idx2, len))
+				errors++;
+		} else {
+			if (bitvec_write_field(&bv1, &idx1, val, len) !=
+			    ref_write_field(&bv2, &idx2, val, len))
+				errors++;
+		}
+		if (idx1 != idx2 || bv1.cur_bit != bv2.cur_bit ||
+		    memcmp(d1, d2, sizeof(d1)))
+			errors++;
+	}
+	printf("fields: %s\n", errors ? "FAILED" : "ok");
+
+	/* sequential access: write with a cursor, read back per field */
+	bitvec_cursor_init(&c, &bv1, 3);
+	for (i = 0; i < ARRAY_SIZE(lens); i++)
+		bitvec_cursor_write(&c, 0x0123456789abcdefULL, lens[i]);
+	rc = bitvec_cursor_finish(&c);
+	printf("cursor write: rc=%d cur_bit=%u\n", rc, bv1.cur_bit);
+	printf("%s\n", osmo_hexdump_nospc(d1, sizeof(d1)));
+
+	bitvec_cursor_init(&c, &bv1, 3);
+	for (i = 0; i < ARRAY_SIZE(lens); i++)
+		printf("%" PRIx64 " ", bitvec_cursor_read(&c, lens[i]));
+	rc = bitvec_cursor_finish(&c);
+	printf("rc=%d cur_bit=%u\n", rc, bv1.cur_bit);
+
+	/* past the end: nothing read and the error is sticky */
+	printf("%" PRIx64 " ", bitvec_cursor_read(&c, 64));
+	printf("%" PRIx64 " ", bitvec_cursor_read(&c, 16));
+	printf("%" PRIx64 " ", bitvec_cursor_read(&c, 1));
+	rc = bitvec_cursor_finish(&c);
+	printf("rc=%d cur_bit=%u\n", rc, bv1.cur_bit);
+
+	printf("=== end %s ===\n", __func__);
+}
+
 int main(int argc, char **argv)
 {
 	struct bitvec bv;
@@ -204,5 +302,7 @@ int main(int argc, char **argv)
 	test_unhex("DEADFACE000000000000000000000000000000BEEFFEED");
 	test_unhex("FFFFFAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAABBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBB");
 
+	test_fields();
+
 	return 0;
 }
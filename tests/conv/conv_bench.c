@@ -0,0 +1,172 @@
+/* Benchmark of the Viterbi decoder backends
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/conv.h>
+#include <osmocom/core/utils.h>
+
+#define ROUNDS		2000
+
+/* non-recursive code built from generator polynomials (bit K-1: input) */
+struct bench_code {
+	const char *name;
+	int N, K, len;
+	unsigned int poly[4];
+	uint8_t next_output[64][2];
+	uint8_t next_state[64][2];
+	struct osmo_conv_code code;
+};
+
+static struct bench_code codes[] = {
+	{ "xCCH       K=5 N=2", 2, 5, 224, { 0x19, 0x1b } },
+	{ "CS-4 like  K=5 N=4", 4, 5, 224, { 0x19, 0x1b, 0x15, 0x1f } },
+	{ "TCH/HS     K=7 N=3", 3, 7, 101, { 0x5b, 0x79, 0x65 } },
+	{ "TCH/AFS    K=7 N=4", 4, 7, 250, { 0x5b, 0x79, 0x65, 0x6d } },
+};
+
+static void build_code(struct bench_code *bc)
+{
+	int n_states = 1 << (bc->K - 1);
+	int s, b, k;
+
+	for (s = 0; s < n_states; s++) {
+		for (b = 0; b < 2; b++) {
+			unsigned int reg = (b << (bc->K - 1)) | s;
+			uint8_t out = 0;
+
+			for (k = 0; k < bc->N; k++)
+				out = (out << 1) |
+				      (__builtin_popcount(reg & bc->poly[k]) & 1);
+			bc->next_output[s][b] = out;
+			bc->next_state[s][b] = ((s << 1) | b) & (n_states - 1);
+		}
+	}
+
+	bc->code.N = bc->N;
+	bc->code.K = bc->K;
+	bc->code.len = bc->len;
+	bc->code.term = CONV_TERM_FLUSH;
+	bc->code.next_output = (const uint8_t (*)[2]) bc->next_output;
+	bc->code.next_state = (const uint8_t (*)[2]) bc->next_state;
+}
+
+static const char *backend_name(enum osmo_conv_decode_backend be)
+{
+	switch (be) {
+	case OSMO_CONV_DECODE_GENERIC:
+		return "generic";
+	case OSMO_CONV_DECODE_SSE2:
+		return "sse2";
+	case OSMO_CONV_DECODE_SSE41:
+		return "sse4.1";
+	case OSMO_CONV_DECODE_AVX2:
+		return "avx2";
+	}
+	return "unknown";
+}
+
+static void bench_compiled(struct bench_code *bc, const sbit_t *soft,
+			   const ubit_t *ref, int ref_rc)
+{
+	struct osmo_conv_compiled *cc = osmo_conv_compile(&bc->code);
+	struct timeval start, stop, diff;
+	ubit_t out[512];
+	double usecs;
+	int i, rc = 0;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < ROUNDS; i++)
+		rc = osmo_conv_decode_compiled(cc, soft, out);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	usecs = diff.tv_sec * 1000000.0 + diff.tv_usec;
+
+	printf("%s %-8s: %8.2f us/block %8.2f Mbit/s%s\n",
+		bc->name, "compiled", usecs / ROUNDS,
+		bc->len * ROUNDS / usecs,
+		rc != ref_rc || memcmp(ref, out, bc->len) ? " MISMATCH" : "");
+
+	osmo_conv_compiled_free(cc);
+}
+
+int main(int argc, char **argv)
+{
+	enum osmo_conv_decode_backend be_best = osmo_conv_decode_get_backend();
+	ubit_t in[512], enc[2048], out[512], ref[512];
+	sbit_t soft[2048];
+	enum osmo_conv_decode_backend be;
+	unsigned int c;
+	int i, l, ref_rc = 0;
+
+	srandom(1);
+
+	for (c = 0; c < ARRAY_SIZE(codes); c++) {
+		struct bench_code *bc = &codes[c];
+
+		build_code(bc);
+
+		for (i = 0; i < bc->len; i++)
+			in[i] = random() & 1;
+		l = osmo_conv_encode(&bc->code, in, enc);
+		for (i = 0; i < l; i++) {
+			int v = (enc[i] ? -127 : 127) + (int)(random() % 201) - 100;
+			soft[i] = v > 127 ? 127 : (v < -127 ? -127 : v);
+		}
+
+		for (be = OSMO_CONV_DECODE_GENERIC; be <= OSMO_CONV_DECODE_AVX2; be++) {
+			struct timeval start, stop, diff;
+			double usecs;
+			int rc = 0;
+
+			if (osmo_conv_decode_set_backend(be) < 0) {
+				printf("%s %-8s: not available\n", bc->name,
+					backend_name(be));
+				continue;
+			}
+
+			gettimeofday(&start, NULL);
+			for (i = 0; i < ROUNDS; i++)
+				rc = osmo_conv_decode(&bc->code, soft, out);
+			gettimeofday(&stop, NULL);
+			timersub(&stop, &start, &diff);
+			usecs = diff.tv_sec * 1000000.0 + diff.tv_usec;
+
+			if (be == OSMO_CONV_DECODE_GENERIC) {
+				memcpy(ref, out, bc->len);
+				ref_rc = rc;
+			}
+
+			printf("%s %-8s: %8.2f us/block %8.2f Mbit/s%s\n",
+				bc->name, backend_name(be), usecs / ROUNDS,
+				bc->len * ROUNDS / usecs,
+				rc != ref_rc || memcmp(ref, out, bc->len) ?
+					" MISMATCH" : "");
+		}
+
+		/* compiled code, fastest backend */
+		osmo_conv_decode_set_backend(be_best);
+		bench_compiled(bc, soft, ref, ref_rc);
+	}
+
+	return 0;
+}
@@ -347,6 +347,87 @@ ubit_to_sbit(sbit_t *dst, ubit_t *src, int n)
 		dst[i] = src[i] ? -127 : 127;
 }
 
+/* all decoder backends must give the same result as the generic one,
+ * also on noisy and erased input */
+static int
+check_backends(const struct conv_test_vector *tst,
+               ubit_t *bu0, ubit_t *bu1, sbit_t *bs)
+{
+	enum osmo_conv_decode_backend dflt = osmo_conv_decode_get_backend();
+	enum osmo_conv_decode_backend be;
+	ubit_t *ref = malloc(sizeof(ubit_t) * MAX_LEN_BITS);
+	int i, l, ref_l, rc = 0;
+
+	fill_random(bu0, tst->in_len);
+	l = osmo_conv_encode(tst->code, bu0, bu1);
+
+	for (i=0; i<l; i++) {
+		int v = (bu1[i] ? -127 : 127) + (int)(random() % 241) - 120;
+		if (random() % 16 == 0)
+			v = 0;
+		bs[i] = v > 127 ? 127 : (v < -127 ? -127 : v);
+	}
+
+	osmo_conv_decode_set_backend(OSMO_CONV_DECODE_GENERIC);
+	ref_l = osmo_conv_decode(tst->code, bs, ref);
+
+	for (be = OSMO_CONV_DECODE_SSE2; be <= OSMO_CONV_DECODE_AVX2; be++) {
+		if (osmo_conv_decode_set_backend(be) < 0)
+			continue;
+		l = osmo_conv_decode(tst->code, bs, bu1);
+		if (l != ref_l || memcmp(ref, bu1, tst->in_len)) {
+			fprintf(stderr, "[!] Backend %d: metric %d, expected %d\n",
+				be, l, ref_l);
+			rc = -1;
+		}
+	}
+
+	osmo_conv_decode_set_backend(dflt);
+	free(ref);
+
+	return rc;
+}
+
+/* a compiled code must behave exactly like the original one */
+static int
+check_compiled(const struct conv_test_vector *tst,
+               ubit_t *bu0, ubit_t *bu1, sbit_t *bs)
+{
+	struct osmo_conv_compiled *cc;
+	ubit_t *ref = malloc(sizeof(ubit_t) * MAX_LEN_BITS);
+	int i, n, l, ref_l, rc = 0;
+
+	cc = osmo_conv_compile(tst->code);
+	if (!cc) {
+		free(ref);
+		return -1;
+	}
+
+	for (n=0; n<10 && !rc; n++) {
+		fill_random(bu0, tst->in_len);
+
+		ref_l = osmo_conv_encode(tst->code, bu0, ref);
+		l = osmo_conv_encode_compiled(cc, bu0, bu1);
+		if (l != ref_l || memcmp(ref, bu1, l))
+			rc = -1;
+
+		for (i=0; i<l; i++) {
+			int v = (bu1[i] ? -127 : 127) + (int)(random() % 201) - 100;
+			bs[i] = v > 127 ? 127 : (v < -127 ? -127 : v);
+		}
+
+		ref_l = osmo_conv_decode(tst->code, bs, ref);
+		l = osmo_conv_decode_compiled(cc, bs, bu1);
+		if (l != ref_l || memcmp(ref, bu1, tst->in_len))
+			rc = -1;
+	}
+
+	osmo_conv_compiled_free(cc);
+	free(ref);
+
+	return rc;
+}
+
 static void sbit_to_ubit(ubit_t *dst, sbit_t *src, int n) __attribute__((unused));
 
 static void
@@ -477,6 +558,26 @@ int main(int argc, char *argv[])
 			printf("OK\n");
 		}
 
+		/* Check decoder backends */
+		printf("[.] Decoder backends cross-check: ");
+		for (i=0; i<10; i++) {
+			if (check_backends(tst, bu0, bu1, bs)) {
+				printf("ERROR !\n");
+				fprintf(stderr, "[!] Failed decoder backend cross-check\n");
+				return -1;
+			}
+		}
+		printf("OK\n");
+
+		/* Check compiled code */
+		printf("[.] Compiled code check: ");
+		if (check_compiled(tst, bu0, bu1, bs)) {
+			printf("ERROR !\n");
+			fprintf(stderr, "[!] Failed compiled code check\n");
+			return -1;
+		}
+		printf("OK\n");
+
 		/* Spacing */
 		printf("\n");
 	}
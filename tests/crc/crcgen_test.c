@@ -0,0 +1,142 @@
+/* Cross-check of the table driven generic CRC routines
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/crcgen.h>
+#include <osmocom/core/utils.h>
+
+#define MAX_BITS	1400
+
+/* CRC codes of GSM 05.03 and a few wider ones */
+static const struct osmo_crc8gen_code crc3 = { 3, 0x3, 0, 0x7 };
+static const struct osmo_crc8gen_code crc6 = { 6, 0x27, 0, 0x3f };
+static const struct osmo_crc8gen_code crc8 = { 8, 0x49, 0, 0xff };
+static const struct osmo_crc16gen_code crc10 = { 10, 0x175, 0, 0x3ff };
+static const struct osmo_crc16gen_code crc12 = { 12, 0x80f, 0, 0xfff };
+static const struct osmo_crc16gen_code crc16 = { 16, 0x1021, 0, 0xffff };
+static const struct osmo_crc32gen_code crc32 =
+	{ 32, 0x04c11db7, 0xffffffff, 0xffffffff };
+static const struct osmo_crc64gen_code fire40 =
+	{ 40, 0x0004820009ULL, 0, 0xffffffffffULL };
+static const struct osmo_crc64gen_code crc64 =
+	{ 64, 0x42f0e1eba9ea3693ULL, 0, 0 };
+
+static unsigned int rnd_state;
+
+/* deterministic pseudo random numbers */
+static unsigned int rnd(void)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 16) & 0x7fff;
+}
+
+/* one bit at a time, as in GSM 05.03 */
+static uint64_t ref_crc(int bits, uint64_t poly, uint64_t init,
+			uint64_t remainder, const ubit_t *in, int len)
+{
+	const uint64_t top = (uint64_t)1 << (bits - 1);
+	const uint64_t mask = top | (top - 1);
+	uint64_t crc = init;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		crc ^= (uint64_t)(in[i] & 1) << (bits - 1);
+		crc = crc & top ? (crc << 1) ^ poly : crc << 1;
+		crc &= mask;
+	}
+
+	return crc ^ remainder;
+}
+
+static ubit_t ubits[MAX_BITS];
+static pbit_t pbits[MAX_BITS / 8];
+
+#define CHECK_CODE(XX, code) do {					\
+	uint64_t ref = ref_crc((code).bits, (code).poly, (code).init,	\
+			       (code).remainder, ubits, len);		\
+	if (osmo_crc##XX##gen_compute_bits(&(code), ubits, len) != ref)	\
+		errors++;						\
+	if (osmo_crc##XX##gen_compute_pbits(&(code), pbits, len) != ref) \
+		errors++;						\
+} while (0)
+
+static void test_crc(void)
+{
+	unsigned int errors = 0;
+	int i, len;
+
+	rnd_state = 1;
+
+	for (len = 0; len <= MAX_BITS; len += 1 + len / 16) {
+		for (i = 0; i < len; i++)
+			ubits[i] = rnd() & 1;
+		osmo_ubit2pbit(pbits, ubits, len);
+
+		CHECK_CODE(8, crc3);
+		CHECK_CODE(8, crc6);
+		CHECK_CODE(8, crc8);
+		CHECK_CODE(16, crc10);
+		CHECK_CODE(16, crc12);
+		CHECK_CODE(16, crc16);
+		CHECK_CODE(32, crc32);
+		CHECK_CODE(64, fire40);
+		CHECK_CODE(64, crc64);
+	}
+
+	printf("Checking table driven CRC against bitwise: %s\n",
+		errors ? "FAILED" : "ok");
+}
+
+static void test_set_check(void)
+{
+	ubit_t in[224], crc_bits[40];
+	unsigned int i;
+
+	for (i = 0; i < sizeof(in); i++)
+		in[i] = rnd() & 1;
+
+	osmo_crc64gen_set_bits(&fire40, in, 184, crc_bits);
+	printf("FIRE code of 184 bits: %s\n", osmo_ubit_dump(crc_bits, 40));
+	printf("check: %d\n", osmo_crc64gen_check_bits(&fire40, in, 184,
+							 crc_bits));
+	crc_bits[17] ^= 1;
+	printf("check with error: %d\n",
+		osmo_crc64gen_check_bits(&fire40, in, 184, crc_bits));
+
+	printf("CRC-16 of 224 bits: 0x%04x\n",
+		osmo_crc16gen_compute_bits(&crc16, in, 224));
+	printf("CRC-3 of 50 bits: 0x%x\n",
+		osmo_crc8gen_compute_bits(&crc3, in, 50));
+
+	/* CRC-32/BZIP2 check value */
+	printf("CRC-32 of \"123456789\": 0x%08x\n",
+		osmo_crc32gen_compute_pbits(&crc32,
+			(const pbit_t *) "123456789", 72));
+}
+
+int main(int argc, char **argv)
+{
+	test_crc();
+	test_set_check();
+
+	return 0;
+}
@@ -93,6 +93,88 @@ static void test_fc(uint32_t bucket_size_max, uint32_t bucket_leak_rate,
 	}
 }
 
+static uint64_t out_octets;
+static struct timeval tv_last_out;
+
+static int fc_count_cb(struct bssgp_flow_control *fc, struct msgb *msg,
+		       uint32_t llc_pdu_len, void *priv)
+{
+	out_octets += llc_pdu_len;
+	osmo_clock_now(&tv_last_out);
+	msgb_free(msg);
+	return 0;
+}
+
+/* queue all PDUs at once and let a fake clock jump from one timer
+ * expiration to the next, so the rate is measured without jitter */
+static void test_fc_rate(uint32_t bucket_size_max, uint32_t bucket_leak_rate,
+			 uint32_t pdu_len, uint32_t pdu_count)
+{
+	struct bssgp_flow_control *fc = talloc_zero(NULL, struct bssgp_flow_control);
+	struct timeval tv_zero = { 0, 0 };
+	struct timeval *tv;
+	uint64_t burst, usecs, rate;
+	void *msgb_ctx;
+	int i;
+
+	osmo_clock_override_set(&tv_zero);
+	osmo_clock_override_enable(1);
+
+	bssgp_fc_init(fc, bucket_size_max, bucket_leak_rate, pdu_count,
+		      fc_count_cb);
+
+	for (i = 0; i < pdu_count; i++)
+		bssgp_fc_in(fc, msgb_alloc(1, "fc test"), pdu_len, NULL);
+	burst = out_octets;
+
+	while (!llist_empty(&fc->queue)) {
+		osmo_timers_prepare();
+		tv = osmo_timers_nearest();
+		if (!tv)
+			break;
+		osmo_clock_override_add(tv->tv_sec, tv->tv_usec);
+		osmo_timers_update();
+	}
+
+	usecs = tv_last_out.tv_sec * 1000000ULL + tv_last_out.tv_usec;
+	rate = usecs ? (out_octets - burst) * 1000000 / usecs : 0;
+
+	printf("%llu oct at once, %llu oct in %llu us, queue %s\n",
+		(unsigned long long) burst,
+		(unsigned long long) (out_octets - burst),
+		(unsigned long long) usecs,
+		llist_empty(&fc->queue) ? "empty" : "NOT empty");
+	printf("achieved rate %s 1%% of leak-rate\n",
+		rate * 100 >= bucket_leak_rate * 99ULL &&
+		rate * 100 <= bucket_leak_rate * 101ULL ?
+		"within" : "NOT within");
+
+	/* PDUs still queued when the instance goes away are dropped */
+	for (i = 0; i < 3; i++)
+		bssgp_fc_in(fc, msgb_alloc(1, "fc test"), bucket_size_max,
+			    NULL);
+	bssgp_fc_flush_queue(fc);
+	printf("queue %s after flush, timer %s\n",
+		llist_empty(&fc->queue) ? "empty" : "NOT empty",
+		osmo_timer_pending(&fc->timer) ? "pending" : "stopped");
+
+	/* and so they are if the instance is just freed */
+	msgb_ctx = talloc_named_const(NULL, 0, "fc test msgb");
+	msgb_set_talloc_ctx(msgb_ctx);
+	for (i = 0; i < 3; i++)
+		bssgp_fc_in(fc, msgb_alloc(1, "fc test"), bucket_size_max,
+			    NULL);
+	talloc_free(fc);
+	osmo_timers_prepare();
+	printf("msgbs %s after free, timer %s\n",
+		talloc_total_blocks(msgb_ctx) == 1 ? "freed" : "NOT freed",
+		osmo_timers_nearest() ? "pending" : "stopped");
+	msgb_set_talloc_ctx(NULL);
+	talloc_free(msgb_ctx);
+
+	osmo_clock_override_enable(0);
+}
+
 static void help(void)
 {
 	printf(" -h --help                This help message\n");
@@ -100,6 +182,8 @@ static void help(void)
 	printf(" -r --bucket-leak-rate N  Bucket leak rate in octets/sec\n");
 	printf(" -d --max-queue-depth N   Maximum length of pending PDU queue (msgs)\n");
 	printf(" -l --pdu-length N        Length of each PDU in octets\n");
+	printf(" -c --pdu-count N         Number of PDUs\n");
+	printf(" -a --rate                Measure the achieved rate\n");
 }
 
 int bssgp_prim_cb(struct osmo_prim_hdr *oph, void *ctx)
@@ -116,6 +200,7 @@ int main(int argc, char **argv)
 	uint32_t max_queue_depth = 5; /* messages */
 	uint32_t pdu_length = 10; /* octets */
 	uint32_t pdu_count = 20; /* messages */
+	int rate_test = 0;
 	int c;
 
 	static const struct option long_options[] = {
@@ -124,6 +209,7 @@ int main(int argc, char **argv)
 		{ "max-queue-depth", 1, 0, 'd' },
 		{ "pdu-length", 1, 0, 'l' },
 		{ "pdu-count", 1, 0, 'c' },
+		{ "rate", 0, 0, 'a' },
 		{ "help", 0, 0, 'h' },
 		{ 0, 0, 0, 0 }
 	};
@@ -132,7 +218,7 @@ int main(int argc, char **argv)
 	log_set_use_color(osmo_stderr_target, 0);
 	log_set_print_filename(osmo_stderr_target, 0);
 
-	while ((c = getopt_long(argc, argv, "s:r:d:l:c:",
+	while ((c = getopt_long(argc, argv, "s:r:d:l:c:a",
 				long_options, NULL)) != -1) {
 		switch (c) {
 		case 's':
@@ -150,6 +236,9 @@ int main(int argc, char **argv)
 		case 'c':
 			pdu_count = atoi(optarg);
 			break;
+		case 'a':
+			rate_test = 1;
+			break;
 		case 'h':
 			help();
 			exit(EXIT_SUCCESS);
@@ -159,18 +248,20 @@ int main(int argc, char **argv)
 		}
 	}
 
-	/* bucket leak rate less than 100 not supported! */
-	if (bucket_leak_rate < 100) {
-		fprintf(stderr, "Bucket leak rate < 100 not supported!\n");
-		exit(EXIT_FAILURE);
-	}
+	/* the queue takes all PDUs when measuring the rate */
+	if (rate_test)
+		max_queue_depth = pdu_count;
 
 	printf("===== BSSGP flow-control test START\n");
 	printf("size-max=%u oct, leak-rate=%u oct/s, "
 		"queue-len=%u msgs, pdu_len=%u oct, pdu_cnt=%u\n\n", bucket_size_max,
 		bucket_leak_rate, max_queue_depth, pdu_length, pdu_count);
-	test_fc(bucket_size_max, bucket_leak_rate, max_queue_depth,
-		pdu_length, pdu_count);
+	if (rate_test)
+		test_fc_rate(bucket_size_max, bucket_leak_rate, pdu_length,
+			     pdu_count);
+	else
+		test_fc(bucket_size_max, bucket_leak_rate, max_queue_depth,
+			pdu_length, pdu_count);
 	printf("===== BSSGP flow-control test END\n\n");
 
 	exit(EXIT_SUCCESS);
@@ -13,3 +13,9 @@ $T -l 1000
 # test with 100 byte PDUs (10 second)
 $T -s 100
 
+
+# achieved rate with PDUs not dividing the rate (12 seconds fake time)
+$T -a -s 1000 -r 3000 -l 37 -c 1000
+
+# achieved rate below 100 octets/s (28 seconds fake time)
+$T -a -s 100 -r 50 -l 7 -c 214
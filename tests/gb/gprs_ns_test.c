@@ -33,6 +33,8 @@
 #define SGSN_NSEI 0x0100
 
 static int sent_pdu_type = 0;
+/* suppress the dumps of sent messages (bulk transmissions) */
+static int quiet = 0;
 
 static int gprs_process_message(struct gprs_ns_inst *nsi, const char *text,
 				struct sockaddr_in *peer, const unsigned char* data,
@@ -269,6 +271,10 @@ ssize_t sendto(int sockfd, const void *buf, size_t len, int flags,
 
 	sent_pdu_type = len > 0 ? ((uint8_t *)buf)[0] : -1;
 
+	if (quiet && (dest_host == REMOTE_BSS_ADDR ||
+		      dest_host == REMOTE_SGSN_ADDR))
+		return len;
+
 	if (dest_host == REMOTE_BSS_ADDR)
 		printf("MESSAGE to BSS, msg length %zu\n%s\n\n", len, osmo_hexdump(buf, len));
 	else if (dest_host == REMOTE_SGSN_ADDR)
@@ -293,7 +299,9 @@ int gprs_ns_sendmsg(struct gprs_ns_inst *nsi, struct msgb *msg)
 	if (!real_gprs_ns_sendmsg)
 		real_gprs_ns_sendmsg = dlsym(RTLD_NEXT, "gprs_ns_sendmsg");
 
-	if (nsei == SGSN_NSEI)
+	if (quiet)
+		;
+	else if (nsei == SGSN_NSEI)
 		printf("NS UNITDATA MESSAGE to SGSN, BVCI 0x%04x, msg length %zu\n%s\n\n",
 		       bvci, len, osmo_hexdump(buf, len));
 	else
@@ -937,6 +945,116 @@ static void test_sgsn_output()
 	nsi = NULL;
 }
 
+static void send_tlli_messages(struct gprs_ns_inst *nsi, uint16_t nsei,
+			       int rounds)
+{
+	struct msgb *msg;
+	int i, r;
+
+	quiet = 1;
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < 64; i++) {
+			msg = gprs_ns_msgb_alloc();
+			msg->l2h = msgb_put(msg, 1);
+			msg->l2h[0] = 0x00;
+			msgb_nsei(msg) = nsei;
+			msgb_bvci(msg) = 0x0102;
+			msgb_tlli(msg) = 0xc0000000 + i * 7;
+			OSMO_ASSERT(gprs_ns_sendmsg(nsi, msg) >= 0);
+		}
+	}
+	quiet = 0;
+}
+
+static void dump_nsvc_out(struct gprs_ns_inst *nsi, uint16_t nsei)
+{
+	struct gprs_nsvc *nsvc;
+
+	llist_for_each_entry_reverse(nsvc, &nsi->gprs_nsvcs, list) {
+		if (nsvc->nsei != nsei)
+			continue;
+		printf("    NSVCI 0x%04x%s: %llu packets out\n", nsvc->nsvci,
+		       nsvc->state & NSE_S_BLOCKED ? " (blocked)" : "",
+		       (long long)nsvc->ctrg->ctr[1].current);
+	}
+	printf("\n");
+}
+
+static void test_nse_load_sharing()
+{
+	struct gprs_ns_inst *nsi = gprs_ns_instantiate(gprs_ns_callback, NULL);
+	struct sockaddr_in peer[3] = {{0},};
+	struct gprs_nsvc *nsvc;
+	uint64_t before[3];
+	int i;
+
+	printf("--- Setup three NS-VCs of one NSE ---\n\n");
+
+	for (i = 0; i < 3; i++) {
+		peer[i].sin_family = AF_INET;
+		peer[i].sin_port = htons(2001 + i);
+		peer[i].sin_addr.s_addr = htonl(REMOTE_BSS_ADDR);
+		quiet = 1;
+		setup_ns(nsi, &peer[i], 0x3001 + i, 0x3000);
+		quiet = 0;
+	}
+	gprs_dump_nsi(nsi);
+
+	/* lookups by NSVCI must return the NS-VC of the right peer */
+	for (i = 0; i < 3; i++) {
+		nsvc = gprs_nsvc_by_nsvci(nsi, 0x3001 + i);
+		OSMO_ASSERT(nsvc);
+		OSMO_ASSERT(nsvc->ip.bts_addr.sin_port == peer[i].sin_port);
+		OSMO_ASSERT(nsvc->nsei == 0x3000);
+	}
+	OSMO_ASSERT(gprs_nsvc_by_nsei(nsi, 0x3000));
+	OSMO_ASSERT(!gprs_nsvc_by_nsei(nsi, 0x3001));
+
+	printf("--- Send 64 TLLIs twice ---\n\n");
+
+	i = 0;
+	llist_for_each_entry_reverse(nsvc, &nsi->gprs_nsvcs, list)
+		before[i++] = nsvc->ctrg->ctr[1].current;
+	send_tlli_messages(nsi, 0x3000, 1);
+	dump_nsvc_out(nsi, 0x3000);
+
+	/* the same TLLIs must be mapped to the same NS-VCs again */
+	i = 0;
+	llist_for_each_entry_reverse(nsvc, &nsi->gprs_nsvcs, list) {
+		before[i] = nsvc->ctrg->ctr[1].current - before[i];
+		OSMO_ASSERT(before[i] > 0);
+		before[i] += nsvc->ctrg->ctr[1].current;
+		i++;
+	}
+	send_tlli_messages(nsi, 0x3000, 1);
+	i = 0;
+	llist_for_each_entry_reverse(nsvc, &nsi->gprs_nsvcs, list) {
+		OSMO_ASSERT(nsvc->ctrg->ctr[1].current == before[i]);
+		i++;
+	}
+
+	printf("--- Block NSVCI 0x3002 and send 64 TLLIs ---\n\n");
+
+	nsvc = gprs_nsvc_by_nsvci(nsi, 0x3002);
+	quiet = 1;
+	gprs_ns_tx_block(nsvc, NS_CAUSE_OM_INTERVENTION);
+	quiet = 0;
+	send_tlli_messages(nsi, 0x3000, 1);
+	dump_nsvc_out(nsi, 0x3000);
+
+	printf("--- Move NSVCI 0x3003 to NSEI 0x3100 ---\n\n");
+
+	nsvc = gprs_nsvc_by_nsvci(nsi, 0x3003);
+	nsvc->nsei = 0x3100;
+	gprs_nsvc_rehash(nsvc);
+	OSMO_ASSERT(gprs_nsvc_by_nsei(nsi, 0x3100) == nsvc);
+	send_tlli_messages(nsi, 0x3000, 1);
+	dump_nsvc_out(nsi, 0x3000);
+
+	gprs_ns_destroy(nsi);
+	nsi = NULL;
+}
+
 
 int bssgp_prim_cb(struct osmo_prim_hdr *oph, void *ctx)
 {
@@ -965,6 +1083,7 @@ int main(int argc, char **argv)
 	test_sgsn_reset();
 	test_sgsn_reset_invalid_state();
 	test_sgsn_output();
+	test_nse_load_sharing();
 	printf("===== NS protocol test END\n\n");
 
 	exit(EXIT_SUCCESS);
@@ -0,0 +1,160 @@
+/* Loopback throughput benchmark of the NS-over-IP I/O
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/application.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gprs/gprs_ns.h>
+#include <osmocom/gprs/gprs_msgb.h>
+#include <osmocom/gprs/gprs_bssgp.h>
+
+/* The SGSN side NS instance echoes every NS-UNITDATA, which a plain
+ * UDP socket playing the BSS sends in bursts. */
+#define BURST		64
+#define ROUNDS		2000
+#define PAYLOAD_LEN	200
+
+static struct gprs_ns_inst *nsi;
+static unsigned int received;
+
+static int ns_cb(enum gprs_ns_evt event, struct gprs_nsvc *nsvc,
+		 struct msgb *msg, uint16_t bvci)
+{
+	struct msgb *echo;
+
+	if (event != GPRS_NS_EVT_UNIT_DATA)
+		return 0;
+
+	received++;
+
+	echo = gprs_ns_msgb_alloc();
+	memcpy(msgb_put(echo, msgb_bssgp_len(msg)), msgb_bssgph(msg),
+	       msgb_bssgp_len(msg));
+	msgb_nsei(echo) = nsvc->nsei;
+	msgb_bvci(echo) = bvci;
+
+	return gprs_ns_sendmsg(nsi, echo);
+}
+
+/* send a NS PDU from the BSS and wait for the response */
+static void bss_procedure(int fd, const uint8_t *pdu, size_t len)
+{
+	uint8_t buf[64];
+
+	OSMO_ASSERT(send(fd, pdu, len, 0) == len);
+	while (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) < 0)
+		osmo_select_main(0);
+}
+
+static void bench(int fd, unsigned int batch)
+{
+	uint8_t pdu[4 + PAYLOAD_LEN], buf[sizeof(pdu)];
+	struct timeval start, stop, diff;
+	unsigned int i, j, echoed = 0;
+	double usecs;
+
+	nsi->nsip.batch = batch;
+
+	memset(pdu, 0x2b, sizeof(pdu));
+	pdu[0] = NS_PDUT_UNITDATA;
+	pdu[1] = 0;
+	pdu[2] = 0;
+	pdu[3] = 2;	/* BVCI */
+
+	received = 0;
+	gettimeofday(&start, NULL);
+	for (i = 0; i < ROUNDS; i++) {
+		for (j = 0; j < BURST; j++)
+			OSMO_ASSERT(send(fd, pdu, sizeof(pdu), 0) == sizeof(pdu));
+
+		while (echoed < (i + 1) * BURST) {
+			osmo_select_main(0);
+			while (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+				echoed++;
+		}
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	usecs = diff.tv_sec * 1000000.0 + diff.tv_usec;
+	printf("batch %2u: %u PDUs echoed, %8.2f us/PDU, %9.0f PDUs/s\n",
+		batch, received, usecs / received, received * 1000000.0 / usecs);
+}
+
+static const uint8_t ns_reset[] = {
+	NS_PDUT_RESET, NS_IE_CAUSE, 0x81, NS_CAUSE_OM_INTERVENTION,
+	NS_IE_VCI, 0x82, 0x11, 0x22, NS_IE_NSEI, 0x82, 0x11, 0x22
+};
+
+static const uint8_t ns_unblock[] = { NS_PDUT_UNBLOCK };
+
+/* required by libosmogb */
+int bssgp_prim_cb(struct osmo_prim_hdr *oph, void *ctx)
+{
+	return -1;
+}
+
+static struct log_info info = {};
+
+int main(int argc, char **argv)
+{
+	const unsigned int batches[] = { 1, 8, 32, 64 };
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	int fd, bufsize = 1 << 20;
+	unsigned int i;
+
+	osmo_init_logging(&info);
+	log_set_log_level(osmo_stderr_target, LOGL_ERROR);
+
+	nsi = gprs_ns_instantiate(ns_cb, NULL);
+	nsi->nsip.local_ip = INADDR_LOOPBACK;
+	OSMO_ASSERT(gprs_ns_nsip_listen(nsi) >= 0);
+	OSMO_ASSERT(getsockname(nsi->nsip.fd.fd, (struct sockaddr *) &addr,
+				&addr_len) == 0);
+
+	fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	OSMO_ASSERT(fd >= 0);
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+	setsockopt(nsi->nsip.fd.fd, SOL_SOCKET, SO_RCVBUF, &bufsize,
+		   sizeof(bufsize));
+	OSMO_ASSERT(connect(fd, (struct sockaddr *) &addr, addr_len) == 0);
+
+	bss_procedure(fd, ns_reset, sizeof(ns_reset));
+	bss_procedure(fd, ns_unblock, sizeof(ns_unblock));
+
+	for (i = 0; i < ARRAY_SIZE(batches); i++)
+		bench(fd, batches[i]);
+
+	close(fd);
+	gprs_ns_destroy(nsi);
+
+	return 0;
+}
@@ -1,12 +1,15 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
 
 #include <osmocom/core/application.h>
+#include <osmocom/core/bits.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/logging.h>
 #include <osmocom/gsm/apn.h>
+#include <osmocom/crypt/gprs_cipher.h>
 
 static void apn_round_trip(const uint8_t *input, size_t len, const char *wanted_output)
 {
@@ -103,6 +106,44 @@ static void test_gsm_03_03_apn(void)
 	}
 }
 
+/* GEA3 test set 1 of 3GPP TS 55.217 */
+static void test_gea3(void)
+{
+	const uint8_t kc[] = { 0x2B, 0xD6, 0x45, 0x9F, 0x82, 0xC5, 0xBC, 0x00 };
+	const char *exp = "5f359709de950d0105b17b6c90194280f880b48dccdc2afe"
+			  "ed415dbef4354eebb21d073ccbbfb2d706bd7affd371fc96"
+			  "e3970d143dcb2624054826";
+	struct gprs_cipher_key key;
+	uint8_t out[59 + 8];
+	int i;
+
+	printf("Testing GEA3\n");
+
+	OSMO_ASSERT(gprs_cipher_supported(GPRS_ALGO_GEA3) == 1);
+
+	memset(out, 0xaa, sizeof(out));
+	OSMO_ASSERT(gprs_cipher_run(out, 59, GPRS_ALGO_GEA3,
+				    osmo_load64le(kc), 0x8E9421A3,
+				    GPRS_CIPH_MS2SGSN) == 0);
+	OSMO_ASSERT(!strcmp(osmo_hexdump_nospc(out, 59), exp));
+	/* nothing written beyond the requested length */
+	OSMO_ASSERT(out[59] == 0xaa);
+
+	/* a prepared key gives the same keystream, frame after frame */
+	OSMO_ASSERT(gprs_cipher_key_init(&key, GPRS_ALGO_GEA3,
+					 osmo_load64le(kc)) == 0);
+	for (i = 0; i < 2; i++) {
+		memset(out, 0xaa, sizeof(out));
+		OSMO_ASSERT(gprs_cipher_run_key(out, 59, &key, 0x8E9421A3,
+						GPRS_CIPH_MS2SGSN) == 0);
+		OSMO_ASSERT(!strcmp(osmo_hexdump_nospc(out, 59), exp));
+		OSMO_ASSERT(out[59] == 0xaa);
+	}
+	gprs_cipher_key_clear(&key);
+	OSMO_ASSERT(gprs_cipher_run_key(out, 59, &key, 0x8E9421A3,
+					GPRS_CIPH_MS2SGSN) == -EINVAL);
+}
+
 const struct log_info_cat default_categories[] = {
 };
 
@@ -116,6 +157,7 @@ int main(int argc, char **argv)
 	osmo_init_logging(&info);
 
 	test_gsm_03_03_apn();
+	test_gea3();
 
 	printf("Done.\n");
 	return EXIT_SUCCESS;
@@ -35,6 +35,52 @@ inline static void test_expansion(uint8_t * test_key, uint16_t * _KLi1, uint16_t
 	printf(passed ? " OK. " : "FAILED!");
 }
 
+/* prepared keys and interleaved streams against the plain KGCORE */
+static void test_prepared(void)
+{
+	const uint16_t lens[] = { 1, 63, 64, 114, 228, 1000 };
+	struct kasumi_kgcore_key kg[7];
+	const struct kasumi_kgcore_key *kp[7];
+	uint8_t ck[7][16], ref[136], out[7 * 136];
+	uint32_t cc[7];
+	unsigned int i, j, l, bad = 0;
+
+	for (i = 0; i < 7; i++) {
+		for (j = 0; j < 16; j++)
+			ck[i][j] = rand();
+		cc[i] = rand();
+		_kasumi_kgcore_key_init(&kg[i], ck[i]);
+		kp[i] = &kg[i];
+	}
+
+	for (l = 0; l < ARRAY_SIZE(lens); l++) {
+		const unsigned int len = (lens[l] + 7) / 8;
+
+		for (i = 0; i < 7; i++) {
+			_kasumi_kgcore(0xFF, 0, cc[i], i & 1, ck[i], ref, lens[l]);
+			memset(out, 0, sizeof(out));
+			_kasumi_kgcore_prepared(&kg[i], 0xFF, 0, cc[i], i & 1, out, lens[l]);
+			if (memcmp(ref, out, len) || out[len])
+				bad++;
+		}
+
+		/* 7 streams: one full set of KASUMI_LANES and a partial one */
+		for (i = 0; i < 2; i++) {
+			memset(out, 0, sizeof(out));
+			_kasumi_kgcore_multi(kp, cc, 7, 0xFF, 0, i, out, lens[l]);
+			for (j = 0; j < 7; j++) {
+				_kasumi_kgcore(0xFF, 0, cc[j], i, ck[j], ref, lens[l]);
+				if (memcmp(ref, out + len * j, len))
+					bad++;
+			}
+			if (out[7 * len])
+				bad++;
+		}
+	}
+
+	printf("KGCORE with prepared keys: %s\n", bad ? "FAILED!" : "OK.");
+}
+
 int main(int argc, char **argv)
 {
 	uint16_t _KLi1[8], _KLi2[8], _KOi1[8], _KOi2[8], _KOi3[8], _KIi1[8], _KIi2[8], _KIi3[8], _KLi1_r[8], _KLi2_r[8], _KOi1_r[8], _KOi2_r[8], _KOi3_r[8], _KIi1_r[8], _KIi2_r[8], _KIi3_r[8];
@@ -132,5 +178,7 @@ int main(int argc, char **argv)
 	_kasumi_kgcore(0xF, 0, 0x000A59B4, 0, _Key5, gamma, 228);
 	printf ("KGCORE Test Set 5: %d\n", _compare_mem(gamma, _gamma5, 32));
 
+	test_prepared();
+
 	return 0;
 }
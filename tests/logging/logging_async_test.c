@@ -0,0 +1,211 @@
+/* Test of the asynchronous logging writer thread
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/utils.h>
+
+#define RING_SIZE	8
+/* messages logged by another thread while the file is reopened */
+#define REOPEN_MSGS	10000
+
+enum {
+	DTEST,
+};
+
+static const struct log_info_cat default_categories[] = {
+	[DTEST] = {
+		.name = "DTEST",
+		.description = "Test",
+		.enabled = 1, .loglevel = LOGL_DEBUG,
+	},
+};
+
+static const struct log_info log_info = {
+	.cat = default_categories,
+	.num_cat = ARRAY_SIZE(default_categories),
+};
+
+static char fname[] = "/tmp/logging_async_test.XXXXXX";
+
+/* print what the writer thread wrote to the file so far */
+static void dump_file(void)
+{
+	char line[256];
+	FILE *f = fopen(fname, "r");
+
+	OSMO_ASSERT(f);
+	while (fgets(line, sizeof(line), f))
+		printf("  %s", line);
+	fclose(f);
+}
+
+static void print_stats(void)
+{
+	struct log_async_stats st;
+
+	log_async_get_stats(&st);
+	printf("enqueued %lu, dequeued %lu, dropped %lu\n",
+		st.enqueued, st.dequeued, st.dropped);
+}
+
+static void test_write(struct log_target *tgt)
+{
+	int i;
+
+	printf("Testing asynchronous writes\n");
+
+	for (i = 0; i < 5; i++)
+		LOGP(DTEST, LOGL_NOTICE, "message %d\n", i);
+	log_async_flush();
+	dump_file();
+	print_stats();
+}
+
+static void test_drop(struct log_target *tgt)
+{
+	struct log_async_stats st;
+	int i;
+
+	printf("Testing drops on a full ring\n");
+
+	/* block the writer on the FILE lock with one message taken from
+	 * the ring, its slot stays in use until it is written */
+	flockfile(tgt->tgt_file.out);
+	LOGP(DTEST, LOGL_NOTICE, "blocked\n");
+	do {
+		sched_yield();
+		log_async_get_stats(&st);
+	} while (st.dequeued != st.enqueued);
+
+	for (i = 0; i < RING_SIZE + 3; i++)
+		LOGP(DTEST, LOGL_NOTICE, "fill %d\n", i);
+	print_stats();
+	/* the drops are reported before the next message written */
+	funlockfile(tgt->tgt_file.out);
+	log_async_flush();
+
+	LOGP(DTEST, LOGL_NOTICE, "after\n");
+	log_async_flush();
+	dump_file();
+	print_stats();
+}
+
+static void test_sync(struct log_target *tgt)
+{
+	printf("Testing synchronous mode\n");
+
+	OSMO_ASSERT(log_target_set_async(tgt, 0) == 0);
+	LOGP(DTEST, LOGL_NOTICE, "synchronous\n");
+	log_async_stop();
+	dump_file();
+	print_stats();
+}
+
+static void *reopen_logger(void *arg)
+{
+	int i;
+
+	for (i = 0; i < REOPEN_MSGS; i++)
+		LOGP(DTEST, LOGL_NOTICE, "reopen %d\n", i);
+	return NULL;
+}
+
+static void test_reopen(struct log_target *tgt)
+{
+	unsigned long written = 0, dropped = 0, num;
+	pthread_t thread;
+	char line[256];
+	FILE *f;
+	int i;
+
+	printf("Testing reopen while logging\n");
+
+	OSMO_ASSERT(log_async_start(RING_SIZE) == 0);
+	OSMO_ASSERT(log_target_set_async(tgt, 1) == 0);
+
+	OSMO_ASSERT(pthread_create(&thread, NULL, reopen_logger, NULL) == 0);
+	for (i = 0; i < 100; i++) {
+		OSMO_ASSERT(log_target_file_reopen(tgt) == 0);
+		sched_yield();
+	}
+	pthread_join(thread, NULL);
+	/* reports the messages dropped at the end */
+	LOGP(DTEST, LOGL_NOTICE, "end\n");
+	log_async_stop();
+
+	f = fopen(fname, "r");
+	OSMO_ASSERT(f);
+	while (fgets(line, sizeof(line), f)) {
+		if (!strncmp(line, "reopen ", 7))
+			written++;
+		else if (sscanf(line, "%lu log messages dropped", &num) == 1)
+			dropped += num;
+	}
+	fclose(f);
+	printf("%s\n", written + dropped == REOPEN_MSGS ?
+		"all messages written or reported as dropped" :
+		"messages lost");
+}
+
+int main(int argc, char **argv)
+{
+	struct log_target *tgt;
+	int fd;
+
+	log_init(&log_info, NULL);
+
+	fd = mkstemp(fname);
+	OSMO_ASSERT(fd >= 0);
+	close(fd);
+	tgt = log_target_create_file(fname);
+	OSMO_ASSERT(tgt);
+	log_set_use_color(tgt, 0);
+	log_set_print_filename(tgt, 0);
+	log_set_flush_policy(tgt, LOG_FLUSH_IDLE, 0);
+	log_add_target(tgt);
+
+	OSMO_ASSERT(log_async_start(RING_SIZE - 1) == 0);
+	OSMO_ASSERT(log_async_start(RING_SIZE) == -EALREADY);
+	OSMO_ASSERT(log_target_set_async(tgt, 1) == 0);
+
+	test_write(tgt);
+	/* start over with an empty file */
+	OSMO_ASSERT(truncate(fname, 0) == 0);
+	OSMO_ASSERT(log_target_file_reopen(tgt) == 0);
+	test_drop(tgt);
+	OSMO_ASSERT(truncate(fname, 0) == 0);
+	OSMO_ASSERT(log_target_file_reopen(tgt) == 0);
+	test_sync(tgt);
+	OSMO_ASSERT(truncate(fname, 0) == 0);
+	OSMO_ASSERT(log_target_file_reopen(tgt) == 0);
+	test_reopen(tgt);
+
+	log_target_destroy(tgt);
+	unlink(fname);
+
+	printf("Done.\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/* Benchmark of the logging overhead on the calling thread
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/loggingrb.h>
+#include <osmocom/core/utils.h>
+
+#define MSGS		200000
+#define RING_SIZE	4096
+
+enum {
+	DBENCH,
+};
+
+static const struct log_info_cat default_categories[] = {
+	[DBENCH] = {
+		.name = "DBENCH",
+		.description = "Benchmark",
+		.enabled = 1, .loglevel = LOGL_DEBUG,
+	},
+};
+
+static const struct log_info log_info = {
+	.cat = default_categories,
+	.num_cat = ARRAY_SIZE(default_categories),
+};
+
+static double elapsed_usecs(const struct timeval *start)
+{
+	struct timeval stop, diff;
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, start, &diff);
+	return diff.tv_sec * 1000000.0 + diff.tv_usec;
+}
+
+static void bench(const char *name, struct log_target *tgt)
+{
+	struct log_async_stats st0, st1;
+	struct timeval start;
+	double usecs, usecs_total;
+	int i;
+
+	log_async_get_stats(&st0);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < MSGS; i++)
+		LOGP(DBENCH, LOGL_DEBUG, "message %d of the benchmark, tlli "
+		     "0x%08x, %s\n", i, 0xc0000000 + i, name);
+	usecs = elapsed_usecs(&start);
+	log_async_flush();
+	usecs_total = elapsed_usecs(&start);
+	log_async_get_stats(&st1);
+
+	printf("%-24s: %7.1f ns/msg caller, %7.1f ns/msg until written, "
+		"%lu dropped\n", name, usecs * 1000.0 / MSGS,
+		usecs_total * 1000.0 / MSGS, st1.dropped - st0.dropped);
+}
+
+/* messages below the level of the target */
+static void bench_disabled(void)
+{
+	struct timeval start;
+	double usecs;
+	int i;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < MSGS; i++)
+		LOGP(DBENCH, LOGL_DEBUG, "message %d\n", i);
+	usecs = elapsed_usecs(&start);
+
+	printf("%-24s: %7.1f ns/msg caller\n", "disabled",
+		usecs * 1000.0 / MSGS);
+}
+
+int main(int argc, char **argv)
+{
+	char fname[] = "/tmp/logging_bench.XXXXXX";
+	struct log_target *tgt;
+	int fd;
+
+	log_init(&log_info, NULL);
+
+	fd = mkstemp(fname);
+	if (fd < 0)
+		return EXIT_FAILURE;
+	close(fd);
+	tgt = log_target_create_file(fname);
+	if (!tgt)
+		return EXIT_FAILURE;
+	log_add_target(tgt);
+
+	log_set_log_level(tgt, LOGL_NOTICE);
+	bench_disabled();
+	log_set_log_level(tgt, 0);
+
+	bench("sync", tgt);
+	log_set_print_timestamp(tgt, 1);
+	bench("sync, timestamps", tgt);
+	log_set_print_timestamp(tgt, 0);
+
+	log_async_start(RING_SIZE);
+	log_target_set_async(tgt, 1);
+	log_set_flush_policy(tgt, LOG_FLUSH_ALWAYS, 0);
+	bench("async, flush always", tgt);
+	log_set_flush_policy(tgt, LOG_FLUSH_LEVEL, LOGL_ERROR);
+	bench("async, flush on ERROR", tgt);
+	log_set_flush_policy(tgt, LOG_FLUSH_IDLE, 0);
+	bench("async, flush when idle", tgt);
+	log_async_stop();
+
+	log_target_destroy(tgt);
+	unlink(fname);
+
+	/* formatted when read */
+	tgt = log_target_create_rb_bin(1024 * 1024);
+	if (!tgt)
+		return EXIT_FAILURE;
+	log_add_target(tgt);
+	bench("binary ring buffer", tgt);
+	log_target_destroy(tgt);
+
+	return 0;
+}
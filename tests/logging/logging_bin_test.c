@@ -0,0 +1,209 @@
+/* Test of the binary log records and the binary ring buffer target
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/logging_bin.h>
+#include <osmocom/core/loggingrb.h>
+#include <osmocom/core/utils.h>
+
+enum {
+	DTEST,
+};
+
+static const struct log_info_cat default_categories[] = {
+	[DTEST] = {
+		.name = "DTEST",
+		.description = "Test",
+		.enabled = 1, .loglevel = LOGL_DEBUG,
+	},
+};
+
+static const struct log_info log_info = {
+	.cat = default_categories,
+	.num_cat = ARRAY_SIZE(default_categories),
+};
+
+union bin_buf {
+	struct log_bin_rec rec;
+	uint8_t buf[LOG_BIN_MAX_LEN];
+};
+
+static int encode(union bin_buf *b, size_t size, const char *fmt, ...)
+{
+	va_list ap;
+	int rc;
+
+	va_start(ap, fmt);
+	rc = log_bin_encode(&b->rec, size, DTEST, LOGL_INFO, "file.c", 42, 0,
+			    fmt, ap);
+	va_end(ap);
+	return rc;
+}
+
+/* the rendered record must match what printf makes of it */
+#define CHECK(fmt, args...) \
+	do { \
+		union bin_buf b; \
+		char exp[256], out[256]; \
+		int rc; \
+		encode(&b, sizeof(b), fmt, ##args); \
+		snprintf(exp, sizeof(exp), fmt, ##args); \
+		rc = log_bin_render(out, sizeof(out), &b.rec); \
+		printf("%-24s %-4s %s\n", #fmt, \
+			b.rec.flags & LOG_BIN_F_TEXT ? "text" : "", \
+			rc == strlen(exp) && !strcmp(exp, out) ? \
+				out : "MISMATCH"); \
+	} while (0)
+
+static void test_render(void)
+{
+	/* keep the compiler from seeing the NULL */
+	const char *volatile null = NULL;
+
+	printf("Testing rendering of captured arguments\n");
+
+	CHECK("no arguments");
+	CHECK("%d %i %u", -1, 2, 3u);
+	CHECK("%hhx %hd %05x", 0x1ff, 0x12345, 0xab);
+	CHECK("%ld %lu %lld", -1L, 123456789UL, 1LL << 40);
+	CHECK("%zu %zd %td %jd", sizeof(int), (ssize_t) -2,
+	      (ptrdiff_t) 3, (intmax_t) -4);
+	CHECK("%.3f %e %g %Lf", 3.14159, 1e10, 0.5, 2.5L);
+	CHECK("%c%c%%%c", 'a', 'b', 'c');
+	CHECK("%s, %s!", "Hello", "World");
+	CHECK("[%-8s|%8s]", "left", "right");
+	CHECK("[%.3s] [%10.2s]", "abcdef", "xyz");
+	CHECK("[%*d] [%-*d]", 6, 42, 6, 42);
+	CHECK("[%.*s] [%.*s]", 2, "abc", -1, "abc");
+	CHECK("[%*.*f]", 10, 2, 3.14159);
+	CHECK("%s", null);
+	CHECK("%#x %#o %+d % d", 255, 8, 5, 5);
+	CHECK("%p", (void *) 0x1234);
+	CHECK("%s %d trailing text", "text", 1);
+	/* positional arguments can't be captured */
+	CHECK("%2$s %1$s", "world", "hello");
+	CHECK("%d%%", 100);
+}
+
+static void test_truncation(void)
+{
+	char str[LOG_BIN_MAX_LEN * 2], out[LOG_BIN_MAX_LEN * 2];
+	size_t size = LOG_BIN_HDR_LEN + 16;
+	union bin_buf b;
+
+	printf("Testing small records\n");
+
+	memset(str, 'x', sizeof(str) - 1);
+	str[sizeof(str) - 1] = '\0';
+
+	/* a long string is cut short */
+	encode(&b, size, "%s", "0123456789abcdefghij");
+	log_bin_render(out, sizeof(out), &b.rec);
+	printf("%zu bytes, flags 0x%02x: %s\n", b.rec.len - LOG_BIN_HDR_LEN,
+		b.rec.flags, out);
+
+	/* other arguments don't fit, the text is cut short */
+	encode(&b, size, "%d %d %d %d %d", 1, 2, 3, 4, 5);
+	log_bin_render(out, sizeof(out), &b.rec);
+	printf("%zu bytes, flags 0x%02x: %s\n", b.rec.len - LOG_BIN_HDR_LEN,
+		b.rec.flags, out);
+
+	/* the string fills the record */
+	encode(&b, sizeof(b), "%s", str);
+	printf("%s\n", log_bin_render(out, sizeof(out), &b.rec) ==
+		sizeof(b) - LOG_BIN_HDR_LEN - sizeof(uint16_t) ? "full" : "FAIL");
+
+	/* the output buffer is too small */
+	encode(&b, sizeof(b), "%s %d", "abcdefgh", 1234);
+	printf("%d: %s\n", log_bin_render(out, 8, &b.rec), out);
+}
+
+struct print_state {
+	struct log_target *tgt;
+	size_t skip;
+};
+
+static int print_rec(const struct log_bin_rec *rec, void *data)
+{
+	struct print_state *st = data;
+	char buf[256];
+
+	if (st->skip) {
+		st->skip--;
+		return 0;
+	}
+	log_bin_format(st->tgt, buf, sizeof(buf), rec);
+	printf("  %s", buf);
+	return 0;
+}
+
+static void test_rb(void)
+{
+	struct print_state st;
+	struct log_target *tgt;
+	size_t num;
+	int i;
+
+	printf("Testing the binary ring buffer target\n");
+
+	OSMO_ASSERT(!log_target_create_rb_bin(LOG_BIN_MAX_LEN - 1));
+
+	tgt = log_target_create_rb_bin(LOG_BIN_MAX_LEN);
+	OSMO_ASSERT(tgt);
+	log_set_use_color(tgt, 0);
+	log_set_print_filename(tgt, 0);
+	log_set_print_category(tgt, 1);
+	log_add_target(tgt);
+
+	LOGP(DTEST, LOGL_NOTICE, "first %s\n", "message");
+	LOGPC(DTEST, LOGL_NOTICE, "continued %d\n", 1);
+	printf("%zu records:\n", log_target_rb_bin_used_size(tgt));
+	st.tgt = tgt;
+	st.skip = 0;
+	log_target_rb_bin_foreach(tgt, print_rec, &st);
+
+	/* wrap around a few times, the oldest records are dropped */
+	for (i = 0; i < 100; i++)
+		LOGP(DTEST, LOGL_DEBUG, "message %d of %s\n", i, "many");
+	num = log_target_rb_bin_used_size(tgt);
+	OSMO_ASSERT(num > 3 && num < 100);
+	printf("last records:\n");
+	log_set_print_category(tgt, 0);
+	st.skip = num - 3;
+	log_target_rb_bin_foreach(tgt, print_rec, &st);
+
+	log_target_destroy(tgt);
+}
+
+int main(int argc, char **argv)
+{
+	log_init(&log_info, NULL);
+
+	test_render();
+	test_truncation();
+	test_rb();
+
+	printf("Done.\n");
+	return EXIT_SUCCESS;
+}
@@ -30,6 +30,7 @@ enum {
 };
 
 static int filter_called = 0;
+static int args_evaluated = 0;
 static int select_output = 0;
 
 static const struct log_info_cat default_categories[] = {
@@ -106,5 +107,33 @@ int main(int argc, char **argv)
 	select_output = 1;
 	DEBUGP(DRLL, "You should see this\n");
 	OSMO_ASSERT(filter_called == 5); /* called twice on output */
+
+	/* a message rejected by the filter doesn't evaluate its arguments */
+	select_output = 0;
+	DEBUGP(DRLL, "You should not see this %d\n", ++args_evaluated);
+	OSMO_ASSERT(args_evaluated == 0);
+	select_output = 1;
+
+	/* the cached levels follow the configuration of the targets */
+	OSMO_ASSERT(log_check_level_cached(DRLL, LOGL_DEBUG));
+	OSMO_ASSERT(!log_check_level_cached(DMM, LOGL_FATAL));
+	log_set_category_filter(stderr_target, DRLL, 1, LOGL_NOTICE);
+	OSMO_ASSERT(!log_check_level_cached(DRLL, LOGL_INFO));
+	OSMO_ASSERT(log_check_level_cached(DRLL, LOGL_NOTICE));
+	log_set_log_level(stderr_target, LOGL_ERROR);
+	OSMO_ASSERT(!log_check_level_cached(DRLL, LOGL_NOTICE));
+	OSMO_ASSERT(!log_check_level_cached(DCC, LOGL_NOTICE));
+	OSMO_ASSERT(log_check_level_cached(DCC, LOGL_ERROR));
+	log_set_log_level(stderr_target, 0);
+
+	OSMO_ASSERT(!log_check_level_cached(DLGLOBAL, LOGL_FATAL));
+	log_set_category_filter(stderr_target, log_parse_category("LGLOBAL"),
+				1, LOGL_NOTICE);
+	OSMO_ASSERT(!log_check_level_cached(DLGLOBAL, LOGL_INFO));
+	OSMO_ASSERT(log_check_level_cached(DLGLOBAL, LOGL_NOTICE));
+
+	log_del_target(stderr_target);
+	OSMO_ASSERT(!log_check_level_cached(DCC, LOGL_FATAL));
+	OSMO_ASSERT(!log_check_level_cached(DLGLOBAL, LOGL_FATAL));
 	return 0;
 }
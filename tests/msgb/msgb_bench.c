@@ -0,0 +1,79 @@
+/* Benchmark of msgb allocation with and without the msgb pool
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#define ROUNDS		200000
+/* number of msgbs in flight, e.g. queued for transmission */
+#define BURST		64
+
+static void bench(const char *name, uint16_t size)
+{
+	struct msgb *msgs[BURST];
+	struct timeval start, stop, diff;
+	double usecs;
+	int i, j;
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < ROUNDS / BURST; i++) {
+		for (j = 0; j < BURST; j++)
+			msgs[j] = msgb_alloc_headroom(size, 128, "bench");
+		for (j = 0; j < BURST; j++)
+			msgb_free(msgs[j]);
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	usecs = diff.tv_sec * 1000000.0 + diff.tv_usec;
+	printf("%-7s %5u bytes: %8.1f ns/alloc+free %10.0f ops/s\n",
+		name, size, usecs * 1000.0 / ROUNDS,
+		ROUNDS * 1000000.0 / usecs);
+}
+
+int main(int argc, char **argv)
+{
+	/* LAPD/RSL, IPA and NS_ALLOC_SIZE like sizes */
+	const uint16_t sizes[] = { 512, 1500, 2048 };
+	struct rate_ctr_group *ctrg;
+	unsigned int i;
+
+	msgb_set_talloc_ctx(talloc_named_const(NULL, 0, "msgb_bench"));
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		bench("talloc", sizes[i]);
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		msgb_pool_add_class(sizes[i], BURST);
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		bench("pool", sizes[i]);
+
+	ctrg = msgb_pool_get_ctrg();
+	printf("pool hit=%"PRIu64" miss=%"PRIu64"\n",
+		ctrg->ctr[MSGB_POOL_CTR_HIT].current,
+		ctrg->ctr[MSGB_POOL_CTR_MISS].current);
+
+	return 0;
+}
@@ -19,15 +19,20 @@
  */
 
 #include <stdlib.h>
+#include <inttypes.h>
 #include <osmocom/core/application.h>
 #include <osmocom/core/logging.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/msgb.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/write_queue.h>
 #include <setjmp.h>
 
 #include <errno.h>
 
 #include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
 
 #define CHECK_RC(rc)	\
 	if (rc != 0) {	\
@@ -279,6 +284,182 @@ static void test_msgb_resize_area()
 
 static struct log_info info = {};
 
+static void test_msgb_pool()
+{
+	struct rate_ctr_group *ctrg;
+	struct msgb *msg1, *msg2, *msg3;
+
+	printf("Testing msgb pool\n");
+
+	OSMO_ASSERT(msgb_pool_add_class(1024, 1) == 0);
+	OSMO_ASSERT(msgb_pool_add_class(256, 2) == 0);
+	ctrg = msgb_pool_get_ctrg();
+	OSMO_ASSERT(ctrg);
+
+	/* the smallest fitting class is used, buffers are recycled */
+	msg1 = msgb_alloc(200, "pool1");
+	msgb_put(msg1, 10);
+	msg1->l2h = msg1->data;
+	msg1->cb[0] = 42;
+	msgb_free(msg1);
+	msg2 = msgb_alloc(256, "pool2");
+	OSMO_ASSERT(msg2 == msg1);
+
+	/* the header is reset */
+	OSMO_ASSERT(msg2->data_len == 256);
+	OSMO_ASSERT(msgb_length(msg2) == 0);
+	OSMO_ASSERT(msgb_tailroom(msg2) == 256);
+	OSMO_ASSERT(msg2->l2h == NULL);
+	OSMO_ASSERT(msg2->cb[0] == 0);
+
+	msg3 = msgb_alloc(300, "pool3");
+	OSMO_ASSERT(msgb_tailroom(msg3) == 300);
+	/* larger than any class */
+	msg1 = msgb_alloc(2000, "nopool");
+	msgb_free(msg1);
+	msgb_free(msg2);
+	msgb_free(msg3);
+
+	/* only one buffer of the 1024 class is kept */
+	msg1 = msgb_alloc(1024, "pool4");
+	msg2 = msgb_alloc(1000, "pool5");
+	OSMO_ASSERT(msg1 == msg3);
+	msgb_free(msg1);
+	msgb_free(msg2);
+
+	printf("hit=%"PRIu64" miss=%"PRIu64" recycle=%"PRIu64" release=%"PRIu64"\n",
+		ctrg->ctr[MSGB_POOL_CTR_HIT].current,
+		ctrg->ctr[MSGB_POOL_CTR_MISS].current,
+		ctrg->ctr[MSGB_POOL_CTR_RECYCLE].current,
+		ctrg->ctr[MSGB_POOL_CTR_RELEASE].current);
+
+	msgb_pool_flush();
+}
+
+static void test_msgb_clone()
+{
+	struct msgb *msg, *clone1, *clone2;
+	uint8_t *head;
+
+	printf("Testing msgb clone\n");
+
+	msg = msgb_alloc_headroom(256, 32, "orig");
+	memcpy(msgb_put(msg, 4), "\x01\x02\x03\x04", 4);
+	msg->l3h = msg->data;
+	head = msg->head;
+
+	clone1 = msgb_clone(msg, "clone1");
+	clone2 = msgb_clone(clone1, "clone2");
+	OSMO_ASSERT(msgb_shared(msg) && msgb_shared(clone1) && msgb_shared(clone2));
+	OSMO_ASSERT(clone1->data == msg->data && clone2->l3h == msg->l3h);
+	OSMO_ASSERT(msgb_test_invariant(clone1) && msgb_test_invariant(clone2));
+
+	/* the first push/put into the head-/tailroom is done in place */
+	memcpy(msgb_push(clone1, 2), "\xaa\xab", 2);
+	msgb_put_u8(clone2, 0xbb);
+	OSMO_ASSERT(clone1->head == head && clone2->head == head);
+
+	/* pulling doesn't modify the buffer */
+	msgb_pull(clone2, 1);
+	OSMO_ASSERT(clone2->head == head);
+
+	/* conflicting pushes/puts result in a private copy */
+	msgb_push(msg, 1)[0] = 0xcc;
+	OSMO_ASSERT(msg->head != head && !msgb_shared(msg));
+	msgb_put_u8(clone1, 0xdd);
+	OSMO_ASSERT(clone1->head != head && !msgb_shared(clone1));
+	printf("orig:   %s\n", msgb_hexdump(msg));
+	printf("clone1: %s\n", msgb_hexdump(clone1));
+	printf("clone2: %s\n", msgb_hexdump(clone2));
+
+	/* the buffer outlives the msgb it was allocated with */
+	msgb_free(msg);
+	OSMO_ASSERT(clone2->head == head);
+	OSMO_ASSERT(msgb_unshare(clone2) == 0 && clone2->head == head);
+	msgb_put_u8(clone2, 0xee);
+	printf("clone2: %s\n", msgb_hexdump(clone2));
+	msgb_free(clone2);
+	msgb_free(clone1);
+
+	/* writes after msgb_unshare() don't affect the clone */
+	msg = msgb_alloc(64, "orig");
+	msgb_put_u8(msg, 0x11);
+	clone1 = msgb_clone(msg, "clone1");
+	OSMO_ASSERT(msgb_unshare(msg) == 0 && !msgb_shared(clone1));
+	msg->data[0] = 0x22;
+	msgb_reset(clone1);
+	msgb_put_u8(clone1, 0x33);
+	printf("orig:   %s\n", msgb_hexdump(msg));
+	printf("clone1: %s\n", msgb_hexdump(clone1));
+	msgb_free(clone1);
+	msgb_free(msg);
+}
+
+static struct msgb *chain_frag(const char *name, const uint8_t *data,
+			       unsigned int len)
+{
+	struct msgb *msg = msgb_alloc_headroom(64, 16, name);
+
+	memcpy(msgb_put(msg, len), data, len);
+	return msg;
+}
+
+static void test_msgb_chain()
+{
+	static const uint8_t payload[] = {
+		0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19
+	};
+	struct msgb *msg, *copy, *clone;
+	struct osmo_wqueue wq;
+	struct iovec iov[4];
+	uint8_t buf[64];
+	int fds[2], rc;
+
+	printf("Testing msgb chain\n");
+
+	msg = msgb_alloc_headroom(64, 16, "head");
+	msgb_frag_append(msg, chain_frag("frag1", payload, 4));
+	msgb_frag_append(msg, msgb_alloc(64, "empty"));
+	msgb_frag_append(msg, chain_frag("frag2", payload + 4, 6));
+	memcpy(msgb_push(msg, 2), "\xaa\xbb", 2);
+
+	printf("len=%u chain_len=%u iovcnt=%d\n", msgb_length(msg),
+		msgb_chain_len(msg), msgb_iovec(msg, iov, ARRAY_SIZE(iov)));
+	OSMO_ASSERT(msgb_iovec(msg, iov, 2) == -EMSGSIZE);
+
+	/* clones and copies contain all fragments */
+	copy = msgb_copy(msg, "copy");
+	clone = msgb_clone(msg, "clone");
+	OSMO_ASSERT(msgb_chain_len(copy) == 12 && msgb_chain_len(clone) == 12);
+	OSMO_ASSERT(clone->frag->data == msg->frag->data);
+	OSMO_ASSERT(copy->frag->data != msg->frag->data);
+
+	/* skip a partially transmitted part */
+	msgb_chain_pull(copy, 5);
+	OSMO_ASSERT(msgb_length(copy) == 0 && msgb_chain_len(copy) == 7);
+	OSMO_ASSERT(msgb_linearize(copy) == 0 && !copy->frag);
+	printf("pulled: %s\n", msgb_hexdump(copy));
+	msgb_free(copy);
+
+	OSMO_ASSERT(msgb_linearize(clone) == 0);
+	printf("linear: %s\n", msgb_hexdump(clone));
+	msgb_free(clone);
+
+	/* the default writer of a write queue sends chains via writev() */
+	OSMO_ASSERT(pipe(fds) == 0);
+	osmo_wqueue_init(&wq, 10);
+	wq.bfd.fd = fds[1];
+	osmo_wqueue_enqueue(&wq, msg);
+	osmo_wqueue_enqueue(&wq, chain_frag("single", payload, 1));
+	osmo_wqueue_bfd_cb(&wq.bfd, BSC_FD_WRITE);
+	osmo_wqueue_bfd_cb(&wq.bfd, BSC_FD_WRITE);
+	OSMO_ASSERT(wq.current_length == 0 && !(wq.bfd.when & BSC_FD_WRITE));
+	rc = read(fds[0], buf, sizeof(buf));
+	printf("written: %s\n", osmo_hexdump(buf, rc));
+	close(fds[0]);
+	close(fds[1]);
+}
+
 int main(int argc, char **argv)
 {
 	osmo_init_logging(&info);
@@ -287,6 +468,9 @@ int main(int argc, char **argv)
 	test_msgb_api_errors();
 	test_msgb_copy();
 	test_msgb_resize_area();
+	test_msgb_pool();
+	test_msgb_clone();
+	test_msgb_chain();
 
 	printf("Success.\n");
 
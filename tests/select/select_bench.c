@@ -0,0 +1,139 @@
+/* Benchmark of the select loop backends
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
+#include <sys/select.h>
+
+#include <osmocom/core/select.h>
+#include <osmocom/core/utils.h>
+
+/* Every round signals a single one of the registered fds, which is the
+ * common case of a few busy sockets among many idle ones. */
+#define ROUNDS		20000
+
+static unsigned int callbacks;
+
+static int efd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	uint64_t val;
+
+	if (read(ofd->fd, &val, sizeof(val)) == sizeof(val))
+		callbacks++;
+	return 0;
+}
+
+static const char *backend_name(enum osmo_select_backend be)
+{
+	switch (be) {
+	case OSMO_SELECT_BACKEND_SELECT:
+		return "select";
+	case OSMO_SELECT_BACKEND_EPOLL:
+		return "epoll";
+	}
+	return "unknown";
+}
+
+static void bench(enum osmo_select_backend be, unsigned int num_fds)
+{
+	struct osmo_fd *ofds;
+	struct timeval start, stop, diff;
+	uint64_t one = 1;
+	double usecs;
+	unsigned int i;
+	int rc;
+
+	if (osmo_select_set_backend(be) < 0) {
+		printf("%-6s %5u fds: backend not available\n",
+			backend_name(be), num_fds);
+		return;
+	}
+
+	ofds = calloc(num_fds, sizeof(*ofds));
+	for (i = 0; i < num_fds; i++) {
+		ofds[i].fd = eventfd(0, 0);
+		if (ofds[i].fd < 0)
+			break;
+		if (be == OSMO_SELECT_BACKEND_SELECT &&
+		    ofds[i].fd >= FD_SETSIZE) {
+			close(ofds[i].fd);
+			break;
+		}
+		ofds[i].when = BSC_FD_READ;
+		ofds[i].cb = efd_cb;
+		rc = osmo_fd_register(&ofds[i]);
+		if (rc < 0) {
+			close(ofds[i].fd);
+			break;
+		}
+	}
+
+	if (i < num_fds) {
+		printf("%-6s %5u fds: only %u fds usable, skipped\n",
+			backend_name(be), num_fds, i);
+		num_fds = i;
+		goto out;
+	}
+
+	callbacks = 0;
+	gettimeofday(&start, NULL);
+	for (i = 0; i < ROUNDS; i++) {
+		if (write(ofds[(i * 7919) % num_fds].fd, &one, sizeof(one)) < 0)
+			break;
+		osmo_select_main(1);
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	usecs = diff.tv_sec * 1000000.0 + diff.tv_usec;
+	printf("%-6s %5u fds: %u callbacks, %8.2f us/iteration, "
+		"%10.0f iterations/s\n", backend_name(be), num_fds,
+		callbacks, usecs / ROUNDS, ROUNDS * 1000000.0 / usecs);
+
+out:
+	for (i = 0; i < num_fds; i++) {
+		osmo_fd_unregister(&ofds[i]);
+		close(ofds[i].fd);
+	}
+	free(ofds);
+}
+
+int main(int argc, char **argv)
+{
+	const unsigned int sizes[] = { 10, 1000, 10000 };
+	struct rlimit rl;
+	unsigned int i;
+
+	/* make room for the largest test */
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < 10100) {
+		rl.rlim_cur = rl.rlim_max < 10100 ? rl.rlim_max : 10100;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		bench(OSMO_SELECT_BACKEND_SELECT, sizes[i]);
+		bench(OSMO_SELECT_BACKEND_EPOLL, sizes[i]);
+	}
+
+	return 0;
+}
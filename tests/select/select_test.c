@@ -0,0 +1,275 @@
+/* Test fd (un)registration from within select loop call-backs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+
+#include <osmocom/core/select.h>
+#include <osmocom/core/utils.h>
+
+/* stay well below FD_SETSIZE for the select(2) backend */
+#define NUM_FDS		500
+/* number of unregistrations performed from within call-backs */
+#define NUM_CHURN	5000
+
+struct test_fd {
+	struct osmo_fd ofd;
+	int registered;
+	int pending;
+};
+
+/* only half of the slots are in use at any time */
+static struct test_fd fds[2 * NUM_FDS];
+static unsigned int free_slot;
+static unsigned int churn_budget;
+static unsigned int stale_dispatches;
+static unsigned int rnd_state;
+
+/* deterministic pseudo random numbers */
+static unsigned int rnd(void)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 16) & 0x7fff;
+}
+
+static int test_fd_cb(struct osmo_fd *ofd, unsigned int what);
+
+static void test_fd_signal(struct test_fd *tfd)
+{
+	uint64_t one = 1;
+
+	OSMO_ASSERT(write(tfd->ofd.fd, &one, sizeof(one)) == sizeof(one));
+	tfd->pending = 1;
+}
+
+static void test_fd_open(struct test_fd *tfd)
+{
+	memset(tfd, 0, sizeof(*tfd));
+	tfd->ofd.fd = eventfd(0, 0);
+	OSMO_ASSERT(tfd->ofd.fd >= 0);
+	tfd->ofd.when = BSC_FD_READ;
+	tfd->ofd.cb = test_fd_cb;
+	tfd->ofd.data = tfd;
+	OSMO_ASSERT(osmo_fd_register(&tfd->ofd) == 0);
+	tfd->registered = 1;
+}
+
+static void test_fd_close(struct test_fd *tfd)
+{
+	osmo_fd_unregister(&tfd->ofd);
+	close(tfd->ofd.fd);
+	tfd->registered = 0;
+	/* scribble over it like a free() + re-use would do */
+	memset(&tfd->ofd, 0xff, sizeof(tfd->ofd));
+}
+
+/* replace a random (possibly still pending) fd by a fresh, signalled
+ * one in another slot, so the old osmo_fd stays scribbled over */
+static void churn(void)
+{
+	unsigned int i = rnd() % ARRAY_SIZE(fds);
+
+	while (!fds[i].registered)
+		i = (i + 1) % ARRAY_SIZE(fds);
+	test_fd_close(&fds[i]);
+
+	while (fds[free_slot].registered)
+		free_slot = (free_slot + 1) % ARRAY_SIZE(fds);
+	test_fd_open(&fds[free_slot]);
+	test_fd_signal(&fds[free_slot]);
+
+	churn_budget--;
+}
+
+static int test_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct test_fd *tfd = ofd->data;
+	uint64_t val;
+	int i;
+
+	if (tfd < fds || tfd >= fds + ARRAY_SIZE(fds) || !tfd->registered) {
+		stale_dispatches++;
+		return 0;
+	}
+
+	if (read(ofd->fd, &val, sizeof(val)) == sizeof(val))
+		tfd->pending = 0;
+
+	/* unregister ourselves and/or some other fds */
+	for (i = rnd() % 4; i > 0 && churn_budget; i--)
+		churn();
+
+	return 0;
+}
+
+static void test_churn(enum osmo_select_backend backend, const char *name)
+{
+	unsigned int i, lost = 0;
+	int rc;
+
+	rc = osmo_select_set_backend(backend);
+	if (rc < 0) {
+		printf("%s: backend not available\n", name);
+		return;
+	}
+
+	rnd_state = 0;
+	free_slot = 0;
+	stale_dispatches = 0;
+	churn_budget = NUM_CHURN;
+
+	for (i = 0; i < NUM_FDS; i++)
+		test_fd_open(&fds[i]);
+
+	/* kick it off by signalling every 10th fd */
+	for (i = 0; i < NUM_FDS; i += 10)
+		test_fd_signal(&fds[i]);
+
+	while (osmo_select_main(1) > 0)
+		;
+
+	for (i = 0; i < ARRAY_SIZE(fds); i++) {
+		uint64_t val;
+
+		if (!fds[i].registered)
+			continue;
+
+		/* all signalled fds must have been dispatched */
+		if (fds[i].pending ||
+		    read(fds[i].ofd.fd, &val, sizeof(val)) >= 0 ||
+		    errno != EAGAIN)
+			lost++;
+		test_fd_close(&fds[i]);
+	}
+
+	printf("%s: %u unregistrations from call-backs, stale=%u, lost=%u\n",
+		name, NUM_CHURN - churn_budget, stale_dispatches, lost);
+}
+
+/* the first fd runs a nested select loop, which dispatches the second
+ * fd.  That one unregisters itself, and the outer loop must not
+ * dispatch it afterwards */
+static int nested_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct test_fd *tfd = ofd->data;
+	uint64_t val;
+
+	if (tfd < fds || tfd >= fds + 2 || !tfd->registered) {
+		stale_dispatches++;
+		return 0;
+	}
+
+	if (read(ofd->fd, &val, sizeof(val)) == sizeof(val))
+		tfd->pending = 0;
+
+	if (tfd == &fds[0])
+		osmo_select_main(1);
+	else
+		test_fd_close(tfd);
+
+	return 0;
+}
+
+static void test_nested(enum osmo_select_backend backend, const char *name)
+{
+	int i;
+
+	if (osmo_select_set_backend(backend) < 0)
+		return;
+
+	stale_dispatches = 0;
+	for (i = 0; i < 2; i++) {
+		test_fd_open(&fds[i]);
+		fds[i].ofd.cb = nested_cb;
+		test_fd_signal(&fds[i]);
+	}
+
+	osmo_select_main(1);
+
+	printf("%s: nested, stale=%u, pending=%d\n", name, stale_dispatches,
+		fds[0].pending + fds[1].pending);
+	if (fds[0].registered)
+		test_fd_close(&fds[0]);
+	OSMO_ASSERT(!fds[1].registered);
+}
+
+static unsigned int except_dispatches;
+
+static int except_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	if (what & BSC_FD_EXCEPT)
+		except_dispatches++;
+	osmo_fd_unregister(ofd);
+	close(ofd->fd);
+	return 0;
+}
+
+/* epoll always reports EPOLLERR/EPOLLHUP, also to fds that only wait
+ * for exceptions.  They must see it, or the loop keeps waking up */
+static void test_epoll_except(void)
+{
+	struct osmo_fd ofd;
+	int pfd[2], i, work = 0;
+
+	if (osmo_select_set_backend(OSMO_SELECT_BACKEND_EPOLL) < 0)
+		return;
+
+	OSMO_ASSERT(pipe(pfd) == 0);
+	memset(&ofd, 0, sizeof(ofd));
+	ofd.fd = pfd[1];
+	ofd.when = BSC_FD_EXCEPT;
+	ofd.cb = except_cb;
+	OSMO_ASSERT(osmo_fd_register(&ofd) == 0);
+	/* EPOLLERR on the write end */
+	close(pfd[0]);
+
+	for (i = 0; i < 10; i++)
+		work += osmo_select_main(1);
+	printf("epoll: error on except-only fd, dispatched=%u, work=%d\n",
+		except_dispatches, work);
+
+	/* an fd closed behind our back can't be updated */
+	OSMO_ASSERT(pipe(pfd) == 0);
+	memset(&ofd, 0, sizeof(ofd));
+	ofd.fd = pfd[0];
+	ofd.when = BSC_FD_READ;
+	ofd.cb = except_cb;
+	OSMO_ASSERT(osmo_fd_register(&ofd) == 0);
+	close(pfd[0]);
+	close(pfd[1]);
+	ofd.when = BSC_FD_READ | BSC_FD_EXCEPT;
+	printf("epoll: stale fd, rc=%s\n",
+		osmo_select_main(1) == -EBADF ? "-EBADF" : "unexpected");
+	osmo_fd_unregister(&ofd);
+}
+
+int main(int argc, char **argv)
+{
+	test_churn(OSMO_SELECT_BACKEND_SELECT, "select");
+	test_nested(OSMO_SELECT_BACKEND_SELECT, "select");
+	test_churn(OSMO_SELECT_BACKEND_EPOLL, "epoll");
+	test_nested(OSMO_SELECT_BACKEND_EPOLL, "epoll");
+	test_epoll_except();
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+/* Benchmark of the timer backends
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+
+static struct osmo_timer_list *timers;
+static unsigned int fired;
+
+static void timer_cb(void *data)
+{
+	fired++;
+}
+
+static struct timeval bench_start;
+
+static void start(void)
+{
+	gettimeofday(&bench_start, NULL);
+}
+
+static void stop(const char *backend, const char *what, unsigned int num)
+{
+	struct timeval end, diff;
+	double usecs;
+
+	gettimeofday(&end, NULL);
+	timersub(&end, &bench_start, &diff);
+	usecs = diff.tv_sec * 1000000.0 + diff.tv_usec;
+
+	printf("%-6s %6u timers %-10s %8.1f ns/op %10.0f ops/s\n",
+		backend, num, what, usecs * 1000.0 / num,
+		num * 1000000.0 / usecs);
+}
+
+static void bench(enum osmo_timer_backend backend, const char *name,
+		  unsigned int num)
+{
+	unsigned int i;
+
+	OSMO_ASSERT(osmo_timers_set_backend(backend) == 0);
+
+	timers = calloc(num, sizeof(*timers));
+	for (i = 0; i < num; i++)
+		timers[i].cb = timer_cb;
+
+	/* T200/T203 like timeouts between 100ms and 30s */
+	srandom(1);
+	start();
+	for (i = 0; i < num; i++)
+		osmo_timer_schedule(&timers[i], random() % 30,
+				    100000 + random() % 900000);
+	stop(name, "schedule", num);
+
+	/* most timers are restarted before they expire */
+	start();
+	for (i = 0; i < num; i++)
+		osmo_timer_schedule(&timers[i], random() % 30,
+				    100000 + random() % 900000);
+	stop(name, "reschedule", num);
+
+	/* ...or cancelled */
+	start();
+	for (i = 0; i < num; i++)
+		osmo_timer_del(&timers[i]);
+	stop(name, "del", num);
+
+	/* expiry of timers that are all due */
+	fired = 0;
+	start();
+	for (i = 0; i < num; i++)
+		osmo_timer_schedule(&timers[i], 0, 0);
+	while (fired < num) {
+		osmo_timers_prepare();
+		osmo_timers_update();
+	}
+	stop(name, "fire", num);
+
+	free(timers);
+}
+
+int main(int argc, char **argv)
+{
+	const unsigned int sizes[] = { 1000, 10000, 100000 };
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		bench(OSMO_TIMER_BACKEND_RBTREE, "rbtree", sizes[i]);
+		bench(OSMO_TIMER_BACKEND_WHEEL, "wheel", sizes[i]);
+	}
+
+	return 0;
+}
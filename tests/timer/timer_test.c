@@ -67,6 +67,7 @@ static int timer_nsteps = MAIN_TIMER_NSTEPS;
 static unsigned int expired_timers = 0;
 static unsigned int total_timers = 0;
 static unsigned int too_late = 0;
+static int fake_clock = 0;
 
 static void main_timer_fired(void *data)
 {
@@ -90,7 +91,7 @@ static void main_timer_fired(void *data)
 			fprintf(stderr, "timer_test: OOM!\n");
 			return;
 		}
-		gettimeofday(&v->start, NULL);
+		osmo_clock_now(&v->start);
 		v->timer.cb = secondary_timer_fired;
 		v->timer.data = v;
 		unsigned int seconds = (random() % 10) + 1;
@@ -110,7 +111,7 @@ static void secondary_timer_fired(void *data)
 	struct test_timer *v = data, *this, *tmp;
 	struct timeval current, res, precision = { 1, 0 };
 
-	gettimeofday(&current, NULL);
+	osmo_clock_now(&current);
 
 	timersub(&current, &v->stop, &res);
 	if (timercmp(&res, &precision, >)) {
@@ -155,7 +156,7 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
-	while ((c = getopt_long(argc, argv, "s:", NULL, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "s:wf", NULL, NULL)) != -1) {
 	switch(c) {
 		case 's':
 			timer_nsteps = atoi(optarg);
@@ -165,6 +166,13 @@ int main(int argc, char *argv[])
 				exit(EXIT_FAILURE);
 			}
 			break;
+		case 'w':
+			osmo_timers_set_backend(OSMO_TIMER_BACKEND_WHEEL);
+			break;
+		case 'f':
+			fake_clock = 1;
+			osmo_clock_override_enable(1);
+			break;
 		default:
 			exit(EXIT_FAILURE);
 		}
@@ -182,6 +190,17 @@ int main(int argc, char *argv[])
 	 * number of steps (since some of them are reset each step). */
 	alarm(2 * (10 + timer_nsteps));
 
+	/* jump straight to the next timer instead of waiting for it */
+	while (fake_clock) {
+		struct timeval *next;
+
+		osmo_timers_prepare();
+		next = osmo_timers_nearest();
+		if (next)
+			osmo_clock_override_add(next->tv_sec, next->tv_usec);
+		osmo_timers_update();
+	}
+
 #ifdef HAVE_SYS_SELECT_H
 	while (1) {
 		osmo_select_main(0);
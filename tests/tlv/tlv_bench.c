@@ -0,0 +1,123 @@
+/* Benchmark of tlv_parse(), tlv_parse_sparse() and tlv_decode()
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/tlv.h>
+
+#include "tlv_corpus.h"
+
+#define ROUNDS		200000
+
+static const char *proto_name[] = {
+	[CORPUS_RSL]	= "RSL",
+	[CORPUS_BSSGP]	= "BSSGP",
+	[CORPUS_BSSMAP]	= "BSSMAP",
+};
+
+/* keep the compiler from dropping the parse results */
+static volatile unsigned int sink;
+
+static double elapsed_usecs(const struct timeval *start)
+{
+	struct timeval stop, diff;
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, start, &diff);
+	return diff.tv_sec * 1000000.0 + diff.tv_usec;
+}
+
+static void bench(enum tlv_corpus_proto proto,
+		  const struct tlv_compiled_def *cdef)
+{
+	const struct tlv_definition *def = tlv_corpus_def(proto);
+	struct tlv_parsed tp;
+	struct tlv_parsed_sparse tps;
+	struct timeval start;
+	double usecs_dense, usecs_sparse, usecs_decode;
+	unsigned int num_msgs = 0;
+	int r, i, j;
+
+	gettimeofday(&start, NULL);
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < ARRAY_SIZE(tlv_corpus); i++) {
+			const struct tlv_corpus_msg *m = &tlv_corpus[i];
+
+			if (m->proto != proto)
+				continue;
+			tlv_parse(&tp, def, m->data, m->len, 0, 0);
+			for (j = 0; j < 256; j += 8)
+				sink += !!TLVP_PRESENT(&tp, j);
+			if (r == 0)
+				num_msgs++;
+		}
+	}
+	usecs_dense = elapsed_usecs(&start);
+
+	gettimeofday(&start, NULL);
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < ARRAY_SIZE(tlv_corpus); i++) {
+			const struct tlv_corpus_msg *m = &tlv_corpus[i];
+
+			if (m->proto != proto)
+				continue;
+			tlv_parse_sparse(&tps, def, m->data, m->len, 0, 0);
+			for (j = 0; j < 256; j += 8)
+				sink += TLVPS_PRESENT(&tps, j);
+		}
+	}
+	usecs_sparse = elapsed_usecs(&start);
+
+	/* including the checks of the message rules */
+	gettimeofday(&start, NULL);
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < ARRAY_SIZE(tlv_corpus); i++) {
+			const struct tlv_corpus_msg *m = &tlv_corpus[i];
+
+			if (m->proto != proto)
+				continue;
+			tlv_decode(&tps, cdef, m->msg_type, m->data, m->len,
+				   NULL);
+			for (j = 0; j < 256; j += 8)
+				sink += TLVPS_PRESENT(&tps, j);
+		}
+	}
+	usecs_decode = elapsed_usecs(&start);
+
+	printf("%-6s %u msgs: tlv_parse %7.1f ns/msg, tlv_parse_sparse "
+		"%7.1f ns/msg, tlv_decode %7.1f ns/msg\n", proto_name[proto],
+		num_msgs, usecs_dense * 1000.0 / (ROUNDS * num_msgs),
+		usecs_sparse * 1000.0 / (ROUNDS * num_msgs),
+		usecs_decode * 1000.0 / (ROUNDS * num_msgs));
+}
+
+int main(int argc, char **argv)
+{
+	printf("sizeof(struct tlv_parsed) = %zu, "
+		"sizeof(struct tlv_parsed_sparse) = %zu\n",
+		sizeof(struct tlv_parsed), sizeof(struct tlv_parsed_sparse));
+
+	bench(CORPUS_RSL, rsl_att_tlvdef_compiled());
+	bench(CORPUS_BSSGP, tlv_compile(NULL, &tvlv_att_def, NULL, 0));
+	bench(CORPUS_BSSMAP, gsm0808_att_tlvdef_compiled());
+
+	return 0;
+}
@@ -0,0 +1,153 @@
+/* Captured RSL, BSSGP and BSSMAP messages for the TLV parser tests
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/tlv.h>
+#include <osmocom/gsm/gsm0808.h>
+#include <osmocom/gsm/rsl.h>
+#include <osmocom/gsm/protocol/gsm_08_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+#include <osmocom/gprs/protocol/gsm_08_18.h>
+
+/* Each message only contains the IE part, i.e. whatever follows the
+ * message type (RSL, BSSMAP) or the fixed header (BSSGP) */
+enum tlv_corpus_proto {
+	CORPUS_RSL,
+	CORPUS_BSSGP,
+	CORPUS_BSSMAP,
+};
+
+struct tlv_corpus_msg {
+	const char *name;
+	enum tlv_corpus_proto proto;
+	uint8_t msg_type;
+	const uint8_t *data;
+	int len;
+};
+
+#define CORPUS_MSG(n, p, t, ...) \
+	{ n, p, t, (const uint8_t []) { __VA_ARGS__ }, \
+	  sizeof((const uint8_t []) { __VA_ARGS__ }) }
+
+static const struct tlv_corpus_msg tlv_corpus[] = {
+	CORPUS_MSG("RSL EST IND", CORPUS_RSL, RSL_MT_EST_IND,
+		RSL_IE_CHAN_NR, 0x41,
+		RSL_IE_LINK_IDENT, 0x00,
+		RSL_IE_L3_INFO, 0x00, 0x10,
+			0x05, 0x08, 0x72, 0x62, 0xf2, 0x20, 0x00, 0x01,
+			0x33, 0x05, 0xf4, 0x3d, 0x01, 0x98, 0x6d, 0x00),
+	CORPUS_MSG("RSL DATA IND", CORPUS_RSL, RSL_MT_DATA_IND,
+		RSL_IE_CHAN_NR, 0x41,
+		RSL_IE_LINK_IDENT, 0x00,
+		RSL_IE_L3_INFO, 0x00, 0x0b,
+			0x06, 0x16, 0x03, 0x33, 0x19, 0xa2, 0x20, 0x0b,
+			0x60, 0x14, 0x4c),
+	CORPUS_MSG("RSL CHAN ACTIV", CORPUS_RSL, RSL_MT_CHAN_ACTIV,
+		RSL_IE_CHAN_NR, 0x0a,
+		RSL_IE_ACT_TYPE, 0x00,
+		RSL_IE_CHAN_MODE, 0x04, 0x00, 0x00, 0x01, 0x00,
+		RSL_IE_BS_POWER, 0x00,
+		RSL_IE_MS_POWER, 0x00,
+		RSL_IE_TIMING_ADVANCE, 0x01),
+	CORPUS_MSG("RSL MEAS RES", CORPUS_RSL, RSL_MT_MEAS_RES,
+		RSL_IE_CHAN_NR, 0x0a,
+		RSL_IE_MEAS_RES_NR, 0x07,
+		RSL_IE_UPLINK_MEAS, 0x03, 0x36, 0x36, 0x00,
+		RSL_IE_BS_POWER, 0x00,
+		RSL_IE_L1_INFO, 0x00, 0x01,
+		RSL_IE_L3_INFO, 0x00, 0x12,
+			0x06, 0x15, 0x36, 0x36, 0x01, 0xc0, 0x00, 0x00,
+			0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+			0x00, 0x00,
+		RSL_IE_MS_TIMING_OFFSET, 0x01),
+	CORPUS_MSG("BSSGP UL-UNITDATA", CORPUS_BSSGP, BSSGP_PDUT_UL_UNITDATA,
+		BSSGP_IE_CELL_ID, 0x88,
+			0x62, 0xf2, 0x24, 0x00, 0x01, 0x01, 0x00, 0x01,
+		BSSGP_IE_ALIGNMENT, 0x81, 0x00,
+		BSSGP_IE_LLC_PDU, 0x94,
+			0x01, 0xc0, 0x01, 0x08, 0x01, 0x02, 0xf5, 0x40,
+			0x71, 0x08, 0x00, 0x15, 0x08, 0x01, 0xc0, 0x19,
+			0xa0, 0x4e, 0x3d, 0x56),
+	CORPUS_MSG("BSSGP DL-UNITDATA", CORPUS_BSSGP, BSSGP_PDUT_DL_UNITDATA,
+		BSSGP_IE_PDU_LIFETIME, 0x82, 0x02, 0x58,
+		BSSGP_IE_MS_RADIO_ACCESS_CAP, 0x87,
+			0x13, 0x1a, 0x53, 0x62, 0x00, 0xab, 0x00,
+		BSSGP_IE_IMSI, 0x88,
+			0x09, 0x10, 0x26, 0x02, 0x00, 0x00, 0x00, 0xf1,
+		BSSGP_IE_DRX_PARAMS, 0x82, 0x00, 0x00,
+		BSSGP_IE_LLC_PDU, 0x00, 0x1c,
+			0x01, 0xc0, 0x05, 0x08, 0x02, 0x01, 0x49, 0x04,
+			0x21, 0x63, 0x54, 0x40, 0x50, 0x60, 0x19, 0x54,
+			0xab, 0xb3, 0x43, 0x17, 0x05, 0xf4, 0xef, 0xe2,
+			0xb7, 0x00, 0x96, 0xa1),
+	CORPUS_MSG("BSSGP FLOW-CONTROL-BVC", CORPUS_BSSGP,
+		BSSGP_PDUT_FLOW_CONTROL_BVC,
+		BSSGP_IE_TAG, 0x81, 0x01,
+		BSSGP_IE_BVC_BUCKET_SIZE, 0x82, 0x10, 0x00,
+		BSSGP_IE_BUCKET_LEAK_RATE, 0x82, 0x00, 0x50,
+		BSSGP_IE_BMAX_DEFAULT_MS, 0x82, 0x06, 0x40,
+		BSSGP_IE_R_DEFAULT_MS, 0x82, 0x00, 0x50),
+	CORPUS_MSG("BSSGP BVC-RESET", CORPUS_BSSGP, BSSGP_PDUT_BVC_RESET,
+		BSSGP_IE_BVCI, 0x82, 0x00, 0x02,
+		BSSGP_IE_CAUSE, 0x81, 0x08,
+		BSSGP_IE_CELL_ID, 0x88,
+			0x62, 0xf2, 0x24, 0x00, 0x01, 0x01, 0x00, 0x01),
+	CORPUS_MSG("BSSMAP COMPLETE LAYER 3", CORPUS_BSSMAP,
+		BSS_MAP_MSG_COMPLETE_LAYER_3,
+		GSM0808_IE_CELL_IDENTIFIER, 0x08,
+			0x00, 0x62, 0xf2, 0x24, 0x00, 0x01, 0x00, 0x01,
+		GSM0808_IE_LAYER_3_INFORMATION, 0x11,
+			0x05, 0x08, 0x72, 0x62, 0xf2, 0x24, 0x00, 0x01,
+			0x33, 0x08, 0x29, 0x26, 0x24, 0x10, 0x32, 0x54,
+			0x76),
+	CORPUS_MSG("BSSMAP ASSIGNMENT REQUEST", CORPUS_BSSMAP,
+		BSS_MAP_MSG_ASSIGMENT_RQST,
+		GSM0808_IE_CHANNEL_TYPE, 0x03, 0x01, 0x08, 0x01,
+		GSM0808_IE_CIRCUIT_IDENTITY_CODE, 0x00, 0x21),
+	CORPUS_MSG("BSSMAP ASSIGNMENT COMPLETE", CORPUS_BSSMAP,
+		BSS_MAP_MSG_ASSIGMENT_COMPLETE,
+		GSM0808_IE_RR_CAUSE, 0x00,
+		GSM0808_IE_CHOSEN_CHANNEL, 0x98,
+		GSM0808_IE_CHOSEN_ENCR_ALG, 0x02,
+		GSM0808_IE_SPEECH_VERSION, 0x01),
+	CORPUS_MSG("BSSMAP CIPHER MODE CMD", CORPUS_BSSMAP,
+		BSS_MAP_MSG_CIPHER_MODE_CMD,
+		GSM0808_IE_ENCRYPTION_INFORMATION, 0x09,
+			0x02, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x00,
+			0x11),
+	CORPUS_MSG("BSSMAP CLEAR COMMAND", CORPUS_BSSMAP, BSS_MAP_MSG_CLEAR_CMD,
+		GSM0808_IE_CAUSE, 0x01, 0x09),
+};
+
+static inline const struct tlv_definition *
+tlv_corpus_def(enum tlv_corpus_proto proto)
+{
+	switch (proto) {
+	case CORPUS_RSL:
+		return &rsl_att_tlvdef;
+	case CORPUS_BSSGP:
+		return &tvlv_att_def;
+	case CORPUS_BSSMAP:
+		return gsm0808_att_tlvdef();
+	}
+	return NULL;
+}
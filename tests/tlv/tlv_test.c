@@ -0,0 +1,265 @@
+/* Test the sparse TLV parser and the compiled decoder against tlv_parse()
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/tlv.h>
+
+#include "tlv_corpus.h"
+
+/* both results must agree for every tag */
+static int compare(const struct tlv_parsed *tp,
+		   const struct tlv_parsed_sparse *tps)
+{
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		if (!!TLVP_PRESENT(tp, i) != TLVPS_PRESENT(tps, i) ||
+		    TLVP_LEN(tp, i) != TLVPS_LEN(tps, i) ||
+		    TLVP_VAL(tp, i) != TLVPS_VAL(tps, i)) {
+			printf("mismatch for tag 0x%02x\n", i);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int compare_sparse(const struct tlv_parsed_sparse *a,
+			  const struct tlv_parsed_sparse *b)
+{
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		if (TLVPS_PRESENT(a, i) != TLVPS_PRESENT(b, i) ||
+		    TLVPS_LEN(a, i) != TLVPS_LEN(b, i) ||
+		    TLVPS_VAL(a, i) != TLVPS_VAL(b, i)) {
+			printf("mismatch for tag 0x%02x\n", i);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static const struct tlv_compiled_def *corpus_cdef(enum tlv_corpus_proto proto)
+{
+	static struct tlv_compiled_def *bssgp_cdef;
+
+	switch (proto) {
+	case CORPUS_RSL:
+		return rsl_att_tlvdef_compiled();
+	case CORPUS_BSSMAP:
+		return gsm0808_att_tlvdef_compiled();
+	case CORPUS_BSSGP:
+		/* the BSSGP rules are internal to libosmogb */
+		if (!bssgp_cdef)
+			bssgp_cdef = tlv_compile(NULL, &tvlv_att_def, NULL, 0);
+		return bssgp_cdef;
+	}
+	return NULL;
+}
+
+static void test_corpus(void)
+{
+	struct tlv_parsed tp;
+	struct tlv_parsed_sparse tps;
+	int i, rc, rc_s;
+
+	printf("Testing the message corpus\n");
+
+	/* not cleared, and re-used for all messages */
+	memset(&tps, 0xa5, sizeof(tps));
+
+	for (i = 0; i < ARRAY_SIZE(tlv_corpus); i++) {
+		const struct tlv_corpus_msg *m = &tlv_corpus[i];
+		const struct tlv_definition *def = tlv_corpus_def(m->proto);
+
+		rc = tlv_parse(&tp, def, m->data, m->len, 0, 0);
+		rc_s = tlv_parse_sparse(&tps, def, m->data, m->len, 0, 0);
+		printf("%-27s: %d IEs, sparse %d IEs, %s\n", m->name, rc, rc_s,
+			rc == rc_s && compare(&tp, &tps) == 0 ? "OK" : "FAIL");
+	}
+}
+
+static void test_decode_corpus(void)
+{
+	struct tlv_parsed tp, tp_d;
+	struct tlv_parsed_sparse tps, tps_d;
+	int i, rc, rc_d, rc_dd;
+
+	printf("Testing the compiled decoder on the message corpus\n");
+
+	for (i = 0; i < ARRAY_SIZE(tlv_corpus); i++) {
+		const struct tlv_corpus_msg *m = &tlv_corpus[i];
+		const struct tlv_definition *def = tlv_corpus_def(m->proto);
+		const struct tlv_compiled_def *cdef = corpus_cdef(m->proto);
+
+		rc = tlv_parse(&tp, def, m->data, m->len, 0, 0);
+		tlv_parse_sparse(&tps, def, m->data, m->len, 0, 0);
+		rc_d = tlv_decode(&tps_d, cdef, m->msg_type, m->data, m->len,
+				  NULL);
+		rc_dd = tlv_decode_dense(&tp_d, cdef, m->msg_type, m->data,
+					 m->len, NULL);
+		printf("%-27s: %d IEs, decode %d IEs, dense %d IEs, %s\n",
+			m->name, rc, rc_d, rc_dd,
+			rc == rc_d && rc == rc_dd &&
+			compare_sparse(&tps, &tps_d) == 0 &&
+			compare(&tp_d, &tps_d) == 0 ? "OK" : "FAIL");
+	}
+}
+
+static void test_decode_errors(void)
+{
+	/* CHANNEL ACTIVATION without Channel Mode */
+	static const uint8_t missing[] = {
+		RSL_IE_CHAN_NR, 0x0a,
+		RSL_IE_ACT_TYPE, 0x00,
+		RSL_IE_BS_POWER, 0x00,
+	};
+	/* ASSIGNMENT REQUEST with a Channel Type of two octets */
+	static const uint8_t short_ie[] = {
+		GSM0808_IE_CHANNEL_TYPE, 0x02, 0x01, 0x08,
+	};
+	/* DATA INDICATION with the L3 Information cut short */
+	static const uint8_t truncated[] = {
+		RSL_IE_CHAN_NR, 0x41,
+		RSL_IE_LINK_IDENT, 0x00,
+		RSL_IE_L3_INFO, 0x00, 0x0b, 0x06, 0x16,
+	};
+	/* ERROR INDICATION with an undefined IE */
+	static const uint8_t unknown[] = {
+		RSL_IE_RLM_CAUSE, 0x01, 0x01,
+		0xff, 0x01,
+	};
+	struct tlv_parsed_sparse tps;
+	struct tlv_parsed tp;
+	uint8_t err_tag;
+	int rc;
+
+	printf("Testing decoder errors\n");
+
+	err_tag = 0;
+	rc = rsl_tlv_decode(&tps, RSL_MT_CHAN_ACTIV, missing, sizeof(missing),
+			    &err_tag);
+	printf("missing IE: %d, tag 0x%02x\n", rc, err_tag);
+
+	/* unknown message types are parsed without any rules */
+	rc = rsl_tlv_decode(&tps, RSL_MT_IPAC_CRCX, missing, sizeof(missing),
+			    NULL);
+	printf("missing IE, no rules: %d\n", rc);
+
+	err_tag = 0;
+	rc = tlv_decode_dense(&tp, gsm0808_att_tlvdef_compiled(),
+			      BSS_MAP_MSG_ASSIGMENT_RQST, short_ie,
+			      sizeof(short_ie), &err_tag);
+	printf("short IE: %d, tag 0x%02x\n", rc, err_tag);
+
+	err_tag = 0;
+	rc = rsl_tlv_decode(&tps, RSL_MT_DATA_IND, truncated,
+			    sizeof(truncated), &err_tag);
+	printf("truncated IE: %d, tag 0x%02x\n", rc, err_tag);
+
+	err_tag = 0;
+	rc = rsl_tlv_decode(&tps, RSL_MT_ERROR_IND, unknown, sizeof(unknown),
+			    &err_tag);
+	printf("unknown IE: %d, tag 0x%02x\n", rc, err_tag);
+}
+
+static void test_lv_tags(void)
+{
+	static const uint8_t buf[] = { 0x02, 0xaa, 0xbb, 0x01, 0xcc,
+				       0x01, 0xdd };
+	struct tlv_parsed tp;
+	struct tlv_parsed_sparse tps;
+	int rc, rc_s;
+
+	printf("Testing leading LV tags\n");
+
+	rc = tlv_parse(&tp, &rsl_att_tlvdef, buf, sizeof(buf), 0xf0, 0xf1);
+	rc_s = tlv_parse_sparse(&tps, &rsl_att_tlvdef, buf, sizeof(buf),
+				0xf0, 0xf1);
+	printf("%d IEs, sparse %d IEs, %s\n", rc, rc_s,
+		rc == rc_s && compare(&tp, &tps) == 0 ? "OK" : "FAIL");
+
+	/* the LV doesn't fit */
+	rc_s = tlv_parse_sparse(&tps, &rsl_att_tlvdef, buf, 2, 0xf0, 0);
+	printf("truncated LV: %d\n", rc_s);
+}
+
+static void test_repeated(void)
+{
+	static const uint8_t buf[] = {
+		RSL_IE_CHAN_NR, 0x01,
+		RSL_IE_LINK_IDENT, 0x00,
+		RSL_IE_CHAN_NR, 0x02,
+	};
+	struct tlv_parsed tp;
+	struct tlv_parsed_sparse tps;
+	int rc, rc_s;
+
+	printf("Testing repeated IEs\n");
+
+	rc = tlv_parse(&tp, &rsl_att_tlvdef, buf, sizeof(buf), 0, 0);
+	rc_s = tlv_parse_sparse(&tps, &rsl_att_tlvdef, buf, sizeof(buf), 0, 0);
+	printf("%d IEs, sparse %d IEs in %u entries, first 0x%02x, "
+		"value 0x%02x, %s\n", rc, rc_s, tps.num_ie, tps.ie[0].tag,
+		*TLVPS_VAL(&tps, RSL_IE_CHAN_NR),
+		rc == rc_s && compare(&tp, &tps) == 0 ? "OK" : "FAIL");
+}
+
+static void test_errors(void)
+{
+	/* TLV with a length beyond the end of the buffer */
+	static const uint8_t buf[] = { RSL_IE_CHAN_NR, 0x01,
+				       RSL_IE_CHAN_MODE, 0x04, 0x00 };
+	uint8_t many[2 * (TLV_SPARSE_MAX_IE + 1)];
+	struct tlv_parsed tp;
+	struct tlv_parsed_sparse tps;
+	int i, rc, rc_s;
+
+	printf("Testing errors\n");
+
+	rc = tlv_parse(&tp, &rsl_att_tlvdef, buf, sizeof(buf), 0, 0);
+	rc_s = tlv_parse_sparse(&tps, &rsl_att_tlvdef, buf, sizeof(buf), 0, 0);
+	printf("truncated TLV: %d, sparse %d\n", rc, rc_s);
+
+	/* more distinct IEs than fit, zero length TvLV each */
+	for (i = 0; i < TLV_SPARSE_MAX_IE + 1; i++) {
+		many[2 * i] = i;
+		many[2 * i + 1] = 0x80;
+	}
+	rc = tlv_parse(&tp, &tvlv_att_def, many, sizeof(many), 0, 0);
+	rc_s = tlv_parse_sparse(&tps, &tvlv_att_def, many, sizeof(many), 0, 0);
+	printf("%d distinct IEs: %d, sparse %d\n", TLV_SPARSE_MAX_IE + 1,
+		rc, rc_s);
+}
+
+int main(int argc, char **argv)
+{
+	test_corpus();
+	test_lv_tags();
+	test_repeated();
+	test_errors();
+	test_decode_corpus();
+	test_decode_errors();
+
+	printf("Done.\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+/* Test of the write queue batching and drop policies
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <osmocom/core/write_queue.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
+
+static struct msgb *test_msg(unsigned int len, uint8_t fill)
+{
+	struct msgb *msg = msgb_alloc(len, "wqueue_test");
+
+	memset(msgb_put(msg, len), fill, len);
+	return msg;
+}
+
+static void dump_queue(const char *what, struct osmo_wqueue *wq)
+{
+	struct msgb *msg;
+
+	printf("%s: queued=%u dropped=%u rejected=%u:", what,
+		wq->current_length, wq->dropped, wq->rejected);
+	llist_for_each_entry(msg, &wq->msg_queue, list)
+		printf(" %02x", msg->data[0]);
+	printf("\n");
+}
+
+static void test_policy(enum osmo_wqueue_policy policy, const char *name)
+{
+	struct osmo_wqueue wq;
+	struct msgb *msg;
+	int i, rc;
+
+	osmo_wqueue_init(&wq, 2);
+	wq.policy = policy;
+
+	for (i = 1; i <= 3; i++) {
+		msg = test_msg(1, i);
+		rc = osmo_wqueue_enqueue(&wq, msg);
+		if (rc < 0) {
+			printf("%s: enqueue %d: %s\n", name, i, strerror(-rc));
+			msgb_free(msg);
+		}
+	}
+	dump_queue(name, &wq);
+	osmo_wqueue_clear(&wq);
+}
+
+static unsigned int write_calls;
+
+static int count_write_cb(struct osmo_fd *fd, struct msgb *msg)
+{
+	write_calls++;
+	return 0;
+}
+
+static void test_batch(void)
+{
+	struct osmo_wqueue wq;
+	uint8_t buf[64];
+	int fds[2], i, rc;
+
+	printf("Testing batched writes\n");
+
+	OSMO_ASSERT(pipe(fds) == 0);
+	osmo_wqueue_init(&wq, 100);
+	wq.bfd.fd = fds[1];
+	wq.batch = 4;
+
+	for (i = 0; i < 10; i++)
+		osmo_wqueue_enqueue(&wq, test_msg(3, i));
+
+	/* up to 4 msgbs are coalesced into one writev() */
+	osmo_wqueue_bfd_cb(&wq.bfd, BSC_FD_WRITE);
+	rc = read(fds[0], buf, sizeof(buf));
+	printf("written %d: %s, queued=%u\n", rc, osmo_hexdump(buf, rc),
+		wq.current_length);
+
+	wq.batch = 16;
+	osmo_wqueue_bfd_cb(&wq.bfd, BSC_FD_WRITE);
+	rc = read(fds[0], buf, sizeof(buf));
+	printf("written %d, queued=%u, write=%d\n", rc, wq.current_length,
+		!!(wq.bfd.when & BSC_FD_WRITE));
+
+	/* a write_cb is called up to batch times per event */
+	wq.write_cb = count_write_cb;
+	wq.batch = 3;
+	for (i = 0; i < 5; i++)
+		osmo_wqueue_enqueue(&wq, test_msg(1, i));
+	osmo_wqueue_bfd_cb(&wq.bfd, BSC_FD_WRITE);
+	printf("write_cb calls=%u, queued=%u\n", write_calls, wq.current_length);
+	osmo_wqueue_clear(&wq);
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static void test_partial(void)
+{
+	struct osmo_wqueue wq;
+	uint8_t *buf;
+	int fds[2], cap, len, rc, total = 0, i;
+	int ok = 1;
+
+	printf("Testing partial writes\n");
+
+	OSMO_ASSERT(pipe(fds) == 0);
+	OSMO_ASSERT(fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+	cap = fcntl(fds[1], F_GETPIPE_SZ);
+	OSMO_ASSERT(cap > 0);
+
+	/* three msgbs of which only 1.5 fit into the pipe */
+	len = cap * 2 / 3;
+	OSMO_ASSERT(len <= UINT16_MAX);
+	buf = malloc(3 * len);
+
+	osmo_wqueue_init(&wq, 2);
+	wq.bfd.fd = fds[1];
+	wq.batch = 8;
+	wq.policy = OSMO_WQUEUE_DROP_OLDEST;
+	for (i = 1; i <= 2; i++)
+		osmo_wqueue_enqueue(&wq, test_msg(len, i));
+
+	osmo_wqueue_bfd_cb(&wq.bfd, BSC_FD_WRITE);
+	osmo_wqueue_enqueue(&wq, test_msg(len, 3));
+	printf("partial=%d\n", wq.partial);
+	dump_queue("after partial write", &wq);
+
+	/* the partially written msgb isn't dropped */
+	osmo_wqueue_enqueue(&wq, test_msg(len, 4));
+	dump_queue("drop oldest", &wq);
+
+	while (wq.current_length || total < 3 * len) {
+		if (wq.current_length)
+			osmo_wqueue_bfd_cb(&wq.bfd, BSC_FD_WRITE);
+		rc = read(fds[0], buf + total, 3 * len - total);
+		OSMO_ASSERT(rc > 0);
+		total += rc;
+	}
+
+	for (i = 0; i < 3 * len; i++) {
+		if (buf[i] != (i < len ? 1 : i < 2 * len ? 2 : 4))
+			ok = 0;
+	}
+	printf("stream %s, queued=%u, partial=%d\n", ok ? "ok" : "corrupted",
+		wq.current_length, wq.partial);
+
+	free(buf);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+int main(int argc, char **argv)
+{
+	printf("Testing drop policies\n");
+	test_policy(OSMO_WQUEUE_UNLIMITED, "unlimited");
+	test_policy(OSMO_WQUEUE_DROP_OLDEST, "drop-oldest");
+	test_policy(OSMO_WQUEUE_DROP_NEWEST, "drop-newest");
+	test_policy(OSMO_WQUEUE_REJECT, "reject");
+
+	test_batch();
+	test_partial();
+
+	return 0;
+}
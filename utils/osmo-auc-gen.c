@@ -29,7 +29,10 @@
 #include <getopt.h>
 #include <unistd.h>
 #include <inttypes.h>
-#include <time.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/time.h>
 
 #include <osmocom/crypt/auth.h>
 #include <osmocom/core/utils.h>
@@ -68,6 +71,425 @@ static struct osmo_sub_auth_data test_aud = {
 	.algo = OSMO_AUTH_ALG_NONE,
 };
 
+/* Bulk mode: subscriber records are read in chunks, the vectors of a
+ * chunk are generated (and formatted) by a pool of worker threads and
+ * written in input order by the main thread. */
+
+#define BULK_CHUNK	1024	/* subscribers read at a time */
+#define BULK_BLOCK	16	/* subscribers taken by a worker at a time */
+#define BULK_MAX_VEC	32	/* vectors per subscriber */
+#define BULK_CSV_LEN	224	/* longest CSV line */
+#define BULK_BIN_LEN	118	/* size of a binary record */
+#define BULK_SQN_MASK	0xffffffffffffULL	/* SQN is 48 bits */
+
+struct bulk_sub {
+	char imsi[16];
+	struct osmo_sub_auth_data aud;
+	int rc;
+	size_t out_len;
+};
+
+static struct {
+	unsigned int num_vec;
+	int binary;
+
+	struct bulk_sub *subs;
+	struct osmo_auth_vector *vecs;	/* num_vec per subscriber */
+	uint8_t *rands;			/* num_vec * 16 per subscriber */
+	char *out;			/* out_max per subscriber */
+	size_t out_max;
+
+	pthread_mutex_t lock;
+	pthread_cond_t work_cv;
+	pthread_cond_t done_cv;
+	unsigned int num_subs;
+	unsigned int next;
+	unsigned int done;
+	int quit;
+} bulk = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work_cv = PTHREAD_COND_INITIALIZER,
+	.done_cv = PTHREAD_COND_INITIALIZER,
+};
+
+/* osmo_hexdump_nospc() uses a static buffer, which the workers can't */
+static char *hex_put(char *dst, const uint8_t *buf, unsigned int len)
+{
+	static const char hex[] = "0123456789abcdef";
+	unsigned int i;
+
+	for (i = 0; i < len; i++) {
+		*dst++ = hex[buf[i] >> 4];
+		*dst++ = hex[buf[i] & 0xf];
+	}
+	return dst;
+}
+
+/* IMSI,SQN,RAND,AUTN,CK,IK,RES,SRES,KC with the UMTS fields empty for
+ * GSM vectors */
+static size_t bulk_put_csv(char *out, const struct bulk_sub *sub,
+			   const struct osmo_auth_vector *vec, uint64_t sqn)
+{
+	char *p = out;
+
+	p += sprintf(p, "%s,", sub->imsi);
+	if (vec->auth_types & OSMO_AUTH_TYPE_UMTS)
+		p += sprintf(p, "%" PRIu64, sqn);
+	*p++ = ',';
+	p = hex_put(p, vec->rand, sizeof(vec->rand));
+	*p++ = ',';
+	if (vec->auth_types & OSMO_AUTH_TYPE_UMTS) {
+		p = hex_put(p, vec->autn, sizeof(vec->autn));
+		*p++ = ',';
+		p = hex_put(p, vec->ck, sizeof(vec->ck));
+		*p++ = ',';
+		p = hex_put(p, vec->ik, sizeof(vec->ik));
+		*p++ = ',';
+		p = hex_put(p, vec->res, vec->res_len);
+		*p++ = ',';
+	} else {
+		memcpy(p, ",,,,", 4);
+		p += 4;
+	}
+	p = hex_put(p, vec->sres, sizeof(vec->sres));
+	*p++ = ',';
+	p = hex_put(p, vec->kc, sizeof(vec->kc));
+	*p++ = '\n';
+
+	return p - out;
+}
+
+/* fixed size record, see help() */
+static size_t bulk_put_bin(char *out, const struct bulk_sub *sub,
+			   const struct osmo_auth_vector *vec, uint64_t sqn)
+{
+	uint8_t *p = (uint8_t *) out;
+	int i;
+
+	memset(p, 0, 16);
+	memcpy(p, sub->imsi, strlen(sub->imsi));
+	p += 16;
+	for (i = 7; i >= 0; i--)
+		*p++ = sqn >> (8 * i);
+	memcpy(p, vec->rand, 16);
+	memcpy(p + 16, vec->autn, 16);
+	memcpy(p + 32, vec->ck, 16);
+	memcpy(p + 48, vec->ik, 16);
+	memcpy(p + 64, vec->res, 16);
+	p += 80;
+	*p++ = vec->res_len;
+	memcpy(p, vec->sres, 4);
+	memcpy(p + 4, vec->kc, 8);
+	p += 12;
+	*p++ = vec->auth_types;
+
+	return (char *) p - out;
+}
+
+static void bulk_gen(unsigned int i)
+{
+	struct bulk_sub *sub = &bulk.subs[i];
+	struct osmo_auth_vector *vec = &bulk.vecs[i * bulk.num_vec];
+	char *out = bulk.out + i * bulk.out_max;
+	uint64_t sqn = sub->aud.u.umts.sqn;
+	unsigned int v;
+
+	memset(vec, 0, bulk.num_vec * sizeof(*vec));
+	sub->out_len = 0;
+	sub->rc = osmo_auth_gen_vec_batch(vec, bulk.num_vec, &sub->aud,
+					  bulk.rands + i * bulk.num_vec * 16);
+	if (sub->rc < 0)
+		return;
+
+	for (v = 0; v < bulk.num_vec; v++) {
+		uint64_t vec_sqn = (sqn + v) & BULK_SQN_MASK;
+
+		if (bulk.binary)
+			sub->out_len += bulk_put_bin(out + sub->out_len, sub,
+						     &vec[v], vec_sqn);
+		else
+			sub->out_len += bulk_put_csv(out + sub->out_len, sub,
+						     &vec[v], vec_sqn);
+	}
+}
+
+static void *bulk_worker(void *arg)
+{
+	pthread_mutex_lock(&bulk.lock);
+	while (1) {
+		unsigned int first, num, i;
+
+		while (!bulk.quit && bulk.next >= bulk.num_subs)
+			pthread_cond_wait(&bulk.work_cv, &bulk.lock);
+		if (bulk.quit)
+			break;
+
+		first = bulk.next;
+		num = bulk.num_subs - first;
+		if (num > BULK_BLOCK)
+			num = BULK_BLOCK;
+		bulk.next += num;
+		pthread_mutex_unlock(&bulk.lock);
+
+		for (i = first; i < first + num; i++)
+			bulk_gen(i);
+
+		pthread_mutex_lock(&bulk.lock);
+		bulk.done += num;
+		if (bulk.done == bulk.num_subs)
+			pthread_cond_signal(&bulk.done_cv);
+	}
+	pthread_mutex_unlock(&bulk.lock);
+
+	return NULL;
+}
+
+/* hand the first num subscribers to the workers and wait for them */
+static void bulk_dispatch(unsigned int num)
+{
+	pthread_mutex_lock(&bulk.lock);
+	bulk.num_subs = num;
+	bulk.next = 0;
+	bulk.done = 0;
+	pthread_cond_broadcast(&bulk.work_cv);
+	while (bulk.done < bulk.num_subs)
+		pthread_cond_wait(&bulk.done_cv, &bulk.lock);
+	pthread_mutex_unlock(&bulk.lock);
+}
+
+/* SQN is a 48 bit decimal number */
+static int bulk_parse_sqn(const char *str, uint64_t *sqn)
+{
+	unsigned long long val;
+	char *end;
+
+	if (!isdigit((unsigned char) *str))
+		return -EINVAL;
+	errno = 0;
+	val = strtoull(str, &end, 10);
+	if (errno || *end || val > BULK_SQN_MASK)
+		return -EINVAL;
+
+	*sqn = val;
+	return 0;
+}
+
+/* IMSI,ALGO,KI_OR_K[,OPC[,SQN]] */
+static int bulk_parse(struct bulk_sub *sub, char *line,
+		      const struct osmo_sub_auth_data *defaults)
+{
+	char *fields[5];
+	unsigned int n = 0;
+	char *tok;
+	int rc;
+
+	line[strcspn(line, "\r\n")] = '\0';
+	while (n < ARRAY_SIZE(fields) && (tok = strsep(&line, ",")))
+		fields[n++] = tok;
+	if (n < 3 || line)
+		return -EINVAL;
+
+	if (!*fields[0] || strlen(fields[0]) >= sizeof(sub->imsi))
+		return -EINVAL;
+	strcpy(sub->imsi, fields[0]);
+
+	rc = osmo_auth_alg_parse(fields[1]);
+	if (rc < 0 || rc == OSMO_AUTH_ALG_NONE)
+		return -EINVAL;
+
+	sub->aud = *defaults;
+	sub->aud.algo = rc;
+	if (sub->aud.algo == OSMO_AUTH_ALG_MILENAGE) {
+		sub->aud.type = OSMO_AUTH_TYPE_UMTS;
+		if (osmo_hexparse(fields[2], sub->aud.u.umts.k,
+				  sizeof(sub->aud.u.umts.k)) != 16)
+			return -EINVAL;
+		if (n < 4 || osmo_hexparse(fields[3], sub->aud.u.umts.opc,
+					   sizeof(sub->aud.u.umts.opc)) != 16)
+			return -EINVAL;
+		sub->aud.u.umts.opc_is_op = 0;
+		sub->aud.u.umts.sqn = 0;
+		if (n == 5 && bulk_parse_sqn(fields[4],
+					     &sub->aud.u.umts.sqn) < 0)
+			return -EINVAL;
+	} else {
+		sub->aud.type = OSMO_AUTH_TYPE_GSM;
+		if (osmo_hexparse(fields[2], sub->aud.u.gsm.ki,
+				  sizeof(sub->aud.u.gsm.ki)) != 16)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int read_all(int fd, uint8_t *buf, size_t len)
+{
+	while (len) {
+		ssize_t rc = read(fd, buf, len);
+		if (rc <= 0)
+			return -EIO;
+		buf += rc;
+		len -= rc;
+	}
+	return 0;
+}
+
+/* read a line into buf.  Lines that don't fit are skipped and reported
+ * as -EMSGSIZE, so they don't end up as several bogus records */
+static int bulk_getline(char *buf, int size, FILE *in)
+{
+	size_t len;
+	int c;
+
+	if (!fgets(buf, size, in))
+		return -ENOENT;
+
+	/* complete line, or the last one without a newline */
+	len = strlen(buf);
+	if (len < (size_t) size - 1 || buf[len - 1] == '\n')
+		return 0;
+	c = getc(in);
+	if (c == '\n' || c == EOF)
+		return 0;
+
+	while (c != '\n' && c != EOF)
+		c = getc(in);
+	return -EMSGSIZE;
+}
+
+static int bulk_run(const char *path, unsigned int num_threads,
+		    const struct osmo_sub_auth_data *defaults,
+		    const uint8_t *fixed_rand)
+{
+	unsigned int lineno = 0, num_subs = 0, errors = 0, i;
+	unsigned int num_started = 0;
+	unsigned long long num_vecs = 0;
+	struct timeval start, stop, diff;
+	pthread_t *threads = NULL;
+	double secs;
+	char line[256];
+	FILE *in;
+	int rnd_fd = -1;
+	int eof = 0;
+	int rc = 1;
+
+	in = strcmp(path, "-") ? fopen(path, "r") : stdin;
+	if (!in) {
+		fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+	if (!fixed_rand) {
+		rnd_fd = open("/dev/urandom", O_RDONLY);
+		if (rnd_fd < 0) {
+			fprintf(stderr, "Cannot open /dev/urandom: %s\n",
+				strerror(errno));
+			goto out;
+		}
+	}
+
+	bulk.out_max = bulk.num_vec * (bulk.binary ? BULK_BIN_LEN : BULK_CSV_LEN);
+	bulk.subs = calloc(BULK_CHUNK, sizeof(*bulk.subs));
+	bulk.vecs = calloc(BULK_CHUNK * bulk.num_vec, sizeof(*bulk.vecs));
+	bulk.rands = malloc(BULK_CHUNK * bulk.num_vec * 16);
+	bulk.out = malloc(BULK_CHUNK * bulk.out_max);
+	threads = calloc(num_threads, sizeof(*threads));
+	if (!bulk.subs || !bulk.vecs || !bulk.rands || !bulk.out || !threads) {
+		fprintf(stderr, "Out of memory\n");
+		goto out;
+	}
+
+	for (; num_started < num_threads; num_started++) {
+		if (pthread_create(&threads[num_started], NULL, bulk_worker,
+				   NULL)) {
+			fprintf(stderr, "Cannot create worker thread\n");
+			goto out;
+		}
+	}
+
+	gettimeofday(&start, NULL);
+	while (!eof) {
+		unsigned int n = 0;
+
+		while (n < BULK_CHUNK) {
+			int line_rc = bulk_getline(line, sizeof(line), in);
+
+			if (line_rc == -ENOENT) {
+				eof = 1;
+				break;
+			}
+			lineno++;
+			if (line_rc < 0) {
+				fprintf(stderr, "line %u: line too long\n", lineno);
+				errors++;
+				continue;
+			}
+			if (line[0] == '#' || !line[strspn(line, " \t\r\n")])
+				continue;
+			if (bulk_parse(&bulk.subs[n], line, defaults) < 0) {
+				fprintf(stderr, "line %u: invalid subscriber record\n",
+					lineno);
+				errors++;
+				continue;
+			}
+			n++;
+		}
+		if (!n)
+			break;
+
+		if (fixed_rand) {
+			for (i = 0; i < n * bulk.num_vec; i++)
+				memcpy(bulk.rands + 16 * i, fixed_rand, 16);
+		} else if (read_all(rnd_fd, bulk.rands, n * bulk.num_vec * 16) < 0) {
+			fprintf(stderr, "Cannot read random numbers\n");
+			goto out;
+		}
+
+		bulk_dispatch(n);
+
+		for (i = 0; i < n; i++) {
+			if (bulk.subs[i].rc < 0) {
+				fprintf(stderr, "%s: error generating auth vector\n",
+					bulk.subs[i].imsi);
+				errors++;
+				continue;
+			}
+			fwrite(bulk.out + i * bulk.out_max, 1,
+			       bulk.subs[i].out_len, stdout);
+			num_vecs += bulk.num_vec;
+		}
+		num_subs += n;
+	}
+	fflush(stdout);
+	gettimeofday(&stop, NULL);
+
+	timersub(&stop, &start, &diff);
+	secs = diff.tv_sec + diff.tv_usec / 1000000.0;
+	fprintf(stderr, "%u subscribers, %llu vectors in %.3f s: %.0f vectors/s "
+		"with %u threads, %u errors\n", num_subs, num_vecs, secs,
+		secs > 0 ? num_vecs / secs : 0, num_threads, errors);
+	rc = errors ? 1 : 0;
+
+out:
+	pthread_mutex_lock(&bulk.lock);
+	bulk.quit = 1;
+	pthread_cond_broadcast(&bulk.work_cv);
+	pthread_mutex_unlock(&bulk.lock);
+	for (i = 0; i < num_started; i++)
+		pthread_join(threads[i], NULL);
+
+	if (in != stdin)
+		fclose(in);
+	if (rnd_fd >= 0)
+		close(rnd_fd);
+	free(threads);
+	free(bulk.subs);
+	free(bulk.vecs);
+	free(bulk.rands);
+	free(bulk.out);
+
+	return rc;
+}
+
 static void help()
 {
 	printf( "-2  --2g\tUse 2G (GSM) authentication\n"
@@ -80,7 +502,21 @@ static void help()
 		"-s  --sqn\tSpecify SQN (only for 3G)\n"
 		"-A  --auts\tSpecify AUTS (only for 3G)\n"
 		"-r  --rand\tSpecify random value\n"
-		"-I  --ipsec\tOutput in triplets.dat format for strongswan\n");
+		"-I  --ipsec\tOutput in triplets.dat format for strongswan\n"
+		"-b  --bulk\tGenerate vectors for all subscribers in a file (- for stdin)\n"
+		"-j  --threads\tNumber of worker threads in bulk mode\n"
+		"-n  --num-vectors\tNumber of vectors per subscriber in bulk mode\n"
+		"-B  --binary\tBinary output in bulk mode\n"
+		"\n"
+		"Bulk mode reads one subscriber per line:\n"
+		"  IMSI,ALGORITHM,KI_OR_K[,OPC[,SQN]]\n"
+		"OPC is required for MILENAGE, AMF is taken from --amf. RAND is random\n"
+		"unless given by --rand. One line is written per vector:\n"
+		"  IMSI,SQN,RAND,AUTN,CK,IK,RES,SRES,KC\n"
+		"with the UMTS fields empty for GSM algorithms, or with --binary a\n"
+		"118 byte record: IMSI (16, NUL padded), SQN (8, big endian),\n"
+		"RAND, AUTN, CK, IK, RES (16 each), RES length (1), SRES (4), Kc (8),\n"
+		"auth types (1). Throughput is reported on stderr.\n");
 }
 
 int main(int argc, char **argv)
@@ -92,11 +528,11 @@ int main(int argc, char **argv)
 	int rand_is_set = 0;
 	int auts_is_set = 0;
 	int fmt_triplets_dat = 0;
-
-	printf("osmo-auc-gen (C) 2011-2012 by Harald Welte\n");
-	printf("This is FREE SOFTWARE with ABSOLUTELY NO WARRANTY\n\n");
+	const char *bulk_path = NULL;
+	long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
 
 	memset(_auts, 0, sizeof(_auts));
+	bulk.num_vec = 1;
 
 	while (1) {
 		int c;
@@ -113,13 +549,17 @@ int main(int argc, char **argv)
 			{ "rand", 1, 0, 'r' },
 			{ "auts", 1, 0, 'A' },
 			{ "help", 0, 0, 'h' },
+			{ "bulk", 1, 0, 'b' },
+			{ "threads", 1, 0, 'j' },
+			{ "num-vectors", 1, 0, 'n' },
+			{ "binary", 0, 0, 'B' },
 			{ 0, 0, 0, 0 }
 		};
 
 		rc = 0;
 
-		c = getopt_long(argc, argv, "23a:k:o:f:s:r:hO:A:I", long_options,
-				&option_index);
+		c = getopt_long(argc, argv, "23a:k:o:f:s:r:hO:A:Ib:j:n:B",
+				long_options, &option_index);
 
 		if (c == -1)
 			break;
@@ -200,6 +640,23 @@ int main(int argc, char **argv)
 		case 'I':
 			fmt_triplets_dat = 1;
 			break;
+		case 'b':
+			bulk_path = optarg;
+			break;
+		case 'j':
+			num_threads = atol(optarg);
+			if (num_threads < 1)
+				rc = -EINVAL;
+			break;
+		case 'n':
+			ul = strtoul(optarg, 0, 10);
+			if (ul < 1 || ul > BULK_MAX_VEC)
+				rc = -EINVAL;
+			bulk.num_vec = ul;
+			break;
+		case 'B':
+			bulk.binary = 1;
+			break;
 		case 'h':
 			help();
 			exit(0);
@@ -214,6 +671,16 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (bulk_path) {
+		if (num_threads < 1)
+			num_threads = 1;
+		exit(bulk_run(bulk_path, num_threads, &test_aud,
+			      rand_is_set ? _rand : NULL));
+	}
+
+	printf("osmo-auc-gen (C) 2011-2012 by Harald Welte\n");
+	printf("This is FREE SOFTWARE with ABSOLUTELY NO WARRANTY\n\n");
+
 	if (!rand_is_set) {
 		int i;
 		printf("WARNING: We're using really weak random numbers!\n\n");